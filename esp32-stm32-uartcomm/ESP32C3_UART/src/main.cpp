@@ -1,13 +1,12 @@
 #include <Arduino.h>
 #include <HardwareSerial.h>
+#include "msg_assembler.h"
 
 #define UART_BAUDRATE 115200
-#define MAX_MSG_LEN 64  // Reduced buffer size for simplicity
 
 HardwareSerial SerialSTM32(1); // RX=19, TX=18
 
-char receivedMsg[MAX_MSG_LEN];
-uint16_t msgIndex = 0;
+MsgAssembler receivedMsg;
 
 void setup() {
     Serial.begin(115200);
@@ -20,28 +19,13 @@ void loop() {
     while (SerialSTM32.available()) {
         char c = SerialSTM32.read();
 
-        if (c == '\r') {
-            // Ignore carriage return
-            continue;
-        }
-
-        if (c == '\n') {
-            // End of message
-            if (msgIndex > 0) {
-                receivedMsg[msgIndex] = '\0'; // Null-terminate the string
-                Serial.print("Received: ");
-                Serial.println(receivedMsg);
-                msgIndex = 0;
-            }
-        } else {
-            if (msgIndex < (MAX_MSG_LEN - 1)) {
-                // Add to buffer
-                receivedMsg[msgIndex++] = c;
-            } else {
-                // Buffer overflow handling
-                Serial.println("Error: Received message too long");
-                msgIndex = 0;
-            }
+        MsgStatus status = msgAssemblerFeed(&receivedMsg, c);
+        if (status == MSG_COMPLETE) {
+            Serial.print("Received: ");
+            Serial.println(receivedMsg.msg);
+        } else if (status == MSG_TOO_LONG) {
+            // Buffer overflow handling
+            Serial.println("Error: Received message too long");
         }
     }
 
@@ -0,0 +1,27 @@
+#include "msg_assembler.h"
+
+MsgStatus msgAssemblerFeed(MsgAssembler *assembler, char c) {
+    if (c == '\r') {
+        // Ignore carriage return
+        return MSG_PENDING;
+    }
+
+    if (c == '\n') {
+        // End of message
+        if (assembler->index > 0) {
+            assembler->msg[assembler->index] = '\0'; // Null-terminate the string
+            assembler->index = 0;
+            return MSG_COMPLETE;
+        }
+    } else {
+        if (assembler->index < (MAX_MSG_LEN - 1)) {
+            // Add to buffer
+            assembler->msg[assembler->index++] = c;
+        } else {
+            // Buffer overflow handling
+            assembler->index = 0;
+            return MSG_TOO_LONG;
+        }
+    }
+    return MSG_PENDING;
+}
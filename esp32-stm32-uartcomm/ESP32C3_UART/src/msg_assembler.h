@@ -0,0 +1,31 @@
+#ifndef MSG_ASSEMBLER_H
+#define MSG_ASSEMBLER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_MSG_LEN 64  // Reduced buffer size for simplicity
+
+// Newline-delimited messages from the STM32, fed one byte at a time in loop().
+// Also compiled into example/sim/framers.c, so the framer tests run this code.
+typedef struct {
+    char msg[MAX_MSG_LEN];
+    uint16_t index;
+} MsgAssembler;
+
+typedef enum {
+    MSG_PENDING,  // Byte stored or ignored
+    MSG_COMPLETE, // msg holds the NUL-terminated message until the next byte
+    MSG_TOO_LONG  // Buffer full, the message so far is dropped
+} MsgStatus;
+
+MsgStatus msgAssemblerFeed(MsgAssembler *assembler, char c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,10 +1,10 @@
 #include "stm32f0xx_hal.h"
+#include "message_assembler.h"
 #include <string.h>
 #include <stdbool.h>
 
 #define RXBUF_SIZE 128
 #define TXBUF_SIZE 256 // Increased buffer size
-#define MESSAGE_BUFFER_SIZE 64
 
 UART_HandleTypeDef huart1;
 
@@ -16,8 +16,7 @@ volatile bool txBusy = false;
 uint8_t rxByte;
 
 // Message buffering for complete messages
-volatile uint8_t messageBuffer[MESSAGE_BUFFER_SIZE];
-volatile uint16_t messageIndex = 0;
+MessageAssembler messageAssembler;
 
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
@@ -46,37 +45,19 @@ int main(void) {
             uint8_t c = rxBuf[rxTail];
             rxTail = (rxTail + 1) % RXBUF_SIZE;
 
-            if (c == '\r') {
-                // Ignore carriage return
-                continue;
-            }
-
-            if (c == '\n') {
-                // End of message
-                if (messageIndex > 0) {
-                    messageBuffer[messageIndex] = '\0'; // Null-terminate
-
-                    // Check if the message is a heartbeat
-                    if (strcmp((char*)messageBuffer, "Heartbeat") == 0) {
-                        // Echo back the heartbeat without prefix
-                        UART_Transmit_Data("Heartbeat\r\n");
-                    }
-
-                    // Optionally, send a confirmation message
-                    UART_Transmit_Data("Echo Sent\r\n"); // Echo Sent without prefix
-
-                    // Reset message index
-                    messageIndex = 0;
-                }
-            } else {
-                if (messageIndex < (MESSAGE_BUFFER_SIZE - 1)) {
-                    // Add to buffer
-                    messageBuffer[messageIndex++] = c;
-                } else {
-                    // Buffer overflow handling
-                    UART_Transmit_Data("Error: Msg too long\r\n");
-                    messageIndex = 0;
+            MessageStatus status = messageAssemblerFeed(&messageAssembler, c);
+            if (status == MESSAGE_COMPLETE) {
+                // Check if the message is a heartbeat
+                if (strcmp((char*)messageAssembler.buffer, "Heartbeat") == 0) {
+                    // Echo back the heartbeat without prefix
+                    UART_Transmit_Data("Heartbeat\r\n");
                 }
+
+                // Optionally, send a confirmation message
+                UART_Transmit_Data("Echo Sent\r\n"); // Echo Sent without prefix
+            } else if (status == MESSAGE_TOO_LONG) {
+                // Buffer overflow handling
+                UART_Transmit_Data("Error: Msg too long\r\n");
             }
         }
 
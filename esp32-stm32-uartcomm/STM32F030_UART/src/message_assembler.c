@@ -0,0 +1,27 @@
+#include "message_assembler.h"
+
+MessageStatus messageAssemblerFeed(MessageAssembler *assembler, uint8_t c) {
+    if (c == '\r') {
+        // Ignore carriage return
+        return MESSAGE_PENDING;
+    }
+
+    if (c == '\n') {
+        // End of message
+        if (assembler->index > 0) {
+            assembler->buffer[assembler->index] = '\0'; // Null-terminate
+            assembler->index = 0;
+            return MESSAGE_COMPLETE;
+        }
+    } else {
+        if (assembler->index < (MESSAGE_BUFFER_SIZE - 1)) {
+            // Add to buffer
+            assembler->buffer[assembler->index++] = c;
+        } else {
+            // Buffer overflow handling
+            assembler->index = 0;
+            return MESSAGE_TOO_LONG;
+        }
+    }
+    return MESSAGE_PENDING;
+}
@@ -0,0 +1,31 @@
+#ifndef MESSAGE_ASSEMBLER_H
+#define MESSAGE_ASSEMBLER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MESSAGE_BUFFER_SIZE 64
+
+// Newline-delimited messages from the ESP32, fed one byte at a time from the RX ring.
+// Also compiled into example/sim/framers.c, so the framer tests run this code.
+typedef struct {
+    uint8_t buffer[MESSAGE_BUFFER_SIZE];
+    uint16_t index;
+} MessageAssembler;
+
+typedef enum {
+    MESSAGE_PENDING,  // Byte stored or ignored
+    MESSAGE_COMPLETE, // buffer holds the NUL-terminated message until the next byte
+    MESSAGE_TOO_LONG  // Buffer full, the message so far is dropped
+} MessageStatus;
+
+MessageStatus messageAssemblerFeed(MessageAssembler *assembler, uint8_t c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+#include "block_pool.h"
+#include "critical.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+void *POOL_FALLBACK_MALLOC(size_t size); // malloc/free unless a harness replaces them
+void POOL_FALLBACK_FREE(void *ptr);
+
+typedef struct {
+    uint16_t blockSize;
+    uint16_t blocks;
+    uint8_t *begin;
+    void *freeList; // Next pointer kept in the first word of each free block
+    PoolClassStats stats;
+} PoolClass;
+
+#define POOL_STORAGE(size, count)                                           \
+    _Static_assert((size) % 8 == 0 && (size) > 0, "pool block size");       \
+    static uint64_t poolStorage##size[(size) * (count) / sizeof(uint64_t)];
+POOL_CLASSES(POOL_STORAGE)
+
+#define POOL_ENTRY(size, count) \
+    {(size), (count), (uint8_t *)poolStorage##size, NULL, {(size), (count), 0, 0, 0, 0}},
+static PoolClass classes[] = {POOL_CLASSES(POOL_ENTRY)};
+
+#define CLASS_COUNT (sizeof(classes) / sizeof(classes[0]))
+
+static PoolStats fallbackStats;
+static bool ready;
+static CriticalFlag lock; // operator new runs from the RX interrupt as well as from the main loop
+
+/* Lazily, as static constructors may allocate before main() */
+static void buildFreeLists(void) {
+    for (uint32_t c = 0; c < CLASS_COUNT; c++) {
+        PoolClass *cls = &classes[c];
+        cls->freeList = NULL;
+        for (uint32_t i = cls->blocks; i-- > 0;) {
+            void **block = (void **)(cls->begin + i * cls->blockSize);
+            *block = cls->freeList;
+            cls->freeList = block;
+        }
+    }
+    ready = true;
+}
+
+void *poolAlloc(size_t size) {
+    uint32_t key = criticalEnter(&lock);
+    uint32_t c = 0;
+
+    if (!ready) {
+        buildFreeLists();
+    }
+    while (c < CLASS_COUNT && classes[c].blockSize < size) {
+        c++;
+    }
+    for (uint32_t first = c; c < CLASS_COUNT; c++) {
+        PoolClass *cls = &classes[c];
+        void **block = (void **)cls->freeList;
+        if (!block) {
+            if (c == first) {
+                cls->stats.exhausted++;
+            }
+            continue; // Spill into the next larger class
+        }
+        cls->freeList = *block;
+        cls->stats.allocs++;
+        if (++cls->stats.inUse > cls->stats.peak) {
+            cls->stats.peak = cls->stats.inUse;
+        }
+        criticalExit(&lock, key);
+        return block;
+    }
+
+    fallbackStats.fallbacks++;
+    fallbackStats.fallbackBytes += (uint32_t)size;
+    if (size > classes[CLASS_COUNT - 1].blockSize) {
+        fallbackStats.oversize++;
+    }
+    criticalExit(&lock, key);
+
+    void *ptr = POOL_FALLBACK_MALLOC(size);
+    if (!ptr) {
+        key = criticalEnter(&lock);
+        fallbackStats.failures++;
+        criticalExit(&lock, key);
+    }
+    return ptr;
+}
+
+static PoolClass *classOf(const void *ptr) {
+    const uint8_t *p = (const uint8_t *)ptr;
+    for (uint32_t c = 0; c < CLASS_COUNT; c++) {
+        PoolClass *cls = &classes[c];
+        if (p >= cls->begin && p < cls->begin + (size_t)cls->blocks * cls->blockSize) {
+            return cls;
+        }
+    }
+    return NULL;
+}
+
+bool poolOwns(const void *ptr) {
+    return ptr && classOf(ptr);
+}
+
+void poolFree(void *ptr) {
+    PoolClass *cls = ptr ? classOf(ptr) : NULL;
+    if (!cls) {
+        POOL_FALLBACK_FREE(ptr);
+        return;
+    }
+    uint32_t key = criticalEnter(&lock);
+    *(void **)ptr = cls->freeList;
+    cls->freeList = ptr;
+    cls->stats.inUse--;
+    criticalExit(&lock, key);
+}
+
+uint32_t poolClassCount(void) {
+    return CLASS_COUNT;
+}
+
+void poolClassStats(uint32_t index, PoolClassStats *stats) {
+    uint32_t key = criticalEnter(&lock);
+    *stats = classes[index < CLASS_COUNT ? index : CLASS_COUNT - 1].stats;
+    criticalExit(&lock, key);
+}
+
+void poolStats(PoolStats *stats) {
+    uint32_t key = criticalEnter(&lock);
+    *stats = fallbackStats;
+    criticalExit(&lock, key);
+}
+
+void poolExport(PoolWriteFn write, void *ctx) {
+    PoolClassStats cls;
+    PoolStats fb;
+    char line[112];
+
+    for (uint32_t c = 0; c < CLASS_COUNT; c++) {
+        poolClassStats(c, &cls);
+        snprintf(line, sizeof(line), "[POOL] %u B: %u/%u in use, peak %u, %lu allocs, %lu exhausted",
+                 (unsigned)cls.blockSize, (unsigned)cls.inUse, (unsigned)cls.blocks, (unsigned)cls.peak,
+                 (unsigned long)cls.allocs, (unsigned long)cls.exhausted);
+        write(ctx, line);
+    }
+    poolStats(&fb);
+    snprintf(line, sizeof(line), "[POOL] malloc fallback: %lu (%lu B, %lu oversize), %lu failed",
+             (unsigned long)fb.fallbacks, (unsigned long)fb.fallbackBytes, (unsigned long)fb.oversize,
+             (unsigned long)fb.failures);
+    write(ctx, line);
+}
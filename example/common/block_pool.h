@@ -0,0 +1,86 @@
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed-block pools for the MicroOcpp objects (global operator new/delete in
+ * common/pool_new.cpp).
+ *
+ * Each size class is a static array of equal blocks with an intrusive free
+ * list. So alloc and free are O(1), and the pools cannot fragment. A request
+ * takes the smallest class that fits. If that class is empty, it takes the
+ * next larger one. If every larger class is empty too, or the request is
+ * larger than the biggest block, it falls back to malloc. Both cases are
+ * counted.
+ *
+ * Size the classes from an allocation trace: sim/pool_bench.c prints the
+ * peak live blocks per bucket of the heap statistics (common/heap_stats.h)
+ * and the classes that hold every peak in the fewest bytes. The defaults are
+ * its result for the synthetic MicroOcpp-like trace, 3432 B. Override
+ * POOL_CLASSES with X(block bytes, block count) entries in ascending size.
+ * Block sizes must be multiples of 8, as malloc alignment is.
+ */
+
+#ifndef BLOCK_POOL
+#define BLOCK_POOL 0 // Set to 1 when common/pool_new.cpp is linked in
+#endif
+
+#ifndef POOL_CLASSES
+#define POOL_CLASSES(X) \
+    X(48, 23)           \
+    X(56, 2)            \
+    X(72, 8)            \
+    X(96, 6)            \
+    X(184, 3)           \
+    X(512, 1)
+#endif
+
+#ifndef POOL_FALLBACK_MALLOC
+#define POOL_FALLBACK_MALLOC malloc
+#define POOL_FALLBACK_FREE   free
+#endif
+
+typedef void (*PoolWriteFn)(void *ctx, const char *line);
+
+typedef struct {
+    uint16_t blockSize;
+    uint16_t blocks;
+    uint16_t inUse;
+    uint16_t peak;
+    uint32_t allocs;
+    uint32_t exhausted; // Requests for this class that found it empty
+} PoolClassStats;
+
+typedef struct {
+    uint32_t fallbacks;     // Requests served by malloc
+    uint32_t fallbackBytes;
+    uint32_t oversize;      // Of those, larger than the biggest block
+    uint32_t failures;      // malloc returned NULL as well
+} PoolStats;
+
+void *poolAlloc(size_t size);
+
+/* NULL and malloc'd pointers are accepted */
+void poolFree(void *ptr);
+
+bool poolOwns(const void *ptr);
+
+uint32_t poolClassCount(void);
+void poolClassStats(uint32_t index, PoolClassStats *stats);
+void poolStats(PoolStats *stats);
+
+/* "[POOL] <size> B: <inUse>/<blocks> ..." per class and a fallback line */
+void poolExport(PoolWriteFn write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BLOCK_POOL_H */
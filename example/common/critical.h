@@ -0,0 +1,53 @@
+#ifndef CRITICAL_H
+#define CRITICAL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Short critical section shared by the interrupt handlers and the main loop.
+ *
+ * On Cortex-M it masks interrupts (PRIMASK) and restores the previous mask on
+ * exit, so it nests and may be taken inside an interrupt. On a host the
+ * interrupts are threads (native/hal_shim.c), so it spins on the caller's
+ * flag instead. The flag is unused on Cortex-M.
+ *
+ *   static CriticalFlag lock;
+ *   uint32_t key = criticalEnter(&lock);
+ *   ...
+ *   criticalExit(&lock, key);
+ */
+
+typedef volatile uint8_t CriticalFlag;
+
+static inline uint32_t criticalEnter(CriticalFlag *flag) {
+#if defined(__arm__)
+    uint32_t primask;
+    (void)flag;
+    __asm volatile("mrs %0, primask\n\tcpsid i" : "=r"(primask)::"memory");
+    return primask;
+#else
+    while (__atomic_test_and_set(flag, __ATOMIC_ACQUIRE)) {
+    }
+    return 0;
+#endif
+}
+
+static inline void criticalExit(CriticalFlag *flag, uint32_t key) {
+#if defined(__arm__)
+    (void)flag;
+    __asm volatile("msr primask, %0" ::"r"(key) : "memory");
+#else
+    (void)key;
+    __atomic_clear(flag, __ATOMIC_RELEASE);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRITICAL_H */
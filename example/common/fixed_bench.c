@@ -0,0 +1,163 @@
+#include "fixed_bench.h"
+#include "fixed_point.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#define BENCH_PAIRS 80 // One 50 Hz cycle at 4 kHz
+#define BENCH_FRAC  11
+#define BENCH_FULL_SCALE_MV 409600
+#define BENCH_FULL_SCALE_MA 51200
+
+/* 230 V and 16 A at PF 0.98, 0.2 V and 0.025 A per count around 2048 */
+static const uint16_t benchPairs[BENCH_PAIRS * 2] = {
+    2048, 1868, 2176, 1938, 2302, 2009, 2428, 2080, 2551, 2150, 2670, 2221, 2786, 2290, 2898, 2358,
+    3004, 2423, 3104, 2487, 3198, 2548, 3285, 2605, 3364, 2659, 3435, 2710, 3497, 2756, 3551, 2798,
+    3595, 2836, 3629, 2868, 3654, 2896, 3669, 2918, 3674, 2935, 3669, 2946, 3654, 2952, 3629, 2953,
+    3595, 2947, 3551, 2936, 3497, 2920, 3435, 2899, 3364, 2872, 3285, 2840, 3198, 2803, 3104, 2761,
+    3004, 2715, 2898, 2665, 2786, 2611, 2670, 2554, 2551, 2494, 2428, 2431, 2302, 2365, 2176, 2297,
+    2048, 2228, 1920, 2158, 1794, 2087, 1668, 2016, 1545, 1946, 1426, 1875, 1310, 1806, 1198, 1738,
+    1092, 1673, 992,  1609, 898,  1548, 811,  1491, 732,  1437, 661,  1386, 599,  1340, 545,  1298,
+    501,  1260, 467,  1228, 442,  1200, 427,  1178, 422,  1161, 427,  1150, 442,  1144, 467,  1143,
+    501,  1149, 545,  1160, 599,  1176, 661,  1197, 732,  1224, 811,  1256, 898,  1293, 992,  1335,
+    1092, 1381, 1198, 1431, 1310, 1485, 1426, 1542, 1545, 1602, 1668, 1665, 1794, 1731, 1920, 1799,
+};
+
+#if FX_BENCH_FLOAT
+typedef struct {
+    float vv;
+    float ii;
+    float vi;
+} FloatSums;
+
+static volatile float sinkFloat;
+#endif
+
+/* Results go here so the compiler keeps the work */
+static volatile int32_t sinkFixed;
+static volatile float limitAmps = 16.0f;
+static volatile uint32_t windowPairs = BENCH_PAIRS; // Read every round: nothing hoisted out of the loops
+
+#if FX_BENCH_FLOAT
+static void floatSumPairs(const uint16_t *pairs, uint32_t n, float biasV, float biasI, FloatSums *s) {
+    for (uint32_t k = 0; k < n; k++) {
+        float v = ((float)pairs[2 * k] - biasV) * 0.2f;
+        float i = ((float)pairs[2 * k + 1] - biasI) * 0.025f;
+
+        s->vv += v * v;
+        s->ii += i * i;
+        s->vi += v * i;
+    }
+}
+
+static uint16_t floatPilotDuty(float amps) {
+    if (amps < 6.0f) {
+        return 1000;
+    }
+    amps = amps > 80.0f ? 80.0f : amps;
+    return (uint16_t)(amps <= 51.0f ? amps / 0.06f + 0.5f : amps * 4.0f + 640.5f);
+}
+#endif
+
+static void report(const char *step, uint32_t fixed, uint32_t flt, uint32_t rounds, const char *per,
+                   const char *unit, FxBenchWriteFn write, void *ctx) {
+    char line[128];
+
+#if FX_BENCH_FLOAT
+    snprintf(line, sizeof(line), "[FIXED] %s: fixed %lu %s, float %lu %s %s", step,
+             (unsigned long)(fixed / rounds), unit, (unsigned long)(flt / rounds), unit, per);
+#else
+    (void)flt;
+    snprintf(line, sizeof(line), "[FIXED] %s: fixed %lu %s %s", step, (unsigned long)(fixed / rounds), unit, per);
+#endif
+    write(ctx, line);
+}
+
+void fxBench(FxBenchClockFn clock, const char *unit, uint32_t rounds, FxBenchWriteFn write, void *ctx) {
+    uint32_t start, fixed, flt = 0;
+#if FX_SIMD_KERNEL
+    uint32_t simd;
+    char line[128];
+#endif
+    FxPairSums sums = {0};
+#if FX_BENCH_FLOAT
+    FloatSums floatSums = {0};
+#endif
+
+    rounds = rounds ? rounds : 1;
+
+    /* DMA interrupt: sums of one cycle */
+    start = clock();
+    for (uint32_t r = 0; r < rounds; r++) {
+        sums = (FxPairSums){0};
+        fxSumPairs(benchPairs, BENCH_PAIRS, 2048, 2048, &sums);
+        sinkFixed = (int32_t)sums.vi;
+    }
+    fixed = clock() - start;
+#if FX_BENCH_FLOAT
+    start = clock();
+    for (uint32_t r = 0; r < rounds; r++) {
+        floatSums = (FloatSums){0};
+        floatSumPairs(benchPairs, BENCH_PAIRS, 2048.0f, 2048.0f, &floatSums);
+        sinkFloat = floatSums.vi;
+    }
+    flt = clock() - start;
+#endif
+    report("sums", fixed, flt, rounds, "per 80 pairs", unit, write, ctx);
+
+#if FX_SIMD_KERNEL
+    /* The same sums two pairs per step, against the scalar loop */
+    start = clock();
+    for (uint32_t r = 0; r < rounds; r++) {
+        sums = (FxPairSums){0};
+        fxSumPairsSimd(benchPairs, BENCH_PAIRS, 2048, 2048, &sums);
+        sinkFixed = (int32_t)sums.vi;
+    }
+    simd = clock() - start;
+    start = clock();
+    for (uint32_t r = 0; r < rounds; r++) {
+        sums = (FxPairSums){0};
+        fxSumPairsScalar(benchPairs, BENCH_PAIRS, 2048, 2048, &sums);
+        sinkFixed = (int32_t)sums.vi;
+    }
+    fixed = clock() - start;
+    snprintf(line, sizeof(line), "[FIXED] sums %s: simd %lu %s, scalar %lu %s per 80 pairs",
+             FX_SIMD ? "dsp" : "emulated", (unsigned long)(simd / rounds), unit, (unsigned long)(fixed / rounds), unit);
+    write(ctx, line);
+#endif
+
+    /* meterUpdate(): Vrms, Irms and power of a window */
+    start = clock();
+    for (uint32_t r = 0; r < rounds; r++) {
+        sinkFixed = fxScaleQ31(fxRmsQ31(sums.vv, windowPairs, BENCH_FRAC), BENCH_FULL_SCALE_MV);
+        sinkFixed = fxScaleQ31(fxRmsQ31(sums.ii, windowPairs, BENCH_FRAC), BENCH_FULL_SCALE_MA);
+        sinkFixed = fxScaleQ31(fxMeanQ31(sums.vi, windowPairs, BENCH_FRAC),
+                               (int32_t)((int64_t)BENCH_FULL_SCALE_MV * BENCH_FULL_SCALE_MA / 1000));
+    }
+    fixed = clock() - start;
+#if FX_BENCH_FLOAT
+    start = clock();
+    for (uint32_t r = 0; r < rounds; r++) {
+        sinkFloat = sqrtf(floatSums.vv / windowPairs);
+        sinkFloat = sqrtf(floatSums.ii / windowPairs);
+        sinkFloat = floatSums.vi / windowPairs;
+    }
+    flt = clock() - start;
+#endif
+    report("window", fixed, flt, rounds, "per update", unit, write, ctx);
+
+    /* setSmartChargingCurrent(): limit to pilot duty cycle */
+    start = clock();
+    for (uint32_t r = 0; r < rounds; r++) {
+        sinkFixed = fxPilotDuty((int32_t)fxMulShift(fxFromFloat(limitAmps, 16), 1000, 16));
+    }
+    fixed = clock() - start;
+#if FX_BENCH_FLOAT
+    start = clock();
+    for (uint32_t r = 0; r < rounds; r++) {
+        sinkFloat = floatPilotDuty(limitAmps);
+    }
+    flt = clock() - start;
+#endif
+    report("limit", fixed, flt, rounds, "per call", unit, write, ctx);
+}
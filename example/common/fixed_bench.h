@@ -0,0 +1,45 @@
+#ifndef FIXED_BENCH_H
+#define FIXED_BENCH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cost of the fixed-point metering kernels (fixed_point.h) against the same
+ * steps in float.
+ *
+ * Three steps are timed on one 50 Hz cycle of V, I pairs, 230 V and 16 A at
+ * PF 0.98: the per-sample sums of the DMA interrupt, the per-window Vrms, Irms
+ * and power of meterUpdate(), and the current limit to pilot duty cycle of
+ * setSmartChargingCurrent(). The float versions convert each sample to volts
+ * and amps and sum in float, and use sqrtf(), as a meter written with float
+ * would.
+ *
+ * The clock is the caller's: cycleStamp() on the target, or nanoseconds on a
+ * host. The float versions are only timed where float is the soft-float
+ * library (__SOFTFP__, as on the F030). A host FPU would say nothing about
+ * what the fixed-point code saves, and gcc for x86-64 has no soft-float.
+ */
+
+#ifndef FX_BENCH_FLOAT
+#ifdef __SOFTFP__
+#define FX_BENCH_FLOAT 1
+#else
+#define FX_BENCH_FLOAT 0
+#endif
+#endif
+
+typedef uint32_t (*FxBenchClockFn)(void);
+typedef void (*FxBenchWriteFn)(void *ctx, const char *line);
+
+/* "[FIXED] <step>: fixed <n> <unit>, float <n> <unit> ..." averaged over rounds, without float if FX_BENCH_FLOAT is 0 */
+void fxBench(FxBenchClockFn clock, const char *unit, uint32_t rounds, FxBenchWriteFn write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FIXED_BENCH_H */
@@ -0,0 +1,288 @@
+#include "fixed_point.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if FX_SIMD
+#include <arm_acle.h>
+#endif
+
+#define ADC_MAX 4095
+
+void fxSumPairs(const uint16_t *pairs, uint32_t n, int32_t biasV, int32_t biasI, FxPairSums *s) {
+#if FX_SIMD
+    fxSumPairsSimd(pairs, n, biasV, biasI, s);
+#else
+    fxSumPairsScalar(pairs, n, biasV, biasI, s);
+#endif
+}
+
+void fxSumPairsScalar(const uint16_t *pairs, uint32_t n, int32_t biasV, int32_t biasI, FxPairSums *s) {
+    while (n > 0) {
+        uint32_t chunk = n < FX_PAIR_CHUNK ? n : FX_PAIR_CHUNK;
+        uint32_t rawV = 0, rawI = 0, vv = 0, ii = 0, clipped = 0;
+        int32_t vi = 0;
+
+        for (uint32_t k = 0; k < chunk; k++, pairs += 2) {
+            int32_t v = (int32_t)pairs[0] - biasV;
+            int32_t i = (int32_t)pairs[1] - biasI;
+            rawV += pairs[0];
+            rawI += pairs[1];
+            vv += (uint32_t)(v * v);
+            ii += (uint32_t)(i * i);
+            vi += v * i;
+            clipped += (pairs[0] == 0 || pairs[0] >= ADC_MAX) + (pairs[1] == 0 || pairs[1] >= ADC_MAX);
+        }
+        s->rawV += rawV;
+        s->rawI += rawI;
+        s->vv += vv;
+        s->ii += ii;
+        s->vi += vi;
+        s->clipped += clipped;
+        n -= chunk;
+    }
+}
+
+#if FX_SIMD_KERNEL
+#if !FX_SIMD
+/* The DSP instructions as the ARMv7E-M manual defines them, halfwords [hi:lo] */
+static inline int32_t lo16(uint32_t x) {
+    return (int16_t)(x & 0xFFFF);
+}
+
+static inline int32_t hi16(uint32_t x) {
+    return (int16_t)(x >> 16);
+}
+
+static inline uint32_t ssub16(uint32_t a, uint32_t b) {
+    return ((uint32_t)(lo16(a) - lo16(b)) & 0xFFFF) | (uint32_t)(hi16(a) - hi16(b)) << 16;
+}
+
+static inline uint32_t usub16(uint32_t a, uint32_t b) {
+    return ((a - b) & 0xFFFF) | (((a >> 16) - (b >> 16)) << 16);
+}
+
+static inline int32_t smlad(uint32_t a, uint32_t b, int32_t acc) {
+    return (int32_t)((uint32_t)acc + (uint32_t)(lo16(a) * lo16(b)) + (uint32_t)(hi16(a) * hi16(b)));
+}
+
+static inline int64_t smlald(uint32_t a, uint32_t b, int64_t acc) {
+    return (int64_t)((uint64_t)acc + (uint64_t)(int64_t)(lo16(a) * lo16(b)) + (uint64_t)(int64_t)(hi16(a) * hi16(b)));
+}
+
+/* USUB16 sets a GE bit per halfword without borrow, SEL picks by them */
+static inline uint32_t geSel16(uint32_t a, uint32_t b, uint32_t ifGe) {
+    return ((a & 0xFFFF) >= (b & 0xFFFF) ? ifGe & 0xFFFF : 0) | ((a >> 16) >= (b >> 16) ? ifGe & 0xFFFF0000 : 0);
+}
+#else
+#define ssub16 __ssub16
+#define smlad  __smlad
+#define smlald __smlald
+#define usub16 __usub16
+
+static inline uint32_t geSel16(uint32_t a, uint32_t b, uint32_t ifGe) {
+    (void)__usub16(a, b); // Only the GE flags
+    return __sel(ifGe, 0);
+}
+#endif
+
+/* 1 in each halfword that holds 0 or >= 4095: h - 1 wraps 0 to 0xFFFF */
+static inline uint32_t clipFlags(uint32_t raw) {
+    return geSel16(usub16(raw, 0x00010001u), 0x0FFE0FFEu, 0x00010001u);
+}
+
+void fxSumPairsSimd(const uint16_t *pairs, uint32_t n, int32_t biasV, int32_t biasI, FxPairSums *s) {
+    uint32_t packedV = (uint32_t)(uint16_t)biasV * 0x00010001u, packedI = (uint32_t)(uint16_t)biasI * 0x00010001u;
+    int32_t rawV = 0, rawI = 0, clipped = 0;
+    int64_t vv = 0, ii = 0, vi = 0;
+
+    for (; n >= 2; n -= 2, pairs += 4) {
+        uint32_t w0, w1, rv, ri, v, i;
+
+        memcpy(&w0, pairs, sizeof(w0)); // [I0:V0]
+        memcpy(&w1, pairs + 2, sizeof(w1)); // [I1:V1]
+        rv = (w0 & 0xFFFF) | (w1 << 16); // PKHBT: [V1:V0]
+        ri = (w0 >> 16) | (w1 & 0xFFFF0000u); // PKHTB: [I1:I0]
+        v = ssub16(rv, packedV);
+        i = ssub16(ri, packedI);
+        vv = smlald(v, v, vv);
+        ii = smlald(i, i, ii);
+        vi = smlald(v, i, vi);
+        rawV = smlad(rv, 0x00010001u, rawV); // Samples are 12-bit, positive as signed halfwords
+        rawI = smlad(ri, 0x00010001u, rawI);
+        clipped = smlad(clipFlags(rv) + clipFlags(ri), 0x00010001u, clipped);
+    }
+    s->rawV += (uint32_t)rawV;
+    s->rawI += (uint32_t)rawI;
+    s->vv += (uint64_t)vv;
+    s->ii += (uint64_t)ii;
+    s->vi += vi;
+    s->clipped += (uint32_t)clipped;
+    if (n) {
+        fxSumPairsScalar(pairs, n, biasV, biasI, s); // Odd pair
+    }
+}
+#endif
+
+uint32_t fxSqrt64(uint64_t x) {
+    uint64_t root = 0, bit = (uint64_t)1 << 62;
+
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+q31_t fxRmsQ31(uint64_t sumSquares, uint32_t n, unsigned frac) {
+    uint64_t mean = n ? sumSquares / n : 0;
+
+    if (mean >> (2 * frac)) {
+        return FX_Q31_MAX; // Full scale or above
+    }
+    return (q31_t)fxSqrt64(mean << (62 - 2 * frac));
+}
+
+q31_t fxMeanQ31(int64_t sumProducts, uint32_t n, unsigned frac) {
+    unsigned shift = 31 - 2 * frac;
+    uint64_t mag = sumProducts < 0 ? 0 - (uint64_t)sumProducts : (uint64_t)sumProducts;
+    uint64_t q;
+
+    if (!n) {
+        return 0;
+    }
+    if (mag > (uint64_t)INT64_MAX >> shift) {
+        q = FX_Q31_MAX;
+    } else {
+        q = ((mag << shift) + n / 2) / n;
+        q = q > FX_Q31_MAX ? FX_Q31_MAX : q;
+    }
+    return sumProducts < 0 ? -(q31_t)q : (q31_t)q;
+}
+
+int32_t fxScaleQ31(q31_t x, int32_t fullScale) {
+    int64_t p = (int64_t)x * fullScale;
+    uint64_t mag = p < 0 ? 0 - (uint64_t)p : (uint64_t)p;
+    int32_t q = (int32_t)((mag + (1u << 30)) >> 31);
+    return p < 0 ? -q : q;
+}
+
+int64_t fxMulShift(int64_t a, uint32_t mantissa, unsigned shift) {
+    uint64_t mag = a < 0 ? 0 - (uint64_t)a : (uint64_t)a;
+    uint64_t lo = (mag & 0xFFFFFFFFu) * mantissa;
+    uint64_t hi = (mag >> 32) * mantissa + (lo >> 32); // Product: hi * 2^32 + low
+    uint32_t low = (uint32_t)lo;
+    uint64_t q;
+
+    if (shift <= 32) {
+        uint64_t sum = (uint64_t)low + ((uint64_t)1 << (shift - 1)); // Half of the last bit kept
+        hi += sum >> 32;
+        low = (uint32_t)sum;
+        if (shift == 32) {
+            q = hi;
+        } else if (hi >> (32 + shift)) {
+            q = UINT64_MAX; // Does not fit
+        } else {
+            q = (hi << (32 - shift)) | (low >> shift);
+        }
+    } else {
+        hi += (uint64_t)1 << (shift - 33);
+        q = hi >> (shift - 32);
+    }
+    q = q > INT64_MAX ? INT64_MAX : q;
+    return a < 0 ? -(int64_t)q : (int64_t)q;
+}
+
+uint32_t fxRatio(uint64_t num, uint64_t den, uint8_t *shift) {
+    uint32_t mantissa = 0;
+    int exponent = 31;
+
+    while (num < den) {
+        num <<= 1;
+        exponent++;
+    }
+    while (num >= den << 1) {
+        den <<= 1;
+        exponent--;
+    }
+    for (int i = 0; i < 32; i++) { // den <= num < 2 den: one quotient bit per step
+        mantissa <<= 1;
+        if (num >= den) {
+            mantissa |= 1;
+            num -= den;
+        }
+        num <<= 1;
+    }
+    *shift = (uint8_t)exponent;
+    return mantissa;
+}
+
+int32_t fxFromFloat(float f, unsigned frac) {
+    uint32_t bits, mantissa;
+    int exponent;
+    uint64_t q;
+
+    memcpy(&bits, &f, sizeof(bits));
+    exponent = (int)((bits >> 23) & 0xFF);
+    mantissa = bits & 0x7FFFFF;
+    if (exponent == 0xFF) {
+        if (mantissa) {
+            return 0; // NaN
+        }
+        q = INT32_MAX;
+    } else {
+        if (exponent) {
+            mantissa |= 0x800000; // Normal: 1.m * 2^(e - 127)
+        } else {
+            exponent = 1; // Subnormal: 0.m * 2^-126
+        }
+        exponent += (int)frac - 150; // value * 2^frac = mantissa * 2^exponent
+        if (exponent >= 8) {
+            q = INT32_MAX; // mantissa has 24 bits
+        } else if (exponent >= 0) {
+            q = (uint64_t)mantissa << exponent;
+        } else if (exponent >= -24) {
+            q = ((uint64_t)mantissa + ((uint64_t)1 << (-exponent - 1))) >> -exponent;
+        } else {
+            q = 0; // Below 0.5
+        }
+        q = q > INT32_MAX ? INT32_MAX : q;
+    }
+    return (bits >> 31) ? -(int32_t)q : (int32_t)q;
+}
+
+uint16_t fxPilotDuty(int32_t milliAmps) {
+    if (milliAmps < 6000) {
+        return 1000; // No PWM: the EV must not draw current
+    }
+    if (milliAmps <= 51000) {
+        return (uint16_t)((milliAmps + 30) / 60); // Duty = A / 0.6
+    }
+    if (milliAmps > 80000) {
+        milliAmps = 80000;
+    }
+    return (uint16_t)((milliAmps + 125) / 250 + 640); // Duty = A / 2.5 + 64
+}
+
+void fxFormat(char *out, size_t size, int64_t value, unsigned decimals) {
+    uint64_t mag = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    uint64_t unit = 1;
+
+    for (unsigned i = 0; i < decimals; i++) {
+        unit *= 10;
+    }
+    if (!decimals) {
+        snprintf(out, size, "%s%lu", value < 0 ? "-" : "", (unsigned long)mag);
+        return;
+    }
+    snprintf(out, size, "%s%lu.%0*lu", value < 0 ? "-" : "", (unsigned long)(mag / unit), (int)decimals,
+             (unsigned long)(mag % unit));
+}
@@ -0,0 +1,101 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed-point kernels for the metering and the current limit.
+ *
+ * The F030 has no FPU, so every float operation is a soft-float library call.
+ * These kernels use integers only, and 32x32 multiplies where the Cortex-M0
+ * has them. Samples are signed Q(frac) fractions of the ADC's full scale,
+ * frac <= 15; the 12-bit ADC gives Q11 after the bias is removed. Results
+ * are Q31 fractions of full scale, and fxScaleQ31() turns them into
+ * engineering units (mV, mA, mW) with one multiply.
+ *
+ * Sums go into 64-bit accumulators. fxSumPairs() keeps its per-chunk partial
+ * sums in 32 bits, which FX_PAIR_CHUNK bounds, so a Q11 window can run for
+ * 2^39 samples. fxMulShift() keeps its 96-bit product exact, so the energy
+ * register converts to mWh with no overflow at any value.
+ *
+ * On a Cortex-M4 or M7 (FX_SIMD, from the compiler's __ARM_FEATURE_DSP)
+ * fxSumPairs() takes two pairs per step: SSUB16 removes both biases at once
+ * and SMLAD/SMLALD do two 16-bit multiply-accumulates per instruction. The
+ * F030 and the host use the scalar loop. Off target the packed kernel is
+ * built with the instructions emulated, so its sums can be checked against
+ * the scalar ones.
+ *
+ * Every result is exact or rounded as documented (floor, or nearest with
+ * ties away from zero), so the host checks in sim/fixed_bench.c compare them
+ * bit for bit with exact references.
+ */
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#ifndef FX_SIMD
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#define FX_SIMD 1
+#else
+#define FX_SIMD 0
+#endif
+#endif
+
+#define FX_Q31_MAX    INT32_MAX
+#define FX_PAIR_CHUNK 127 // Pairs per 32-bit partial sum: 127 * 4095² < 2^31
+
+typedef struct {
+    uint32_t rawV; // Sums of the raw samples, for the next biases
+    uint32_t rawI;
+    uint64_t vv;   // Sums of squares and products of the samples less their biases
+    uint64_t ii;
+    int64_t vi;
+    uint32_t clipped; // Samples at 0 or 4095
+} FxPairSums;
+
+/* Adds n interleaved V, I pairs of 12-bit ADC samples to s: fxSumPairsSimd() with FX_SIMD, else the scalar loop */
+void fxSumPairs(const uint16_t *pairs, uint32_t n, int32_t biasV, int32_t biasI, FxPairSums *s);
+void fxSumPairsScalar(const uint16_t *pairs, uint32_t n, int32_t biasV, int32_t biasI, FxPairSums *s);
+
+#if FX_SIMD || !defined(__arm__)
+#define FX_SIMD_KERNEL 1 // Native on a DSP core, emulated on the host
+void fxSumPairsSimd(const uint16_t *pairs, uint32_t n, int32_t biasV, int32_t biasI, FxPairSums *s);
+#endif
+
+/* floor(sqrt(x)) */
+uint32_t fxSqrt64(uint64_t x);
+
+/* RMS in Q31 of n Q(frac) samples from their sum of squares, floored, saturated */
+q31_t fxRmsQ31(uint64_t sumSquares, uint32_t n, unsigned frac);
+
+/* Mean in Q31 of n products of two Q(frac) samples, rounded, saturated to +-FX_Q31_MAX */
+q31_t fxMeanQ31(int64_t sumProducts, uint32_t n, unsigned frac);
+
+/* x * fullScale, rounded: a Q31 fraction in the units of fullScale */
+int32_t fxScaleQ31(q31_t x, int32_t fullScale);
+
+/* a * mantissa / 2^shift, rounded, saturated; the 96-bit product is exact; shift 1..95 */
+int64_t fxMulShift(int64_t a, uint32_t mantissa, unsigned shift);
+
+/* num / den as mantissa * 2^-shift, mantissa in [2^31, 2^32), truncated; num, den in 1..2^62, num / den < 2^31 */
+uint32_t fxRatio(uint64_t num, uint64_t den, uint8_t *shift);
+
+/* IEEE 754 single to Q(frac), rounded, saturated to +-INT32_MAX, NaN to 0, from its bits alone */
+int32_t fxFromFloat(float f, unsigned frac);
+
+/* IEC 61851-1 control pilot duty cycle in 0.1% for a current limit, 1000 below 6 A */
+uint16_t fxPilotDuty(int32_t milliAmps);
+
+/* value / 10^decimals as text, "-1.25", with no float formatting */
+void fxFormat(char *out, size_t size, int64_t value, unsigned decimals);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FIXED_POINT_H */
@@ -0,0 +1,276 @@
+#include "flash_kv.h"
+
+#include <string.h>
+
+#define PAGE_MAGIC 0x4B56 // "VK" in memory
+#define ERASED16   0xFFFF
+#define LEN_MASK   0x7FFF
+
+_Static_assert(FLASH_KV_BATCH_SIZE <= 508, "staged[] holds batch offset / 2 + 1 in a byte");
+
+static uint32_t pad2(uint32_t len) {
+    return (len + 1) & ~1u;
+}
+
+static uint32_t recordSize(uint16_t len) {
+    return FLASH_KV_RECORD + pad2(len & LEN_MASK);
+}
+
+static uint16_t read16(const uint8_t *p) {
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/* CRC-16/CCITT over key, len and value; never 0xFFFF, which marks an unfinished record */
+static uint16_t recordCrc(const uint8_t *record) {
+    uint16_t len = read16(record + 2) & LEN_MASK;
+    uint16_t crc = 0xFFFF;
+    for (uint32_t i = 0; i < 4u + len; i++) {
+        crc ^= (uint16_t)(record[i < 4 ? i : i + 2] << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (uint16_t)(crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1);
+        }
+    }
+    return crc == ERASED16 ? 0 : crc;
+}
+
+static const uint8_t *flashAt(const FlashKv *kv, uint32_t offset) {
+    return flashRingAt(&kv->ring, offset);
+}
+
+static bool openPage(FlashKv *kv, uint32_t page, uint32_t sequence) {
+    if (!flashRingOpen(&kv->ring, page, sequence)) {
+        return false;
+    }
+    kv->headOffset = FLASH_KV_PAGE_HEADER;
+    return true;
+}
+
+/*
+ * Walks the records of a page: returns the offset of the next record, or 0 at
+ * the end of the log. len is programmed first, so an erased len ends the log.
+ * *valid is false for a record whose key or CRC is missing or wrong. A len
+ * that cannot be right ends the page.
+ */
+static uint32_t nextRecord(const FlashKv *kv, uint32_t page, uint32_t offset, bool *valid, uint32_t *end) {
+    uint32_t pageEnd = (page + 1) * kv->ring.dev.pageSize;
+    const uint8_t *r = flashAt(kv, offset);
+
+    *end = offset;
+    if (offset + FLASH_KV_RECORD > pageEnd || read16(r + 2) == ERASED16) {
+        return 0;
+    }
+    uint16_t len = read16(r + 2);
+    if ((len & LEN_MASK) > FLASH_KV_MAX_VALUE || offset + recordSize(len) > pageEnd) {
+        *end = pageEnd; // Corrupt: nothing more is appended to this page
+        return 0;
+    }
+    *valid = read16(r) < FLASH_KV_MAX_KEYS && read16(r + 4) == recordCrc(r);
+    *end = offset + recordSize(len);
+    return *end;
+}
+
+static uint32_t liveLimit(const FlashKv *kv) {
+    return (kv->ring.dev.pages - 2) * (kv->ring.dev.pageSize - FLASH_KV_PAGE_HEADER);
+}
+
+/* Flash bytes of the key's newest record, 0 if it has none in flash */
+static uint32_t flashSize(const FlashKv *kv, uint16_t key) {
+    return kv->index[key] ? recordSize(read16(flashAt(kv, kv->index[key] * 2u) + 2)) : 0;
+}
+
+/* Moves the live records of the oldest page into the head page, then erases it */
+static bool collect(FlashKv *kv) {
+    uint32_t page = kv->ring.tail, offset = page * kv->ring.dev.pageSize + FLASH_KV_PAGE_HEADER, end;
+    bool valid;
+
+    for (uint32_t next; (next = nextRecord(kv, page, offset, &valid, &end)) != 0; offset = next) {
+        uint16_t key = read16(flashAt(kv, offset));
+        if (!valid || kv->index[key] != offset / 2) {
+            continue;
+        }
+        uint32_t size = next - offset;
+        uint32_t to = kv->ring.head * kv->ring.dev.pageSize + kv->headOffset;
+        if (!flashRingProgram(&kv->ring, to, flashAt(kv, offset), size)) {
+            return false;
+        }
+        kv->index[key] = (uint16_t)(to / 2);
+        kv->headOffset += size;
+        kv->stats.copied++;
+    }
+    if (!flashRingRetire(&kv->ring, page)) {
+        return false;
+    }
+    kv->ring.tail = flashRingNext(&kv->ring, page);
+    return true;
+}
+
+static FlashKvResult ensureRoom(FlashKv *kv, uint32_t size) {
+    const FlashRing *ring = &kv->ring;
+
+    for (uint32_t tries = 0; kv->headOffset + size > ring->dev.pageSize; tries++) {
+        if (tries >= ring->dev.pages || !openPage(kv, flashRingNext(ring, ring->head), ring->sequence + 1)) {
+            return tries >= ring->dev.pages ? FLASH_KV_FULL : FLASH_KV_IO;
+        }
+        if (flashRingNext(ring, ring->head) == ring->tail && !collect(kv)) {
+            return FLASH_KV_IO; // The last erased page was just taken
+        }
+    }
+    return FLASH_KV_OK;
+}
+
+static FlashKvResult append(FlashKv *kv, const uint8_t *record) {
+    uint16_t key = read16(record), len = read16(record + 2);
+    uint32_t size = recordSize(len);
+    FlashKvResult result = ensureRoom(kv, size);
+    if (result != FLASH_KV_OK) {
+        return result;
+    }
+
+    FlashRing *ring = &kv->ring;
+    uint32_t to = ring->head * ring->dev.pageSize + kv->headOffset;
+    kv->headOffset += size; // Taken even if programming fails halfway
+    if (!flashRingProgram(ring, to + 2, record + 2, 2) || !flashRingProgram(ring, to, record, 2) ||
+        (size > FLASH_KV_RECORD &&
+         !flashRingProgram(ring, to + FLASH_KV_RECORD, record + FLASH_KV_RECORD, size - FLASH_KV_RECORD)) ||
+        !flashRingProgram(ring, to + 4, record + 4, 2)) { // len, key, value, then the CRC
+        return FLASH_KV_IO;
+    }
+    kv->liveBytes -= flashSize(kv, key);
+    if (len & FLASH_KV_DELETED) {
+        kv->index[key] = 0;
+    } else {
+        kv->index[key] = (uint16_t)(to / 2);
+        kv->liveBytes += size;
+    }
+    kv->stats.records++;
+    return FLASH_KV_OK;
+}
+
+FlashKvResult flashKvMount(FlashKv *kv, const FlashKvDevice *dev) {
+    FlashRingResult mounted;
+
+    memset(kv, 0, sizeof(*kv));
+    mounted = flashRingMount(&kv->ring, dev, PAGE_MAGIC);
+    if (mounted != FLASH_RING_OK) {
+        kv->headOffset = FLASH_KV_PAGE_HEADER;
+        return mounted == FLASH_RING_FORMATTED ? FLASH_KV_OK : FLASH_KV_IO;
+    }
+    if (flashRingNext(&kv->ring, kv->ring.head) == kv->ring.tail && kv->ring.head != kv->ring.tail) {
+        /* No erased page: cut off while collecting. The newest page only holds copies; collect again */
+        if (!flashRingRetire(&kv->ring, kv->ring.head)) {
+            return FLASH_KV_IO;
+        }
+        kv->ring.head = (kv->ring.head + dev->pages - 1) % dev->pages;
+        kv->ring.sequence--;
+    }
+
+    for (uint32_t page = kv->ring.tail;; page = flashRingNext(&kv->ring, page)) {
+        uint32_t offset = page * dev->pageSize + FLASH_KV_PAGE_HEADER, end = offset;
+        bool valid;
+        for (uint32_t next; (next = nextRecord(kv, page, offset, &valid, &end)) != 0; offset = next) {
+            const uint8_t *r = flashAt(kv, offset);
+            if (!valid) {
+                kv->stats.skipped++;
+                continue;
+            }
+            kv->index[read16(r)] = read16(r + 2) & FLASH_KV_DELETED ? 0 : (uint16_t)(offset / 2);
+        }
+        if (page == kv->ring.head) {
+            kv->headOffset = end - page * dev->pageSize;
+            break;
+        }
+    }
+    for (uint16_t key = 0; key < FLASH_KV_MAX_KEYS; key++) {
+        kv->liveBytes += flashSize(kv, key);
+    }
+    return FLASH_KV_OK;
+}
+
+int flashKvGet(const FlashKv *kv, uint16_t key, void *out, uint32_t size) {
+    if (key >= FLASH_KV_MAX_KEYS || (!kv->staged[key] && !kv->index[key])) {
+        return FLASH_KV_NOT_FOUND;
+    }
+    const uint8_t *r = kv->staged[key] ? &kv->batch[(kv->staged[key] - 1) * 2] : flashAt(kv, kv->index[key] * 2u);
+    uint16_t len = read16(r + 2);
+    if (len & FLASH_KV_DELETED) {
+        return FLASH_KV_NOT_FOUND;
+    }
+    memcpy(out, r + FLASH_KV_RECORD, len < size ? len : size);
+    return len;
+}
+
+static FlashKvResult stage(FlashKv *kv, uint16_t key, const void *value, uint16_t len) {
+    uint32_t size = recordSize(len);
+    uint8_t *r;
+
+    if (key >= FLASH_KV_MAX_KEYS || (len & LEN_MASK) > FLASH_KV_MAX_VALUE) {
+        return FLASH_KV_TOO_LARGE;
+    }
+    if (!(len & FLASH_KV_DELETED) && kv->liveBytes - flashSize(kv, key) + size > liveLimit(kv)) {
+        return FLASH_KV_FULL;
+    }
+    kv->stats.sets++;
+    kv->stats.bytesStaged += len & LEN_MASK;
+
+    if (kv->staged[key] && recordSize(read16(&kv->batch[(kv->staged[key] - 1) * 2] + 2)) == size) {
+        r = &kv->batch[(kv->staged[key] - 1) * 2]; // Same key, same size: replace before it reaches flash
+        kv->stats.merged++;
+    } else {
+        if (kv->batchUsed + size > FLASH_KV_BATCH_SIZE) {
+            FlashKvResult result = flashKvFlush(kv);
+            if (result != FLASH_KV_OK) {
+                return result;
+            }
+        }
+        r = &kv->batch[kv->batchUsed];
+        kv->staged[key] = (uint8_t)(kv->batchUsed / 2 + 1);
+        kv->batchUsed += (uint16_t)size;
+    }
+    memcpy(r, &key, 2);
+    memcpy(r + 2, &len, 2);
+    memset(r + FLASH_KV_RECORD, 0xFF, pad2(len & LEN_MASK));
+    memcpy(r + FLASH_KV_RECORD, value, len & LEN_MASK);
+    uint16_t crc = recordCrc(r);
+    memcpy(r + 4, &crc, 2);
+    return FLASH_KV_OK;
+}
+
+FlashKvResult flashKvSet(FlashKv *kv, uint16_t key, const void *value, uint32_t len) {
+    return len > FLASH_KV_MAX_VALUE ? FLASH_KV_TOO_LARGE : stage(kv, key, value, (uint16_t)len);
+}
+
+FlashKvResult flashKvDelete(FlashKv *kv, uint16_t key) {
+    if (key < FLASH_KV_MAX_KEYS && !kv->index[key] && !kv->staged[key]) {
+        return FLASH_KV_NOT_FOUND;
+    }
+    return stage(kv, key, NULL, FLASH_KV_DELETED);
+}
+
+FlashKvResult flashKvFlush(FlashKv *kv) {
+    FlashKvResult result = FLASH_KV_OK;
+    uint16_t used = kv->batchUsed;
+
+    if (!used) {
+        return FLASH_KV_OK;
+    }
+    kv->stats.flushes++;
+    kv->batchUsed = 0; // A record that fails is dropped; the key keeps its previous value
+    for (uint16_t offset = 0; offset < used; offset += (uint16_t)recordSize(read16(&kv->batch[offset + 2]))) {
+        uint16_t key = read16(&kv->batch[offset]);
+        if (kv->staged[key] != offset / 2 + 1) {
+            continue; // Superseded by a later record in the same batch
+        }
+        kv->staged[key] = 0;
+        FlashKvResult appended = append(kv, &kv->batch[offset]);
+        if (appended != FLASH_KV_OK) {
+            result = appended;
+        }
+    }
+    return result;
+}
+
+bool flashKvPending(const FlashKv *kv) {
+    return kv->batchUsed != 0;
+}
@@ -0,0 +1,115 @@
+#ifndef FLASH_KV_H
+#define FLASH_KV_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "flash_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Log-structured key-value store on a reserved flash region.
+ *
+ * The region is a ring of erase pages (flash_ring.h). Each page starts with an
+ * 8-byte header that holds a sequence number, so after a reset the oldest and
+ * the newest page can be found. Records are only ever appended:
+ *   [key u16][len u16][crc u16][value, padded to 2 bytes]
+ * They are programmed in half-words: len first, then key and value, the CRC
+ * last. A record cut short by a reset has no valid CRC and is skipped on the
+ * next mount. A later record for the same key replaces the earlier one. A
+ * record with FLASH_KV_DELETED set in len deletes the key.
+ *
+ * When the newest page is full, the next erased page is opened. If that uses
+ * up the last erased page, the oldest page is collected: its live records are
+ * copied into the newly opened page, then it is erased (its magic is cleared
+ * first, so a cut-off erase does not leave a page that looks valid). If a
+ * reset cuts the copy short, the next mount starts it over. Every page is
+ * therefore erased in turn, and wear is spread over the whole region. The
+ * live data has to fit in all but two pages; flashKvSet() refuses anything
+ * more.
+ *
+ * Writes are batched. flashKvSet() stages a record in a RAM buffer, and
+ * setting the same key again before the flush replaces it in place. The batch
+ * goes to flash when it is full or on flashKvFlush(). Call that from the main
+ * loop on a timer, and after values that must survive a reset. A key that
+ * changes every second then costs one record per flush, not one per change.
+ *
+ * A RAM index of one half-word per key gives the location of each key's
+ * newest record in flash, and one byte per key its staged record, if any. So
+ * a read is O(1). Keys are small integers below FLASH_KV_MAX_KEYS, for example
+ * OcppConfigId values.
+ *
+ * Endurance sets the flush interval: the F030 guarantees only 1000 erase
+ * cycles per page. Flush a value that changes every second rarely, and at
+ * transaction start and stop, or give the store more pages; sim/flash_kv_sim.c
+ * reports the wear for a given interval.
+ */
+
+#ifndef FLASH_KV_MAX_KEYS
+#define FLASH_KV_MAX_KEYS 64
+#endif
+
+#ifndef FLASH_KV_BATCH_SIZE
+#define FLASH_KV_BATCH_SIZE 128 // Staged records, bytes; at most 508
+#endif
+
+#define FLASH_KV_MAX_VALUE   120     // Must fit the batch with its record header
+#define FLASH_KV_DELETED     0x8000  // In a record's len: tombstone
+#define FLASH_KV_PAGE_HEADER FLASH_RING_HEADER
+#define FLASH_KV_RECORD      6       // Record header, the value follows
+
+typedef enum {
+    FLASH_KV_OK = 0,
+    FLASH_KV_NOT_FOUND = -1,
+    FLASH_KV_TOO_LARGE = -2, // Value longer than FLASH_KV_MAX_VALUE, or key out of range
+    FLASH_KV_FULL = -3,      // Live data would not fit in all but two pages
+    FLASH_KV_IO = -4         // Program or erase failed
+} FlashKvResult;
+
+/* The flash region, at least 3 pages */
+typedef FlashRingDevice FlashKvDevice;
+
+typedef struct {
+    uint32_t sets;          // flashKvSet/Delete calls
+    uint32_t merged;        // Of those, replaced a staged record before it reached flash
+    uint32_t flushes;       // Batches written
+    uint32_t records;       // Records appended by flushes
+    uint32_t copied;        // Records moved by garbage collection
+    uint32_t bytesStaged;   // Value bytes handed to flashKvSet
+    uint32_t skipped;       // Torn or corrupt records found by the mount
+} FlashKvStats;
+
+typedef struct {
+    FlashRing ring;      // Its head is the page being appended to; bytes programmed and erases
+    uint32_t headOffset; // Next free byte in the head page
+    uint32_t liveBytes;  // Flash bytes of the newest record of every key
+    uint16_t index[FLASH_KV_MAX_KEYS];  // Flash offset / 2 of the newest record, 0 if none
+    uint8_t staged[FLASH_KV_MAX_KEYS];  // Batch offset / 2 + 1 of the staged record, 0 if none
+    uint16_t batchUsed;
+    uint8_t batch[FLASH_KV_BATCH_SIZE];
+    FlashKvStats stats;
+} FlashKv;
+
+/* Scans the region and builds the index; formats it if it holds no valid page */
+FlashKvResult flashKvMount(FlashKv *kv, const FlashKvDevice *dev);
+
+/* Copies the value into out; returns its length, or FLASH_KV_NOT_FOUND */
+int flashKvGet(const FlashKv *kv, uint16_t key, void *out, uint32_t size);
+
+/* Staged until the next flush */
+FlashKvResult flashKvSet(FlashKv *kv, uint16_t key, const void *value, uint32_t len);
+FlashKvResult flashKvDelete(FlashKv *kv, uint16_t key);
+
+/* Appends the staged records; a no-op when nothing is staged */
+FlashKvResult flashKvFlush(FlashKv *kv);
+
+bool flashKvPending(const FlashKv *kv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLASH_KV_H */
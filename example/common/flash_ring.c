@@ -0,0 +1,114 @@
+#include "flash_ring.h"
+
+#include <string.h>
+
+#define PROGRAM_CHUNK 32 // Half-words copied per program() call
+
+typedef struct {
+    uint32_t sequence;
+    uint16_t magic;
+    uint16_t check; // ~sequence, low half
+} PageHeader;
+
+_Static_assert(sizeof(PageHeader) == FLASH_RING_HEADER, "page header size");
+
+static bool readHeader(const FlashRing *ring, uint32_t page, uint32_t *sequence) {
+    PageHeader header;
+    memcpy(&header, flashRingAt(ring, page * ring->dev.pageSize), sizeof(header));
+    *sequence = header.sequence;
+    return header.magic == ring->magic && header.check == (uint16_t)~header.sequence;
+}
+
+bool flashRingProgram(FlashRing *ring, uint32_t offset, const void *data, uint32_t bytes) {
+    uint16_t words[PROGRAM_CHUNK];
+    const uint8_t *from = (const uint8_t *)data;
+
+    ring->bytesProgrammed += bytes;
+    while (bytes) {
+        uint32_t n = bytes < sizeof(words) ? bytes : sizeof(words);
+        memcpy(words, from, n); // data may be unaligned
+        if (!ring->dev.program(ring->dev.ctx, offset, words, n / 2)) {
+            return false;
+        }
+        offset += n;
+        from += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+bool flashRingErase(FlashRing *ring, uint32_t page) {
+    ring->erases++;
+    return ring->dev.erase(ring->dev.ctx, page);
+}
+
+bool flashRingErased(const FlashRing *ring, uint32_t offset, uint32_t bytes) {
+    const uint8_t *p = flashRingAt(ring, offset);
+    for (uint32_t i = 0; i < bytes; i++) {
+        if (p[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool flashRingOpen(FlashRing *ring, uint32_t page, uint32_t sequence) {
+    PageHeader header = {sequence, ring->magic, (uint16_t)~sequence};
+    if (!flashRingErased(ring, page * ring->dev.pageSize, ring->dev.pageSize) && !flashRingErase(ring, page)) {
+        return false;
+    }
+    if (!flashRingProgram(ring, page * ring->dev.pageSize, &header, sizeof(header))) {
+        return false;
+    }
+    ring->head = page;
+    ring->sequence = sequence;
+    return true;
+}
+
+bool flashRingRetire(FlashRing *ring, uint32_t page) {
+    static const uint16_t zero = 0; // The one value that may be programmed over written flash
+    return flashRingProgram(ring, page * ring->dev.pageSize + offsetof(PageHeader, magic), &zero, sizeof(zero)) &&
+           flashRingErase(ring, page);
+}
+
+FlashRingResult flashRingMount(FlashRing *ring, const FlashRingDevice *dev, uint16_t magic) {
+    uint32_t sequence, best = 0;
+    bool found = false;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->dev = *dev;
+    ring->magic = magic;
+    for (uint32_t page = 0; page < dev->pages; page++) {
+        if (readHeader(ring, page, &sequence) && (!found || (int32_t)(sequence - best) > 0)) {
+            best = sequence;
+            ring->head = page;
+            found = true;
+        }
+    }
+    if (!found) {
+        for (uint32_t page = 0; page < dev->pages; page++) {
+            if (!flashRingErased(ring, page * dev->pageSize, dev->pageSize) && !flashRingErase(ring, page)) {
+                return FLASH_RING_IO;
+            }
+        }
+        ring->tail = 0;
+        return flashRingOpen(ring, 0, 1) ? FLASH_RING_FORMATTED : FLASH_RING_IO;
+    }
+
+    /* The ring runs back from the newest page through consecutive sequence numbers */
+    ring->sequence = best;
+    ring->tail = ring->head;
+    for (uint32_t n = 1; n < dev->pages; n++) {
+        uint32_t page = (ring->head + dev->pages - n) % dev->pages;
+        if (!readHeader(ring, page, &sequence) || sequence != best - n) {
+            break;
+        }
+        ring->tail = page;
+    }
+    for (uint32_t page = flashRingNext(ring, ring->head); page != ring->tail; page = flashRingNext(ring, page)) {
+        if (!flashRingErased(ring, page * dev->pageSize, dev->pageSize) && !flashRingErase(ring, page)) {
+            return FLASH_RING_IO; // Stale, or an erase cut short
+        }
+    }
+    return FLASH_RING_OK;
+}
@@ -0,0 +1,87 @@
+#ifndef FLASH_RING_H
+#define FLASH_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A ring of flash erase pages, the storage under flash_kv.h and
+ * meter_history.h.
+ *
+ * Each page in use starts with an 8-byte header: a sequence number, the
+ * owner's magic and a check of the sequence. The mount finds the newest page
+ * (the head) by its sequence number, and follows consecutive numbers back to
+ * the oldest (the tail). Pages after the head up to the tail must be erased;
+ * the mount erases any that are not, since they are stale or an erase was cut
+ * short. A region with no valid page is formatted: every page is erased and
+ * page 0 is opened with sequence 1.
+ *
+ * A page is retired by clearing its magic before the erase, so a page whose
+ * erase is cut short is not mistaken for a valid one. What goes after the
+ * header, and when the head moves on, is up to the owner.
+ */
+
+#define FLASH_RING_HEADER 8
+
+/*
+ * The flash region. Reads go through base (memory-mapped on the target).
+ * program() writes half-words to erased flash at a region offset, and erase()
+ * erases one page. Both return false on failure.
+ */
+typedef struct {
+    const uint8_t *base;
+    uint32_t pageSize; // Erase unit, 1024 bytes on the STM32F030
+    uint32_t pages;
+    bool (*program)(void *ctx, uint32_t offset, const uint16_t *data, uint32_t halfWords);
+    bool (*erase)(void *ctx, uint32_t page);
+    void *ctx;
+} FlashRingDevice;
+
+typedef enum {
+    FLASH_RING_OK = 0,
+    FLASH_RING_FORMATTED = 1, // No valid page was found
+    FLASH_RING_IO = -1        // Program or erase failed
+} FlashRingResult;
+
+typedef struct {
+    FlashRingDevice dev;
+    uint16_t magic;
+    uint32_t tail;     // Oldest page
+    uint32_t head;     // Newest page
+    uint32_t sequence; // Of the head page
+    uint32_t bytesProgrammed;
+    uint32_t erases;
+} FlashRing;
+
+/* Finds the head and the tail, erases the pages between them; formats the region if it holds no valid page */
+FlashRingResult flashRingMount(FlashRing *ring, const FlashRingDevice *dev, uint16_t magic);
+
+/* Erases the page if it needs it and makes it the head */
+bool flashRingOpen(FlashRing *ring, uint32_t page, uint32_t sequence);
+
+/* Clears the page's magic, then erases it */
+bool flashRingRetire(FlashRing *ring, uint32_t page);
+
+/* bytes is even; data needs no alignment */
+bool flashRingProgram(FlashRing *ring, uint32_t offset, const void *data, uint32_t bytes);
+bool flashRingErase(FlashRing *ring, uint32_t page);
+bool flashRingErased(const FlashRing *ring, uint32_t offset, uint32_t bytes);
+
+static inline uint32_t flashRingNext(const FlashRing *ring, uint32_t page) {
+    return page + 1 == ring->dev.pages ? 0 : page + 1;
+}
+
+static inline const uint8_t *flashRingAt(const FlashRing *ring, uint32_t offset) {
+    return ring->dev.base + offset;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLASH_RING_H */
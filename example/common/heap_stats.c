@@ -0,0 +1,178 @@
+#include "heap_stats.h"
+#include "critical.h"
+
+#include <malloc.h>
+#include <stdio.h>
+
+static HeapStats stats;
+static CriticalFlag lock; // MicroOcpp allocates from the RX interrupt as well as from the main loop
+static HeapTraceFn traceFn;
+static void *traceCtx;
+
+void heapStatsSbrk(uint32_t arenaBytes, uint32_t limitBytes, bool ok) {
+    uint32_t key = criticalEnter(&lock);
+    stats.arenaBytes = arenaBytes;
+    stats.arenaLimit = limitBytes;
+    if (arenaBytes > stats.peakArenaBytes) {
+        stats.peakArenaBytes = arenaBytes;
+    }
+    if (!ok) {
+        stats.sbrkFailures++;
+    }
+    criticalExit(&lock, key);
+}
+
+void heapStatsGet(HeapStats *out) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+    uint32_t key = criticalEnter(&lock);
+    if (!stats.arenaLimit) { // No _sbrk() reports on the host
+        stats.arenaBytes = (uint32_t)info.arena;
+        if (stats.arenaBytes > stats.peakArenaBytes) {
+            stats.peakArenaBytes = stats.arenaBytes;
+        }
+    }
+    stats.freeBytes = (uint32_t)info.fordblks;
+    *out = stats;
+    criticalExit(&lock, key);
+}
+
+uint32_t heapStatsFragmentation(const HeapStats *s) {
+    return s->arenaBytes ? (uint32_t)((uint64_t)s->freeBytes * 1000 / s->arenaBytes) : 0;
+}
+
+void heapStatsResetPeaks(void) {
+    uint32_t key = criticalEnter(&lock);
+    stats.peakLiveBytes = stats.liveBytes;
+    stats.peakLiveBlocks = stats.liveBlocks;
+    stats.peakArenaBytes = stats.arenaBytes;
+    criticalExit(&lock, key);
+}
+
+void heapStatsSetTrace(HeapTraceFn trace, void *ctx) {
+    traceCtx = ctx;
+    traceFn = trace;
+}
+
+void heapStatsExport(HeapStatsWriteFn write, void *ctx) {
+    static const char *const bucketNames[HEAP_STATS_BUCKETS] = {"16", "32", "64", "128",
+                                                                "256", "512", "1k", ">1k"};
+    HeapStats s;
+    char line[160];
+    int len;
+
+    heapStatsGet(&s);
+    uint32_t frag = heapStatsFragmentation(&s);
+    snprintf(line, sizeof(line), "[HEAP] live %lu B in %lu blocks, peak %lu B / %lu blocks, "
+             "%lu allocs %lu frees %lu failed", (unsigned long)s.liveBytes, (unsigned long)s.liveBlocks,
+             (unsigned long)s.peakLiveBytes, (unsigned long)s.peakLiveBlocks, (unsigned long)s.allocs,
+             (unsigned long)s.frees, (unsigned long)s.failures);
+    write(ctx, line);
+
+    len = snprintf(line, sizeof(line), "[HEAP] arena %lu B, peak %lu B", (unsigned long)s.arenaBytes,
+                   (unsigned long)s.peakArenaBytes);
+    if (s.arenaLimit) {
+        len += snprintf(line + len, sizeof(line) - len, " of %lu B (%lu sbrk refused)",
+                        (unsigned long)s.arenaLimit, (unsigned long)s.sbrkFailures);
+    } else {
+        len += snprintf(line + len, sizeof(line) - len, " (C library arena, no limit)");
+    }
+    snprintf(line + len, sizeof(line) - len, ", free in arena %lu B, fragmentation %lu.%lu%%",
+             (unsigned long)s.freeBytes, (unsigned long)(frag / 10), (unsigned long)(frag % 10));
+    write(ctx, line); // Integer formatting, newlib-nano printf has no floats
+
+    len = snprintf(line, sizeof(line), "[HEAP] sizes");
+    for (int i = 0; i < HEAP_STATS_BUCKETS; i++) {
+        len += snprintf(line + len, sizeof(line) - len, " %s%s:%lu", i < HEAP_STATS_BUCKETS - 1 ? "<=" : "",
+                        bucketNames[i], (unsigned long)s.sizes[i]);
+    }
+    write(ctx, line);
+}
+
+#if HEAP_STATS
+/* Front-end over the C library allocator, selected with -Wl,--wrap=<function> */
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static uint8_t sizeBucket(size_t size) {
+    uint8_t bucket = 0;
+    for (size_t limit = 16; size > limit && bucket < HEAP_STATS_BUCKETS - 1; limit <<= 1) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static void recordAlloc(void *ptr, size_t size) {
+    uint32_t usable = ptr ? (uint32_t)malloc_usable_size(ptr) : 0;
+    uint32_t key = criticalEnter(&lock);
+    if (!ptr) {
+        stats.failures++;
+    } else {
+        stats.allocs++;
+        stats.sizes[sizeBucket(size)]++;
+        stats.liveBytes += usable;
+        stats.liveBlocks++;
+        if (stats.liveBytes > stats.peakLiveBytes) {
+            stats.peakLiveBytes = stats.liveBytes;
+        }
+        if (stats.liveBlocks > stats.peakLiveBlocks) {
+            stats.peakLiveBlocks = stats.liveBlocks;
+        }
+    }
+    criticalExit(&lock, key);
+    if (traceFn && ptr) {
+        traceFn(traceCtx, 'a', ptr, size);
+    }
+}
+
+static void recordFree(void *ptr, uint32_t usable) {
+    uint32_t key = criticalEnter(&lock);
+    stats.frees++;
+    stats.liveBytes -= usable;
+    stats.liveBlocks--;
+    criticalExit(&lock, key);
+    if (traceFn) {
+        traceFn(traceCtx, 'f', ptr, 0);
+    }
+}
+
+void *__wrap_malloc(size_t size) {
+    void *ptr = __real_malloc(size);
+    recordAlloc(ptr, size);
+    return ptr;
+}
+
+void __wrap_free(void *ptr) {
+    if (ptr) {
+        recordFree(ptr, (uint32_t)malloc_usable_size(ptr));
+    }
+    __real_free(ptr);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    void *ptr = __real_calloc(count, size);
+    recordAlloc(ptr, count * size);
+    return ptr;
+}
+
+void *__wrap_realloc(void *old, size_t size) {
+    uint32_t oldUsable = old ? (uint32_t)malloc_usable_size(old) : 0;
+    void *ptr = __real_realloc(old, size);
+    if (!ptr && size) {
+        recordAlloc(NULL, size); // The old block is still there
+        return NULL;
+    }
+    if (old) {
+        recordFree(old, oldUsable);
+    }
+    if (ptr) {
+        recordAlloc(ptr, size);
+    }
+    return ptr;
+}
+#endif
@@ -0,0 +1,81 @@
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Heap instrumentation for sizing the MicroOcpp heap and pools.
+ *
+ * With -DHEAP_STATS=1 and the linker flags
+ *   -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc
+ * every malloc/free in the image, including operator new/delete, goes through
+ * counters for live bytes, their high-water mark, failed requests and a
+ * histogram of request sizes. Live bytes are usable sizes
+ * (malloc_usable_size), so they include the allocator's rounding.
+ * Allocations newlib makes internally through _malloc_r (stdio buffers,
+ * printf of floats) are not seen.
+ *
+ * _sbrk() in Core/Src/sysmem.c reports the arena size and how far it can
+ * still grow before the _Min_Stack_Size reserve. The fragmentation is the
+ * share of the arena that is free but already taken from sbrk (mallinfo
+ * fordblks / arena). An arena never shrinks, so that memory is lost to the
+ * stack and to static buffers. On the host glibc provides the arena, without a
+ * limit.
+ */
+
+#ifndef HEAP_STATS
+#define HEAP_STATS 0
+#endif
+
+#define HEAP_STATS_BUCKETS 8 // Request sizes: <=16, <=32, ... <=1024, >1024 bytes
+
+typedef void (*HeapStatsWriteFn)(void *ctx, const char *line);
+
+/* op 'a' (size = request) or 'f' (size = 0) for every block seen, for sim/pool_bench.c */
+typedef void (*HeapTraceFn)(void *ctx, char op, const void *ptr, size_t size);
+
+typedef struct {
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;       // malloc/calloc/realloc returned NULL
+    uint32_t liveBytes;
+    uint32_t liveBlocks;
+    uint32_t peakLiveBytes;
+    uint32_t peakLiveBlocks;
+    uint32_t arenaBytes;     // Taken from sbrk so far
+    uint32_t peakArenaBytes;
+    uint32_t arenaLimit;     // Largest arena before the stack reserve, 0 if unknown
+    uint32_t freeBytes;      // Free inside the arena (mallinfo)
+    uint32_t sbrkFailures;
+    uint32_t sizes[HEAP_STATS_BUCKETS];
+} HeapStats;
+
+/* Called by _sbrk() on every request, ok = false when it was refused */
+void heapStatsSbrk(uint32_t arenaBytes, uint32_t limitBytes, bool ok);
+
+/* Consistent snapshot; walks the free list, so call it from the main loop */
+void heapStatsGet(HeapStats *stats);
+
+/* Free arena bytes per 1000 arena bytes */
+uint32_t heapStatsFragmentation(const HeapStats *stats);
+
+/* Peaks restart from the current values */
+void heapStatsResetPeaks(void);
+
+/* Installs a trace of every malloc/free; called outside the statistics lock */
+void heapStatsSetTrace(HeapTraceFn trace, void *ctx);
+
+/* "[HEAP] ..." lines: live and peak, arena and fragmentation, size histogram */
+void heapStatsExport(HeapStatsWriteFn write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEAP_STATS_H */
@@ -0,0 +1,89 @@
+#include "link_protocol.h"
+
+#include <string.h>
+
+enum {
+    LINK_WAIT_SOF,
+    LINK_WAIT_TYPE,
+    LINK_WAIT_LEN,
+    LINK_WAIT_PAYLOAD,
+    LINK_WAIT_CRC
+};
+
+uint8_t linkCrc8(uint8_t crc, uint8_t byte) {
+    crc ^= byte;
+    for (int i = 0; i < 8; i++) {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+void linkDecoderInit(LinkDecoder *decoder) {
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->state = LINK_WAIT_SOF;
+}
+
+bool linkDecodeByte(LinkDecoder *decoder, uint8_t byte) {
+    switch (decoder->state) {
+        case LINK_WAIT_SOF:
+            if (byte == LINK_SOF) {
+                decoder->crc = 0;
+                decoder->state = LINK_WAIT_TYPE;
+            }
+            break;
+
+        case LINK_WAIT_TYPE:
+            decoder->type = byte;
+            decoder->crc = linkCrc8(decoder->crc, byte);
+            decoder->state = LINK_WAIT_LEN;
+            break;
+
+        case LINK_WAIT_LEN:
+            if (byte > LINK_MAX_PAYLOAD) {
+                decoder->lengthErrors++;
+                decoder->state = LINK_WAIT_SOF; // Resynchronise on the next SOF
+                break;
+            }
+            decoder->len = byte;
+            decoder->pos = 0;
+            decoder->crc = linkCrc8(decoder->crc, byte);
+            decoder->state = byte ? LINK_WAIT_PAYLOAD : LINK_WAIT_CRC;
+            break;
+
+        case LINK_WAIT_PAYLOAD:
+            decoder->payload[decoder->pos++] = byte;
+            decoder->crc = linkCrc8(decoder->crc, byte);
+            if (decoder->pos == decoder->len) {
+                decoder->state = LINK_WAIT_CRC;
+            }
+            break;
+
+        case LINK_WAIT_CRC:
+            decoder->state = LINK_WAIT_SOF;
+            if (byte == decoder->crc) {
+                return true;
+            }
+            decoder->crcErrors++;
+            break;
+    }
+    return false;
+}
+
+size_t linkEncodeFrame(uint8_t *out, uint8_t type, const void *payload, uint8_t len) {
+    uint8_t crc = 0;
+
+    if (len > LINK_MAX_PAYLOAD) {
+        return 0;
+    }
+    out[0] = LINK_SOF;
+    out[1] = type;
+    out[2] = len;
+    if (len) {
+        memcpy(&out[3], payload, len);
+    }
+    for (size_t i = 1; i < 3u + len; i++) {
+        crc = linkCrc8(crc, out[i]);
+    }
+    out[3 + len] = crc;
+    return (size_t)len + LINK_FRAME_OVERHEAD;
+}
@@ -0,0 +1,157 @@
+#ifndef LINK_PROTOCOL_H
+#define LINK_PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Binary ESP32 <-> STM32 link for split-processing mode.
+ *
+ * In split mode the ESP32 terminates OCPP-J: it parses and validates the JSON
+ * and sends the STM32 fixed-layout command structs. The STM32 answers with
+ * binary events which the ESP32 renders back to OCPP-J. The STM32 never sees
+ * JSON text.
+ *
+ * Frame:  [0xA5][type][len][payload (len bytes)][crc8]
+ * CRC-8 (poly 0x07) covers type, len and payload. All multi-byte fields are
+ * little endian, which both the Cortex-M0 and the ESP32-C3 use natively, so
+ * payloads are read in place as the packed structs below.
+ */
+
+#define LINK_SOF             0xA5
+#define LINK_MAX_PAYLOAD     32
+#define LINK_FRAME_OVERHEAD  4
+#define LINK_MAX_FRAME       (LINK_MAX_PAYLOAD + LINK_FRAME_OVERHEAD)
+#define LINK_ID_TAG_LEN      20 // OCPP 1.6 IdToken is CiString20Type
+
+/* Commands: ESP32 -> STM32 */
+#define LINK_CMD_REMOTE_START      0x01
+#define LINK_CMD_REMOTE_STOP       0x02
+#define LINK_CMD_SET_CURRENT_LIMIT 0x03
+#define LINK_CMD_GET_STATS         0x04 // Empty payload
+
+/* Events: STM32 -> ESP32 */
+#define LINK_EVT_RESULT            0x81
+#define LINK_EVT_STATUS            0x82
+#define LINK_EVT_METER             0x83
+#define LINK_EVT_STATS             0x84
+#define LINK_EVT_TX_BEGIN          0x85 // The STM32 opened a transaction
+#define LINK_EVT_TX_END            0x86 // The STM32 closed it
+
+/* LINK_EVT_RESULT status codes */
+#define LINK_RESULT_ACCEPTED       0
+#define LINK_RESULT_REJECTED       1
+
+/* LINK_EVT_STATUS connector states (subset of OCPP ChargePointStatus) */
+#define LINK_STATUS_AVAILABLE      0
+#define LINK_STATUS_PREPARING      1
+#define LINK_STATUS_CHARGING       2
+#define LINK_STATUS_FINISHING      3
+#define LINK_STATUS_FAULTED        4
+
+/* LINK_EVT_TX_END reasons (subset of OCPP Reason) */
+#define LINK_TX_REASON_REMOTE      0
+#define LINK_TX_REASON_LOCAL       1
+#define LINK_TX_REASON_OTHER       2
+
+typedef struct __attribute__((packed)) {
+    uint16_t msgId;                     // Bridge handle for the OCPP message ID
+    uint8_t connectorId;
+    char idTag[LINK_ID_TAG_LEN + 1];    // Null-terminated
+} LinkRemoteStart;
+
+typedef struct __attribute__((packed)) {
+    uint16_t msgId;
+    int32_t transactionId;
+} LinkRemoteStop;
+
+typedef struct __attribute__((packed)) {
+    uint16_t msgId;
+    uint8_t connectorId;
+    uint16_t limitDeciAmps;             // 0.1 A steps, no float on the STM32
+} LinkSetCurrentLimit;
+
+typedef struct __attribute__((packed)) {
+    uint16_t msgId;
+    uint8_t result;
+} LinkResult;
+
+typedef struct __attribute__((packed)) {
+    uint8_t connectorId;
+    uint8_t status;
+} LinkStatus;
+
+typedef struct __attribute__((packed)) {
+    uint8_t connectorId;
+    uint32_t energyWh;
+    uint16_t powerW;
+    uint16_t deciVolts;                 // Vrms, 0.1 V
+    uint16_t centiAmps;                 // Irms, 0.01 A
+} LinkMeter;
+
+typedef struct __attribute__((packed)) {
+    uint8_t connectorId;
+    uint32_t meterStartWh;
+    char idTag[LINK_ID_TAG_LEN + 1];    // Null-terminated
+} LinkTxBegin;
+
+typedef struct __attribute__((packed)) {
+    uint8_t connectorId;
+    uint8_t reason;                     // LINK_TX_REASON_*
+    uint32_t meterStopWh;
+} LinkTxEnd;
+
+typedef struct __attribute__((packed)) {
+    uint32_t commands;                  // Commands dispatched since boot
+    uint32_t avgCycles;                 // CPU cycles per dispatch
+    uint32_t maxCycles;
+    uint32_t rxBytes;                   // Link bytes in both directions
+    uint32_t txBytes;
+    uint16_t ramStatic;                 // .data + .bss bytes, 0 if unknown (host builds)
+    uint16_t ramRxPath;                 // Receive state of this mode
+} LinkStatsReport;
+
+typedef char linkAssertPayloadSize[(sizeof(LinkRemoteStart) <= LINK_MAX_PAYLOAD) ? 1 : -1];
+typedef char linkAssertTxBeginSize[(sizeof(LinkTxBegin) <= LINK_MAX_PAYLOAD) ? 1 : -1];
+typedef char linkAssertStatsSize[(sizeof(LinkStatsReport) <= LINK_MAX_PAYLOAD) ? 1 : -1];
+
+/* Incremental decoder, safe to feed from the UART RX interrupt */
+typedef struct {
+    uint8_t state;
+    uint8_t type;
+    uint8_t len;
+    uint8_t pos;
+    uint8_t crc;
+    uint8_t payload[LINK_MAX_PAYLOAD];
+    uint16_t crcErrors;
+    uint16_t lengthErrors;
+} LinkDecoder;
+
+/* Link traffic counters, kept by both sides in both modes */
+typedef struct {
+    uint32_t rxBytes;
+    uint32_t txBytes;
+    uint32_t rxFrames;
+    uint32_t txFrames;
+} LinkStats;
+
+void linkDecoderInit(LinkDecoder *decoder);
+
+/* Returns true when a complete, CRC-checked frame is in decoder->type/len/payload */
+bool linkDecodeByte(LinkDecoder *decoder, uint8_t byte);
+
+/* Builds a frame into out (at least LINK_MAX_FRAME bytes), returns its size or 0 */
+size_t linkEncodeFrame(uint8_t *out, uint8_t type, const void *payload, uint8_t len);
+
+uint8_t linkCrc8(uint8_t crc, uint8_t byte);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINK_PROTOCOL_H */
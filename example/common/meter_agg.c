@@ -0,0 +1,180 @@
+#include "meter_agg.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void meterAggInit(MeterAgg *agg) {
+    memset(agg, 0, sizeof(*agg));
+}
+
+int meterAggAddChannel(MeterAgg *agg, StrHandle measurand, StrHandle unit, MeterAggPhase phase, uint8_t decimals,
+                       bool reg) {
+    MeterAggChannel *channel;
+
+    if (agg->channelCount >= METER_AGG_CHANNELS) {
+        return -1;
+    }
+    channel = &agg->channels[agg->channelCount];
+    channel->measurand = measurand;
+    channel->unit = unit;
+    channel->phase = (uint8_t)phase;
+    channel->decimals = decimals;
+    channel->reg = reg;
+    return agg->channelCount++;
+}
+
+static void pushBatch(MeterAgg *agg, MeterAggKind kind, uint32_t end) {
+    MeterAggInterval *iv = &agg->intervals[kind];
+    MeterAggBatch *batch;
+
+    if (agg->count == METER_AGG_QUEUE) {
+        agg->head = (uint8_t)((agg->head + 1) % METER_AGG_QUEUE); // Oldest out
+        agg->count--;
+        agg->dropped++;
+    }
+    batch = &agg->queue[(agg->head + agg->count) % METER_AGG_QUEUE];
+    agg->count++;
+    agg->batches++;
+
+    batch->start = iv->start;
+    batch->end = end;
+    batch->samples = iv->samples;
+    batch->kind = (uint8_t)kind;
+    for (int c = 0; c < agg->channelCount; c++) {
+        const MeterAggStat *st = &iv->stats[c];
+        int64_t half = iv->samples / 2;
+
+        batch->values[c].min = st->min;
+        batch->values[c].max = st->max;
+        batch->values[c].last = st->last;
+        batch->values[c].avg = (int32_t)(st->sum < 0 ? (st->sum - half) / iv->samples : (st->sum + half) / iv->samples);
+    }
+    iv->samples = 0;
+}
+
+/* Closes the open interval of kind if it ended by now or the clock went back */
+static void roll(MeterAgg *agg, MeterAggKind kind, uint32_t now) {
+    MeterAggInterval *iv = &agg->intervals[kind];
+
+    if (!iv->samples) {
+        return;
+    }
+    if (now < iv->lastTime) {
+        agg->clockSteps++;
+        pushBatch(agg, kind, iv->lastTime); // Its last sample is all that is certain
+    } else if (now >= iv->end) {
+        pushBatch(agg, kind, iv->end);
+    }
+}
+
+/* Bounds of the interval of kind that holds now */
+static void openInterval(MeterAgg *agg, MeterAggKind kind, uint32_t now) {
+    MeterAggInterval *iv = &agg->intervals[kind];
+
+    if (kind == METER_AGG_ALIGNED) {
+        uint32_t midnight = now - now % METER_AGG_DAY;
+        iv->start = midnight + (now - midnight) / iv->interval * iv->interval;
+        iv->end = iv->start + iv->interval;
+        if (iv->end > midnight + METER_AGG_DAY) {
+            iv->end = midnight + METER_AGG_DAY; // Intervals that do not divide the day restart at midnight
+        }
+    } else {
+        if (now < agg->sampledFrom) {
+            agg->sampledFrom = now; // Clock went back: the grid starts again here
+        }
+        iv->start = agg->sampledFrom + (now - agg->sampledFrom) / iv->interval * iv->interval;
+        iv->end = iv->start + iv->interval;
+    }
+}
+
+void meterAggSetInterval(MeterAgg *agg, MeterAggKind kind, uint32_t seconds, uint32_t now) {
+    MeterAggInterval *iv = &agg->intervals[kind];
+
+    if (iv->samples) {
+        pushBatch(agg, kind, now);
+    }
+    iv->interval = seconds;
+}
+
+void meterAggStart(MeterAgg *agg, uint32_t now) {
+    meterAggStop(agg, now);
+    agg->sampling = true;
+    agg->sampledFrom = now;
+}
+
+void meterAggStop(MeterAgg *agg, uint32_t now) {
+    MeterAggInterval *iv = &agg->intervals[METER_AGG_SAMPLED];
+
+    roll(agg, METER_AGG_SAMPLED, now);
+    if (iv->samples) {
+        pushBatch(agg, METER_AGG_SAMPLED, now); // Cut short by the end of the transaction
+    }
+    agg->sampling = false;
+}
+
+void meterAggAdd(MeterAgg *agg, uint32_t now, const int32_t *values) {
+    agg->samples++;
+    for (int k = 0; k < METER_AGG_KINDS; k++) {
+        MeterAggInterval *iv = &agg->intervals[k];
+
+        roll(agg, (MeterAggKind)k, now);
+        if (!iv->interval || (k == METER_AGG_SAMPLED && !agg->sampling)) {
+            continue;
+        }
+        if (!iv->samples) {
+            openInterval(agg, (MeterAggKind)k, now);
+            for (int c = 0; c < agg->channelCount; c++) {
+                MeterAggStat *st = &iv->stats[c];
+                st->min = st->max = st->last = values[c];
+                st->sum = values[c];
+            }
+        } else {
+            for (int c = 0; c < agg->channelCount; c++) {
+                MeterAggStat *st = &iv->stats[c];
+                st->min = values[c] < st->min ? values[c] : st->min;
+                st->max = values[c] > st->max ? values[c] : st->max;
+                st->last = values[c];
+                st->sum += values[c];
+            }
+        }
+        iv->samples++;
+        iv->lastTime = now;
+    }
+}
+
+void meterAggPoll(MeterAgg *agg, uint32_t now) {
+    for (int k = 0; k < METER_AGG_KINDS; k++) {
+        roll(agg, (MeterAggKind)k, now);
+    }
+}
+
+bool meterAggTake(MeterAgg *agg, MeterAggBatch *out) {
+    if (!agg->count) {
+        return false;
+    }
+    *out = agg->queue[agg->head];
+    agg->head = (uint8_t)((agg->head + 1) % METER_AGG_QUEUE);
+    agg->count--;
+    return true;
+}
+
+int32_t meterAggValue(const MeterAgg *agg, const MeterAggBatch *batch, int channel) {
+    return agg->channels[channel].reg ? batch->values[channel].last : batch->values[channel].avg;
+}
+
+const char *meterAggPhaseName(uint8_t phase) {
+    static const char *const names[] = {"", "L1", "L2", "L3", "N"};
+    return phase < sizeof(names) / sizeof(names[0]) ? names[phase] : "";
+}
+
+void meterAggExport(const MeterAgg *agg, MeterAggWriteFn write, void *ctx) {
+    char line[160];
+
+    snprintf(line, sizeof(line),
+             "[AGG] %lu samples, %lu batches, %u queued, %lu dropped, %lu clock steps, sampled %lu s%s, aligned %lu s",
+             (unsigned long)agg->samples, (unsigned long)agg->batches, (unsigned)agg->count,
+             (unsigned long)agg->dropped, (unsigned long)agg->clockSteps,
+             (unsigned long)agg->intervals[METER_AGG_SAMPLED].interval, agg->sampling ? " (running)" : "",
+             (unsigned long)agg->intervals[METER_AGG_ALIGNED].interval);
+    write(ctx, line);
+}
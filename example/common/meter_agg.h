@@ -0,0 +1,153 @@
+#ifndef METER_AGG_H
+#define METER_AGG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "str_intern.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Meter value aggregation for the two OCPP 1.6 reading intervals.
+ *
+ * Every channel (a measurand, its unit and phase) keeps running statistics
+ * for the interval of each kind: sampled (MeterValueSampleInterval, counted
+ * from meterAggStart() at the beginning of a transaction) and clock-aligned
+ * (ClockAlignedDataInterval, boundaries at midnight UTC plus whole
+ * intervals). A sample updates min, max, sum and last of each open interval,
+ * O(1) per channel and kind; nothing else is kept, so the memory is fixed
+ * by METER_AGG_CHANNELS and METER_AGG_QUEUE.
+ *
+ * Times are Unix seconds. A sample at an interval's end belongs to the next
+ * interval. meterAggAdd() and meterAggPoll() first close every interval that
+ * ended at or before now, into a batch stamped with its exact boundary, and
+ * then start the interval that holds now; intervals without a sample give no
+ * batch. If the wall clock steps back, the open interval closes at its last
+ * sample and a new one starts from now. Batches wait in a ring for the
+ * MeterValues sender (meterAggTake()); when it is full the oldest batch is
+ * dropped and counted.
+ *
+ * Values are integers in 10^-decimals of the channel's unit. A register
+ * (Energy.*.Register) reports its last value, everything else its average,
+ * as meterAggValue() returns. Use the engine from one context.
+ */
+
+#ifndef METER_AGG_CHANNELS
+#define METER_AGG_CHANNELS 4 // Measurand and phase combinations
+#endif
+
+#ifndef METER_AGG_QUEUE
+#define METER_AGG_QUEUE 4 // Batches waiting for the MeterValues sender
+#endif
+
+#define METER_AGG_DAY 86400u
+
+typedef enum {
+    METER_AGG_SAMPLED, // Sample.Periodic
+    METER_AGG_ALIGNED, // Sample.Clock
+    METER_AGG_KINDS
+} MeterAggKind;
+
+typedef enum {
+    METER_AGG_PHASE_NONE,
+    METER_AGG_PHASE_L1,
+    METER_AGG_PHASE_L2,
+    METER_AGG_PHASE_L3,
+    METER_AGG_PHASE_N
+} MeterAggPhase;
+
+typedef void (*MeterAggWriteFn)(void *ctx, const char *line);
+
+typedef struct {
+    StrHandle measurand; // STR_EnergyActiveImportRegister, ...
+    StrHandle unit;
+    uint8_t phase;       // MeterAggPhase
+    uint8_t decimals;
+    bool reg;            // Register: reported as its last value
+} MeterAggChannel;
+
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int32_t last;
+    int64_t sum;
+} MeterAggStat;
+
+typedef struct {
+    int32_t min;
+    int32_t max;
+    int32_t avg; // Rounded, ties away from zero
+    int32_t last;
+} MeterAggValues;
+
+typedef struct {
+    uint32_t start; // Unix seconds, first sample at or after it
+    uint32_t end;   // Boundary the interval closed at, the MeterValues timestamp
+    uint32_t samples;
+    uint8_t kind;   // MeterAggKind
+    MeterAggValues values[METER_AGG_CHANNELS];
+} MeterAggBatch;
+
+typedef struct {
+    uint32_t interval; // Seconds, 0 = off
+    uint32_t start;
+    uint32_t end;
+    uint32_t lastTime; // Of the last sample
+    uint32_t samples;  // 0 = no interval open
+    MeterAggStat stats[METER_AGG_CHANNELS];
+} MeterAggInterval;
+
+typedef struct {
+    MeterAggChannel channels[METER_AGG_CHANNELS];
+    uint8_t channelCount;
+    bool sampling; // Between meterAggStart() and meterAggStop()
+    uint32_t sampledFrom;
+    MeterAggInterval intervals[METER_AGG_KINDS];
+    MeterAggBatch queue[METER_AGG_QUEUE];
+    uint8_t head;
+    uint8_t count;
+    uint32_t samples; // Statistics since meterAggInit()
+    uint32_t batches;
+    uint32_t dropped;   // Batches pushed out of a full queue
+    uint32_t clockSteps; // Times the clock went back
+} MeterAgg;
+
+/* No channels, both intervals off */
+void meterAggInit(MeterAgg *agg);
+
+/* Channel index, -1 if all METER_AGG_CHANNELS are taken */
+int meterAggAddChannel(MeterAgg *agg, StrHandle measurand, StrHandle unit, MeterAggPhase phase, uint8_t decimals,
+                       bool reg);
+
+/* Interval of one kind in seconds, 0 = off; the open interval closes at now first */
+void meterAggSetInterval(MeterAgg *agg, MeterAggKind kind, uint32_t seconds, uint32_t now);
+
+/* Sampled intervals run from now until meterAggStop(), which closes the last one at now */
+void meterAggStart(MeterAgg *agg, uint32_t now);
+void meterAggStop(MeterAgg *agg, uint32_t now);
+
+/* One reading of every channel, in channel order, taken at now */
+void meterAggAdd(MeterAgg *agg, uint32_t now, const int32_t *values);
+
+/* Closes intervals that ended by now, without a sample */
+void meterAggPoll(MeterAgg *agg, uint32_t now);
+
+/* Oldest batch into out; false if there is none */
+bool meterAggTake(MeterAgg *agg, MeterAggBatch *out);
+
+/* The reading OCPP reports for a channel: last of a register, else the average */
+int32_t meterAggValue(const MeterAgg *agg, const MeterAggBatch *batch, int channel);
+
+/* "L1", ..., "" for METER_AGG_PHASE_NONE */
+const char *meterAggPhaseName(uint8_t phase);
+
+/* "[AGG] <samples> samples, <batches> batches ..." */
+void meterAggExport(const MeterAgg *agg, MeterAggWriteFn write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METER_AGG_H */
@@ -0,0 +1,410 @@
+#include "meter_history.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PAGE_MAGIC 0x484D // "MH" in memory
+#define ERASED16   0xFFFF
+#define DATA_BITS  ((METER_HISTORY_BLOCK - 4) * 8)
+#define MAX_CODE   36     // '1111' and 32 bits
+
+_Static_assert(sizeof(MeterHistoryBlock) == METER_HISTORY_BLOCK && METER_HISTORY_BLOCK % 2 == 0,
+               "blocks are programmed in half-words");
+_Static_assert(32 + MAX_CODE * METER_HISTORY_CHANNELS <= DATA_BITS, "a block holds at least one sample");
+_Static_assert(DATA_BITS < ERASED16, "bits and count are half-words");
+_Static_assert(METER_HISTORY_RAM_BLOCKS >= 1 && METER_HISTORY_RAM_BLOCKS <= 255, "ramHead is a byte");
+
+/* Widths after the '10', '110' and '1110' prefixes; '1111' is followed by 32 bits */
+static const uint8_t timeWidths[3] = {7, 9, 12};
+static const uint8_t valueWidths[3] = {4, 8, 16};
+
+/* Code */
+
+static uint32_t zigzag(uint32_t v) {
+    return (v << 1) ^ (0u - (v >> 31));
+}
+
+static uint32_t unzigzag(uint32_t z) {
+    return (z >> 1) ^ (0u - (z & 1));
+}
+
+static uint32_t codeBits(uint32_t z, const uint8_t *widths) {
+    if (!z) {
+        return 1;
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        if (z < (1u << widths[i])) {
+            return i + 2 + widths[i];
+        }
+    }
+    return MAX_CODE;
+}
+
+/* MSB first; data must be zero from pos on */
+static void putBits(uint8_t *data, uint32_t *pos, uint32_t value, uint32_t n) {
+    while (n) {
+        uint32_t room = 8 - (*pos & 7), take = n < room ? n : room;
+        data[*pos >> 3] |= (uint8_t)(((value >> (n - take)) & ((1u << take) - 1)) << (room - take));
+        *pos += take;
+        n -= take;
+    }
+}
+
+static uint32_t getBits(const uint8_t *data, uint32_t *pos, uint32_t n) {
+    uint32_t value = 0;
+    while (n) {
+        uint32_t room = 8 - (*pos & 7), take = n < room ? n : room;
+        value = (value << take) | ((uint32_t)(data[*pos >> 3] >> (room - take)) & ((1u << take) - 1));
+        *pos += take;
+        n -= take;
+    }
+    return value;
+}
+
+static void putCode(uint8_t *data, uint32_t *pos, uint32_t z, const uint8_t *widths) {
+    if (!z) {
+        putBits(data, pos, 0, 1);
+        return;
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        if (z < (1u << widths[i])) {
+            putBits(data, pos, (1u << (i + 2)) - 2, i + 2); // '10', '110', '1110'
+            putBits(data, pos, z, widths[i]);
+            return;
+        }
+    }
+    putBits(data, pos, 0xF, 4);
+    putBits(data, pos, z, 32);
+}
+
+static uint32_t getCode(const uint8_t *data, uint32_t *pos, const uint8_t *widths) {
+    uint32_t ones = 0;
+    while (ones < 4 && getBits(data, pos, 1)) {
+        ones++;
+    }
+    return ones ? getBits(data, pos, ones == 4 ? 32 : widths[ones - 1]) : 0;
+}
+
+/* Bits the sample takes in block b, against the encoder state */
+static uint32_t sampleBits(const MeterHistory *h, const MeterHistoryBlock *b, uint32_t time, const int32_t *values) {
+    uint32_t bits = 32;
+    if (b->count) {
+        uint32_t delta = time - h->lastTime;
+        bits = codeBits(zigzag(delta - (uint32_t)h->lastDelta), timeWidths);
+    }
+    for (uint32_t c = 0; c < h->channels; c++) {
+        bits += codeBits(zigzag((uint32_t)values[c] - (uint32_t)h->last[c]), valueWidths);
+    }
+    return bits;
+}
+
+static void encode(MeterHistory *h, MeterHistoryBlock *b, uint32_t time, const int32_t *values) {
+    uint32_t pos = b->bits;
+
+    if (!b->count) {
+        putBits(b->data, &pos, time, 32);
+        h->lastDelta = 0;
+    } else {
+        uint32_t delta = time - h->lastTime;
+        putCode(b->data, &pos, zigzag(delta - (uint32_t)h->lastDelta), timeWidths);
+        h->lastDelta = (int32_t)delta;
+    }
+    h->lastTime = time;
+    for (uint32_t c = 0; c < h->channels; c++) {
+        putCode(b->data, &pos, zigzag((uint32_t)values[c] - (uint32_t)h->last[c]), valueWidths);
+        h->last[c] = values[c];
+    }
+    h->stats.bits += pos - b->bits;
+    b->bits = (uint16_t)pos;
+    b->count++;
+}
+
+/* Flash */
+
+static uint32_t slotOffset(const MeterHistory *h, uint32_t page, uint32_t slot) {
+    return page * h->ring.dev.pageSize + METER_HISTORY_PAGE_HEADER + slot * METER_HISTORY_BLOCK;
+}
+
+static const MeterHistoryBlock *flashBlock(const MeterHistory *h, uint32_t page, uint32_t slot) {
+    return (const MeterHistoryBlock *)(h->ring.dev.base + slotOffset(h, page, slot));
+}
+
+static bool live(const MeterHistoryBlock *b) {
+    return b->count != 0 && b->count != ERASED16;
+}
+
+static bool openPage(MeterHistory *h, uint32_t page, uint32_t sequence) {
+    if (!flashRingOpen(&h->ring, page, sequence)) {
+        return false;
+    }
+    h->headSlot = 0;
+    return true;
+}
+
+static uint32_t usedSlots(const MeterHistory *h, uint32_t page) {
+    return page == h->ring.head ? h->headSlot : h->slots;
+}
+
+/* Erases the oldest page; its samples that are left count as dropped */
+static MeterHistoryResult dropTail(MeterHistory *h) {
+    uint32_t samples = 0;
+
+    for (uint32_t slot = h->tailSlot; slot < usedSlots(h, h->ring.tail); slot++) {
+        const MeterHistoryBlock *b = flashBlock(h, h->ring.tail, slot);
+        samples += live(b) ? b->count : 0;
+    }
+    if (samples) {
+        samples -= h->skip; // The oldest block is in this page
+        h->skip = 0;
+        h->count -= samples;
+        h->stats.dropped += samples;
+    }
+    h->tailSlot = 0;
+    if (!flashRingRetire(&h->ring, h->ring.tail)) {
+        h->ring.tail = flashRingNext(&h->ring, h->ring.tail);
+        return METER_HISTORY_IO;
+    }
+    h->ring.tail = flashRingNext(&h->ring, h->ring.tail);
+    return METER_HISTORY_OK;
+}
+
+static MeterHistoryResult mount(MeterHistory *h, const MeterHistoryDevice *dev) {
+    FlashRingResult mounted = flashRingMount(&h->ring, dev, PAGE_MAGIC);
+
+    h->slots = (dev->pageSize - METER_HISTORY_PAGE_HEADER) / METER_HISTORY_BLOCK;
+    if (mounted != FLASH_RING_OK) {
+        return mounted == FLASH_RING_FORMATTED ? METER_HISTORY_OK : METER_HISTORY_IO;
+    }
+
+    /* Blocks are filled in order: the head page continues after the last one that is not erased */
+    for (uint32_t page = h->ring.tail;; page = flashRingNext(&h->ring, page)) {
+        uint32_t used = 0;
+        for (uint32_t slot = 0; slot < h->slots; slot++) {
+            const MeterHistoryBlock *b = flashBlock(h, page, slot);
+            if (b->count == ERASED16) {
+                if (flashRingErased(&h->ring, slotOffset(h, page, slot), METER_HISTORY_BLOCK)) {
+                    continue;
+                }
+                h->stats.skipped++;
+            } else {
+                h->count += b->count;
+            }
+            used = slot + 1;
+        }
+        if (page == h->ring.head) {
+            h->headSlot = used;
+            break;
+        }
+    }
+    return METER_HISTORY_OK;
+}
+
+/* Cursor */
+
+static const MeterHistoryBlock *cursorBlock(const MeterHistory *h, const MeterHistoryCursor *c) {
+    if (c->inRam) {
+        return c->slot < h->ramCount ? &h->ram[(h->ramHead + c->slot) % METER_HISTORY_RAM_BLOCKS] : NULL;
+    }
+    return flashBlock(h, c->page, c->slot);
+}
+
+/* From the cursor's block (after it if next) to the first one with samples; left is 0 past the newest */
+static void seek(const MeterHistory *h, MeterHistoryCursor *c, bool next) {
+    const MeterHistoryBlock *b;
+
+    c->left = 0;
+    for (;; next = true) {
+        if (next) {
+            c->slot++;
+        }
+        while (!c->inRam && c->slot >= usedSlots(h, c->page)) {
+            c->inRam = c->page == h->ring.head;
+            c->page = c->inRam ? c->page : flashRingNext(&h->ring, c->page);
+            c->slot = 0;
+        }
+        b = cursorBlock(h, c);
+        if (!b) {
+            return;
+        }
+        if (live(b)) {
+            break;
+        }
+    }
+    c->pos = 0;
+    c->left = b->count;
+}
+
+static void first(const MeterHistory *h, MeterHistoryCursor *c) {
+    c->inRam = !h->flash;
+    c->page = h->ring.tail;
+    c->slot = h->flash ? h->tailSlot : 0;
+    seek(h, c, false);
+}
+
+void meterHistoryBegin(const MeterHistory *h, MeterHistoryCursor *cursor) {
+    uint32_t time;
+    int32_t values[METER_HISTORY_CHANNELS];
+
+    first(h, cursor);
+    for (uint32_t i = 0; i < h->skip; i++) {
+        meterHistoryNext(h, cursor, &time, values); // Dropped, but blocks only decode from their start
+    }
+}
+
+bool meterHistoryNext(const MeterHistory *h, MeterHistoryCursor *cursor, uint32_t *time, int32_t *values) {
+    const MeterHistoryBlock *b;
+
+    if (!cursor->left) {
+        return false;
+    }
+    b = cursorBlock(h, cursor);
+    if (!cursor->pos) {
+        cursor->time = getBits(b->data, &cursor->pos, 32);
+        cursor->delta = 0;
+        memset(cursor->values, 0, sizeof(cursor->values));
+    } else {
+        cursor->delta = (int32_t)((uint32_t)cursor->delta + unzigzag(getCode(b->data, &cursor->pos, timeWidths)));
+        cursor->time += (uint32_t)cursor->delta;
+    }
+    for (uint32_t c = 0; c < h->channels; c++) {
+        cursor->values[c] =
+            (int32_t)((uint32_t)cursor->values[c] + unzigzag(getCode(b->data, &cursor->pos, valueWidths)));
+        values[c] = cursor->values[c];
+    }
+    *time = cursor->time;
+    if (!--cursor->left) {
+        seek(h, cursor, true);
+    }
+    return true;
+}
+
+/* History */
+
+MeterHistoryResult meterHistoryInit(MeterHistory *h, uint8_t channels, const MeterHistoryDevice *dev) {
+    memset(h, 0, sizeof(*h));
+    h->channels = channels < METER_HISTORY_CHANNELS ? channels : METER_HISTORY_CHANNELS;
+    if (!dev) {
+        return METER_HISTORY_OK;
+    }
+    h->flash = true;
+    return mount(h, dev);
+}
+
+/* Takes the oldest RAM block out of the ring, into flash if there is room */
+static MeterHistoryResult spill(MeterHistory *h) {
+    MeterHistoryBlock *b = &h->ram[h->ramHead];
+    MeterHistoryResult result = METER_HISTORY_OK;
+    FlashRing *ring = &h->ring;
+    MeterHistoryCursor c;
+    uint32_t lost;
+
+    if (h->flash) {
+        if (h->headSlot == h->slots) {
+            if (flashRingNext(ring, ring->head) == ring->tail) {
+                result = dropTail(h);
+            }
+            if (!openPage(h, flashRingNext(ring, ring->head), ring->sequence + 1)) {
+                result = METER_HISTORY_IO;
+            }
+        }
+        if (h->headSlot < h->slots) {
+            uint32_t offset = slotOffset(h, ring->head, h->headSlot++); // Taken even if programming fails halfway
+            if (flashRingProgram(ring, offset + offsetof(MeterHistoryBlock, data), b->data, (b->bits + 15u) / 16 * 2) &&
+                flashRingProgram(ring, offset + offsetof(MeterHistoryBlock, bits), &b->bits, 2) &&
+                flashRingProgram(ring, offset + offsetof(MeterHistoryBlock, count), &b->count, 2)) { // Count last
+                h->stats.spilled++;
+                h->ramHead = (uint8_t)((h->ramHead + 1) % METER_HISTORY_RAM_BLOCKS);
+                h->ramCount--;
+                return result;
+            }
+            result = METER_HISTORY_IO;
+        }
+    }
+
+    first(h, &c);
+    lost = b->count - (c.inRam ? h->skip : 0);
+    h->skip = c.inRam ? 0 : h->skip;
+    h->count -= lost;
+    h->stats.dropped += lost;
+    h->ramHead = (uint8_t)((h->ramHead + 1) % METER_HISTORY_RAM_BLOCKS);
+    h->ramCount--;
+    return result;
+}
+
+MeterHistoryResult meterHistoryAppend(MeterHistory *h, uint32_t time, const int32_t *values) {
+    MeterHistoryResult result = METER_HISTORY_OK;
+    MeterHistoryBlock *b = h->open ? &h->ram[(h->ramHead + h->ramCount - 1) % METER_HISTORY_RAM_BLOCKS] : NULL;
+
+    if (!b || b->bits + sampleBits(h, b, time, values) > DATA_BITS) {
+        if (h->ramCount == METER_HISTORY_RAM_BLOCKS) {
+            result = spill(h);
+        }
+        b = &h->ram[(h->ramHead + h->ramCount) % METER_HISTORY_RAM_BLOCKS];
+        h->ramCount++;
+        memset(b, 0, sizeof(*b));
+        memset(h->last, 0, sizeof(h->last));
+        h->open = true;
+    }
+    encode(h, b, time, values);
+    h->count++;
+    h->stats.appended++;
+    return result;
+}
+
+MeterHistoryResult meterHistoryDrop(MeterHistory *h, uint32_t n) {
+    static const uint16_t zero = 0;
+    MeterHistoryResult result = METER_HISTORY_OK;
+
+    n = n < h->count ? n : h->count;
+    h->count -= n;
+    h->stats.uploaded += n;
+    while (n) {
+        MeterHistoryCursor c;
+        const MeterHistoryBlock *b;
+        uint32_t left;
+
+        first(h, &c);
+        b = cursorBlock(h, &c);
+        left = b->count - h->skip;
+        if (n < left) {
+            h->skip += n;
+            break;
+        }
+        n -= left;
+        h->skip = 0;
+        if (c.inRam) {
+            h->ramHead = (uint8_t)((h->ramHead + 1) % METER_HISTORY_RAM_BLOCKS);
+            h->ramCount--;
+            h->open = h->open && h->ramCount;
+            continue;
+        }
+        uint32_t offset = slotOffset(h, c.page, c.slot) + offsetof(MeterHistoryBlock, count);
+        if (!flashRingProgram(&h->ring, offset, &zero, sizeof(zero))) {
+            result = METER_HISTORY_IO;
+        }
+        while (h->ring.tail != c.page) {
+            if (dropTail(h) != METER_HISTORY_OK) { // Nothing left in it
+                result = METER_HISTORY_IO;
+            }
+        }
+        h->tailSlot = c.slot + 1;
+        if (h->ring.tail != h->ring.head && h->tailSlot == h->slots && dropTail(h) != METER_HISTORY_OK) {
+            result = METER_HISTORY_IO;
+        }
+    }
+    return result;
+}
+
+void meterHistoryExport(const MeterHistory *h, MeterHistoryWriteFn write, void *ctx) {
+    char line[160];
+    uint32_t centiBits = h->stats.appended ? (uint32_t)((uint64_t)h->stats.bits * 100 / h->stats.appended) : 0;
+
+    snprintf(line, sizeof(line),
+             "[HIST] %lu samples, %lu.%02lu bits each, %u RAM blocks, %lu spilled, %lu uploaded, %lu dropped, "
+             "%lu erases",
+             (unsigned long)h->count, (unsigned long)(centiBits / 100), (unsigned long)(centiBits % 100),
+             (unsigned)h->ramCount, (unsigned long)h->stats.spilled, (unsigned long)h->stats.uploaded,
+             (unsigned long)h->stats.dropped, (unsigned long)h->ring.erases);
+    write(ctx, line);
+}
@@ -0,0 +1,133 @@
+#ifndef METER_HISTORY_H
+#define METER_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "flash_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Compressed history of meter readings, kept until they can be uploaded.
+ *
+ * A sample is a Unix time and up to METER_HISTORY_CHANNELS integer values.
+ * Samples are bit-packed into blocks of METER_HISTORY_BLOCK bytes, in the
+ * manner of Gorilla (Pelkonen et al., VLDB 2015):
+ *   - The time is stored as the difference of its delta to the previous
+ *     delta. Readings at a steady rate cost one bit.
+ *   - Each value is stored as the zigzag of its difference to the previous
+ *     value of its channel. Meter values are integers, so a small delta
+ *     packs tighter than Gorilla's XOR of float bits.
+ * Both use a prefix code of 1 to 4 bits that selects the width:
+ *   '0' no change, '10' short, '110' medium, '1110' long, '1111' 32 bits
+ * The first sample of a block is stored against zero, so every block decodes
+ * on its own.
+ *
+ * The newest blocks live in a RAM ring of METER_HISTORY_RAM_BLOCKS. When it is
+ * full, the oldest block spills to a flash region (a ring of erase pages,
+ * flash_ring.h, as under flash_kv.h) if there is one, or is dropped. When the flash is full,
+ * its oldest page is erased and its samples are dropped. Drops are counted.
+ * Flash blocks survive a reset: the next meterHistoryInit() mounts them, the
+ * RAM blocks are lost.
+ *
+ * A flash block is programmed in half-words: its data first, then bits, then
+ * count. A block cut short by a reset has no count and is skipped by the next
+ * mount. meterHistoryDrop() removes the oldest samples once they are
+ * uploaded, and programs a flash block's count to 0 once it has no samples
+ * left. A block that is only partly dropped is remembered in RAM, so its
+ * samples may come back after a reset: uploads are at least once.
+ */
+
+#ifndef METER_HISTORY_CHANNELS
+#define METER_HISTORY_CHANNELS 6 // Values per sample, at most
+#endif
+
+#ifndef METER_HISTORY_BLOCK
+#define METER_HISTORY_BLOCK 254 // Bytes with the 4-byte header; four fit a 1 KB page with its header
+#endif
+
+#ifndef METER_HISTORY_RAM_BLOCKS
+#define METER_HISTORY_RAM_BLOCKS 4
+#endif
+
+#define METER_HISTORY_PAGE_HEADER FLASH_RING_HEADER
+
+typedef enum {
+    METER_HISTORY_OK = 0,
+    METER_HISTORY_IO = -1 // Program or erase failed; the samples involved are dropped
+} MeterHistoryResult;
+
+/* The flash region, at least 2 pages; the same device as FlashKvDevice */
+typedef FlashRingDevice MeterHistoryDevice;
+
+typedef struct {
+    uint16_t bits;  // Of data in use
+    uint16_t count; // Samples; 0xFFFF: not finished, 0: all dropped
+    uint8_t data[METER_HISTORY_BLOCK - 4];
+} MeterHistoryBlock;
+
+typedef void (*MeterHistoryWriteFn)(void *ctx, const char *line);
+
+typedef struct {
+    uint32_t appended;
+    uint32_t uploaded;   // Removed by meterHistoryDrop()
+    uint32_t dropped;    // Pushed out of a full history
+    uint32_t bits;       // Encoded, block headers and padding not included
+    uint32_t spilled;    // Blocks written to flash
+    uint32_t skipped;    // Unfinished blocks found by the mount
+} MeterHistoryStats;
+
+typedef struct {
+    uint8_t channels;
+    bool flash;        // ring is mounted
+    FlashRing ring;    // Its head is the flash page being filled; bytes programmed and erases
+    uint32_t slots;    // Blocks per flash page
+    uint32_t tailSlot; // Blocks before this one in the tail page are dropped
+    uint32_t headSlot; // Next free block in the head page
+    MeterHistoryBlock ram[METER_HISTORY_RAM_BLOCKS];
+    uint8_t ramHead;   // Oldest RAM block
+    uint8_t ramCount;
+    bool open;         // The newest RAM block takes more samples
+    uint32_t lastTime; // Encoder state of the open block
+    int32_t lastDelta;
+    int32_t last[METER_HISTORY_CHANNELS];
+    uint32_t count;    // Samples held
+    uint32_t skip;     // Samples of the oldest block already dropped
+    MeterHistoryStats stats;
+} MeterHistory;
+
+/* Decoder state; valid until the next append or drop */
+typedef struct {
+    bool inRam;
+    uint32_t page;
+    uint32_t slot; // Or RAM block, counted from the oldest
+    uint32_t pos;  // Bit position in the block
+    uint32_t left; // Samples left in the block
+    uint32_t time;
+    int32_t delta;
+    int32_t values[METER_HISTORY_CHANNELS];
+} MeterHistoryCursor;
+
+/* Empty RAM history, or mounts the flash region if dev is set (formats it if it holds no valid page) */
+MeterHistoryResult meterHistoryInit(MeterHistory *h, uint8_t channels, const MeterHistoryDevice *dev);
+
+/* One sample of every channel; may spill or drop the oldest block */
+MeterHistoryResult meterHistoryAppend(MeterHistory *h, uint32_t time, const int32_t *values);
+
+/* Oldest sample first */
+void meterHistoryBegin(const MeterHistory *h, MeterHistoryCursor *cursor);
+bool meterHistoryNext(const MeterHistory *h, MeterHistoryCursor *cursor, uint32_t *time, int32_t *values);
+
+/* Removes the oldest n samples, or all of them */
+MeterHistoryResult meterHistoryDrop(MeterHistory *h, uint32_t n);
+
+/* "[HIST] <samples> samples, <bits> bits per sample ..." */
+void meterHistoryExport(const MeterHistory *h, MeterHistoryWriteFn write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METER_HISTORY_H */
@@ -0,0 +1,101 @@
+#include "metering.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void meterInit(Meter *m, int32_t fullScaleMilliVolts, int32_t fullScaleMilliAmps) {
+    int64_t fullScaleMilliWatts = ((int64_t)fullScaleMilliVolts * fullScaleMilliAmps + 500) / 1000;
+
+    memset(m, 0, sizeof(*m));
+    m->offsetV = METER_ADC_MID;
+    m->offsetI = METER_ADC_MID;
+    m->fullScaleMilliVolts = fullScaleMilliVolts;
+    m->fullScaleMilliAmps = fullScaleMilliAmps;
+    m->fullScaleMilliWatts = (int32_t)fullScaleMilliWatts;
+
+    /* One count² of V·I for one sample: full-scale mW / 2^22 / samples per hour */
+    m->mWhMantissa = fxRatio((uint64_t)fullScaleMilliWatts, (uint64_t)METER_SAMPLE_HZ * 3600, &m->mWhShift);
+    m->mWhShift += 2 * METER_ADC_FRAC;
+    m->creepLimit = ((int64_t)METER_CREEP_MW * METER_WINDOW_SAMPLES << (2 * METER_ADC_FRAC)) / fullScaleMilliWatts;
+}
+
+static void latchWindow(Meter *m) {
+    if (m->windowReady) {
+        m->missed++;
+    } else {
+        m->window = m->acc;
+        m->windowReady = true;
+    }
+    if (m->acc.sums.vi > -m->creepLimit && m->acc.sums.vi < m->creepLimit) {
+        m->creeping++; // Noise and offsets of an idle line
+    } else {
+        m->energy += m->acc.sums.vi;
+    }
+    m->windows++; // After the register, see meterEnergyMilliWh()
+
+    m->clipped += m->acc.sums.clipped;
+    m->offsetV = (int32_t)((m->acc.sums.rawV + m->acc.samples / 2) / m->acc.samples);
+    m->offsetI = (int32_t)((m->acc.sums.rawI + m->acc.samples / 2) / m->acc.samples);
+    memset(&m->acc, 0, sizeof(m->acc));
+}
+
+void meterProcessBlock(Meter *m, const uint16_t *pairs, uint32_t count) {
+    while (count > 0) {
+        uint32_t n = METER_WINDOW_SAMPLES - m->acc.samples;
+
+        n = n < count ? n : count;
+        fxSumPairs(pairs, n, m->offsetV, m->offsetI, &m->acc.sums);
+        m->acc.samples += n;
+        pairs += 2 * n;
+        count -= n;
+        if (m->acc.samples == METER_WINDOW_SAMPLES) {
+            latchWindow(m);
+        }
+    }
+    m->blocks++;
+}
+
+bool meterUpdate(Meter *m) {
+    MeterWindow w;
+
+    if (!m->windowReady) {
+        return false;
+    }
+    w = m->window;
+    m->windowReady = false; // The interrupt may latch the next one now
+    m->milliVolts = fxScaleQ31(fxRmsQ31(w.sums.vv, w.samples, METER_ADC_FRAC), m->fullScaleMilliVolts);
+    m->milliAmps = fxScaleQ31(fxRmsQ31(w.sums.ii, w.samples, METER_ADC_FRAC), m->fullScaleMilliAmps);
+    m->milliWatts = fxScaleQ31(fxMeanQ31(w.sums.vi, w.samples, METER_ADC_FRAC), m->fullScaleMilliWatts);
+    return true;
+}
+
+int64_t meterEnergyMilliWh(const Meter *m) {
+    uint32_t windows;
+    int64_t energy;
+
+    do {
+        windows = m->windows;
+        energy = m->energy;
+    } while (windows != m->windows); // Retry if a window was latched in between
+    return fxMulShift(energy, m->mWhMantissa, m->mWhShift);
+}
+
+/* value / 10^decimals with its decimals, "-1.234" */
+void meterExport(const Meter *m, MeterWriteFn write, void *ctx) {
+    char line[160], volts[16], amps[16], watts[16], pf[16], kwh[24];
+    int64_t va = (int64_t)m->milliVolts * m->milliAmps / 1000; // mVA
+
+    fxFormat(volts, sizeof(volts), m->milliVolts / 100, 1);
+    fxFormat(amps, sizeof(amps), m->milliAmps / 10, 2);
+    fxFormat(watts, sizeof(watts), m->milliWatts / 1000, 0);
+    fxFormat(pf, sizeof(pf), va > 0 ? (int64_t)m->milliWatts * 100 / va : 0, 2);
+    fxFormat(kwh, sizeof(kwh), meterEnergyMilliWh(m) / 1000, 3);
+    snprintf(line, sizeof(line), "[METER] %s V %s A %s W PF %s, %s kWh", volts, amps, watts, pf, kwh);
+    write(ctx, line);
+    snprintf(line, sizeof(line),
+             "[METER] %lu windows, %lu idle, %lu missed, %lu clipped, offsets %ld/%ld, %lu avg / %lu max cycles",
+             (unsigned long)m->windows, (unsigned long)m->creeping, (unsigned long)m->missed,
+             (unsigned long)m->clipped, (long)m->offsetV, (long)m->offsetI,
+             (unsigned long)(m->blocks ? m->cyclesTotal / m->blocks : 0), (unsigned long)m->cyclesMax);
+    write(ctx, line);
+}
@@ -0,0 +1,120 @@
+#ifndef METERING_H
+#define METERING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fixed_point.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Energy metering from ADC samples of the line voltage and the load current.
+ *
+ * A timer triggers a conversion of both channels METER_SAMPLE_HZ times a
+ * second, and DMA writes the V, I pairs into a circular buffer of two blocks.
+ * The half- and full-transfer interrupts pass the block the DMA has just
+ * finished to meterProcessBlock() while it fills the other one. That only adds
+ * integer sums: V², I² and V·I of the samples with their DC bias removed.
+ * Every METER_WINDOW_SAMPLES pairs the sums are latched as one window, and the
+ * energy register advances by the window's V·I sum, so no energy is lost
+ * however late the main loop runs.
+ *
+ * meterUpdate() in the main loop turns the latched window into Vrms, Irms and
+ * real power; the square roots and the scaling stay out of the interrupt. The
+ * bias of each channel (mid-scale of the front end) is taken from the mean of
+ * the previous window, so it follows drift of the reference.
+ *
+ * All of it is integer math (fixed_point.h): the F030 has no FPU. Samples
+ * less their bias are Q11 fractions of the full scales below, measurements
+ * are in mV, mA and mW. The register counts in ADC units and is exact; at
+ * full scale on both channels it runs for 17 years before the 64-bit sum
+ * overflows. meterEnergyMilliWh() scales it, and retries if a window was
+ * latched while it read the register. Everything above "Main loop" in Meter
+ * belongs to the DMA interrupt.
+ */
+
+#ifndef METER_SAMPLE_HZ
+#define METER_SAMPLE_HZ 4000 // V, I pairs per second: 80 per 50 Hz cycle
+#endif
+
+#ifndef METER_BLOCK_PAIRS
+#define METER_BLOCK_PAIRS 40 // Pairs per DMA half-transfer, 10 ms
+#endif
+
+#ifndef METER_WINDOW_SAMPLES
+#define METER_WINDOW_SAMPLES METER_SAMPLE_HZ // 1 s: whole cycles at 50 and 60 Hz
+#endif
+
+/* Front end calibration: line and load at METER_ADC_MID counts from the bias */
+#ifndef METER_FULL_SCALE_MV
+#define METER_FULL_SCALE_MV 409600 // 0.2 V per count
+#endif
+#ifndef METER_FULL_SCALE_MA
+#define METER_FULL_SCALE_MA 51200 // 0.025 A per count, 32 A rms leaves headroom
+#endif
+
+/* Windows below this real power add nothing to the register (no-load creep) */
+#ifndef METER_CREEP_MW
+#define METER_CREEP_MW 5000
+#endif
+
+#define METER_ADC_MAX  4095 // 12-bit, right aligned
+#define METER_ADC_MID  2048 // Bias before the first window
+#define METER_ADC_FRAC 11   // Samples less their bias are Q11
+
+typedef void (*MeterWriteFn)(void *ctx, const char *line);
+
+typedef struct {
+    FxPairSums sums;
+    uint32_t samples;
+} MeterWindow;
+
+typedef struct {
+    /* DMA interrupt */
+    int32_t offsetV; // ADC counts
+    int32_t offsetI;
+    MeterWindow acc;
+    volatile MeterWindow window; // Last complete window, kept until meterUpdate() took it
+    volatile int64_t energy;     // Sum of V·I over all windows, in counts²·samples
+    volatile uint32_t windows;
+    volatile bool windowReady;
+    uint32_t blocks;
+    uint32_t missed;  // Windows not measured: meterUpdate() had not taken the previous one
+    uint32_t clipped; // Samples at either end of the ADC range
+    uint32_t creeping; // Windows below METER_CREEP_MW
+    int64_t creepLimit; // METER_CREEP_MW as a window's V·I sum
+    uint32_t cyclesTotal; // Of meterProcessBlock(), filled in by the caller
+    uint32_t cyclesMax;
+
+    /* Main loop */
+    int32_t fullScaleMilliVolts;
+    int32_t fullScaleMilliAmps;
+    int32_t fullScaleMilliWatts;
+    uint32_t mWhMantissa; // Register to mWh: * mantissa >> shift
+    uint8_t mWhShift;
+    int32_t milliVolts; // Vrms
+    int32_t milliAmps;  // Irms
+    int32_t milliWatts; // Real power, negative when exporting
+} Meter;
+
+void meterInit(Meter *m, int32_t fullScaleMilliVolts, int32_t fullScaleMilliAmps);
+
+/* One finished DMA block of pairs, V first; from the half/full-transfer interrupt */
+void meterProcessBlock(Meter *m, const uint16_t *pairs, uint32_t count);
+
+/* Measurements of the window latched since the last call; false if there is none */
+bool meterUpdate(Meter *m);
+
+/* Energy register in mWh */
+int64_t meterEnergyMilliWh(const Meter *m);
+
+/* "[METER] <V> V <A> A <W> W ..." */
+void meterExport(const Meter *m, MeterWriteFn write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METERING_H */
@@ -0,0 +1,118 @@
+#include "msg_arena.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define OTHER_ACTIONS "(other)"
+
+void msgArenaInit(MsgArena *arena, void *buf, uint32_t size) {
+    uintptr_t start = ((uintptr_t)buf + MSG_ARENA_ALIGN - 1) & ~(uintptr_t)(MSG_ARENA_ALIGN - 1);
+    memset(arena, 0, sizeof(*arena));
+    for (uint32_t i = 0; i < MSG_ARENA_ACTIONS; i++) {
+        arena->actions[i].action = STR_INVALID;
+    }
+    arena->buf = (uint8_t *)start;
+    arena->size = size > start - (uintptr_t)buf ? size - (uint32_t)(start - (uintptr_t)buf) : 0;
+}
+
+void *msgArenaAlloc(MsgArena *arena, size_t size) {
+    uint32_t offset = (arena->used + MSG_ARENA_ALIGN - 1) & ~(uint32_t)(MSG_ARENA_ALIGN - 1);
+    if (offset > arena->size || size > arena->size - offset) {
+        arena->overflowed = true;
+        return NULL;
+    }
+    arena->used = offset + (uint32_t)size;
+    return arena->buf + offset;
+}
+
+char *msgArenaStrndup(MsgArena *arena, const char *s, size_t len) {
+    char *copy = msgArenaAlloc(arena, len + 1);
+    if (copy) {
+        memcpy(copy, s, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+char *msgArenaVprintf(MsgArena *arena, const char *format, va_list args) {
+    uint32_t offset = (arena->used + MSG_ARENA_ALIGN - 1) & ~(uint32_t)(MSG_ARENA_ALIGN - 1);
+    uint32_t room = offset < arena->size ? arena->size - offset : 0;
+    char *text = (char *)arena->buf + offset;
+    int len = room ? vsnprintf(text, room, format, args) : -1;
+
+    if (len < 0 || (uint32_t)len >= room) {
+        arena->overflowed = true;
+        return NULL;
+    }
+    arena->used = offset + (uint32_t)len + 1;
+    return text;
+}
+
+char *msgArenaPrintf(MsgArena *arena, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    char *text = msgArenaVprintf(arena, format, args);
+    va_end(args);
+    return text;
+}
+
+/* Slot for an action; the last slot takes every action that finds no free one, and every unknown name */
+static MsgArenaAction *actionSlot(MsgArena *arena, StrHandle handle) {
+    for (uint32_t i = 0; handle != STR_INVALID && i < MSG_ARENA_ACTIONS - 1; i++) {
+        MsgArenaAction *action = &arena->actions[i];
+        if (action->action == STR_INVALID) {
+            action->action = handle;
+            return action;
+        }
+        if (action->action == handle) {
+            return action;
+        }
+    }
+    return &arena->actions[MSG_ARENA_ACTIONS - 1];
+}
+
+void msgArenaReset(MsgArena *arena, const char *name) {
+    MsgArenaAction *action = actionSlot(arena, name && name[0] ? strFind(name, strlen(name)) : STR_NONE);
+
+    action->messages++;
+    action->last = (uint16_t)arena->used;
+    if (arena->used > action->peak) {
+        action->peak = (uint16_t)arena->used;
+    }
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    if (arena->overflowed) {
+        action->overflows++;
+        arena->overflows++;
+    }
+    arena->messages++;
+    arena->used = 0;
+    arena->overflowed = false;
+}
+
+static const char *actionName(uint32_t slot, StrHandle handle) {
+    if (slot == MSG_ARENA_ACTIONS - 1) {
+        return OTHER_ACTIONS;
+    }
+    return handle == STR_NONE ? "(none)" : strText(handle);
+}
+
+void msgArenaExport(const MsgArena *arena, MsgArenaWriteFn write, void *ctx) {
+    char line[96];
+
+    snprintf(line, sizeof(line), "[ARENA] peak %lu of %lu B over %lu messages, %lu overflowed",
+             (unsigned long)arena->peak, (unsigned long)arena->size, (unsigned long)arena->messages,
+             (unsigned long)arena->overflows);
+    write(ctx, line);
+    for (uint32_t i = 0; i < MSG_ARENA_ACTIONS; i++) {
+        const MsgArenaAction *action = &arena->actions[i];
+        if (!action->messages) {
+            continue;
+        }
+        snprintf(line, sizeof(line), "[ARENA] %s: peak %u B, last %u B, %lu messages, %lu overflowed",
+                 actionName(i, action->action), (unsigned)action->peak, (unsigned)action->last,
+                 (unsigned long)action->messages, (unsigned long)action->overflows);
+        write(ctx, line);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef MSG_ARENA_H
+#define MSG_ARENA_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "str_intern.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bump-pointer arena for handling one inbound message.
+ *
+ * Handlers take the pieces of the parsed CALL, the strings they copy out of
+ * the payload and the response they render from the arena. Nothing is freed
+ * one by one: msgArenaReset() after the dispatch drops all of it at once. So
+ * the memory for a message is bounded by the arena size, and the cost does
+ * not depend on what earlier messages left behind. A request that does not
+ * fit returns NULL and marks the message as overflowed. The handler then
+ * answers without the piece, for example with a CALLERROR.
+ *
+ * The reset also records the bytes that message used under its action name,
+ * so the export shows the peak per action type. Actions are kept as handles
+ * of the interned constants (str_intern.h); names that are not one count
+ * under "(other)". Size the arena from the
+ * largest peak. The arena is used from one context only (the USART2 RX
+ * interrupt in stm32/main.c). The export reads the counters without a lock,
+ * so run it from the main loop; one line may then mix two messages.
+ */
+
+#ifndef MSG_ARENA_SIZE
+#define MSG_ARENA_SIZE 512 // Twice the 256 byte receive buffer: copies of it and the response
+#endif
+
+#define MSG_ARENA_ACTIONS    8  // Action names with their own peak; the last one collects the rest
+#define MSG_ARENA_ALIGN      8  // As malloc
+
+typedef void (*MsgArenaWriteFn)(void *ctx, const char *line);
+
+typedef struct {
+    StrHandle action; // STR_INVALID while the slot is free
+    uint32_t messages;
+    uint32_t overflows;
+    uint16_t peak; // Bytes of the largest message
+    uint16_t last;
+} MsgArenaAction;
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t used;
+    uint32_t peak;
+    uint32_t messages;
+    uint32_t overflows;
+    bool overflowed; // The current message ran out of space
+    MsgArenaAction actions[MSG_ARENA_ACTIONS];
+} MsgArena;
+
+void msgArenaInit(MsgArena *arena, void *buf, uint32_t size);
+
+/* MSG_ARENA_ALIGN-aligned, NULL when the rest of the arena is too small */
+void *msgArenaAlloc(MsgArena *arena, size_t size);
+
+/* NUL-terminated copy of len bytes */
+char *msgArenaStrndup(MsgArena *arena, const char *s, size_t len);
+
+/* vsnprintf into the arena; NULL (and nothing taken) if the text does not fit */
+char *msgArenaPrintf(MsgArena *arena, const char *format, ...) __attribute__((format(printf, 2, 3)));
+char *msgArenaVprintf(MsgArena *arena, const char *format, va_list args);
+
+/* Ends a message: books its usage under action (NULL counts as "(none)") and frees everything */
+void msgArenaReset(MsgArena *arena, const char *action);
+
+/* "[ARENA] <n> of <size> B peak ..." and one "[ARENA] <action>: ..." line per action */
+void msgArenaExport(const MsgArena *arena, MsgArenaWriteFn write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MSG_ARENA_H */
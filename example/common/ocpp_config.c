@@ -0,0 +1,321 @@
+#include "ocpp_config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Flash table */
+#define OFFSET_RW(name) offsetof(OcppConfigValues, name)
+#define OFFSET_RB(name) offsetof(OcppConfigValues, name)
+#define OFFSET_RO(name) OCPP_CONFIG_NO_RAM
+#define FLAGS_RW        0
+#define FLAGS_RB        OCPP_CONFIG_REBOOT
+#define FLAGS_RO        OCPP_CONFIG_READONLY
+
+#define KEY_B(name, value, access) \
+    {#name, NULL, (value), OCPP_CONFIG_NO_RAM, OCPP_CONFIG_BOOL, FLAGS_##access, 0},
+#define KEY_I(name, value, access) \
+    {#name, NULL, (value), OFFSET_##access(name), OCPP_CONFIG_INT, FLAGS_##access, 0},
+#define KEY_S(name, value, access, bytes) \
+    {#name, (value), 0, OFFSET_##access(name), OCPP_CONFIG_STRING, FLAGS_##access, (bytes)},
+
+const OcppConfigKey ocppConfigKeys[OCPP_CONFIG_KEY_COUNT] = {OCPP_CONFIG_KEYS(KEY_B, KEY_I, KEY_S)};
+
+#define CHECK_DEFAULT_S(name, value, access, bytes) \
+    _Static_assert(sizeof(value) <= (bytes) || (bytes) == 0, #name " default longer than its RAM");
+#define CHECK_NONE(...)
+OCPP_CONFIG_KEYS(CHECK_NONE, CHECK_NONE, CHECK_DEFAULT_S)
+
+OcppConfigValues ocppConfigValues;
+
+static const char *const statusNames[] = {"Accepted", "Rejected", "RebootRequired", "NotSupported"};
+
+/* Value storage in RAM, NULL for read-only keys */
+static void *slot(const OcppConfigKey *key) {
+    return key->offset == OCPP_CONFIG_NO_RAM ? NULL : (uint8_t *)&ocppConfigValues + key->offset;
+}
+
+static void setBit(OcppConfigId id, bool value) {
+    if (value) {
+        ocppConfigValues.bools[id / 8] |= (uint8_t)(1u << (id % 8));
+    } else {
+        ocppConfigValues.bools[id / 8] &= (uint8_t)~(1u << (id % 8));
+    }
+}
+
+bool ocppConfigInit(void) {
+    for (uint32_t id = 0; id < OCPP_CONFIG_KEY_COUNT; id++) {
+        const OcppConfigKey *key = &ocppConfigKeys[id];
+        void *value = slot(key);
+        if (key->type == OCPP_CONFIG_BOOL) {
+            setBit((OcppConfigId)id, key->defaultInt != 0);
+        } else if (value && key->type == OCPP_CONFIG_INT) {
+            memcpy(value, &key->defaultInt, sizeof(int32_t)); // Packed, may be unaligned
+        } else if (value) {
+            strcpy((char *)value, key->defaultString);
+        }
+        if (id > 0 && strcmp(ocppConfigKeys[id - 1].name, key->name) >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int ocppConfigFind(const char *name, size_t len) {
+    int lo = 0, hi = OCPP_CONFIG_KEY_COUNT - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const char *key = ocppConfigKeys[mid].name;
+        int cmp = strncmp(key, name, len);
+        if (cmp == 0 && key[len] != '\0') {
+            cmp = 1; // name is a prefix of key
+        }
+        if (cmp == 0) {
+            return mid;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return -1;
+}
+
+bool ocppConfigGetBool(OcppConfigId id) {
+    return (ocppConfigValues.bools[id / 8] >> (id % 8)) & 1;
+}
+
+int32_t ocppConfigGetInt(OcppConfigId id) {
+    const OcppConfigKey *key = &ocppConfigKeys[id];
+    const void *value = slot(key);
+    int32_t result = key->defaultInt;
+    if (value) {
+        memcpy(&result, value, sizeof(result));
+    }
+    return result;
+}
+
+const char *ocppConfigGetString(OcppConfigId id) {
+    const OcppConfigKey *key = &ocppConfigKeys[id];
+    const char *value = slot(key);
+    return value ? value : key->defaultString;
+}
+
+size_t ocppConfigFormat(OcppConfigId id, char *out, size_t size) {
+    int len;
+    switch (ocppConfigKeys[id].type) {
+        case OCPP_CONFIG_BOOL:
+            len = snprintf(out, size, "%s", ocppConfigGetBool(id) ? "true" : "false");
+            break;
+        case OCPP_CONFIG_INT:
+            len = snprintf(out, size, "%ld", (long)ocppConfigGetInt(id));
+            break;
+        default:
+            len = snprintf(out, size, "%s", ocppConfigGetString(id));
+            break;
+    }
+    return len < 0 ? 0 : (size_t)len < size ? (size_t)len : size - 1;
+}
+
+static bool parseInt(const char *text, size_t len, int32_t *out) {
+    int64_t value = 0;
+    if (len == 0 || len > 10) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false; // All integer keys are counts or intervals, never negative
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    if (value > INT32_MAX) {
+        return false;
+    }
+    *out = (int32_t)value;
+    return true;
+}
+
+static bool matches(const char *text, size_t len, const char *word) {
+    size_t i = 0;
+    for (; i < len && word[i]; i++) {
+        if ((text[i] | 0x20) != word[i]) {
+            return false;
+        }
+    }
+    return i == len && !word[i];
+}
+
+OcppConfigStatus ocppConfigSet(OcppConfigId id, const char *value, size_t len) {
+    const OcppConfigKey *key = &ocppConfigKeys[id];
+    int32_t number;
+
+    if (key->flags & OCPP_CONFIG_READONLY) {
+        return OCPP_CONFIG_REJECTED;
+    }
+    switch (key->type) {
+        case OCPP_CONFIG_BOOL:
+            if (!matches(value, len, "true") && !matches(value, len, "false")) {
+                return OCPP_CONFIG_REJECTED;
+            }
+            setBit(id, matches(value, len, "true"));
+            break;
+        case OCPP_CONFIG_INT:
+            if (!parseInt(value, len, &number)) {
+                return OCPP_CONFIG_REJECTED;
+            }
+            memcpy(slot(key), &number, sizeof(number));
+            break;
+        default:
+            if (len >= key->bytes) {
+                return OCPP_CONFIG_REJECTED;
+            }
+            memcpy(slot(key), value, len);
+            ((char *)slot(key))[len] = '\0';
+            break;
+    }
+    return key->flags & OCPP_CONFIG_REBOOT ? OCPP_CONFIG_REBOOT_REQUIRED : OCPP_CONFIG_ACCEPTED;
+}
+
+/* JSON scanning: enough for the two request payloads, escapes are kept as they are */
+static const char *skipSpace(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+        p++;
+    }
+    return p;
+}
+
+/* String at p: start and length of its contents; returns the position after it, NULL if none */
+static const char *readString(const char *p, const char **start, size_t *len) {
+    p = skipSpace(p);
+    if (*p != '"') {
+        return NULL;
+    }
+    *start = ++p;
+    while (*p && *p != '"') {
+        p += (*p == '\\' && p[1]) ? 2 : 1;
+    }
+    if (*p != '"') {
+        return NULL;
+    }
+    *len = (size_t)(p - *start);
+    return p + 1;
+}
+
+/* Value of a top-level member, NULL if absent */
+static const char *member(const char *payload, const char *name) {
+    const char *p = skipSpace(payload);
+    size_t nameLen = strlen(name);
+
+    if (*p++ != '{') {
+        return NULL;
+    }
+    for (int depth = 0; *p; p++) {
+        if (*p == '"') {
+            const char *start;
+            size_t len;
+            const char *end = readString(p, &start, &len);
+            if (!end) {
+                return NULL;
+            }
+            end = skipSpace(end);
+            if (depth == 0 && *end == ':' && len == nameLen && !strncmp(start, name, len)) {
+                return skipSpace(end + 1);
+            }
+            p = end - 1;
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            depth--;
+        }
+    }
+    return NULL;
+}
+
+OcppConfigStatus ocppConfigChange(const char *payload) {
+    const char *keyValue = member(payload, "key");
+    const char *valueValue = member(payload, "value");
+    const char *name, *value;
+    size_t nameLen, valueLen;
+
+    if (!keyValue || !valueValue || !readString(keyValue, &name, &nameLen) ||
+        !readString(valueValue, &value, &valueLen)) {
+        return OCPP_CONFIG_REJECTED;
+    }
+    int id = ocppConfigFind(name, nameLen);
+    return id < 0 ? OCPP_CONFIG_NOT_SUPPORTED : ocppConfigSet((OcppConfigId)id, value, valueLen);
+}
+
+int ocppConfigChangeKey(const char *payload) {
+    const char *keyValue = member(payload, "key");
+    const char *name;
+    size_t nameLen;
+
+    return keyValue && readString(keyValue, &name, &nameLen) ? ocppConfigFind(name, nameLen) : -1;
+}
+
+const char *ocppConfigStatusName(OcppConfigStatus status) {
+    return statusNames[status];
+}
+
+static void writeText(OcppConfigWriteFn write, void *ctx, const char *text) {
+    write(ctx, text, strlen(text));
+}
+
+static void writeKey(OcppConfigId id, bool first, OcppConfigWriteFn write, void *ctx) {
+    const OcppConfigKey *key = &ocppConfigKeys[id];
+    char value[80];
+
+    ocppConfigFormat(id, value, sizeof(value));
+    writeText(write, ctx, first ? "{\"key\":\"" : ",{\"key\":\"");
+    writeText(write, ctx, key->name);
+    writeText(write, ctx, key->flags & OCPP_CONFIG_READONLY ? "\",\"readonly\":true,\"value\":\""
+                                                            : "\",\"readonly\":false,\"value\":\"");
+    writeText(write, ctx, value);
+    writeText(write, ctx, "\"}");
+}
+
+void ocppConfigGet(const char *payload, OcppConfigWriteFn write, void *ctx) {
+    const char *keys = member(payload, "key");
+    const char *p, *name;
+    size_t len;
+    bool first = true;
+
+    if (keys && *keys != '[') {
+        keys = NULL;
+    }
+    if (keys && *skipSpace(keys + 1) == ']') {
+        keys = NULL; // An empty list asks for every key as well
+    }
+
+    writeText(write, ctx, "{\"configurationKey\":[");
+    if (!keys) {
+        for (uint32_t id = 0; id < OCPP_CONFIG_KEY_COUNT; id++) {
+            writeKey((OcppConfigId)id, id == 0, write, ctx);
+        }
+        writeText(write, ctx, "]}");
+        return;
+    }
+    for (p = keys + 1; (p = readString(p, &name, &len)) != NULL; p = skipSpace(p) + 1) {
+        int id = ocppConfigFind(name, len);
+        if (id >= 0) {
+            writeKey((OcppConfigId)id, first, write, ctx);
+            first = false;
+        }
+        if (*skipSpace(p) != ',') {
+            break;
+        }
+    }
+    first = true;
+    for (p = keys + 1; (p = readString(p, &name, &len)) != NULL; p = skipSpace(p) + 1) {
+        if (ocppConfigFind(name, len) < 0) {
+            writeText(write, ctx, first ? "],\"unknownKey\":[\"" : ",\"");
+            write(ctx, name, len);
+            writeText(write, ctx, "\"");
+            first = false;
+        }
+        if (*skipSpace(p) != ',') {
+            break;
+        }
+    }
+    writeText(write, ctx, "]}");
+}
@@ -0,0 +1,158 @@
+#ifndef OCPP_CONFIG_H
+#define OCPP_CONFIG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * OCPP 1.6 configuration keys, split between flash and RAM.
+ *
+ * Names, types, access and defaults are const tables built from
+ * OCPP_CONFIG_KEYS, so they stay in flash (.rodata). Only the values that can
+ * change live in RAM, in the packed struct OcppConfigValues: one member per
+ * writable int or string key, and one bit per bool key. Read-only keys take
+ * no RAM at all; their value is the default.
+ *
+ * Firmware code reads a key through its compile-time ID, e.g.
+ * OCPP_CONFIG_GET_INT(HeartbeatInterval). That is an index into the table.
+ * Names from GetConfiguration and ChangeConfiguration go through a binary
+ * search, so OCPP_CONFIG_KEYS must be sorted by name. ocppConfigInit()
+ * returns false if it is not.
+ *
+ * The table lists the keys of the Core profile and the Smart Charging limits.
+ * B(name, default, access), I(name, default, access) and S(name, default,
+ * access, RAM bytes incl. NUL); access is RW, RO or RB (writable, takes
+ * effect after a reboot).
+ */
+
+#define OCPP_CONFIG_KEYS(B, I, S)                                                        \
+    B(AllowOfflineTxForUnknownId, false, RW)                                             \
+    B(AuthorizationCacheEnabled, false, RW)                                              \
+    B(AuthorizeRemoteTxRequests, true, RW)                                               \
+    I(ChargeProfileMaxStackLevel, 8, RO)                                                 \
+    S(ChargingScheduleAllowedChargingRateUnit, "Current", RO, 0)                         \
+    I(ChargingScheduleMaxPeriods, 24, RO)                                                \
+    I(ClockAlignedDataInterval, 0, RW)                                                   \
+    I(ConnectionTimeOut, 30, RW)                                                         \
+    S(ConnectorPhaseRotation, "Unknown", RW, 16)                                         \
+    I(GetConfigurationMaxKeys, 30, RO)                                                   \
+    I(HeartbeatInterval, 86400, RW)                                                      \
+    B(LocalAuthorizeOffline, true, RW)                                                   \
+    B(LocalPreAuthorize, false, RW)                                                      \
+    I(MaxChargingProfilesInstalled, 8, RO)                                               \
+    I(MeterValueSampleInterval, 60, RW)                                                  \
+    S(MeterValuesAlignedData, "Energy.Active.Import.Register", RW, 64)                   \
+    S(MeterValuesSampledData, "Energy.Active.Import.Register", RW, 64)                   \
+    I(NumberOfConnectors, 1, RO)                                                         \
+    I(ResetRetries, 3, RW)                                                               \
+    B(StopTransactionOnEVSideDisconnect, true, RW)                                       \
+    B(StopTransactionOnInvalidId, true, RW)                                              \
+    S(StopTxnAlignedData, "", RW, 64)                                                    \
+    S(StopTxnSampledData, "", RW, 64)                                                    \
+    S(SupportedFeatureProfiles, "Core,RemoteTrigger,SmartCharging", RO, 0)               \
+    I(TransactionMessageAttempts, 3, RW)                                                 \
+    I(TransactionMessageRetryInterval, 60, RW)                                           \
+    B(UnlockConnectorOnEVSideDisconnect, true, RW)                                       \
+    I(WebSocketPingInterval, 0, RB)
+
+/* Key IDs */
+#define OCPP_CONFIG_ID(name, ...) OCPP_CONFIG_##name,
+typedef enum {
+    OCPP_CONFIG_KEYS(OCPP_CONFIG_ID, OCPP_CONFIG_ID, OCPP_CONFIG_ID)
+    OCPP_CONFIG_KEY_COUNT
+} OcppConfigId;
+#undef OCPP_CONFIG_ID
+
+/* RAM block: members for writable ints and strings only */
+#define OCPP_CONFIG_FIELD_B(name, value, access)
+#define OCPP_CONFIG_FIELD_I(name, value, access)        OCPP_CONFIG_FIELD_I_##access(name)
+#define OCPP_CONFIG_FIELD_S(name, value, access, bytes) OCPP_CONFIG_FIELD_S_##access(name, bytes)
+#define OCPP_CONFIG_FIELD_I_RW(name)                    int32_t name;
+#define OCPP_CONFIG_FIELD_I_RB(name)                    int32_t name;
+#define OCPP_CONFIG_FIELD_I_RO(name)
+#define OCPP_CONFIG_FIELD_S_RW(name, bytes)             char name[bytes];
+#define OCPP_CONFIG_FIELD_S_RB(name, bytes)             char name[bytes];
+#define OCPP_CONFIG_FIELD_S_RO(name, bytes)
+
+typedef struct __attribute__((packed)) {
+    uint8_t bools[(OCPP_CONFIG_KEY_COUNT + 7) / 8]; // Bit = key ID
+    OCPP_CONFIG_KEYS(OCPP_CONFIG_FIELD_B, OCPP_CONFIG_FIELD_I, OCPP_CONFIG_FIELD_S)
+} OcppConfigValues;
+
+typedef enum {
+    OCPP_CONFIG_BOOL,
+    OCPP_CONFIG_INT,
+    OCPP_CONFIG_STRING
+} OcppConfigType;
+
+#define OCPP_CONFIG_READONLY 0x01
+#define OCPP_CONFIG_REBOOT   0x02
+#define OCPP_CONFIG_NO_RAM   0xFFFF
+
+typedef struct {
+    const char *name;
+    const char *defaultString; // Strings
+    int32_t defaultInt;        // Ints and bools
+    uint16_t offset;           // Into OcppConfigValues, OCPP_CONFIG_NO_RAM for read-only keys and bools
+    uint8_t type;              // OcppConfigType
+    uint8_t flags;
+    uint8_t bytes;             // String capacity in RAM, including the NUL
+} OcppConfigKey;
+
+/* ChangeConfiguration.conf status */
+typedef enum {
+    OCPP_CONFIG_ACCEPTED,
+    OCPP_CONFIG_REJECTED,
+    OCPP_CONFIG_REBOOT_REQUIRED,
+    OCPP_CONFIG_NOT_SUPPORTED
+} OcppConfigStatus;
+
+typedef void (*OcppConfigWriteFn)(void *ctx, const char *data, size_t len);
+
+extern const OcppConfigKey ocppConfigKeys[OCPP_CONFIG_KEY_COUNT];
+extern OcppConfigValues ocppConfigValues;
+
+/* Loads the defaults; false if OCPP_CONFIG_KEYS is not sorted */
+bool ocppConfigInit(void);
+
+/* Key ID for a name, -1 if unknown */
+int ocppConfigFind(const char *name, size_t len);
+
+bool ocppConfigGetBool(OcppConfigId id);
+int32_t ocppConfigGetInt(OcppConfigId id);
+const char *ocppConfigGetString(OcppConfigId id);
+
+#define OCPP_CONFIG_GET_BOOL(name)   ocppConfigGetBool(OCPP_CONFIG_##name)
+#define OCPP_CONFIG_GET_INT(name)    ocppConfigGetInt(OCPP_CONFIG_##name)
+#define OCPP_CONFIG_GET_STRING(name) ocppConfigGetString(OCPP_CONFIG_##name)
+
+/* Value as OCPP text ("true", "60", ...); returns the length, truncated to size - 1 */
+size_t ocppConfigFormat(OcppConfigId id, char *out, size_t size);
+
+/* Validates and stores a value given as text */
+OcppConfigStatus ocppConfigSet(OcppConfigId id, const char *value, size_t len);
+
+/* ChangeConfiguration.req payload {"key":"...","value":"..."} */
+OcppConfigStatus ocppConfigChange(const char *payload);
+
+/* Key ID named in a ChangeConfiguration.req payload, -1 if none or unknown */
+int ocppConfigChangeKey(const char *payload);
+const char *ocppConfigStatusName(OcppConfigStatus status);
+
+/*
+ * GetConfiguration.conf payload for a GetConfiguration.req payload: the
+ * listed keys and unknownKey, or every key when "key" is absent. Written in
+ * pieces, so the reply is never held in RAM as a whole.
+ */
+void ocppConfigGet(const char *payload, OcppConfigWriteFn write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OCPP_CONFIG_H */
@@ -0,0 +1,58 @@
+/*
+ * Global operator new/delete on the block pools (common/block_pool.h).
+ *
+ * Link this into the STM32 image next to the MicroOcpp library, with
+ * -DBLOCK_POOL=1 so stm32/main.c answers "PoolStats". C++ on the
+ * target is MicroOcpp only, so every object it creates comes from the pools
+ * and everything else keeps using malloc. The library is built without
+ * exceptions, so a failed plain new aborts like libstdc++'s does then; the
+ * nothrow forms return nullptr.
+ */
+#include <cstdlib>
+#include <new>
+
+#include "block_pool.h"
+
+void *operator new(std::size_t size) {
+    void *ptr = poolAlloc(size ? size : 1);
+    if (!ptr) {
+        std::abort();
+    }
+    return ptr;
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return poolAlloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return poolAlloc(size ? size : 1);
+}
+
+void operator delete(void *ptr) noexcept {
+    poolFree(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    poolFree(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    poolFree(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+    poolFree(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    poolFree(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    poolFree(ptr);
+}
@@ -0,0 +1,170 @@
+#include "probe.h"
+#include "critical.h"
+
+#include <stdio.h>
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+#define PROBE_HAS_DWT 1
+#define PROBE_DEMCR      (*(volatile uint32_t *)0xE000EDFCu)
+#define PROBE_DWT_CTRL   (*(volatile uint32_t *)0xE0001000u)
+#define PROBE_DWT_CYCCNT (*(volatile uint32_t *)0xE0001004u)
+#elif defined(__unix__) || defined(__APPLE__)
+#define PROBE_HAS_CLOCK_GETTIME 1
+#include <time.h>
+#endif
+
+static ProbeRecord trace[PROBE_TRACE_LEN];
+static uint32_t head; // Total records written, the ring index is head % PROBE_TRACE_LEN
+static CriticalFlag lock; // Probes fire in interrupts and in the main loop
+static ProbeClockFn clockFn;
+static uint32_t clockHz;
+
+static const char *const names[PROBE_COUNT] = {
+    "ws_rx", "uart_tx", "rx_done", "dispatch", "begin_tx", "gpio_write",
+};
+
+#if PROBE_HAS_DWT
+static uint32_t dwtCycles(void) {
+    return PROBE_DWT_CYCCNT;
+}
+#elif PROBE_HAS_CLOCK_GETTIME
+static uint32_t hostNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
+#endif
+
+void probeInit(ProbeClockFn clock, uint32_t hz) {
+    clockFn = clock;
+    clockHz = hz;
+    if (!clock) {
+#if PROBE_HAS_DWT
+        PROBE_DEMCR |= 1u << 24; // TRCENA
+        PROBE_DWT_CYCCNT = 0;
+        PROBE_DWT_CTRL |= 1u;    // CYCCNTENA
+        clockFn = dwtCycles;
+#elif PROBE_HAS_CLOCK_GETTIME
+        clockFn = hostNanos;
+        clockHz = 1000000000u;
+#endif
+    }
+    probeReset();
+}
+
+void probeReset(void) {
+    head = 0;
+}
+
+void probeMark(ProbeId id) {
+    if (!clockFn) {
+        return; // No clock on this target, probes stay silent
+    }
+    uint32_t key = criticalEnter(&lock); // The slot and its stamp together, so the trace stays in time order
+    ProbeRecord *record = &trace[head++ % PROBE_TRACE_LEN];
+    record->ticks = clockFn();
+    record->id = (uint8_t)id;
+    criticalExit(&lock, key);
+}
+
+const char *probeName(ProbeId id) {
+    return id < PROBE_COUNT ? names[id] : "?";
+}
+
+/* Histogram of one stage, built from the trace on demand */
+typedef struct {
+    uint16_t buckets[PROBE_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+} ProbeHistogram;
+
+static uint32_t ticksToUs(uint32_t ticks) {
+    return (uint32_t)((uint64_t)ticks * 1000000u / clockHz);
+}
+
+static void addSample(ProbeHistogram *hist, uint32_t ticks) {
+    uint32_t us = ticksToUs(ticks);
+    uint32_t bucket = 0;
+
+    for (uint32_t v = us; v && bucket < PROBE_HIST_BUCKETS - 1; v >>= 1) {
+        bucket++;
+    }
+    if (hist->buckets[bucket] < UINT16_MAX) {
+        hist->buckets[bucket]++;
+    }
+    if (hist->count == 0 || us < hist->minUs) {
+        hist->minUs = us;
+    }
+    if (us > hist->maxUs) {
+        hist->maxUs = us;
+    }
+    hist->count++;
+}
+
+/* Collects from->to stage deltas, or span totals (first probe from, last probe to) */
+static void collect(ProbeHistogram *hist, uint8_t from, uint8_t to, int totals, uint32_t start, uint32_t end) {
+    uint32_t spanStart = start;
+
+    for (uint32_t i = start; i < end; i++) {
+        const ProbeRecord *cur = &trace[i % PROBE_TRACE_LEN];
+        const ProbeRecord *next = i + 1 < end ? &trace[(i + 1) % PROBE_TRACE_LEN] : NULL;
+        int sameSpan = next && next->id > cur->id;
+
+        if (!totals && sameSpan && cur->id == from && next->id == to) {
+            addSample(hist, next->ticks - cur->ticks);
+        }
+        if (!sameSpan) {
+            const ProbeRecord *first = &trace[spanStart % PROBE_TRACE_LEN];
+            if (totals && i > spanStart && first->id == from && cur->id == to) {
+                addSample(hist, cur->ticks - first->ticks);
+            }
+            spanStart = i + 1;
+        }
+    }
+}
+
+static void writeHistogram(ProbeWriteFn write, void *ctx, const char *label, uint8_t from, uint8_t to,
+                           const ProbeHistogram *hist) {
+    char line[192];
+    uint32_t seen = 0, p50 = 0;
+    int len;
+
+    for (uint32_t b = 0; b < PROBE_HIST_BUCKETS; b++) {
+        seen += hist->buckets[b];
+        if (seen * 2 >= hist->count) {
+            p50 = 1u << b; // Upper bound of the median bucket
+            break;
+        }
+    }
+    len = snprintf(line, sizeof(line), "[PROBE] %s%s->%s n=%lu min=%lu p50<%lu max=%lu us |", label,
+                   names[from], names[to], (unsigned long)hist->count, (unsigned long)hist->minUs,
+                   (unsigned long)p50, (unsigned long)hist->maxUs);
+    for (uint32_t b = 0; b < PROBE_HIST_BUCKETS && len < (int)sizeof(line) - 16; b++) {
+        if (hist->buckets[b]) {
+            len += snprintf(line + len, sizeof(line) - len, b < PROBE_HIST_BUCKETS - 1 ? " <%lu:%u" : " >=%lu:%u",
+                            b < PROBE_HIST_BUCKETS - 1 ? 1ul << b : 1ul << (b - 1), hist->buckets[b]);
+        }
+    }
+    write(ctx, line);
+}
+
+void probeExport(ProbeWriteFn write, void *ctx) {
+    uint32_t end = head;
+    uint32_t start = end > PROBE_TRACE_LEN ? end - PROBE_TRACE_LEN : 0;
+
+    if (!clockFn) {
+        return;
+    }
+    for (int totals = 0; totals <= 1; totals++) {
+        for (uint8_t from = 0; from < PROBE_COUNT; from++) {
+            for (uint8_t to = from + 1; to < PROBE_COUNT; to++) {
+                ProbeHistogram hist = {{0}, 0, 0, 0};
+                collect(&hist, from, to, totals, start, end);
+                if (hist.count) {
+                    writeHistogram(write, ctx, totals ? "total " : "", from, to, &hist);
+                }
+            }
+        }
+    }
+}
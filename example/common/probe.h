@@ -0,0 +1,74 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Named latency probes along the backend command path.
+ *
+ * PROBE(id) stores a timestamp and the probe ID in a small RAM ring. The
+ * clock is the DWT cycle counter on Cortex-M3/M4/M7, clock_gettime() on a
+ * host, or a caller-supplied counter (the Cortex-M0 has no DWT).
+ * probeExport() turns the trace into per-stage histograms. The IDs are in
+ * pipeline order. A trace is split into spans wherever the ID sequence goes
+ * backwards, and each histogram is keyed by the pair of consecutive probes
+ * it measures. Commands that overlap in time are attributed to the wrong
+ * span, so space them out when measuring.
+ *
+ * Build with -DPROBES_ENABLED=0 to compile every probe out.
+ */
+
+#ifndef PROBES_ENABLED
+#define PROBES_ENABLED 1
+#endif
+
+#ifndef PROBE_TRACE_LEN
+#define PROBE_TRACE_LEN 64 // Records (8 bytes each), oldest are overwritten
+#endif
+
+#define PROBE_HIST_BUCKETS 20 // log2 buckets: <1 us ... >=262 ms
+
+typedef enum {
+    PROBE_WS_RX = 0,  // ESP32: backend message received
+    PROBE_UART_TX,    // ESP32: message queued to the STM32 UART
+    PROBE_RX_DONE,    // STM32: last byte of a message received
+    PROBE_DISPATCH,   // STM32: command handler entered
+    PROBE_BEGIN_TX,   // STM32: beginTransaction() returned
+    PROBE_GPIO_WRITE, // STM32: charge relay output changed
+    PROBE_COUNT
+} ProbeId;
+
+typedef uint32_t (*ProbeClockFn)(void);
+typedef void (*ProbeWriteFn)(void *ctx, const char *line);
+
+typedef struct {
+    uint32_t ticks;
+    uint8_t id;
+    uint8_t reserved[3];
+} ProbeRecord;
+
+/* clock NULL selects the built-in clock: DWT (hz = core clock) or clock_gettime (hz ignored) */
+void probeInit(ProbeClockFn clock, uint32_t hz);
+void probeReset(void);
+void probeMark(ProbeId id);
+
+/* One line per stage: "<from>-><to> n= min= p50= max= us | <=Nus:count ..." */
+void probeExport(ProbeWriteFn write, void *ctx);
+
+const char *probeName(ProbeId id);
+
+#if PROBES_ENABLED
+#define PROBE(id) probeMark(id)
+#else
+#define PROBE(id) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PROBE_H */
@@ -0,0 +1,181 @@
+#include "stack_watch.h"
+#include "critical.h"
+
+#include <stdio.h>
+
+#define PAINT_MARGIN 256 // Left unpainted below the caller: its own frame, the x86-64 red zone
+
+typedef struct {
+    const char *name;
+    uint32_t *base;
+    uint32_t words;
+    bool alarm;
+    volatile bool ready;
+} StackRegion;
+
+static StackRegion regions[STACK_WATCH_REGIONS];
+
+#if STACK_WATCH
+static uint32_t regionsTaken;
+static CriticalFlag lock; // Regions are added from more than one thread on the host
+
+static uint8_t *stackPointer(void) {
+#if defined(__arm__)
+    uint8_t *sp;
+    __asm volatile("mov %0, sp" : "=r"(sp));
+    return sp;
+#else
+    return __builtin_frame_address(0);
+#endif
+}
+
+/* Stops PAINT_MARGIN below its own frame; not inlined so that frame is the innermost one */
+__attribute__((noinline)) static void paint(uint32_t *base, uint32_t *end) {
+    uint32_t *limit = (uint32_t *)(((uintptr_t)stackPointer() - PAINT_MARGIN) & ~(uintptr_t)3);
+    volatile uint32_t *word = base;
+
+    if (end > limit) {
+        end = limit;
+    }
+    while (word < end) {
+        *word++ = STACK_WATCH_PATTERN;
+    }
+}
+
+static StackRegion *addRegion(const char *name, uint32_t *base, uint32_t words) {
+    uint32_t key = criticalEnter(&lock); // Not an atomic add: ARMv6-M has no LDREX/STREX
+    uint32_t slot = regionsTaken;
+    if (slot < STACK_WATCH_REGIONS) {
+        regionsTaken++;
+    }
+    criticalExit(&lock, key);
+    if (slot >= STACK_WATCH_REGIONS) {
+        return NULL;
+    }
+    StackRegion *region = &regions[slot];
+    region->name = name;
+    region->base = base;
+    region->words = words;
+    region->alarm = false;
+    return region;
+}
+#endif
+
+static uint32_t freeWords(const StackRegion *region) {
+    const volatile uint32_t *word = region->base;
+    uint32_t count = 0;
+    while (count < region->words && word[count] == STACK_WATCH_PATTERN) {
+        count++;
+    }
+    return count;
+}
+
+void stackWatchInit(void) {
+#if STACK_WATCH
+#if defined(__arm__)
+    extern uint32_t _estack;         // Linker script
+    extern uint32_t _Min_Stack_Size; // Linker script
+    uint32_t *top = &_estack;
+    uint32_t words = (uint32_t)&_Min_Stack_Size / sizeof(uint32_t);
+    StackRegion *region = addRegion("msp", top - words, words);
+    if (region) {
+        paint(region->base, top);
+        region->ready = true;
+    }
+#else
+    stackWatchAddCurrent("main", STACK_WATCH_HOST_BYTES);
+#endif
+#endif
+}
+
+bool stackWatchAdd(const char *name, void *base, size_t bytes, bool paintIt) {
+#if STACK_WATCH
+    uint32_t *start = (uint32_t *)(((uintptr_t)base + 3) & ~(uintptr_t)3);
+    StackRegion *region = addRegion(name, start, (uint32_t)(bytes / sizeof(uint32_t)));
+    if (!region) {
+        return false;
+    }
+    if (paintIt) {
+        paint(region->base, region->base + region->words);
+    }
+    region->ready = true;
+    return true;
+#else
+    (void)name;
+    (void)base;
+    (void)bytes;
+    (void)paintIt;
+    return false;
+#endif
+}
+
+bool stackWatchAddCurrent(const char *name, size_t bytes) {
+#if STACK_WATCH
+    uintptr_t top = ((uintptr_t)stackPointer() - PAINT_MARGIN) & ~(uintptr_t)3;
+    StackRegion *region = addRegion(name, (uint32_t *)(top - bytes), (uint32_t)(bytes / sizeof(uint32_t)));
+    if (!region) {
+        return false;
+    }
+    paint(region->base, region->base + region->words);
+    region->ready = true;
+    return true;
+#else
+    (void)name;
+    (void)bytes;
+    return false;
+#endif
+}
+
+uint32_t stackWatchCheck(StackWatchWriteFn write, void *ctx) {
+    uint32_t alarms = 0;
+    for (uint32_t i = 0; i < STACK_WATCH_REGIONS; i++) {
+        StackRegion *region = &regions[i];
+        uint32_t guard = STACK_GUARD_BYTES / sizeof(uint32_t);
+        if (!region->ready || region->alarm) {
+            continue;
+        }
+        guard = guard < region->words ? guard : region->words;
+        for (uint32_t w = 0; w < guard; w++) {
+            if (region->base[w] != STACK_WATCH_PATTERN) {
+                region->alarm = true;
+                break;
+            }
+        }
+        if (region->alarm) {
+            char line[96];
+            uint32_t left = freeWords(region) * sizeof(uint32_t);
+            snprintf(line, sizeof(line), "[STACK] ALARM %s: %lu of %lu B left, guard %u B", region->name,
+                     (unsigned long)left, (unsigned long)(region->words * sizeof(uint32_t)),
+                     (unsigned)STACK_GUARD_BYTES);
+            if (write) {
+                write(ctx, line);
+            }
+            alarms++;
+        }
+    }
+    return alarms;
+}
+
+bool stackWatchUsage(uint32_t index, StackUsage *usage) {
+    if (index >= STACK_WATCH_REGIONS || !regions[index].ready) {
+        return false;
+    }
+    const StackRegion *region = &regions[index];
+    usage->name = region->name;
+    usage->sizeBytes = region->words * sizeof(uint32_t);
+    usage->usedBytes = usage->sizeBytes - freeWords(region) * sizeof(uint32_t);
+    usage->alarm = region->alarm;
+    return true;
+}
+
+void stackWatchExport(StackWatchWriteFn write, void *ctx) {
+    StackUsage usage;
+    char line[96];
+    for (uint32_t i = 0; stackWatchUsage(i, &usage); i++) {
+        snprintf(line, sizeof(line), "[STACK] %s used %lu of %lu B (%lu%%), %lu B free%s", usage.name,
+                 (unsigned long)usage.usedBytes, (unsigned long)usage.sizeBytes,
+                 (unsigned long)(usage.sizeBytes ? usage.usedBytes * 100 / usage.sizeBytes : 0),
+                 (unsigned long)(usage.sizeBytes - usage.usedBytes), usage.alarm ? ", guard band hit" : "");
+        write(ctx, line);
+    }
+}
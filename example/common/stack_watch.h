@@ -0,0 +1,76 @@
+#ifndef STACK_WATCH_H
+#define STACK_WATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Stack high-water marks by painting.
+ *
+ * stackWatchInit() fills the unused part of the main stack with a pattern.
+ * Later the scanner counts how much of the pattern is still intact, from the
+ * bottom of the region up. On target the region is the _Min_Stack_Size
+ * reserve below _estack. The main loop and every interrupt share that MSP, so
+ * its mark covers the deepest ISR path as well (RX callback ->
+ * handleBackendMessage -> logMessage -> sprintf). On the host it is
+ * STACK_WATCH_HOST_BYTES below the caller. A stack that grows past its region
+ * shows as 100% used.
+ *
+ * Task stacks are added with stackWatchAdd(). The pattern is FreeRTOS's fill
+ * byte (tskSTACK_FILL_BYTE), so stacks it created can be added without
+ * repainting. stackWatchCheck() only looks at the bottom STACK_GUARD_BYTES of
+ * each region. It is cheap enough for every main-loop pass and raises the
+ * alarm once per region.
+ *
+ * Build with -DSTACK_WATCH=0 to compile it out.
+ */
+
+#ifndef STACK_WATCH
+#define STACK_WATCH 1
+#endif
+
+#ifndef STACK_GUARD_BYTES
+#define STACK_GUARD_BYTES 128
+#endif
+
+#define STACK_WATCH_REGIONS    4
+#define STACK_WATCH_PATTERN    0xA5A5A5A5u
+#define STACK_WATCH_HOST_BYTES (64 * 1024)
+
+typedef void (*StackWatchWriteFn)(void *ctx, const char *line);
+
+typedef struct {
+    const char *name;
+    uint32_t sizeBytes;
+    uint32_t usedBytes; // High-water mark
+    bool alarm;         // Less than STACK_GUARD_BYTES left at some point
+} StackUsage;
+
+/* Paints the main stack (MSP) below the caller; call first thing in main() */
+void stackWatchInit(void);
+
+/* Watches another stack, lowest address first; paint = false when it is already filled */
+bool stackWatchAdd(const char *name, void *base, size_t bytes, bool paint);
+
+/* Watches the calling thread's stack below the caller (host threads standing in for interrupts) */
+bool stackWatchAddCurrent(const char *name, size_t bytes);
+
+/* Regions that entered their guard band since the last call; writes one alarm line each */
+uint32_t stackWatchCheck(StackWatchWriteFn write, void *ctx);
+
+/* false past the last region */
+bool stackWatchUsage(uint32_t index, StackUsage *usage);
+
+/* "[STACK] <name> used <n> of <size> B ..." per region */
+void stackWatchExport(StackWatchWriteFn write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STACK_WATCH_H */
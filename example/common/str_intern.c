@@ -0,0 +1,130 @@
+#include "str_intern.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Flash table, indexed by handle - 1 */
+#define STR_TEXT(name, text) text,
+static const char *const constants[STR_CONSTANT_COUNT] = {STR_CONSTANTS(STR_TEXT)};
+#undef STR_TEXT
+
+typedef struct {
+    uint8_t refs; // 0: free
+    char text[STR_INTERN_LEN + 1];
+} StrSlot;
+
+static StrSlot slots[STR_INTERN_SLOTS];
+static StrInternStats stats;
+
+bool strInternInit(void) {
+    memset(slots, 0, sizeof(slots));
+    memset(&stats, 0, sizeof(stats));
+    for (uint32_t i = 1; i < STR_CONSTANT_COUNT; i++) {
+        if (strcmp(constants[i - 1], constants[i]) >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+StrHandle strFind(const char *text, size_t len) {
+    int lo = 0, hi = STR_CONSTANT_COUNT - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = strncmp(constants[mid], text, len);
+        if (cmp == 0 && constants[mid][len] != '\0') {
+            cmp = 1; // text is a prefix of the constant
+        }
+        if (cmp == 0) {
+            return (StrHandle)(mid + 1);
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return STR_INVALID;
+}
+
+static StrSlot *slotOf(StrHandle handle) {
+    uint32_t slot = (uint32_t)(handle & ~STR_RAM);
+    return handle != STR_INVALID && (handle & STR_RAM) && slot < STR_INTERN_SLOTS ? &slots[slot] : NULL;
+}
+
+StrHandle strIntern(const char *text, size_t len) {
+    StrSlot *empty = NULL;
+    StrHandle handle;
+
+    if (len == 0) {
+        return STR_NONE;
+    }
+    if ((handle = strFind(text, len)) != STR_INVALID || len > STR_INTERN_LEN) {
+        return handle;
+    }
+    for (uint32_t i = 0; i < STR_INTERN_SLOTS; i++) {
+        StrSlot *slot = &slots[i];
+        if (!slot->refs) {
+            empty = empty ? empty : slot;
+        } else if (!strncmp(slot->text, text, len) && slot->text[len] == '\0' && slot->refs < UINT8_MAX) {
+            slot->refs++;
+            stats.interned++;
+            stats.shared++;
+            return (StrHandle)(STR_RAM | i);
+        }
+    }
+    if (!empty) {
+        stats.full++;
+        return STR_INVALID;
+    }
+    memcpy(empty->text, text, len);
+    empty->text[len] = '\0';
+    empty->refs = 1;
+    stats.interned++;
+    if (++stats.inUse > stats.peak) {
+        stats.peak = stats.inUse;
+    }
+    return (StrHandle)(STR_RAM | (uint32_t)(empty - slots));
+}
+
+void strRetain(StrHandle handle) {
+    StrSlot *slot = slotOf(handle);
+    if (slot && slot->refs && slot->refs < UINT8_MAX) {
+        slot->refs++;
+    }
+}
+
+void strRelease(StrHandle handle) {
+    StrSlot *slot = slotOf(handle);
+    if (slot && slot->refs && --slot->refs == 0) {
+        stats.inUse--;
+    }
+}
+
+const char *strText(StrHandle handle) {
+    StrSlot *slot = slotOf(handle);
+    if (handle >= 1 && handle <= STR_CONSTANT_COUNT) {
+        return constants[handle - 1];
+    }
+    return slot && slot->refs ? slot->text : "";
+}
+
+void strInternStats(StrInternStats *out) {
+    *out = stats;
+}
+
+void strInternExport(StrInternWriteFn write, void *ctx) {
+    char line[96];
+
+    snprintf(line, sizeof(line), "[INTERN] %u/%u slots, peak %u, %lu interned, %lu shared, %lu full",
+             (unsigned)stats.inUse, (unsigned)STR_INTERN_SLOTS, (unsigned)stats.peak, (unsigned long)stats.interned,
+             (unsigned long)stats.shared, (unsigned long)stats.full);
+    write(ctx, line);
+    for (uint32_t i = 0; i < STR_INTERN_SLOTS; i++) {
+        if (slots[i].refs) {
+            snprintf(line, sizeof(line), "[INTERN] 0x%04x \"%s\": %u refs", (unsigned)(STR_RAM | i), slots[i].text,
+                     (unsigned)slots[i].refs);
+            write(ctx, line);
+        }
+    }
+}
@@ -0,0 +1,139 @@
+#ifndef STR_INTERN_H
+#define STR_INTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Interned strings behind 16-bit handles.
+ *
+ * Protocol constants (action names, measurands, units, reading contexts and
+ * the status values) are a const table built from STR_CONSTANTS, so they stay
+ * in flash and have fixed handles: STR_Authorize, STR_EnergyActiveImportRegister
+ * and so on. Runtime IDs such as idTags go into a small RAM table of
+ * STR_INTERN_SLOTS entries with a reference count. Interning a string that is
+ * already there takes another reference on the same entry instead of a copy.
+ *
+ * So a transaction, and every message queued for it, carries the idTag as a
+ * 2-byte handle rather than a 21-byte array, and a meter sample carries its
+ * measurand and unit the same way. strText() gives the text back for
+ * rendering. Release every reference taken; the entry is free again when the
+ * count drops to zero.
+ *
+ * Lookups of the constants use a binary search, so STR_CONSTANTS must be
+ * sorted by text. strInternInit() returns false if it is not. The RAM table is
+ * used from one context (the USART2 RX interrupt in stm32/main.c); run the
+ * export from the main loop.
+ */
+
+#ifndef STR_INTERN_SLOTS
+#define STR_INTERN_SLOTS 4 // Runtime strings alive at the same time
+#endif
+
+#define STR_INTERN_LEN 20 // OCPP 1.6 IdToken is CiString20Type
+
+/* X(name, text), sorted by text */
+#define STR_CONSTANTS(X)                                               \
+    X(A, "A")                                                          \
+    X(Accepted, "Accepted")                                            \
+    X(Authorize, "Authorize")                                          \
+    X(BootNotification, "BootNotification")                            \
+    X(Celsius, "Celsius")                                              \
+    X(ChangeAvailability, "ChangeAvailability")                        \
+    X(ChangeConfiguration, "ChangeConfiguration")                      \
+    X(ClearCache, "ClearCache")                                        \
+    X(ClearChargingProfile, "ClearChargingProfile")                    \
+    X(CurrentImport, "Current.Import")                                 \
+    X(CurrentOffered, "Current.Offered")                               \
+    X(DataTransfer, "DataTransfer")                                    \
+    X(EnergyActiveImportRegister, "Energy.Active.Import.Register")     \
+    X(GetCompositeSchedule, "GetCompositeSchedule")                    \
+    X(GetConfiguration, "GetConfiguration")                            \
+    X(Heartbeat, "Heartbeat")                                          \
+    X(MeterValues, "MeterValues")                                      \
+    X(Percent, "Percent")                                              \
+    X(PowerActiveImport, "Power.Active.Import")                        \
+    X(PowerOffered, "Power.Offered")                                   \
+    X(Rejected, "Rejected")                                            \
+    X(RemoteStartTransaction, "RemoteStartTransaction")                \
+    X(RemoteStopTransaction, "RemoteStopTransaction")                  \
+    X(Reset, "Reset")                                                  \
+    X(SampleClock, "Sample.Clock")                                     \
+    X(SamplePeriodic, "Sample.Periodic")                               \
+    X(SetChargingProfile, "SetChargingProfile")                        \
+    X(SoC, "SoC")                                                      \
+    X(StartTransaction, "StartTransaction")                            \
+    X(StatusNotification, "StatusNotification")                        \
+    X(StopTransaction, "StopTransaction")                              \
+    X(Temperature, "Temperature")                                      \
+    X(TransactionBegin, "Transaction.Begin")                           \
+    X(TransactionEnd, "Transaction.End")                               \
+    X(TriggerMessage, "TriggerMessage")                                \
+    X(UnlockConnector, "UnlockConnector")                              \
+    X(V, "V")                                                          \
+    X(Voltage, "Voltage")                                              \
+    X(W, "W")                                                          \
+    X(Wh, "Wh")                                                        \
+    X(kWh, "kWh")
+
+typedef uint16_t StrHandle;
+
+#define STR_NONE    0      // Empty string
+#define STR_RAM     0x8000 // | slot: runtime string
+#define STR_INVALID 0xFFFF // Not found, too long, or the RAM table is full
+
+/* Constant handles, 1 .. STR_CONSTANT_COUNT */
+#define STR_ID(name, text) STR_##name,
+enum {
+    STR_FIRST_CONSTANT = STR_NONE,
+    STR_CONSTANTS(STR_ID)
+    STR_END_CONSTANTS
+};
+#undef STR_ID
+#define STR_CONSTANT_COUNT (STR_END_CONSTANTS - 1)
+
+typedef void (*StrInternWriteFn)(void *ctx, const char *line);
+
+typedef struct {
+    uint32_t interned; // strIntern() calls that returned a RAM handle
+    uint32_t shared;   // Of those, found the string already there
+    uint32_t full;     // strIntern() calls that found no free slot
+    uint16_t inUse;
+    uint16_t peak;
+} StrInternStats;
+
+/* Empties the RAM table; false if STR_CONSTANTS is not sorted */
+bool strInternInit(void);
+
+/* Handle of a constant, STR_INVALID if text is not one */
+StrHandle strFind(const char *text, size_t len);
+
+/*
+ * Handle for text: the constant if there is one, otherwise a RAM entry with
+ * one more reference. STR_NONE for an empty string, STR_INVALID if text is
+ * longer than STR_INTERN_LEN or every slot is taken.
+ */
+StrHandle strIntern(const char *text, size_t len);
+
+/* Reference counting; no-ops for constants, STR_NONE and STR_INVALID */
+void strRetain(StrHandle handle);
+void strRelease(StrHandle handle);
+
+/* NUL-terminated text, "" for STR_NONE and STR_INVALID */
+const char *strText(StrHandle handle);
+
+void strInternStats(StrInternStats *stats);
+
+/* "[INTERN] <inUse>/<slots> slots ..." and one line per entry in use */
+void strInternExport(StrInternWriteFn write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STR_INTERN_H */
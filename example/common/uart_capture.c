@@ -0,0 +1,233 @@
+#include "uart_capture.h"
+
+#include <string.h>
+
+static uint8_t *at(UartCapture *cap, uint32_t pos) {
+    return &cap->buf[cap->ring ? pos & (cap->size - 1) : pos];
+}
+
+static void put32(uint8_t *out, uint32_t v) {
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+    out[2] = (uint8_t)(v >> 16);
+    out[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get32(const uint8_t *in) {
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+void uartCaptureInit(UartCapture *cap, uint8_t *buf, uint32_t size, bool ring, uint32_t baud,
+                     UartCaptureClockFn clock) {
+    memset(cap, 0, sizeof(*cap));
+    if (ring && (size & (size - 1))) {
+        return; // Not a power of two, capture stays off
+    }
+    cap->buf = buf;
+    cap->size = size;
+    cap->ring = ring;
+    cap->baud = baud;
+    cap->mergeUs = baud ? 20000000u / baud : 0; // Two byte times
+    cap->clock = clock;
+}
+
+void uartCaptureReset(UartCapture *cap) {
+    uint32_t key = criticalEnter(&cap->lock);
+    cap->head = 0;
+    cap->tail = 0;
+    cap->records = 0;
+    cap->dropped = 0;
+    cap->open = false;
+    criticalExit(&cap->lock, key);
+}
+
+void uartCapturePause(UartCapture *cap, bool paused) {
+    cap->paused = paused;
+}
+
+/* Makes room for n bytes, dropping the oldest records of a ring */
+static bool reserve(UartCapture *cap, uint32_t n) {
+    if (!cap->ring) {
+        return cap->head + n <= cap->size;
+    }
+    if (n > cap->size) {
+        return false;
+    }
+    while (cap->head - cap->tail + n > cap->size) {
+        if (cap->open && cap->tail == cap->openRecord) {
+            cap->open = false;
+        }
+        cap->tail += UART_CAPTURE_RECORD_SIZE + *at(cap, cap->tail + 5);
+        cap->records--;
+        cap->dropped++;
+    }
+    return true;
+}
+
+static void copyIn(UartCapture *cap, const uint8_t *data, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        *at(cap, cap->head++) = data[i];
+    }
+}
+
+void uartCaptureAppend(UartCapture *cap, UartCaptureDir dir, const uint8_t *data, size_t len) {
+    if (!cap->buf || cap->paused || len == 0) {
+        return;
+    }
+    uint32_t key = criticalEnter(&cap->lock);
+    uint32_t now = cap->clock ? cap->clock() : 0;
+
+    while (len > 0) {
+        /* Continue the open record while the bytes keep coming */
+        if (cap->open && cap->lastDir == dir && now - cap->lastStampUs <= cap->mergeUs) {
+            uint32_t n = UART_CAPTURE_MAX_CHUNK - *at(cap, cap->openRecord + 5);
+            n = len < n ? (uint32_t)len : n;
+            if (n > 0 && reserve(cap, n) && cap->open) {
+                copyIn(cap, data, n);
+                *at(cap, cap->openRecord + 5) += (uint8_t)n;
+                cap->lastStampUs = now;
+                data += n;
+                len -= n;
+                continue;
+            }
+        }
+
+        uint32_t n = len < UART_CAPTURE_MAX_CHUNK ? (uint32_t)len : UART_CAPTURE_MAX_CHUNK;
+        uint8_t header[UART_CAPTURE_RECORD_SIZE];
+        if (!reserve(cap, UART_CAPTURE_RECORD_SIZE + n)) {
+            cap->dropped++;
+            cap->open = false;
+            break;
+        }
+        put32(header, now);
+        header[4] = (uint8_t)dir;
+        header[5] = (uint8_t)n;
+        cap->openRecord = cap->head;
+        copyIn(cap, header, sizeof(header));
+        copyIn(cap, data, n);
+        cap->records++;
+        cap->open = true;
+        cap->lastDir = (uint8_t)dir;
+        cap->lastStampUs = now;
+        data += n;
+        len -= n;
+    }
+    criticalExit(&cap->lock, key);
+}
+
+void uartCaptureGetHeader(const UartCapture *cap, UartCaptureHeader *header) {
+    memcpy(header->magic, UART_CAPTURE_MAGIC, sizeof(header->magic));
+    header->version = UART_CAPTURE_VERSION;
+    header->headerSize = UART_CAPTURE_HEADER_SIZE;
+    header->baud = cap->baud;
+    header->records = cap->records;
+    header->bytes = cap->head - cap->tail;
+    header->dropped = cap->dropped;
+}
+
+void uartCaptureEncodeHeader(const UartCaptureHeader *header, uint8_t out[UART_CAPTURE_HEADER_SIZE]) {
+    memcpy(out, header->magic, 4);
+    out[4] = (uint8_t)header->version;
+    out[5] = (uint8_t)(header->version >> 8);
+    out[6] = (uint8_t)header->headerSize;
+    out[7] = (uint8_t)(header->headerSize >> 8);
+    put32(out + 8, header->baud);
+    put32(out + 12, header->records);
+    put32(out + 16, header->bytes);
+    put32(out + 20, header->dropped);
+}
+
+bool uartCaptureDecodeHeader(const uint8_t *in, size_t len, UartCaptureHeader *header) {
+    if (len < UART_CAPTURE_HEADER_SIZE || memcmp(in, UART_CAPTURE_MAGIC, 4)) {
+        return false;
+    }
+    memcpy(header->magic, in, 4);
+    header->version = (uint16_t)(in[4] | in[5] << 8);
+    header->headerSize = (uint16_t)(in[6] | in[7] << 8);
+    header->baud = get32(in + 8);
+    header->records = get32(in + 12);
+    header->bytes = get32(in + 16);
+    header->dropped = get32(in + 20);
+    return header->version == UART_CAPTURE_VERSION && header->headerSize >= UART_CAPTURE_HEADER_SIZE &&
+           header->headerSize <= len;
+}
+
+void uartCaptureDump(UartCapture *cap, UartCaptureWriteFn write, void *ctx) {
+    UartCaptureHeader header;
+    uint8_t encoded[UART_CAPTURE_HEADER_SIZE];
+    bool wasPaused = cap->paused;
+
+    if (!cap->buf) {
+        return;
+    }
+    cap->paused = true; // Nothing is added while the ring is read out
+    uint32_t key = criticalEnter(&cap->lock);
+    cap->open = false;
+    criticalExit(&cap->lock, key);
+
+    uartCaptureGetHeader(cap, &header);
+    uartCaptureEncodeHeader(&header, encoded);
+    write(ctx, encoded, sizeof(encoded));
+    for (uint32_t pos = cap->tail; pos != cap->head;) {
+        uint8_t *start = at(cap, pos);
+        uint32_t n = cap->head - pos;
+        if (cap->ring && (pos & (cap->size - 1)) + n > cap->size) {
+            n = cap->size - (pos & (cap->size - 1)); // Up to the end of the ring, then wrap
+        }
+        write(ctx, start, n);
+        pos += n;
+    }
+    cap->paused = wasPaused;
+}
+
+/* Hex line assembly for uartCaptureDumpHex() */
+typedef struct {
+    UartCaptureLineFn line;
+    void *ctx;
+    char text[8 + 2 * UART_CAPTURE_HEX_LINE + 1];
+    uint32_t bytes;
+} HexWriter;
+
+static void flushHex(HexWriter *hex) {
+    if (hex->bytes) {
+        hex->line(hex->ctx, hex->text);
+        hex->bytes = 0;
+    }
+}
+
+static void writeHex(void *ctx, const uint8_t *data, size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    HexWriter *hex = ctx;
+
+    for (size_t i = 0; i < len; i++) {
+        char *out = hex->text + 7 + 2 * hex->bytes;
+        out[0] = digits[data[i] >> 4];
+        out[1] = digits[data[i] & 0x0F];
+        out[2] = '\0';
+        if (++hex->bytes == UART_CAPTURE_HEX_LINE) {
+            flushHex(hex);
+        }
+    }
+}
+
+void uartCaptureDumpHex(UartCapture *cap, UartCaptureLineFn line, void *ctx) {
+    HexWriter hex = {line, ctx, "[UCAP] ", 0};
+    uartCaptureDump(cap, writeHex, &hex);
+    flushHex(&hex);
+}
+
+bool uartCaptureNext(const uint8_t *area, uint32_t bytes, uint32_t *offset, UartCaptureRecord *record) {
+    if (*offset + UART_CAPTURE_RECORD_SIZE > bytes) {
+        return false;
+    }
+    const uint8_t *p = area + *offset;
+    if (*offset + UART_CAPTURE_RECORD_SIZE + p[5] > bytes) {
+        return false;
+    }
+    record->stampUs = get32(p);
+    record->dir = p[4];
+    record->len = p[5];
+    record->data = p + UART_CAPTURE_RECORD_SIZE;
+    *offset += UART_CAPTURE_RECORD_SIZE + p[5];
+    return true;
+}
@@ -0,0 +1,110 @@
+#ifndef UART_CAPTURE_H
+#define UART_CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "critical.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Timestamped capture of the ESP32 <-> STM32 UART traffic.
+ *
+ * Bytes are stored as records: [stamp_us u32][dir u8][len u8][data]. A byte
+ * that arrives within two byte times of the previous one in the same
+ * direction is appended to the open record. So a message costs six bytes of
+ * overhead rather than six per byte. A replay spreads the bytes of a record
+ * at the recorded baud rate.
+ *
+ * The record area is a RAM ring (power-of-two size, oldest records are
+ * dropped) on the target, or a linear buffer that stops when full (the
+ * mapped file in native/uart_capture_file.c). uartCaptureDump() writes the
+ * header followed by all records, oldest first. That is exactly the file
+ * format, so a dump can be replayed like a file capture. uartCaptureDumpHex()
+ * sends the same bytes as hex text lines over a log channel.
+ *
+ * All multi-byte fields are little endian.
+ */
+
+#define UART_CAPTURE_MAGIC       "UCAP"
+#define UART_CAPTURE_VERSION     1
+#define UART_CAPTURE_HEADER_SIZE 24
+#define UART_CAPTURE_RECORD_SIZE 6   // Record header, data follows
+#define UART_CAPTURE_MAX_CHUNK   255
+#define UART_CAPTURE_HEX_LINE    32  // Bytes per "[UCAP]" line
+
+typedef enum {
+    UART_CAPTURE_TO_STM32 = 0, // ESP32 TX, STM32 RX
+    UART_CAPTURE_TO_ESP32 = 1  // STM32 TX, ESP32 RX
+} UartCaptureDir;
+
+typedef uint32_t (*UartCaptureClockFn)(void); // Microseconds
+typedef void (*UartCaptureWriteFn)(void *ctx, const uint8_t *data, size_t len);
+typedef void (*UartCaptureLineFn)(void *ctx, const char *line);
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t baud;
+    uint32_t records;
+    uint32_t bytes;   // Size of the record area that follows
+    uint32_t dropped; // Records overwritten (ring) or refused (buffer full)
+} UartCaptureHeader;
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t head;         // Free-running write position
+    uint32_t tail;         // Free-running position of the oldest record
+    uint32_t openRecord;   // Position of the record bytes may be appended to
+    uint32_t lastStampUs;
+    uint32_t mergeUs;
+    uint32_t baud;
+    uint32_t records;
+    uint32_t dropped;
+    uint8_t lastDir;
+    bool open;
+    bool ring;
+    volatile bool paused;
+    CriticalFlag lock; // Appends come from the RX interrupt and from the main loop
+    UartCaptureClockFn clock;
+} UartCapture;
+
+typedef struct {
+    uint32_t stampUs;
+    uint8_t dir;
+    uint8_t len;
+    const uint8_t *data;
+} UartCaptureRecord;
+
+/* ring = true needs a power-of-two size and overwrites; false stops when full */
+void uartCaptureInit(UartCapture *cap, uint8_t *buf, uint32_t size, bool ring, uint32_t baud,
+                     UartCaptureClockFn clock);
+void uartCaptureReset(UartCapture *cap);
+void uartCaptureAppend(UartCapture *cap, UartCaptureDir dir, const uint8_t *data, size_t len);
+
+/* Pause while dumping over the captured link itself */
+void uartCapturePause(UartCapture *cap, bool paused);
+
+void uartCaptureGetHeader(const UartCapture *cap, UartCaptureHeader *header);
+void uartCaptureEncodeHeader(const UartCaptureHeader *header, uint8_t out[UART_CAPTURE_HEADER_SIZE]);
+bool uartCaptureDecodeHeader(const uint8_t *in, size_t len, UartCaptureHeader *header);
+
+/* Header and records, oldest first */
+void uartCaptureDump(UartCapture *cap, UartCaptureWriteFn write, void *ctx);
+
+/* The same as text: "[UCAP] <hex>" lines of 32 bytes for a log channel */
+void uartCaptureDumpHex(UartCapture *cap, UartCaptureLineFn line, void *ctx);
+
+/* Iterates a linear record area; returns false at the end or on a truncated record */
+bool uartCaptureNext(const uint8_t *area, uint32_t bytes, uint32_t *offset, UartCaptureRecord *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UART_CAPTURE_H */
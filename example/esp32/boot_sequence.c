@@ -0,0 +1,142 @@
+#include "boot_sequence.h"
+
+#include <string.h>
+
+/* Marks a milestone; 0 is reserved for "not reached yet" */
+static uint32_t stamp(const BootSequence *boot, uint32_t nowMs) {
+    uint32_t elapsed = nowMs - boot->bootMs;
+    return elapsed ? elapsed : 1;
+}
+
+/* Next step once Wi-Fi (and the clock, if needed) are available */
+static BootAction afterNetworkUp(BootSequence *boot) {
+    if (boot->needsTimeSync && !boot->timeSynced) {
+        boot->state = BOOT_TIME_SYNCING;
+        if (!boot->timeSyncStarted) {
+            boot->timeSyncStarted = true;
+            return BOOT_ACTION_START_TIME_SYNC;
+        }
+        return BOOT_ACTION_NONE;
+    }
+
+    boot->state = BOOT_WS_CONNECTING;
+    if (!boot->webSocketStarted) {
+        boot->webSocketStarted = true;
+        return BOOT_ACTION_START_WEBSOCKET;
+    }
+    return BOOT_ACTION_NONE;
+}
+
+void bootEventQueueInit(BootEventQueue *queue) {
+    memset(queue, 0, sizeof(*queue));
+    for (uint32_t i = 0; i < BOOT_EVENT_QUEUE_LEN; i++) {
+        queue->slots[i].sequence = i;
+    }
+}
+
+bool bootEventPost(BootEventQueue *queue, BootEvent event) {
+    uint32_t pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    BootEventSlot *slot;
+
+    for (;;) {
+        slot = &queue->slots[pos & (BOOT_EVENT_QUEUE_LEN - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break; // Slot claimed
+            }
+        } else if (diff < 0) {
+            __atomic_fetch_add(&queue->dropped, 1, __ATOMIC_RELAXED);
+            return false; // Full: the consumer has not freed this slot yet
+        } else {
+            pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED); // Claimed by another task
+        }
+    }
+    slot->event = (uint8_t)event;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool bootEventTake(BootEventQueue *queue, BootEvent *event) {
+    uint32_t pos = queue->tail;
+    BootEventSlot *slot = &queue->slots[pos & (BOOT_EVENT_QUEUE_LEN - 1)];
+
+    if ((int32_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - (pos + 1)) < 0) {
+        return false; // Not published yet
+    }
+    *event = (BootEvent)slot->event;
+    __atomic_store_n(&slot->sequence, pos + BOOT_EVENT_QUEUE_LEN, __ATOMIC_RELEASE);
+    queue->tail = pos + 1;
+    return true;
+}
+
+void bootSequenceInit(BootSequence *boot, bool needsTimeSync, uint32_t nowMs) {
+    memset(boot, 0, sizeof(*boot));
+    boot->state = BOOT_WIFI_CONNECTING;
+    boot->needsTimeSync = needsTimeSync;
+    boot->bootMs = nowMs;
+}
+
+BootAction bootSequenceHandle(BootSequence *boot, BootEvent event, uint32_t nowMs) {
+    switch (event) {
+        case BOOT_EVT_WIFI_UP:
+            if (!boot->wifiUpMs) {
+                boot->wifiUpMs = stamp(boot, nowMs);
+            }
+            if (boot->state == BOOT_WIFI_CONNECTING) {
+                return afterNetworkUp(boot);
+            }
+            break;
+
+        case BOOT_EVT_WIFI_DOWN:
+            boot->state = BOOT_WIFI_CONNECTING;
+            break;
+
+        case BOOT_EVT_TIME_SYNCED:
+            if (!boot->timeSynced) {
+                boot->timeSynced = true;
+                boot->timeSyncedMs = stamp(boot, nowMs);
+            }
+            if (boot->state == BOOT_TIME_SYNCING) {
+                return afterNetworkUp(boot);
+            }
+            break;
+
+        case BOOT_EVT_WS_UP:
+            if (!boot->readyMs) {
+                boot->readyMs = stamp(boot, nowMs);
+            }
+            boot->state = BOOT_READY;
+            break;
+
+        case BOOT_EVT_WS_DOWN:
+            if (boot->state == BOOT_READY) {
+                boot->state = BOOT_WS_CONNECTING;
+            }
+            break;
+    }
+    return BOOT_ACTION_NONE;
+}
+
+bool bootSequenceIsReady(const BootSequence *boot) {
+    return boot->state == BOOT_READY;
+}
+
+bool bootSequenceNoteBootNotification(BootSequence *boot, uint32_t nowMs) {
+    if (boot->firstBootNotificationMs) {
+        return false;
+    }
+    boot->firstBootNotificationMs = stamp(boot, nowMs);
+    return true;
+}
+
+const char *bootStateName(BootState state) {
+    switch (state) {
+        case BOOT_WIFI_CONNECTING: return "WIFI_CONNECTING";
+        case BOOT_TIME_SYNCING:    return "TIME_SYNCING";
+        case BOOT_WS_CONNECTING:   return "WS_CONNECTING";
+        case BOOT_READY:           return "READY";
+    }
+    return "UNKNOWN";
+}
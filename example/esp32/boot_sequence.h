@@ -0,0 +1,100 @@
+#ifndef BOOT_SEQUENCE_H
+#define BOOT_SEQUENCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Event-driven bring-up of the bridge: Wi-Fi -> (NTP) -> WebSocket.
+ *
+ * Nothing in here blocks or delays. The sketch feeds events from the Wi-Fi,
+ * SNTP and WebSocket callbacks and performs the returned action, while loop()
+ * keeps servicing the STM32 UART from the very first iteration.
+ */
+
+typedef enum {
+    BOOT_WIFI_CONNECTING,
+    BOOT_TIME_SYNCING,
+    BOOT_WS_CONNECTING,
+    BOOT_READY
+} BootState;
+
+typedef enum {
+    BOOT_EVT_WIFI_UP,
+    BOOT_EVT_WIFI_DOWN,
+    BOOT_EVT_TIME_SYNCED,
+    BOOT_EVT_WS_UP,
+    BOOT_EVT_WS_DOWN
+} BootEvent;
+
+typedef enum {
+    BOOT_ACTION_NONE,
+    BOOT_ACTION_START_TIME_SYNC,
+    BOOT_ACTION_START_WEBSOCKET
+} BootAction;
+
+typedef struct {
+    BootState state;
+    bool needsTimeSync;        // TLS needs a valid clock for certificate checks
+    bool timeSyncStarted;
+    bool timeSynced;
+    bool webSocketStarted;     // WebSocketsClient reconnects on its own after begin()
+    uint32_t bootMs;
+    uint32_t wifiUpMs;         // 0 until reached
+    uint32_t timeSyncedMs;
+    uint32_t readyMs;
+    uint32_t firstBootNotificationMs;
+} BootSequence;
+
+/*
+ * Events in the order they were posted, from several tasks (Wi-Fi, lwIP,
+ * loop) to loop(). A bounded lock-free ring (Vyukov): a producer claims a
+ * slot by advancing head with a compare-and-swap and publishes it through the
+ * slot's sequence number. A full queue drops the new event and counts it.
+ */
+#ifndef BOOT_EVENT_QUEUE_LEN
+#define BOOT_EVENT_QUEUE_LEN 16 // Power of two
+#endif
+
+typedef struct {
+    uint32_t sequence;
+    uint8_t event;
+} BootEventSlot;
+
+typedef struct {
+    BootEventSlot slots[BOOT_EVENT_QUEUE_LEN];
+    uint32_t head;    // Next slot to claim, any task
+    uint32_t tail;    // Next slot to take, loop() only
+    uint32_t dropped;
+} BootEventQueue;
+
+void bootEventQueueInit(BootEventQueue *queue);
+
+/* Safe from any task. Returns false if the queue is full. */
+bool bootEventPost(BootEventQueue *queue, BootEvent event);
+
+/* Single consumer. Returns false if the queue is empty. */
+bool bootEventTake(BootEventQueue *queue, BootEvent *event);
+
+void bootSequenceInit(BootSequence *boot, bool needsTimeSync, uint32_t nowMs);
+
+/* Advances the state machine. The caller performs the returned action. */
+BootAction bootSequenceHandle(BootSequence *boot, BootEvent event, uint32_t nowMs);
+
+/* True once STM32 messages can be sent to the backend. */
+bool bootSequenceIsReady(const BootSequence *boot);
+
+/* Records the first forwarded BootNotification. Returns true the first time. */
+bool bootSequenceNoteBootNotification(BootSequence *boot, uint32_t nowMs);
+
+const char *bootStateName(BootState state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOOT_SEQUENCE_H */
@@ -1,6 +1,16 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <WebSocketsClient.h>
+#include "boot_sequence.h"
+#include "reconnect_policy.h"
+#include "uart_stream.h"
+#include "ocpp_split.h"
+#include "../common/probe.h"
+
+/* Split Processing: 1 = ESP32 terminates OCPP-J, STM32 gets binary commands */
+#ifndef SPLIT_PROCESSING
+#define SPLIT_PROCESSING 0
+#endif
 
 #define WIFI_SSID "YourWiFiSSID"
 #define WIFI_PASSWORD "YourWiFiPassword"
@@ -9,47 +19,211 @@
 #define UART_RX_PIN 16
 #define UART_TX_PIN 17
 HardwareSerial uart(2); // Use Serial2 for communication with STM32
+#define UART_TX_RING_SIZE 1024
+UartStream uartStream;   // Streams backend messages into the TX ring
+LinkStats linkStats;     // Text-mode link counters (split mode keeps its own)
+#define LINK_STATS_INTERVAL_MS 60000
 
 /* WebSocket Client Configuration */
 WebSocketsClient webSocket;
 bool isWebSocketConnected = false;
 
+/* Reconnect Scheduling (backoff with jitter instead of a fixed interval) */
+ReconnectPolicy reconnect;
+
+/* Boot Sequence (events are posted from the Wi-Fi task, consumed in loop()) */
+BootSequence boot;
+BootEventQueue bootEvents;
+
 /* Function Prototypes */
 void handleSTM32Message(const String &message);
 void webSocketEvent(WStype_t type, uint8_t *payload, size_t length);
+void onWiFiEvent(WiFiEvent_t event);
+void postBootEvent(BootEvent event);
+void processBootEvents(void);
+size_t uartStreamWrite(void *ctx, const uint8_t *data, size_t len);
+void uartStreamWait(void *ctx);
+void splitSendUart(const uint8_t *data, size_t len);
+void splitSendBackend(const char *json, size_t len);
+void reportLinkStats(void);
+void startWebSocket(void);
+void serviceWebSocket(void);
+uint32_t probeClock(void);
+void probeWrite(void *ctx, const char *line);
 
 void setup() {
     Serial.begin(115200); // Debug output
-    uart.begin(115200, SERIAL_8N1, UART_RX_PIN, UART_TX_PIN);
+    uart.setTxBufferSize(UART_TX_RING_SIZE);
+    uart.begin(UART_LINK_BAUD, SERIAL_8N1, UART_RX_PIN, UART_TX_PIN);
+    uartStreamInit(&uartStream, uartStreamWrite, uartStreamWait, NULL);
+    probeInit(probeClock, ESP.getCpuFreqMHz() * 1000000u);
+#if SPLIT_PROCESSING
+    splitInit(splitSendUart, splitSendBackend);
+#endif
+    bootEventQueueInit(&bootEvents); // Before any callback can post
+    bootSequenceInit(&boot, false, millis());
 
-    // Wi-Fi Setup
+    // Wi-Fi Setup (non-blocking, progress arrives through onWiFiEvent)
     Serial.println("[ESP32] Connecting to Wi-Fi...");
+    WiFi.onEvent(onWiFiEvent);
     WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(1000);
-        Serial.print(".");
-    }
-    Serial.println("\n[ESP32] Wi-Fi connected.");
 
-    // WebSocket Setup
-    webSocket.begin("192.168.1.100", 8180, "/steve/websocket/CentralSystemService"); // Replace with your OCPP backend URL
     webSocket.onEvent(webSocketEvent);
 }
 
 void loop() {
+    // Advance Bring-Up
+    processBootEvents();
+
     // Handle WebSocket Events
-    webSocket.loop();
+    if (boot.webSocketStarted) {
+        serviceWebSocket();
+    }
+
+    // Report link usage of the selected mode
+    reportLinkStats();
 
+#if SPLIT_PROCESSING
+    // Decode binary events from STM32
+    while (uart.available()) {
+        splitHandleUartByte((uint8_t)uart.read());
+    }
+#else
     // Forward STM32 messages to backend
     if (uart.available()) {
         String message = uart.readStringUntil('\n');
+        linkStats.rxBytes += message.length() + 1;
+        linkStats.rxFrames++;
         Serial.printf("[ESP32] Received from STM32: %s\n", message.c_str());
         if (isWebSocketConnected) {
             webSocket.sendTXT(message);
+            if (message.indexOf("\"BootNotification\"") >= 0 &&
+                bootSequenceNoteBootNotification(&boot, millis())) {
+                Serial.printf("[ESP32] First BootNotification forwarded %u ms after boot.\n",
+                              boot.firstBootNotificationMs);
+            }
         } else {
             Serial.println("[ESP32] WebSocket not connected.");
         }
     }
+#endif
+}
+
+void reportLinkStats(void) {
+    static unsigned long lastReport = 0;
+    if (millis() - lastReport < LINK_STATS_INTERVAL_MS) {
+        return;
+    }
+    lastReport = millis();
+
+#if SPLIT_PROCESSING
+    const LinkStats *stats = splitLinkStats();
+    splitRequestStats(); // STM32 answers with its dispatch timing
+#else
+    const LinkStats *stats = &linkStats;
+    linkStats.txBytes = uartStream.totalBytes + uartStream.messages; // Payload + delimiters
+    linkStats.txFrames = uartStream.messages;
+#endif
+    Serial.printf("[ESP32] Link (%s): rx %lu bytes / %lu msgs, tx %lu bytes / %lu msgs\n",
+                  SPLIT_PROCESSING ? "binary" : "text",
+                  (unsigned long)stats->rxBytes, (unsigned long)stats->rxFrames,
+                  (unsigned long)stats->txBytes, (unsigned long)stats->txFrames);
+    probeExport(probeWrite, NULL); // ws_rx -> uart_tx histogram
+}
+
+/* Latency Probes (CPU cycle counter) */
+uint32_t probeClock(void) {
+    return ESP.getCycleCount();
+}
+
+void probeWrite(void *ctx, const char *line) {
+    Serial.println(line);
+}
+
+/* Wi-Fi Event Handler (runs in the Wi-Fi event task) */
+void onWiFiEvent(WiFiEvent_t event) {
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+            postBootEvent(BOOT_EVT_WIFI_UP);
+            break;
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+            postBootEvent(BOOT_EVT_WIFI_DOWN);
+            break;
+        default:
+            break;
+    }
+}
+
+void postBootEvent(BootEvent event) {
+    bootEventPost(&bootEvents, event);
+}
+
+void processBootEvents(void) {
+    BootEvent event;
+
+    while (bootEventTake(&bootEvents, &event)) { // In posting order, repeats included
+        BootState before = boot.state;
+        BootAction action = bootSequenceHandle(&boot, event, millis());
+
+        if (action == BOOT_ACTION_START_WEBSOCKET) {
+            ReconnectConfig config;
+            reconnectConfigDefaults(&config);
+            uint64_t mac = ESP.getEfuseMac();
+            reconnectInit(&reconnect, &config, (uint32_t)(mac ^ (mac >> 32)), millis());
+            Serial.printf("[ESP32] First connect attempt in %lu ms.\n", reconnect.nextAttemptMs - millis());
+        }
+        if (boot.state != before) {
+            Serial.printf("[ESP32] Boot %s -> %s at %lu ms.\n",
+                          bootStateName(before), bootStateName(boot.state), millis() - boot.bootMs);
+        }
+    }
+}
+
+/* UART TX Backpressure (only accept what fits into the ring) */
+size_t uartStreamWrite(void *ctx, const uint8_t *data, size_t len) {
+    size_t space = uart.availableForWrite();
+    return space ? uart.write(data, len < space ? len : space) : 0;
+}
+
+void uartStreamWait(void *ctx) {
+    delay(1); // ~11 bytes drain per ms at 115200 baud
+}
+
+/* Split-Mode Outputs */
+void splitSendUart(const uint8_t *data, size_t len) {
+    uart.write(data, len);
+}
+
+void splitSendBackend(const char *json, size_t len) {
+    if (isWebSocketConnected) {
+        webSocket.sendTXT((uint8_t *)json, len);
+    }
+}
+
+/* Start a Connect Attempt (the policy decides when) */
+void startWebSocket(void) {
+    webSocket.begin("192.168.1.100", 8180, "/steve/websocket/CentralSystemService"); // Replace with your OCPP backend URL
+    webSocket.setReconnectInterval(RECONNECT_ATTEMPT_WINDOW_MS); // At most one TCP attempt per window
+    webSocket.enableHeartbeat(WS_PING_INTERVAL_MS, WS_PONG_TIMEOUT_MS, WS_PONG_MISSED_LIMIT);
+}
+
+void serviceWebSocket(void) {
+    switch (reconnectPoll(&reconnect, millis())) {
+        case RECONNECT_BEGIN:
+            Serial.printf("[ESP32] WebSocket connect attempt %u.\n", reconnect.attempts);
+            startWebSocket();
+            webSocket.loop();
+            break;
+        case RECONNECT_POLL:
+            webSocket.loop();
+            break;
+        case RECONNECT_ABORT:
+            webSocket.disconnect();
+            Serial.printf("[ESP32] Connect attempt timed out, next in %lu ms.\n", reconnect.nextAttemptMs - millis());
+            break;
+        case RECONNECT_IDLE:
+            break;
+    }
 }
 
 /* WebSocket Event Handler */
@@ -57,18 +231,59 @@ void webSocketEvent(WStype_t type, uint8_t *payload, size_t length) {
     switch (type) {
         case WStype_CONNECTED:
             isWebSocketConnected = true;
+            reconnectOnConnected(&reconnect, millis());
+            postBootEvent(BOOT_EVT_WS_UP);
             Serial.println("[ESP32] WebSocket connected.");
+#if SPLIT_PROCESSING
+            splitOnBackendConnected(); // The bridge owns BootNotification in split mode
+            if (bootSequenceNoteBootNotification(&boot, millis())) {
+                Serial.printf("[ESP32] First BootNotification sent %u ms after boot.\n",
+                              boot.firstBootNotificationMs);
+            }
+#endif
             break;
 
         case WStype_TEXT:
-            Serial.printf("[ESP32] Received from backend: %s\n", payload);
-            uart.print((char *)payload); // Forward backend message to STM32
-            uart.print("\n");
+            PROBE(PROBE_WS_RX);
+            Serial.printf("[ESP32] Received from backend (%u bytes): %.48s\n", length, payload);
+#if SPLIT_PROCESSING
+            splitHandleBackendMessage(payload, length); // Parse here, send binary command
+#else
+            uartStreamMessage(&uartStream, payload, length); // Forward backend message to STM32
+#endif
+            PROBE(PROBE_UART_TX);
+            break;
+
+#if !SPLIT_PROCESSING // Split mode needs the complete JSON document
+        case WStype_FRAGMENT_TEXT_START:
+            PROBE(PROBE_WS_RX);
+            uartStreamBegin(&uartStream);
+            uartStreamChunk(&uartStream, payload, length);
+            break;
+
+        case WStype_FRAGMENT:
+            uartStreamChunk(&uartStream, payload, length);
+            break;
+
+        case WStype_FRAGMENT_FIN:
+            uartStreamChunk(&uartStream, payload, length);
+            uartStreamEnd(&uartStream);
+            PROBE(PROBE_UART_TX);
+            Serial.printf("[ESP32] Streamed fragmented message from backend (%u bytes).\n", uartStream.bytes);
             break;
+#endif
 
         case WStype_DISCONNECTED:
             isWebSocketConnected = false;
-            Serial.println("[ESP32] WebSocket disconnected.");
+#if SPLIT_PROCESSING
+            splitOnBackendDisconnected();
+#else
+            uartStreamAbort(&uartStream); // The rest of a fragmented message will never come
+#endif
+            reconnectOnDisconnected(&reconnect, millis());
+            postBootEvent(BOOT_EVT_WS_DOWN);
+            Serial.printf("[ESP32] WebSocket disconnected, next attempt in %lu ms.\n",
+                          reconnect.nextAttemptMs - millis());
             break;
 
         default:
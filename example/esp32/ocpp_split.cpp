@@ -0,0 +1,621 @@
+#include "ocpp_split.h"
+#include "../common/fixed_point.h"
+#include "../common/meter_agg.h"
+#include "../common/meter_history.h"
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_partition.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_PENDING_CALLS 8
+#define OCPP_UID_LEN      36 // OCPP-J unique IDs are at most 36 characters
+#define CALL_UID_SIZE     12 // Our own CALL IDs: a decimal uint32_t
+
+/* MeterValues from the STM32's readings (common/meter_agg.h), until configuration reaches the ESP32 */
+#ifndef SPLIT_SAMPLE_INTERVAL_S
+#define SPLIT_SAMPLE_INTERVAL_S 60 // MeterValueSampleInterval, during a transaction
+#endif
+#ifndef SPLIT_ALIGNED_INTERVAL_S
+#define SPLIT_ALIGNED_INTERVAL_S 900 // ClockAlignedDataInterval, 0 = off
+#endif
+#define SPLIT_CLOCK_VALID 1577836800 // 2020-01-01: before that, SNTP has not set the clock
+#define SPLIT_TX_PENDING  -1         // transactionId until the StartTransaction CALLRESULT numbers it
+
+/* MeterValues the backend missed while offline (common/meter_history.h) */
+#ifndef SPLIT_HISTORY_PARTITION
+#define SPLIT_HISTORY_PARTITION "history" // Data partition to spill to; RAM only if the table has none
+#endif
+#ifndef SPLIT_HISTORY_BURST
+#define SPLIT_HISTORY_BURST 4 // Stored MeterValues in flight once back online
+#endif
+#ifndef SPLIT_HISTORY_TIMEOUT_MS
+#define SPLIT_HISTORY_TIMEOUT_MS 30000 // A burst without all its CALLRESULTs by then is sent again
+#endif
+
+/* Backend CALLs waiting for an STM32 result, keyed by link msgId */
+typedef struct {
+    uint16_t msgId;
+    bool used;
+    char uid[OCPP_UID_LEN + 1];
+} PendingCall;
+
+static SplitSendUartFn sendUart;
+static SplitSendBackendFn sendBackend;
+static PendingCall pending[MAX_PENDING_CALLS];
+static uint16_t nextMsgId = 1;
+static uint32_t nextCallId = 1;
+static LinkDecoder decoder;
+static LinkStats stats;
+static MeterAgg meterAgg;
+static MeterHistory history; // Kind, transactionId, then meterAgg's channels
+static const esp_partition_t *historyPartition;
+static bool online;
+static char historyUids[SPLIT_HISTORY_BURST][CALL_UID_SIZE]; // Stored MeterValues in flight, oldest first
+static bool historyAnswered[SPLIT_HISTORY_BURST];
+static uint8_t historySent;   // 0: none in flight
+static uint32_t historyFirst; // Samples removed from the history before the first in flight
+static uint32_t historySentAt;
+
+/*
+ * The transaction the STM32 runs (LINK_EVT_TX_BEGIN/END), numbered by the
+ * backend: the bridge sends its Start/StopTransaction. Each is kept until its
+ * CALLRESULT arrives and sent again on the next connect. RemoteStart is
+ * refused until both are answered, so one transaction at a time is in flight.
+ */
+static int32_t transactionId; // Of the one in progress, SPLIT_TX_PENDING until numbered, 0 outside one
+static int32_t startedId;     // The backend's number for the last StartTransaction
+static bool awaitingId;       // StartTransaction not answered yet
+static bool stopPending;      // StopTransaction not answered yet
+static char startUid[CALL_UID_SIZE]; // Their CALLs, while in flight
+static char stopUid[CALL_UID_SIZE];
+static char startIdTag[LINK_ID_TAG_LEN + 1];
+static uint32_t startTime, stopTime, startWh, stopWh;
+static uint8_t stopReason;
+
+static void sendFrame(uint8_t type, const void *payload, uint8_t len) {
+    uint8_t frame[LINK_MAX_FRAME];
+    size_t size = linkEncodeFrame(frame, type, payload, len);
+    sendUart(frame, size);
+    stats.txBytes += size;
+    stats.txFrames++;
+}
+
+static void sendJson(const JsonDocument &doc) {
+    char buf[1024];
+    size_t len = serializeJson(doc, buf, sizeof(buf));
+    sendBackend(buf, len);
+}
+
+static void sendCallError(const char *uid, const char *code, const char *description) {
+    StaticJsonDocument<256> doc;
+    doc.add(4);
+    doc.add(uid);
+    doc.add(code);
+    doc.add(description);
+    doc.createNestedObject();
+    sendJson(doc);
+}
+
+static void sendCallResult(const char *uid, const char *status) {
+    StaticJsonDocument<128> doc;
+    doc.add(3);
+    doc.add(uid);
+    doc.createNestedObject()["status"] = status;
+    sendJson(doc);
+}
+
+/* Starts a CALL from the charge point, returns the payload object */
+static JsonObject beginCall(JsonDocument &doc, const char *action) {
+    char uid[CALL_UID_SIZE];
+    snprintf(uid, sizeof(uid), "%lu", (unsigned long)nextCallId++);
+    doc.add(2);
+    doc.add(uid);
+    doc.add(action);
+    return doc.createNestedObject();
+}
+
+static uint16_t addPending(const char *uid) {
+    for (int i = 0; i < MAX_PENDING_CALLS; i++) {
+        if (!pending[i].used) {
+            pending[i].used = true;
+            pending[i].msgId = nextMsgId++;
+            if (nextMsgId == 0) {
+                nextMsgId = 1;
+            }
+            strncpy(pending[i].uid, uid, OCPP_UID_LEN);
+            pending[i].uid[OCPP_UID_LEN] = '\0';
+            return pending[i].msgId;
+        }
+    }
+    return 0;
+}
+
+static PendingCall *findPending(uint16_t msgId) {
+    for (int i = 0; i < MAX_PENDING_CALLS; i++) {
+        if (pending[i].used && pending[i].msgId == msgId) {
+            return &pending[i];
+        }
+    }
+    return NULL;
+}
+
+static const char *statusName(uint8_t status) {
+    switch (status) {
+        case LINK_STATUS_AVAILABLE: return "Available";
+        case LINK_STATUS_PREPARING: return "Preparing";
+        case LINK_STATUS_CHARGING:  return "Charging";
+        case LINK_STATUS_FINISHING: return "Finishing";
+        default:                    return "Faulted";
+    }
+}
+
+static void formatTime(char *out, size_t size, uint32_t t) {
+    time_t at = (time_t)t;
+    strftime(out, size, "%Y-%m-%dT%H:%M:%SZ", gmtime(&at));
+}
+
+static const char *reasonName(uint8_t reason) {
+    switch (reason) {
+        case LINK_TX_REASON_REMOTE: return "Remote";
+        case LINK_TX_REASON_LOCAL:  return "Local";
+        default:                    return "Other";
+    }
+}
+
+/* StartTransaction of the transaction in progress, then StopTransaction once it is numbered */
+static void sendTransactionCalls(void) {
+    char timestamp[25];
+
+    if (!online) {
+        return;
+    }
+    if (awaitingId && !startUid[0]) {
+        StaticJsonDocument<256> doc;
+        JsonObject payload = beginCall(doc, "StartTransaction");
+        formatTime(timestamp, sizeof(timestamp), startTime);
+        payload["connectorId"] = 1;
+        payload["idTag"] = (const char *)startIdTag;
+        payload["meterStart"] = startWh;
+        payload["timestamp"] = (const char *)timestamp;
+        snprintf(startUid, sizeof(startUid), "%s", doc[1].as<const char *>());
+        sendJson(doc);
+    }
+    if (!awaitingId && stopPending && !stopUid[0]) {
+        StaticJsonDocument<256> doc;
+        JsonObject payload = beginCall(doc, "StopTransaction");
+        formatTime(timestamp, sizeof(timestamp), stopTime);
+        payload["transactionId"] = startedId;
+        payload["meterStop"] = stopWh;
+        payload["timestamp"] = (const char *)timestamp;
+        payload["reason"] = reasonName(stopReason);
+        snprintf(stopUid, sizeof(stopUid), "%s", doc[1].as<const char *>());
+        sendJson(doc);
+    }
+}
+
+/* One MeterValues CALL: values in meterAgg's channel order, transactionId 0 for none; uid gets its CALL ID */
+static void sendMeterValue(uint32_t end, uint8_t kind, int32_t txId, const int32_t *values, char *uid) {
+    char timestamp[25], value[16];
+    formatTime(timestamp, sizeof(timestamp), end);
+
+    StaticJsonDocument<1024> doc;
+    JsonObject payload = beginCall(doc, "MeterValues");
+    payload["connectorId"] = 1;
+    if (txId) {
+        payload["transactionId"] = txId;
+    }
+    JsonObject reading = payload.createNestedArray("meterValue").createNestedObject();
+    reading["timestamp"] = timestamp;
+    JsonArray sampled = reading.createNestedArray("sampledValue");
+    for (int c = 0; c < meterAgg.channelCount; c++) {
+        const MeterAggChannel *channel = &meterAgg.channels[c];
+        JsonObject sample = sampled.createNestedObject();
+        fxFormat(value, sizeof(value), values[c], channel->decimals);
+        sample["value"] = String(value);
+        sample["context"] = strText(kind == METER_AGG_ALIGNED ? STR_SampleClock : STR_SamplePeriodic);
+        sample["measurand"] = strText(channel->measurand);
+        if (channel->phase != METER_AGG_PHASE_NONE) {
+            sample["phase"] = meterAggPhaseName(channel->phase);
+        }
+        sample["unit"] = strText(channel->unit);
+    }
+    if (uid) {
+        snprintf(uid, CALL_UID_SIZE, "%s", doc[1].as<const char *>());
+    }
+    sendJson(doc);
+}
+
+/*
+ * One CALL per finished interval; kept in the history while offline, behind
+ * older ones, or until the backend has numbered the transaction it belongs to
+ */
+static void sendMeterValues(void) {
+    MeterAggBatch batch;
+
+    while (meterAggTake(&meterAgg, &batch)) {
+        int32_t values[2 + METER_AGG_CHANNELS] = {batch.kind, batch.kind == METER_AGG_SAMPLED ? transactionId : 0};
+        for (int c = 0; c < meterAgg.channelCount; c++) {
+            values[2 + c] = meterAggValue(&meterAgg, &batch, c);
+        }
+        if (online && !history.count && values[1] != SPLIT_TX_PENDING) {
+            sendMeterValue(batch.end, batch.kind, values[1], &values[2], NULL);
+        } else {
+            meterHistoryAppend(&history, batch.end, values);
+        }
+    }
+}
+
+/* Samples removed from the history since boot: the index of its oldest one */
+static uint32_t historyRemoved(void) {
+    return history.stats.uploaded + history.stats.dropped;
+}
+
+/*
+ * A few stored MeterValues, oldest first, so the backlog does not flood the
+ * link. They stay in the history until the burst is answered, and are sent
+ * again if it is not answered in time or the connection drops.
+ */
+static void uploadHistory(void) {
+    MeterHistoryCursor cursor;
+    uint32_t end, sent = 0;
+    int32_t values[METER_HISTORY_CHANNELS];
+
+    if (historySent && millis() - historySentAt >= SPLIT_HISTORY_TIMEOUT_MS) {
+        historySent = 0;
+    }
+    if (!online || !history.count || historySent) {
+        return;
+    }
+    meterHistoryBegin(&history, &cursor);
+    while (sent < SPLIT_HISTORY_BURST && meterHistoryNext(&history, &cursor, &end, values)) {
+        if (values[1] == SPLIT_TX_PENDING) {
+            if (awaitingId) {
+                break; // No transactionId yet; only the last transaction can be waiting for one
+            }
+            values[1] = startedId;
+        }
+        sendMeterValue(end, (uint8_t)values[0], values[1], &values[2], historyUids[sent]);
+        historyAnswered[sent] = false;
+        sent++;
+    }
+    historySent = (uint8_t)sent;
+    historyFirst = historyRemoved();
+    historySentAt = millis();
+}
+
+/* Drops the burst once every CALL in it is answered, less what a full history pushed out meanwhile */
+static void ackHistory(const char *uid) {
+    uint32_t gone;
+    bool found = false, done = true;
+
+    for (int i = 0; i < historySent; i++) {
+        if (!strcmp(uid, historyUids[i])) {
+            historyAnswered[i] = found = true;
+        }
+        done = done && historyAnswered[i];
+    }
+    if (!found || !done) {
+        return;
+    }
+    gone = historyRemoved() - historyFirst;
+    if (historySent > gone) {
+        meterHistoryDrop(&history, historySent - gone);
+    }
+    historySent = 0;
+    uploadHistory();
+}
+
+/* Flash device over the history partition, read through its memory mapping */
+static bool historyProgram(void *ctx, uint32_t offset, const uint16_t *data, uint32_t halfWords) {
+    return esp_partition_write(historyPartition, offset, data, halfWords * 2) == ESP_OK;
+}
+
+static bool historyErase(void *ctx, uint32_t page) {
+    return esp_partition_erase_range(historyPartition, page * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE) == ESP_OK;
+}
+
+static void historyInit(void) {
+    const void *base;
+    spi_flash_mmap_handle_t handle;
+    uint8_t channels = (uint8_t)(2 + meterAgg.channelCount);
+
+    historyPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                SPLIT_HISTORY_PARTITION);
+    if (!historyPartition ||
+        esp_partition_mmap(historyPartition, 0, historyPartition->size, SPI_FLASH_MMAP_DATA, &base, &handle) != ESP_OK) {
+        meterHistoryInit(&history, channels, NULL);
+        return;
+    }
+    MeterHistoryDevice dev = {(const uint8_t *)base, SPI_FLASH_SEC_SIZE, historyPartition->size / SPI_FLASH_SEC_SIZE,
+                              historyProgram, historyErase, NULL};
+    if (meterHistoryInit(&history, channels, &dev) != METER_HISTORY_OK) {
+        meterHistoryInit(&history, channels, NULL);
+    }
+    Serial.printf("[ESP32] MeterValues history: %lu stored from before the reset\n", (unsigned long)history.count);
+}
+
+/* Validates a backend CALL and turns it into a link command, false if unsupported */
+static bool forwardCall(const char *uid, const char *action, JsonObject payload) {
+    if (!strcmp(action, "RemoteStartTransaction")) {
+        const char *idTag = payload["idTag"];
+        if (!idTag || strlen(idTag) > LINK_ID_TAG_LEN) {
+            sendCallError(uid, "FormationViolation", "idTag");
+            return true;
+        }
+        if (transactionId || awaitingId || stopPending) {
+            sendCallResult(uid, "Rejected"); // One in progress, or the last one is not settled with the backend
+            return true;
+        }
+        LinkRemoteStart cmd = {};
+        cmd.msgId = addPending(uid);
+        cmd.connectorId = payload["connectorId"] | 1;
+        strcpy(cmd.idTag, idTag);
+        if (!cmd.msgId) {
+            sendCallResult(uid, "Rejected"); // Too many calls in flight
+            return true;
+        }
+        sendFrame(LINK_CMD_REMOTE_START, &cmd, sizeof(cmd));
+        return true;
+    }
+
+    if (!strcmp(action, "RemoteStopTransaction")) {
+        if (!payload["transactionId"].is<int32_t>()) {
+            sendCallError(uid, "FormationViolation", "transactionId");
+            return true;
+        }
+        int32_t id = payload["transactionId"];
+        if (!transactionId || transactionId == SPLIT_TX_PENDING || id != transactionId) {
+            sendCallResult(uid, "Rejected"); // Not the transaction in progress, or it is not numbered yet
+            return true;
+        }
+        LinkRemoteStop cmd = {};
+        cmd.msgId = addPending(uid);
+        cmd.transactionId = id;
+        if (!cmd.msgId) {
+            sendCallResult(uid, "Rejected");
+            return true;
+        }
+        sendFrame(LINK_CMD_REMOTE_STOP, &cmd, sizeof(cmd));
+        return true;
+    }
+
+    if (!strcmp(action, "SetChargingProfile")) {
+        JsonObject schedule = payload["csChargingProfiles"]["chargingSchedule"];
+        const char *unit = schedule["chargingRateUnit"];
+        JsonVariant limit = schedule["chargingSchedulePeriod"][0]["limit"];
+        if (!unit || strcmp(unit, "A") || !limit.is<float>()) {
+            sendCallResult(uid, "Rejected"); // Only amp limits are forwarded in split mode
+            return true;
+        }
+        LinkSetCurrentLimit cmd = {};
+        cmd.msgId = addPending(uid);
+        cmd.connectorId = payload["connectorId"] | 1;
+        cmd.limitDeciAmps = (uint16_t)(limit.as<float>() * 10.0f + 0.5f);
+        if (!cmd.msgId) {
+            sendCallResult(uid, "Rejected");
+            return true;
+        }
+        sendFrame(LINK_CMD_SET_CURRENT_LIMIT, &cmd, sizeof(cmd));
+        return true;
+    }
+
+    return false;
+}
+
+static void handleLinkEvent(const LinkDecoder *frame) {
+    switch (frame->type) {
+        case LINK_EVT_RESULT: {
+            if (frame->len != sizeof(LinkResult)) {
+                break;
+            }
+            LinkResult result;
+            memcpy(&result, frame->payload, sizeof(result));
+            PendingCall *call = findPending(result.msgId);
+            if (call) {
+                sendCallResult(call->uid, result.result == LINK_RESULT_ACCEPTED ? "Accepted" : "Rejected");
+                call->used = false;
+            }
+            break;
+        }
+
+        case LINK_EVT_STATUS: {
+            if (frame->len != sizeof(LinkStatus)) {
+                break;
+            }
+            LinkStatus status;
+            memcpy(&status, frame->payload, sizeof(status));
+            StaticJsonDocument<256> doc;
+            JsonObject payload = beginCall(doc, "StatusNotification");
+            payload["connectorId"] = status.connectorId;
+            payload["errorCode"] = "NoError";
+            payload["status"] = statusName(status.status);
+            sendJson(doc);
+            break;
+        }
+
+        case LINK_EVT_TX_BEGIN: {
+            if (frame->len != sizeof(LinkTxBegin) || transactionId) {
+                break; // The STM32 sends one per transaction it opens
+            }
+            LinkTxBegin begin;
+            memcpy(&begin, frame->payload, sizeof(begin));
+            uint32_t now = (uint32_t)time(nullptr);
+            transactionId = SPLIT_TX_PENDING;
+            awaitingId = true;
+            startTime = now;
+            startWh = begin.meterStartWh;
+            memcpy(startIdTag, begin.idTag, LINK_ID_TAG_LEN);
+            startIdTag[LINK_ID_TAG_LEN] = '\0';
+            meterAggStart(&meterAgg, now); // Sampled intervals run during the transaction
+            sendTransactionCalls();
+            break;
+        }
+
+        case LINK_EVT_TX_END: {
+            if (frame->len != sizeof(LinkTxEnd) || !transactionId) {
+                break;
+            }
+            LinkTxEnd end;
+            memcpy(&end, frame->payload, sizeof(end));
+            uint32_t now = (uint32_t)time(nullptr);
+            meterAggStop(&meterAgg, now);
+            sendMeterValues(); // The last sampled batch still carries the transactionId
+            transactionId = 0;
+            stopPending = true;
+            stopTime = now;
+            stopWh = end.meterStopWh;
+            stopReason = end.reason;
+            sendTransactionCalls();
+            break;
+        }
+
+        case LINK_EVT_METER: {
+            if (frame->len != sizeof(LinkMeter)) {
+                break;
+            }
+            LinkMeter meter;
+            memcpy(&meter, frame->payload, sizeof(meter));
+            time_t now = time(nullptr);
+            if (now < SPLIT_CLOCK_VALID) {
+                break; // No wall clock to align the intervals to yet
+            }
+            int32_t values[] = {(int32_t)meter.energyWh, meter.powerW, meter.deciVolts, meter.centiAmps};
+            meterAggAdd(&meterAgg, (uint32_t)now, values); // In the order of splitInit()'s channels
+            sendMeterValues();
+            uploadHistory();
+            break;
+        }
+
+        case LINK_EVT_STATS: {
+            if (frame->len != sizeof(LinkStatsReport)) {
+                break;
+            }
+            LinkStatsReport report;
+            memcpy(&report, frame->payload, sizeof(report));
+            Serial.printf("[ESP32] STM32 stats: %lu commands, %lu avg / %lu max cycles, link rx %lu / tx %lu bytes\n",
+                          (unsigned long)report.commands, (unsigned long)report.avgCycles,
+                          (unsigned long)report.maxCycles, (unsigned long)report.rxBytes,
+                          (unsigned long)report.txBytes);
+            Serial.printf("[ESP32] STM32 RAM: %u B static, %u B receive path (binary)\n",
+                          (unsigned)report.ramStatic, (unsigned)report.ramRxPath);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void splitInit(SplitSendUartFn sendUartFn, SplitSendBackendFn sendBackendFn) {
+    sendUart = sendUartFn;
+    sendBackend = sendBackendFn;
+    memset(pending, 0, sizeof(pending));
+    memset(&stats, 0, sizeof(stats));
+    linkDecoderInit(&decoder);
+
+    uint32_t now = (uint32_t)time(nullptr);
+    meterAggInit(&meterAgg);
+    meterAggAddChannel(&meterAgg, STR_EnergyActiveImportRegister, STR_Wh, METER_AGG_PHASE_NONE, 0, true);
+    meterAggAddChannel(&meterAgg, STR_PowerActiveImport, STR_W, METER_AGG_PHASE_NONE, 0, false);
+    meterAggAddChannel(&meterAgg, STR_Voltage, STR_V, METER_AGG_PHASE_L1, 1, false);
+    meterAggAddChannel(&meterAgg, STR_CurrentImport, STR_A, METER_AGG_PHASE_L1, 2, false);
+    meterAggSetInterval(&meterAgg, METER_AGG_SAMPLED, SPLIT_SAMPLE_INTERVAL_S, now);
+    meterAggSetInterval(&meterAgg, METER_AGG_ALIGNED, SPLIT_ALIGNED_INTERVAL_S, now);
+    online = false;
+    transactionId = 0;
+    awaitingId = false;
+    stopPending = false;
+    startUid[0] = '\0';
+    stopUid[0] = '\0';
+    historySent = 0;
+    historyInit();
+}
+
+/*
+ * CALLRESULT or CALLERROR for one of our own CALLs. An error leaves a
+ * Start/StopTransaction to the next connect, and answers a stored MeterValues.
+ */
+static void handleCallResult(const char *uid, bool error, JsonObject payload) {
+    ackHistory(uid);
+    if (stopUid[0] && !strcmp(uid, stopUid)) {
+        stopUid[0] = '\0';
+        if (!error) {
+            stopPending = false;
+        }
+        return;
+    }
+    if (startUid[0] && !strcmp(uid, startUid)) {
+        startUid[0] = '\0';
+        if (error || !payload["transactionId"].is<int32_t>()) {
+            return;
+        }
+        startedId = payload["transactionId"];
+        awaitingId = false;
+        if (transactionId == SPLIT_TX_PENDING) {
+            transactionId = startedId;
+        }
+        sendTransactionCalls();
+        uploadHistory(); // Sampled MeterValues that waited for the number
+    }
+}
+
+void splitHandleBackendMessage(const uint8_t *payload, size_t len) {
+    StaticJsonDocument<1024> doc;
+
+    if (deserializeJson(doc, (const char *)payload, len) != DeserializationError::Ok || !doc.is<JsonArray>()) {
+        return;
+    }
+    if (doc[0] == 3 || doc[0] == 4) {
+        if (doc[1].is<const char *>()) {
+            handleCallResult(doc[1], doc[0] == 4, doc[2]); // A CALLERROR's [2] is its code, not an object
+        }
+        return;
+    }
+    if (doc[0] != 2) {
+        return;
+    }
+
+    const char *uid = doc[1];
+    const char *action = doc[2];
+    if (!uid || !action || strlen(uid) > OCPP_UID_LEN) {
+        return;
+    }
+    if (!forwardCall(uid, action, doc[3])) {
+        sendCallError(uid, "NotImplemented", action);
+    }
+}
+
+void splitHandleUartByte(uint8_t byte) {
+    stats.rxBytes++;
+    if (linkDecodeByte(&decoder, byte)) {
+        stats.rxFrames++;
+        handleLinkEvent(&decoder);
+    }
+}
+
+void splitOnBackendConnected(void) {
+    StaticJsonDocument<256> doc;
+    JsonObject payload = beginCall(doc, "BootNotification");
+    payload["chargePointModel"] = "STM32 Charger";
+    payload["chargePointVendor"] = "My Company";
+    sendJson(doc);
+    online = true; // Stored MeterValues follow with the next meter events
+    sendTransactionCalls();
+}
+
+void splitOnBackendDisconnected(void) {
+    online = false;
+    startUid[0] = '\0'; // Their answers are lost with the connection
+    stopUid[0] = '\0';
+    historySent = 0;    // As are these; the records are still held
+}
+
+void splitRequestStats(void) {
+    sendFrame(LINK_CMD_GET_STATS, NULL, 0);
+}
+
+const LinkStats *splitLinkStats(void) {
+    return &stats;
+}
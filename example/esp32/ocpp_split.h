@@ -0,0 +1,41 @@
+#ifndef OCPP_SPLIT_H
+#define OCPP_SPLIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../common/link_protocol.h"
+
+/*
+ * Split-processing mode of the bridge (SPLIT_PROCESSING=1).
+ *
+ * The ESP32 parses and validates OCPP-J from the backend and forwards only
+ * RemoteStartTransaction, RemoteStopTransaction and SetChargingProfile (as a
+ * current limit) to the STM32 as binary link commands. Binary events from the
+ * STM32 are rendered back to OCPP-J CALLRESULTs and CALLs, including the
+ * Start/StopTransaction of each transaction the STM32 opens and closes
+ * (LINK_EVT_TX_BEGIN/END) and its MeterValues.
+ */
+
+typedef void (*SplitSendUartFn)(const uint8_t *data, size_t len);
+typedef void (*SplitSendBackendFn)(const char *json, size_t len);
+
+void splitInit(SplitSendUartFn sendUart, SplitSendBackendFn sendBackend);
+
+/* One complete OCPP-J message from the backend */
+void splitHandleBackendMessage(const uint8_t *payload, size_t len);
+
+/* Raw byte received from the STM32 */
+void splitHandleUartByte(uint8_t byte);
+
+/* Sends the BootNotification the STM32 no longer generates in split mode */
+void splitOnBackendConnected(void);
+
+/* MeterValues go to the history (common/meter_history.h) until the next connect */
+void splitOnBackendDisconnected(void);
+
+/* Asks the STM32 for dispatch timing and link counters (printed on arrival) */
+void splitRequestStats(void);
+
+const LinkStats *splitLinkStats(void);
+
+#endif /* OCPP_SPLIT_H */
@@ -0,0 +1,107 @@
+#include "reconnect_policy.h"
+
+#include <string.h>
+
+/* xorshift32, good enough for jitter and cheap on the C3 */
+static uint32_t nextRandom(ReconnectPolicy *policy) {
+    uint32_t x = policy->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    policy->rng = x;
+    return x;
+}
+
+/* Uniform value in [lo, hi] */
+static uint32_t randomBetween(ReconnectPolicy *policy, uint32_t lo, uint32_t hi) {
+    if (hi <= lo) {
+        return lo;
+    }
+    return lo + nextRandom(policy) % (hi - lo + 1);
+}
+
+static void scheduleAttempt(ReconnectPolicy *policy, uint32_t nowMs) {
+    policy->state = RECONNECT_WAITING;
+    policy->nextAttemptMs = nowMs + reconnectNextDelay(policy);
+}
+
+void reconnectConfigDefaults(ReconnectConfig *config) {
+    config->baseMs = RECONNECT_BASE_MS;
+    config->capMs = RECONNECT_CAP_MS;
+    config->maxOffsetMs = RECONNECT_MAX_OFFSET_MS;
+    config->attemptWindowMs = RECONNECT_ATTEMPT_WINDOW_MS;
+    config->stableMs = RECONNECT_STABLE_MS;
+}
+
+void reconnectInit(ReconnectPolicy *policy, const ReconnectConfig *config,
+                   uint32_t deviceSeed, uint32_t nowMs) {
+    memset(policy, 0, sizeof(*policy));
+    policy->config = *config;
+
+    // Scramble the seed so that consecutive MACs give unrelated offsets
+    uint32_t seed = deviceSeed * 0x9E3779B1u;
+    seed ^= seed >> 16;
+    policy->rng = seed ? seed : 0x2545F491u;
+
+    policy->deviceOffsetMs = config->maxOffsetMs ? nextRandom(policy) % config->maxOffsetMs : 0;
+    scheduleAttempt(policy, nowMs);
+}
+
+uint32_t reconnectNextDelay(ReconnectPolicy *policy) {
+    const ReconnectConfig *config = &policy->config;
+    uint32_t delay;
+
+    if (policy->lastDelayMs == 0) {
+        // First attempt of an outage: spread the fleet over the offset window
+        delay = policy->deviceOffsetMs + randomBetween(policy, 0, config->baseMs);
+        policy->lastDelayMs = config->baseMs;
+    } else {
+        uint32_t upper = policy->lastDelayMs > config->capMs / 3 ? config->capMs : policy->lastDelayMs * 3;
+        delay = randomBetween(policy, config->baseMs, upper);
+        if (delay > config->capMs) {
+            delay = config->capMs;
+        }
+        policy->lastDelayMs = delay;
+    }
+    return delay;
+}
+
+ReconnectAction reconnectPoll(ReconnectPolicy *policy, uint32_t nowMs) {
+    switch (policy->state) {
+        case RECONNECT_WAITING:
+            if ((int32_t)(nowMs - policy->nextAttemptMs) < 0) {
+                return RECONNECT_IDLE;
+            }
+            policy->state = RECONNECT_ATTEMPTING;
+            policy->windowEndMs = nowMs + policy->config.attemptWindowMs;
+            policy->attempts++;
+            return RECONNECT_BEGIN;
+
+        case RECONNECT_ATTEMPTING:
+            if ((int32_t)(nowMs - policy->windowEndMs) >= 0) {
+                scheduleAttempt(policy, nowMs); // No CONNECTED event in time
+                return RECONNECT_ABORT;
+            }
+            return RECONNECT_POLL;
+
+        case RECONNECT_CONNECTED:
+            return RECONNECT_POLL;
+    }
+    return RECONNECT_IDLE;
+}
+
+void reconnectOnConnected(ReconnectPolicy *policy, uint32_t nowMs) {
+    policy->state = RECONNECT_CONNECTED;
+    policy->connectedMs = nowMs;
+}
+
+void reconnectOnDisconnected(ReconnectPolicy *policy, uint32_t nowMs) {
+    if (policy->state == RECONNECT_CONNECTED &&
+        nowMs - policy->connectedMs >= policy->config.stableMs) {
+        policy->lastDelayMs = 0; // Fresh outage, start again from the device offset
+        policy->attempts = 0;
+    }
+    if (policy->state != RECONNECT_WAITING) {
+        scheduleAttempt(policy, nowMs);
+    }
+}
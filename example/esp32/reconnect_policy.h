@@ -0,0 +1,98 @@
+#ifndef RECONNECT_POLICY_H
+#define RECONNECT_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fleet-safe WebSocket reconnect scheduler.
+ *
+ * Replaces the fixed reconnect interval of WebSocketsClient. The bridge asks
+ * reconnectPoll() every loop() and only calls webSocket.begin()/loop() when
+ * told to, so connect attempts happen exactly when this policy allows them:
+ *
+ *  - the first attempt after boot or after a stable connection is delayed by
+ *    a per-device offset (derived from the MAC) plus jitter, so a whole site
+ *    does not reconnect in lockstep when the backend comes back,
+ *  - every further attempt uses decorrelated jitter backoff
+ *    delay = min(cap, random(base, 3 * previous delay)),
+ *  - the backoff is only reset once a connection stayed up for stableMs.
+ */
+
+typedef struct {
+    uint32_t baseMs;          // Smallest backoff delay
+    uint32_t capMs;           // Largest backoff delay
+    uint32_t maxOffsetMs;     // Per-device offset is in [0, maxOffsetMs)
+    uint32_t attemptWindowMs; // Time allowed for TCP + TLS + HTTP upgrade
+    uint32_t stableMs;        // Connection uptime after which the backoff resets
+} ReconnectConfig;
+
+typedef enum {
+    RECONNECT_WAITING,    // Backing off, do not poll the client
+    RECONNECT_ATTEMPTING, // Poll the client until connected or the window expires
+    RECONNECT_CONNECTED
+} ReconnectState;
+
+typedef enum {
+    RECONNECT_IDLE,  // Do not touch the client
+    RECONNECT_BEGIN, // Start a connect attempt (begin()), then poll
+    RECONNECT_POLL,  // Poll the client (loop())
+    RECONNECT_ABORT  // Attempt window expired, drop the half-open client (disconnect())
+} ReconnectAction;
+
+typedef struct {
+    ReconnectConfig config;
+    ReconnectState state;
+    uint32_t rng;
+    uint32_t deviceOffsetMs;
+    uint32_t lastDelayMs;   // 0 = no backoff in progress
+    uint32_t nextAttemptMs; // Valid while WAITING
+    uint32_t windowEndMs;   // Valid while ATTEMPTING
+    uint32_t connectedMs;   // Valid while CONNECTED
+    uint32_t attempts;      // Attempts since the last stable connection
+} ReconnectPolicy;
+
+/* Defaults used by the bridge (tuned for a few hundred chargers per backend) */
+#define RECONNECT_BASE_MS           1000
+#define RECONNECT_CAP_MS            120000
+#define RECONNECT_MAX_OFFSET_MS     30000
+#define RECONNECT_ATTEMPT_WINDOW_MS 10000
+#define RECONNECT_STABLE_MS         60000
+
+/*
+ * Connectivity health check: WebSocket ping/pong. The WebSocket callback
+ * blocks while a backend message drains into the UART (uart_stream.h), and no
+ * pong is read meanwhile, so the timeout covers the drain of the largest
+ * message (10 bits per byte) on top of the round trip.
+ */
+#define UART_LINK_BAUD              115200
+#define WS_MAX_MESSAGE_BYTES        65536
+#define WS_DRAIN_MS                 ((uint32_t)((uint64_t)WS_MAX_MESSAGE_BYTES * 10 * 1000 / UART_LINK_BAUD)) // 5688 ms
+#define WS_PING_INTERVAL_MS         25000
+#define WS_PONG_TIMEOUT_MS          (WS_DRAIN_MS + 5000)
+#define WS_PONG_MISSED_LIMIT        2
+
+void reconnectConfigDefaults(ReconnectConfig *config);
+
+/* deviceSeed should be unique per device (e.g. eFuse MAC), nowMs is millis() */
+void reconnectInit(ReconnectPolicy *policy, const ReconnectConfig *config,
+                   uint32_t deviceSeed, uint32_t nowMs);
+
+/* Called every loop(); the caller performs the returned action */
+ReconnectAction reconnectPoll(ReconnectPolicy *policy, uint32_t nowMs);
+
+void reconnectOnConnected(ReconnectPolicy *policy, uint32_t nowMs);
+void reconnectOnDisconnected(ReconnectPolicy *policy, uint32_t nowMs);
+
+/* Picks the next backoff delay and advances the jitter state */
+uint32_t reconnectNextDelay(ReconnectPolicy *policy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RECONNECT_POLICY_H */
@@ -0,0 +1,83 @@
+#include "uart_stream.h"
+
+/* Blocks (via wait) until all bytes are in the TX ring */
+static void writeAll(UartStream *stream, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        size_t written = stream->write(stream->ctx, data, len);
+        if (written == 0) {
+            stream->stalls++;
+            stream->wait(stream->ctx);
+            continue;
+        }
+        data += written;
+        len -= written;
+    }
+}
+
+void uartStreamInit(UartStream *stream, UartStreamWriteFn write, UartStreamWaitFn wait, void *ctx) {
+    stream->write = write;
+    stream->wait = wait;
+    stream->ctx = ctx;
+    stream->inMessage = false;
+    stream->messages = 0;
+    stream->bytes = 0;
+    stream->totalBytes = 0;
+    stream->stalls = 0;
+    stream->aborted = 0;
+}
+
+void uartStreamBegin(UartStream *stream) {
+    uartStreamAbort(stream); // A new message while one is open: the open one never ends
+    stream->inMessage = true;
+    stream->bytes = 0;
+}
+
+void uartStreamChunk(UartStream *stream, const uint8_t *data, size_t len) {
+    static const uint8_t space = ' ';
+    size_t start = 0;
+
+    if (!stream->inMessage) {
+        return; // Fragments of a binary message or after an aborted one
+    }
+
+    // Forward runs between line breaks in place, only the breaks themselves are replaced
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\n' || data[i] == '\r' || data[i] == UART_STREAM_CANCEL) {
+            writeAll(stream, data + start, i - start);
+            writeAll(stream, &space, 1);
+            start = i + 1;
+        }
+    }
+    writeAll(stream, data + start, len - start);
+
+    stream->bytes += (uint32_t)len;
+    stream->totalBytes += (uint32_t)len;
+}
+
+void uartStreamEnd(UartStream *stream) {
+    static const uint8_t delimiter = '\n';
+
+    if (!stream->inMessage) {
+        return;
+    }
+    writeAll(stream, &delimiter, 1);
+    stream->inMessage = false;
+    stream->messages++;
+}
+
+void uartStreamAbort(UartStream *stream) {
+    static const uint8_t cancel = UART_STREAM_CANCEL;
+
+    if (!stream->inMessage) {
+        return;
+    }
+    writeAll(stream, &cancel, 1);
+    stream->inMessage = false;
+    stream->aborted++;
+}
+
+void uartStreamMessage(UartStream *stream, const uint8_t *data, size_t len) {
+    uartStreamBegin(stream);
+    uartStreamChunk(stream, data, len);
+    uartStreamEnd(stream);
+}
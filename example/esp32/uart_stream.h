@@ -0,0 +1,67 @@
+#ifndef UART_STREAM_H
+#define UART_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Streams backend messages to the STM32 UART chunk by chunk.
+ *
+ * WebSocket text frames (or WStype_FRAGMENT_* pieces of a fragmented message)
+ * are written straight into the UART TX ring as they arrive. Nothing is copied
+ * or re-scanned here. The WebSocket library still holds a whole unfragmented
+ * frame, so only fragmented messages use RAM independent of their size. Raw line
+ * breaks inside a message are sent as spaces (JSON whitespace) so they cannot
+ * be mistaken for the '\n' frame delimiter on the STM32 side.
+ *
+ * The calls block (through wait) until their bytes are in the ring, so a large
+ * message holds up the WebSocket callback for its drain time; see
+ * WS_PONG_TIMEOUT_MS in reconnect_policy.h.
+ *
+ * A message cut short (WebSocket lost between fragments) is aborted with
+ * UART_STREAM_CANCEL, on which the STM32 discards the partial line. Raw CAN
+ * bytes inside a message are sent as spaces, like line breaks.
+ */
+
+#define UART_STREAM_CANCEL 0x18 // ASCII CAN
+
+/* Writes up to len bytes, returns how many were accepted (0 when the ring is full) */
+typedef size_t (*UartStreamWriteFn)(void *ctx, const uint8_t *data, size_t len);
+
+/* Called while the ring is full, e.g. yields until the UART drains */
+typedef void (*UartStreamWaitFn)(void *ctx);
+
+typedef struct {
+    UartStreamWriteFn write;
+    UartStreamWaitFn wait;
+    void *ctx;
+    bool inMessage;
+    uint32_t messages;
+    uint32_t bytes;       // Payload bytes of the current message
+    uint32_t totalBytes;
+    uint32_t stalls;      // Times the TX ring was full
+    uint32_t aborted;     // Messages cancelled before their end
+} UartStream;
+
+void uartStreamInit(UartStream *stream, UartStreamWriteFn write, UartStreamWaitFn wait, void *ctx);
+
+void uartStreamBegin(UartStream *stream);
+void uartStreamChunk(UartStream *stream, const uint8_t *data, size_t len);
+void uartStreamEnd(UartStream *stream); // Appends the '\n' delimiter
+
+/* Cancels a message in progress, e.g. on disconnect; no-op otherwise */
+void uartStreamAbort(UartStream *stream);
+
+/* Convenience for a complete (unfragmented) message */
+void uartStreamMessage(UartStream *stream, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UART_STREAM_H */
@@ -0,0 +1,70 @@
+#include "ca_bundle.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "mbedtls/pk.h"
+#include "mbedtls/x509_crt.h"
+
+/* Bundle layout: [num_certs:2] then per cert [name_len:2][key_len:2][name][key] */
+#define BUNDLE_HEADER_SIZE 2
+#define CERT_HEADER_SIZE   4
+#define MAX_KEY_DER_SIZE   600 // Enough for RSA-4096 and EC public keys
+
+static uint8_t *bundle = NULL;
+static size_t bundleSize = 0;
+
+int caBundleInit(const char *pemCert) {
+    mbedtls_x509_crt crt;
+    uint8_t keyBuf[MAX_KEY_DER_SIZE];
+    int ret;
+
+    if (bundle) {
+        return 0; // Already built, keep it for the lifetime of the firmware
+    }
+
+    mbedtls_x509_crt_init(&crt);
+    ret = mbedtls_x509_crt_parse(&crt, (const unsigned char *)pemCert, strlen(pemCert) + 1);
+    if (ret != 0) {
+        mbedtls_x509_crt_free(&crt);
+        return ret;
+    }
+
+    // mbedtls_pk_write_pubkey_der() writes at the end of the buffer
+    int keyLen = mbedtls_pk_write_pubkey_der(&crt.pk, keyBuf, sizeof(keyBuf));
+    if (keyLen <= 0) {
+        mbedtls_x509_crt_free(&crt);
+        return keyLen < 0 ? keyLen : -1;
+    }
+    const uint8_t *key = keyBuf + sizeof(keyBuf) - keyLen;
+    size_t nameLen = crt.subject_raw.len;
+
+    bundleSize = BUNDLE_HEADER_SIZE + CERT_HEADER_SIZE + nameLen + (size_t)keyLen;
+    bundle = (uint8_t *)malloc(bundleSize);
+    if (!bundle) {
+        bundleSize = 0;
+        mbedtls_x509_crt_free(&crt);
+        return -1;
+    }
+
+    uint8_t *p = bundle;
+    *p++ = 0;
+    *p++ = 1; // One certificate
+    *p++ = (uint8_t)(nameLen >> 8);
+    *p++ = (uint8_t)(nameLen & 0xFF);
+    *p++ = (uint8_t)((size_t)keyLen >> 8);
+    *p++ = (uint8_t)((size_t)keyLen & 0xFF);
+    memcpy(p, crt.subject_raw.p, nameLen);
+    p += nameLen;
+    memcpy(p, key, (size_t)keyLen);
+
+    mbedtls_x509_crt_free(&crt); // PEM text and parsed chain are no longer needed
+    return 0;
+}
+
+const uint8_t *caBundleData(void) {
+    return bundle;
+}
+
+size_t caBundleSize(void) {
+    return bundleSize;
+}
@@ -0,0 +1,34 @@
+#ifndef CA_BUNDLE_H
+#define CA_BUNDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Pre-parsed trust anchor for the TLS WebSocket connection.
+ *
+ * The CA certificate is parsed from PEM exactly once at boot and stored as a
+ * DER certificate bundle (subject name + public key) in the layout expected by
+ * the ESP32 certificate bundle verifier. Every later handshake only looks the
+ * issuer up in this bundle instead of base64-decoding and parsing the full PEM
+ * certificate again on each reconnect.
+ */
+
+/* Parses the PEM certificate and builds the bundle. Returns 0 on success. */
+int caBundleInit(const char *pemCert);
+
+/* Bundle buffer to hand to beginSslWithBundle(), or NULL before init. */
+const uint8_t *caBundleData(void);
+
+/* Size of the bundle in bytes (0 before init). */
+size_t caBundleSize(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CA_BUNDLE_H */
@@ -1,6 +1,11 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <WebSocketsClient.h>
+#include "esp_sntp.h"
+#include "ca_bundle.h"
+#include "../esp32/boot_sequence.h"
+#include "../esp32/reconnect_policy.h"
+#include "../esp32/uart_stream.h"
 
 // Wi-Fi Credentials
 #define WIFI_SSID "YourWiFiSSID"
@@ -10,7 +15,7 @@
 #define OCPP_BACKEND_URL "wss://your-backend-url/steve/websocket/CentralSystemService"
 #define OCPP_AUTH_KEY "SecureAuthKey" // Basic Authentication key
 
-// CA Certificate
+// CA Certificate (parsed once at boot into a DER bundle, see ca_bundle.c)
 const char ca_cert[] PROGMEM = R"EOF(
 -----BEGIN CERTIFICATE-----
 ... (your CA certificate here) ...
@@ -21,62 +26,187 @@ const char ca_cert[] PROGMEM = R"EOF(
 #define UART_RX_PIN 16
 #define UART_TX_PIN 17
 HardwareSerial uart(2);
+#define UART_TX_RING_SIZE 1024
+UartStream uartStream; // Streams backend messages into the TX ring
+
+// UART TX Backpressure (only accept what fits into the ring)
+size_t uartStreamWrite(void *ctx, const uint8_t *data, size_t len) {
+    size_t space = uart.availableForWrite();
+    return space ? uart.write(data, len < space ? len : space) : 0;
+}
+
+void uartStreamWait(void *ctx) {
+    delay(1); // ~11 bytes drain per ms at 115200 baud
+}
 
 // WebSocket Client
 WebSocketsClient webSocket;
 bool isWebSocketConnected = false;
 
+// Boot Sequence (events are posted from the Wi-Fi/SNTP tasks, consumed in loop())
+BootSequence boot;
+BootEventQueue bootEvents;
+
+void postBootEvent(BootEvent event) {
+    bootEventPost(&bootEvents, event);
+}
+
+// Reconnect Scheduling (backoff with jitter instead of a fixed interval)
+ReconnectPolicy reconnect;
+
+// Connect Timing (attempt start until WebSocket upgrade incl. TLS handshake)
+int64_t connectStartUs = 0;
+uint32_t connectCount = 0;
+
 // WebSocket Event Handler
 void webSocketEvent(WStype_t type, uint8_t *payload, size_t length) {
     switch (type) {
         case WStype_CONNECTED:
             isWebSocketConnected = true;
-            Serial.println("[ESP32] WebSocket connected.");
+            reconnectOnConnected(&reconnect, millis());
+            postBootEvent(BOOT_EVT_WS_UP);
+            connectCount++;
+            Serial.printf("[ESP32] WebSocket connected (#%u, %lld ms).\n",
+                          connectCount, (esp_timer_get_time() - connectStartUs) / 1000);
             break;
         case WStype_TEXT:
-            Serial.printf("[ESP32] Received from backend: %s\n", payload);
-            uart.print((char *)payload); // Forward to STM32
-            uart.print("\n");
+            Serial.printf("[ESP32] Received from backend (%u bytes): %.48s\n", length, payload);
+            uartStreamMessage(&uartStream, payload, length); // Forward to STM32
+            break;
+        case WStype_FRAGMENT_TEXT_START:
+            uartStreamBegin(&uartStream);
+            uartStreamChunk(&uartStream, payload, length);
+            break;
+        case WStype_FRAGMENT:
+            uartStreamChunk(&uartStream, payload, length);
+            break;
+        case WStype_FRAGMENT_FIN:
+            uartStreamChunk(&uartStream, payload, length);
+            uartStreamEnd(&uartStream);
+            Serial.printf("[ESP32] Streamed fragmented message from backend (%u bytes).\n", uartStream.bytes);
             break;
         case WStype_DISCONNECTED:
             isWebSocketConnected = false;
-            Serial.println("[ESP32] WebSocket disconnected.");
+            uartStreamAbort(&uartStream); // The rest of a fragmented message will never come
+            reconnectOnDisconnected(&reconnect, millis());
+            postBootEvent(BOOT_EVT_WS_DOWN);
+            Serial.printf("[ESP32] WebSocket disconnected, next attempt in %lu ms.\n",
+                          reconnect.nextAttemptMs - millis());
             break;
         default:
             break;
     }
 }
 
+// Wi-Fi Event Handler (runs in the Wi-Fi event task)
+void onWiFiEvent(WiFiEvent_t event) {
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+            postBootEvent(BOOT_EVT_WIFI_UP);
+            break;
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+            postBootEvent(BOOT_EVT_WIFI_DOWN);
+            break;
+        default:
+            break;
+    }
+}
+
+// SNTP Sync Callback (runs in the lwIP task)
+void onTimeSynced(struct timeval *tv) {
+    postBootEvent(BOOT_EVT_TIME_SYNCED);
+}
+
+void processBootEvents() {
+    BootEvent event;
+
+    while (bootEventTake(&bootEvents, &event)) { // In posting order, repeats included
+        BootState before = boot.state;
+        BootAction action = bootSequenceHandle(&boot, event, millis());
+
+        if (action == BOOT_ACTION_START_TIME_SYNC) {
+            // Time Synchronization for TLS certificate validation
+            configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+        } else if (action == BOOT_ACTION_START_WEBSOCKET) {
+            ReconnectConfig config;
+            reconnectConfigDefaults(&config);
+            uint64_t mac = ESP.getEfuseMac();
+            reconnectInit(&reconnect, &config, (uint32_t)(mac ^ (mac >> 32)), millis());
+            Serial.printf("[ESP32] First connect attempt in %lu ms.\n", reconnect.nextAttemptMs - millis());
+        }
+        if (boot.state != before) {
+            Serial.printf("[ESP32] Boot %s -> %s at %lu ms.\n",
+                          bootStateName(before), bootStateName(boot.state), millis() - boot.bootMs);
+        }
+    }
+}
+
+// Start a Connect Attempt (the policy decides when)
+bool startWebSocket() {
+    if (caBundleData() == NULL) {
+        return false; // Never connect without a trust anchor, a NULL bundle would skip verification
+    }
+    connectStartUs = esp_timer_get_time();
+    webSocket.beginSslWithBundle("your-backend-url", 443, "/steve/websocket/CentralSystemService",
+                                 caBundleData());
+    webSocket.setAuthorization("Basic", OCPP_AUTH_KEY); // Basic Authentication
+    webSocket.setReconnectInterval(RECONNECT_ATTEMPT_WINDOW_MS); // At most one TCP attempt per window
+    webSocket.enableHeartbeat(WS_PING_INTERVAL_MS, WS_PONG_TIMEOUT_MS, WS_PONG_MISSED_LIMIT);
+    return true;
+}
+
+void serviceWebSocket() {
+    switch (reconnectPoll(&reconnect, millis())) {
+        case RECONNECT_BEGIN:
+            Serial.printf("[ESP32] WebSocket connect attempt %u.\n", reconnect.attempts);
+            if (!startWebSocket()) {
+                Serial.println("[ESP32] No CA bundle, refusing to connect.");
+                break;
+            }
+            webSocket.loop();
+            break;
+        case RECONNECT_POLL:
+            webSocket.loop();
+            break;
+        case RECONNECT_ABORT:
+            webSocket.disconnect();
+            Serial.printf("[ESP32] Connect attempt timed out, next in %lu ms.\n", reconnect.nextAttemptMs - millis());
+            break;
+        case RECONNECT_IDLE:
+            break;
+    }
+}
+
 void setup() {
     Serial.begin(115200); // Debug output
-    uart.begin(115200, SERIAL_8N1, UART_RX_PIN, UART_TX_PIN);
+    uart.setTxBufferSize(UART_TX_RING_SIZE);
+    uart.begin(UART_LINK_BAUD, SERIAL_8N1, UART_RX_PIN, UART_TX_PIN);
+    uartStreamInit(&uartStream, uartStreamWrite, uartStreamWait, NULL);
+    bootEventQueueInit(&bootEvents); // Before any callback can post
+    bootSequenceInit(&boot, true, millis());
 
-    // Wi-Fi Setup
-    Serial.println("[ESP32] Connecting to Wi-Fi...");
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(1000);
-        Serial.print(".");
+    // Trust Anchor Setup (PEM is parsed only here, never on reconnect)
+    if (caBundleInit(ca_cert) != 0) {
+        Serial.println("[ESP32] Failed to parse CA certificate, WebSocket disabled.");
+        return; // Error state: Wi-Fi and the WebSocket are never started
     }
-    Serial.println("\n[ESP32] Wi-Fi connected.");
 
-    // Time Synchronization for TLS
-    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-    while (time(nullptr) < 8 * 3600 * 2) {
-        delay(1000);
-        Serial.print(".");
-    }
-    Serial.println("\n[ESP32] Time synchronized for certificate validation.");
+    // Wi-Fi and SNTP Setup (non-blocking, progress arrives through callbacks)
+    Serial.println("[ESP32] Connecting to Wi-Fi...");
+    sntp_set_time_sync_notification_cb(onTimeSynced);
+    WiFi.onEvent(onWiFiEvent);
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
 
-    // WebSocket Setup
-    webSocket.beginSSL("your-backend-url", 443, "/steve/websocket/CentralSystemService");
-    webSocket.setAuthorization("Basic", OCPP_AUTH_KEY); // Basic Authentication
-    webSocket.setCACert(ca_cert);
     webSocket.onEvent(webSocketEvent);
 }
 
 void loop() {
-    webSocket.loop();
+    // Advance Bring-Up
+    processBootEvents();
+
+    if (boot.webSocketStarted) {
+        serviceWebSocket();
+    }
 
     // Forward STM32 messages to backend
     if (uart.available()) {
@@ -84,6 +214,11 @@ void loop() {
         Serial.printf("[ESP32] Forwarding to backend: %s\n", message.c_str());
         if (isWebSocketConnected) {
             webSocket.sendTXT(message);
+            if (message.indexOf("\"BootNotification\"") >= 0 &&
+                bootSequenceNoteBootNotification(&boot, millis())) {
+                Serial.printf("[ESP32] First BootNotification forwarded %u ms after boot.\n",
+                              boot.firstBootNotificationMs);
+            }
         } else {
             Serial.println("[ESP32] WebSocket not connected.");
         }
@@ -0,0 +1,662 @@
+#define _GNU_SOURCE
+#include "hal_shim.h"
+#include "uart_capture_file.h"
+#include "waveform.h"
+#include "../common/stack_watch.h"
+#include "../common/heap_stats.h"
+#include "../common/metering.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHIM_UART_COUNT 2
+#define SHIM_POLL_MS    1
+#define SHIM_CAPTURE_KB 16384 // Default bound of a NATIVE_CAPTURE file
+#define SHIM_RELAY_PIN  GPIO_PIN_5 // PA5, the load draws current while it is high
+
+typedef struct {
+    UART_HandleTypeDef *handle;
+    int rxFd;
+    int txFd;
+    int slaveFd;            // Kept open so the pty master never reports EIO
+    uint8_t *rxBuf;
+    uint16_t rxSize;
+    uint16_t rxCount;
+    bool rxArmed;
+    bool rxBlocking;        // HAL_UART_Receive() in progress, no callback
+    volatile bool txCpltPending;
+    ShimUartTxHook txHook;
+    void *txCtx;
+    ShimUartStats stats;
+    pthread_t thread;
+    bool threadStarted;
+} ShimUart;
+
+typedef struct {
+    ADC_HandleTypeDef *handle;
+    uint16_t *buf;
+    uint32_t length;  // Half-words, both halves of the DMA buffer
+    uint32_t pos;     // Next half-word the DMA writes
+    uint64_t samples; // Pairs converted since the start
+    uint64_t startNs;
+    uint32_t rateHz;  // TIM3 update rate, the conversion trigger
+    bool triggered;   // TIM3 running
+    double loadIrms;
+    Waveform wave;
+} ShimAdc;
+
+GPIO_TypeDef shimGpioA = {0, 0, 0, "A"};
+GPIO_TypeDef shimGpioB = {0, 0, 0, "B"};
+GPIO_TypeDef shimGpioC = {0, 0, 0, "C"};
+GPIO_TypeDef shimGpioF = {0, 0, 0, "F"};
+USART_TypeDef shimUsart1 = {"USART1", 0};
+USART_TypeDef shimUsart2 = {"USART2", 1};
+ADC_TypeDef shimAdc1 = {"ADC1"};
+DMA_Channel_TypeDef shimDma1Channel1 = {"DMA1_Channel1"};
+TIM_TypeDef shimTim1 = {"TIM1", 0, 0, false};
+TIM_TypeDef shimTim3 = {"TIM3", 0, 0, false};
+uint32_t SystemCoreClock = SHIM_CORE_CLOCK_HZ;
+
+static ShimUart uarts[SHIM_UART_COUNT] = {
+    {.rxFd = -1, .txFd = -1, .slaveFd = -1},
+    {.rxFd = -1, .txFd = -1, .slaveFd = -1},
+};
+static pthread_mutex_t irqLock;
+static pthread_once_t initOnce = PTHREAD_ONCE_INIT;
+static uint64_t startNs;
+static volatile uint64_t skippedNs;
+static uint32_t runMs;
+static bool fastMode;
+static bool trace;
+static SysTick_Type sysTick;
+static SCB_Type scb;
+static uint32_t gpioEdges[4][16];
+static ShimAdc adc;
+static UartCaptureFile capture; // USART2 traffic when NATIVE_CAPTURE is set
+static FILE *heapTrace;          // malloc/free trace when NATIVE_HEAP_TRACE is set
+
+/* Present when common/heap_stats.c is linked in */
+extern void heapStatsSetTrace(HeapTraceFn trace, void *ctx) __attribute__((weak));
+
+/* Heap trace ----------------------------------------------------------------*/
+static void writeHeapTrace(void *ctx, char op, const void *ptr, size_t size) {
+    if (op == 'a') {
+        fprintf((FILE *)ctx, "a %p %zu\n", ptr, size);
+    } else {
+        fprintf((FILE *)ctx, "f %p\n", ptr);
+    }
+}
+
+static void openHeapTrace(void) {
+    const char *path = getenv("NATIVE_HEAP_TRACE");
+    if (!path || !heapStatsSetTrace) {
+        return;
+    }
+    heapTrace = fopen(path, "w"); // glibc's own allocations are not wrapped, no recursion
+    if (!heapTrace) {
+        perror("[native] heap trace");
+        return;
+    }
+    heapStatsSetTrace(writeHeapTrace, heapTrace);
+    fprintf(stderr, "[native] tracing malloc/free to %s\n", path);
+}
+
+/* Time ----------------------------------------------------------------------*/
+static uint64_t monotonicNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t firmwareNs(void) {
+    return monotonicNs() - startNs + skippedNs;
+}
+
+static void advanceAdc(void);
+
+static void printSummary(void) {
+    for (int i = 0; i < SHIM_UART_COUNT; i++) {
+        const ShimUartStats *s = &uarts[i].stats;
+        if (uarts[i].handle) {
+            fprintf(stderr, "[native] %s: rx %u bytes (%u overruns), tx %u bytes\n",
+                    uarts[i].handle->Instance->name, s->rxBytes, s->rxOverruns, s->txBytes);
+        }
+    }
+    if (adc.buf) {
+        fprintf(stderr, "[native] ADC1: %llu pairs at %u Hz, %u clipped\n", (unsigned long long)adc.samples,
+                adc.rateHz, adc.wave.clipped);
+    }
+    if (shimTim1.pwm) {
+        fprintf(stderr, "[native] TIM1 CH1: compare %u of %u\n", (unsigned)shimTim1.CCR1, (unsigned)shimTim1.ARR + 1);
+    }
+    fprintf(stderr, "[native] ran %u ms firmware time\n", HAL_GetTick());
+}
+
+static void shimInit(void) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE); // ISRs may call HAL functions
+    pthread_mutex_init(&irqLock, &attr);
+
+    startNs = monotonicNs();
+    runMs = getenv("NATIVE_RUN_MS") ? (uint32_t)strtoul(getenv("NATIVE_RUN_MS"), NULL, 10) : 0;
+    fastMode = getenv("NATIVE_FAST") && atoi(getenv("NATIVE_FAST"));
+    trace = getenv("NATIVE_TRACE") && atoi(getenv("NATIVE_TRACE"));
+    sysTick.LOAD = SHIM_CORE_CLOCK_HZ / 1000 - 1;
+    sysTick.CTRL = 0x7;
+    if (runMs) {
+        atexit(printSummary);
+    }
+    openHeapTrace();
+}
+
+static uint32_t captureClock(void) {
+    return (uint32_t)(firmwareNs() / 1000);
+}
+
+static void closeCapture(void) {
+    uartCaptureFileClose(&capture);
+    fprintf(stderr, "[native] capture: %u records, %u bytes, %u dropped\n", capture.cap.records,
+            capture.cap.head, capture.cap.dropped);
+}
+
+static void openCapture(uint32_t baud) {
+    const char *path = getenv("NATIVE_CAPTURE");
+    const char *kb = getenv("NATIVE_CAPTURE_KB");
+    size_t maxBytes = (kb ? strtoul(kb, NULL, 10) : SHIM_CAPTURE_KB) * 1024;
+
+    if (!path || capture.map) {
+        return;
+    }
+    if (uartCaptureFileCreate(&capture, path, maxBytes, baud, captureClock)) {
+        perror("[native] capture");
+        return;
+    }
+    fprintf(stderr, "[native] capturing USART2 to %s\n", path);
+    atexit(closeCapture);
+}
+
+static void ensureInit(void) {
+    pthread_once(&initOnce, shimInit);
+}
+
+uint64_t shimNowUs(void) {
+    ensureInit();
+    return firmwareNs() / 1000;
+}
+
+HAL_StatusTypeDef HAL_Init(void) {
+    ensureInit();
+    return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void) {
+    ensureInit();
+    return (uint32_t)(firmwareNs() / 1000000);
+}
+
+void HAL_Delay(uint32_t Delay) {
+    ensureInit();
+    if (fastMode) {
+        skippedNs += (uint64_t)Delay * 1000000;
+    } else {
+        struct timespec ts = {Delay / 1000, (long)(Delay % 1000) * 1000000L};
+        while (nanosleep(&ts, &ts) && errno == EINTR) {
+        }
+    }
+    advanceAdc(); // Conversions of the delay, and their DMA interrupts
+    if (runMs && HAL_GetTick() >= runMs) {
+        exit(0);
+    }
+}
+
+void HAL_IncTick(void) {
+    // The tick is derived from the host clock
+}
+
+SysTick_Type *shimSysTick(void) {
+    ensureInit();
+    uint64_t nsInTick = firmwareNs() % 1000000;
+    sysTick.VAL = sysTick.LOAD - (uint32_t)(nsInTick * (SHIM_CORE_CLOCK_HZ / 1000000) / 1000);
+    return &sysTick;
+}
+
+SCB_Type *shimScb(void) {
+    return &scb;
+}
+
+void __disable_irq(void) {
+    ensureInit();
+    pthread_mutex_lock(&irqLock);
+}
+
+void __enable_irq(void) {
+    pthread_mutex_unlock(&irqLock);
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) {
+    (void)IRQn;
+    (void)PreemptPriority;
+    (void)SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {
+    (void)IRQn;
+}
+
+/* GPIO ----------------------------------------------------------------------*/
+static int portIndex(const GPIO_TypeDef *port) {
+    if (port == GPIOA) return 0;
+    if (port == GPIOB) return 1;
+    if (port == GPIOC) return 2;
+    return 3;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init) {
+    if (GPIO_Init->Mode == GPIO_MODE_OUTPUT_PP || GPIO_Init->Mode == GPIO_MODE_OUTPUT_OD) {
+        GPIOx->outputMask |= GPIO_Init->Pin;
+    } else {
+        GPIOx->outputMask &= ~GPIO_Init->Pin;
+    }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    uint32_t level = (GPIOx->outputMask & GPIO_Pin) ? GPIOx->ODR : GPIOx->IDR;
+    return (level & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+    uint32_t before = GPIOx->ODR;
+    GPIOx->ODR = PinState == GPIO_PIN_SET ? (before | GPIO_Pin) : (before & ~(uint32_t)GPIO_Pin);
+
+    uint32_t changed = before ^ GPIOx->ODR;
+    for (int pin = 0; changed && pin < 16; pin++) {
+        if (changed & (1u << pin)) {
+            gpioEdges[portIndex(GPIOx)][pin]++;
+            if (trace) {
+                fprintf(stderr, "[native] %u ms GPIO%s%d -> %d\n", HAL_GetTick(), GPIOx->name, pin,
+                        (GPIOx->ODR >> pin) & 1);
+            }
+        }
+    }
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+    HAL_GPIO_WritePin(GPIOx, GPIO_Pin, (GPIOx->ODR & GPIO_Pin) ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+void shimGpioSetInput(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state) {
+    port->IDR = state == GPIO_PIN_SET ? (port->IDR | pin) : (port->IDR & ~(uint32_t)pin);
+}
+
+uint32_t shimGpioOutputEdges(GPIO_TypeDef *port, uint16_t pin) {
+    for (int i = 0; i < 16; i++) {
+        if (pin & (1u << i)) {
+            return gpioEdges[portIndex(port)][i];
+        }
+    }
+    return 0;
+}
+
+/* UART ----------------------------------------------------------------------*/
+__attribute__((weak)) void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
+    (void)huart;
+}
+
+__attribute__((weak)) void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+    (void)huart;
+}
+
+static ShimUart *uartOf(const USART_TypeDef *instance) {
+    return &uarts[instance->index];
+}
+
+/* RX ISR path: fills the armed receive buffer, overruns otherwise */
+static void deliverRx(ShimUart *uart, uint8_t byte) {
+    pthread_mutex_lock(&irqLock);
+    if (uart->handle && uart->handle->Instance == USART2) {
+        uartCaptureFileAppend(&capture, UART_CAPTURE_TO_STM32, &byte, 1);
+    }
+    uart->stats.rxBytes++;
+    if (!uart->rxArmed) {
+        uart->stats.rxOverruns++;
+    } else {
+        uart->rxBuf[uart->rxCount++] = byte;
+        if (uart->rxCount == uart->rxSize) {
+            uart->rxArmed = false;
+            if (!uart->rxBlocking) {
+                HAL_UART_RxCpltCallback(uart->handle);
+            }
+        }
+    }
+    pthread_mutex_unlock(&irqLock);
+}
+
+/* Emulated interrupt context: one thread per UART */
+static void *uartIsrThread(void *arg) {
+    ShimUart *uart = (ShimUart *)arg;
+    uint8_t buf[64];
+
+    static const char *const isrNames[SHIM_UART_COUNT] = {"usart1 isr", "usart2 isr"};
+    stackWatchAddCurrent(isrNames[uart->handle->Instance->index], STACK_WATCH_HOST_BYTES); // MSP on target
+    for (;;) {
+        if (uart->rxFd >= 0) {
+            struct pollfd pfd = {uart->rxFd, POLLIN, 0};
+            if (poll(&pfd, 1, SHIM_POLL_MS) > 0) {
+                ssize_t n = read(uart->rxFd, buf, sizeof(buf));
+                if (n == 0 && uart->rxFd == STDIN_FILENO) {
+                    uart->rxFd = -1; // stdin closed, keep serving TX completions
+                }
+                for (ssize_t i = 0; i < n; i++) {
+                    deliverRx(uart, buf[i]);
+                }
+            }
+        } else {
+            usleep(SHIM_POLL_MS * 1000);
+        }
+
+        if (uart->txCpltPending) {
+            pthread_mutex_lock(&irqLock);
+            uart->txCpltPending = false;
+            HAL_UART_TxCpltCallback(uart->handle);
+            pthread_mutex_unlock(&irqLock);
+        }
+    }
+    return NULL;
+}
+
+static int openPty(ShimUart *uart, const char *name) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)) {
+        perror("[native] pty");
+        return -1;
+    }
+
+    const char *slaveName = ptsname(master);
+    uart->slaveFd = open(slaveName, O_RDWR | O_NOCTTY);
+    if (uart->slaveFd >= 0) {
+        struct termios tio;
+        tcgetattr(uart->slaveFd, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(uart->slaveFd, TCSANOW, &tio);
+    }
+    fprintf(stderr, "[native] %s <-> %s\n", name, slaveName);
+    uart->rxFd = master;
+    uart->txFd = master;
+    return 0;
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart) {
+    ShimUart *uart = uartOf(huart->Instance);
+    const char *mode = getenv("NATIVE_UART");
+
+    ensureInit();
+    uart->handle = huart;
+    if (huart->Instance == USART2) {
+        openCapture(huart->Init.BaudRate);
+    }
+    if (!uart->txHook && uart->rxFd < 0) {
+        if (mode && !strcmp(mode, "stdio") && huart->Instance == USART2) {
+            uart->rxFd = STDIN_FILENO;
+            uart->txFd = STDOUT_FILENO;
+        } else if (openPty(uart, huart->Instance->name)) {
+            return HAL_ERROR;
+        }
+    }
+    if (!uart->threadStarted) {
+        uart->threadStarted = pthread_create(&uart->thread, NULL, uartIsrThread, uart) == 0;
+    }
+    return uart->threadStarted ? HAL_OK : HAL_ERROR;
+}
+
+static void transmit(ShimUart *uart, const uint8_t *data, uint16_t len) {
+    if (uart->handle->Instance == USART2) {
+        uartCaptureFileAppend(&capture, UART_CAPTURE_TO_ESP32, data, len);
+    }
+    uart->stats.txBytes += len;
+    if (uart->txHook) {
+        uart->txHook(uart->txCtx, data, len);
+        return;
+    }
+    while (len > 0 && uart->txFd >= 0) {
+        ssize_t n = write(uart->txFd, data, len);
+        if (n <= 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break; // Nobody attached to the pty, the bytes are lost like on an open line
+        }
+        data += n;
+        len -= (uint16_t)n;
+    }
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    (void)Timeout;
+    transmit(uartOf(huart->Instance), pData, Size);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size) {
+    ShimUart *uart = uartOf(huart->Instance);
+    if (uart->txCpltPending) {
+        return HAL_BUSY;
+    }
+    transmit(uart, pData, Size);
+    uart->txCpltPending = true; // Completion is signalled from the ISR thread
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) {
+    ShimUart *uart = uartOf(huart->Instance);
+    if (Size == 0) {
+        return HAL_ERROR;
+    }
+    pthread_mutex_lock(&irqLock);
+    uart->rxBuf = pData;
+    uart->rxSize = Size;
+    uart->rxCount = 0;
+    uart->rxBlocking = false;
+    uart->rxArmed = true;
+    pthread_mutex_unlock(&irqLock);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    ShimUart *uart = uartOf(huart->Instance);
+    uint32_t start = HAL_GetTick();
+
+    if (Size == 0) {
+        return HAL_ERROR;
+    }
+    pthread_mutex_lock(&irqLock);
+    uart->rxBuf = pData;
+    uart->rxSize = Size;
+    uart->rxCount = 0;
+    uart->rxBlocking = true;
+    uart->rxArmed = true;
+    pthread_mutex_unlock(&irqLock);
+
+    while (uart->rxArmed) {
+        if (Timeout != HAL_MAX_DELAY && HAL_GetTick() - start >= Timeout) {
+            pthread_mutex_lock(&irqLock);
+            uart->rxArmed = false;
+            uart->rxBlocking = false;
+            pthread_mutex_unlock(&irqLock);
+            return HAL_TIMEOUT;
+        }
+        usleep(100);
+    }
+    uart->rxBlocking = false;
+    return HAL_OK;
+}
+
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart) {
+    (void)huart; // Interrupts are emulated by the ISR thread
+}
+
+void shimUartSetTxHook(USART_TypeDef *instance, ShimUartTxHook hook, void *ctx) {
+    ShimUart *uart = uartOf(instance);
+    uart->txHook = hook;
+    uart->txCtx = ctx;
+}
+
+void shimUartInject(USART_TypeDef *instance, uint8_t byte) {
+    ensureInit();
+    deliverRx(uartOf(instance), byte);
+}
+
+const ShimUartStats *shimUartStats(USART_TypeDef *instance) {
+    return &uartOf(instance)->stats;
+}
+
+/* ADC, DMA and TIM ----------------------------------------------------------*/
+__attribute__((weak)) void HAL_ADC_MspInit(ADC_HandleTypeDef *hadc) {
+    (void)hadc;
+}
+
+__attribute__((weak)) void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc) {
+    (void)hadc;
+}
+
+__attribute__((weak)) void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc) {
+    (void)hadc;
+}
+
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef *hadc) {
+    ensureInit();
+    HAL_ADC_MspInit(hadc);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef *hadc, ADC_ChannelConfTypeDef *sConfig) {
+    (void)hadc;
+    (void)sConfig; // The first channel converts the voltage, the second the current
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADCEx_Calibration_Start(ADC_HandleTypeDef *hadc) {
+    (void)hadc;
+    return HAL_OK;
+}
+
+/* Conversions up to the firmware clock; runs the DMA interrupt path at every half */
+static void advanceAdc(void) {
+    if (!adc.buf || !adc.triggered) {
+        return;
+    }
+    pthread_mutex_lock(&irqLock);
+    uint64_t target = (firmwareNs() - adc.startNs) * adc.rateHz / 1000000000ull;
+    while (adc.buf && adc.samples < target) {
+        uint32_t end = adc.pos < adc.length / 2 ? adc.length / 2 : adc.length;
+        uint64_t n = (end - adc.pos) / 2;
+        n = n < target - adc.samples ? n : target - adc.samples;
+
+        adc.wave.irms = (shimGpioA.ODR & SHIM_RELAY_PIN) ? adc.loadIrms : 0.0;
+        waveformFill(&adc.wave, adc.buf + adc.pos, (uint32_t)n);
+        adc.pos += (uint32_t)n * 2;
+        adc.samples += n;
+        if (adc.pos == adc.length / 2) {
+            HAL_ADC_ConvHalfCpltCallback(adc.handle);
+        } else if (adc.pos == adc.length) {
+            adc.pos = 0;
+            HAL_ADC_ConvCpltCallback(adc.handle);
+        }
+    }
+    pthread_mutex_unlock(&irqLock);
+}
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData, uint32_t Length) {
+    const char *load = getenv("NATIVE_METER");
+    double vrms = 230.0, irms = 16.0, pf = 0.98;
+
+    ensureInit();
+    if (Length < 4 || Length % 4) {
+        return HAL_ERROR; // Two halves of whole V, I pairs
+    }
+    if (load && sscanf(load, "%lf,%lf,%lf", &vrms, &irms, &pf) < 1) {
+        fprintf(stderr, "[native] NATIVE_METER: expected <V>,<A>,<PF>\n");
+    }
+    pthread_mutex_lock(&irqLock);
+    waveformInit(&adc.wave, adc.rateHz, METER_FULL_SCALE_MV / (METER_ADC_MID * 1000.0),
+                 METER_FULL_SCALE_MA / (METER_ADC_MID * 1000.0)); // Calibration of common/metering.h
+    adc.wave.vrms = vrms;
+    adc.wave.phaseDeg = acos(pf < -1.0 ? -1.0 : pf > 1.0 ? 1.0 : pf) * 180.0 / M_PI;
+    adc.wave.noiseCounts = 0.5;
+    adc.loadIrms = irms;
+    adc.handle = hadc;
+    adc.buf = (uint16_t *)pData;
+    adc.length = Length;
+    adc.pos = 0;
+    pthread_mutex_unlock(&irqLock);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef *hadc) {
+    (void)hadc;
+    pthread_mutex_lock(&irqLock);
+    adc.buf = NULL;
+    pthread_mutex_unlock(&irqLock);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma) {
+    (void)hdma;
+    return HAL_OK;
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma) {
+    (void)hdma; // Transfers and their interrupts are emulated by advanceAdc()
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim) {
+    uint64_t divider = (uint64_t)(htim->Init.Prescaler + 1) * (htim->Init.Period + 1);
+    if (htim->Instance == TIM3) {
+        adc.rateHz = (uint32_t)(SystemCoreClock / divider);
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim) {
+    if (htim->Instance == TIM3 && adc.rateHz) {
+        pthread_mutex_lock(&irqLock);
+        adc.wave.sampleHz = adc.rateHz;
+        adc.samples = 0;
+        adc.startNs = firmwareNs();
+        adc.triggered = true;
+        pthread_mutex_unlock(&irqLock);
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef *htim) {
+    htim->Instance->ARR = htim->Init.Period;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *sConfig, uint32_t Channel) {
+    (void)Channel;
+    htim->Instance->CCR1 = sConfig->Pulse;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+    (void)Channel; // The compare is only recorded, no pin toggles
+    htim->Instance->pwm = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, TIM_MasterConfigTypeDef *sMasterConfig) {
+    (void)htim;
+    (void)sMasterConfig; // TIM3 update always triggers ADC1
+    return HAL_OK;
+}
@@ -0,0 +1,60 @@
+#ifndef HAL_SHIM_H
+#define HAL_SHIM_H
+
+#include "stm32f0xx_hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Harness-side controls of the native HAL.
+ *
+ * By default each UART is bridged to a pty (its /dev/pts path is printed at
+ * init), or to stdin/stdout with NATIVE_UART=stdio. Harnesses can instead
+ * install a TX hook and inject RX bytes themselves.
+ *
+ * Environment:
+ *   NATIVE_UART=stdio   use stdin/stdout for USART2 instead of a pty
+ *   NATIVE_RUN_MS=<ms>  exit (with a summary on stderr) after this much firmware time
+ *   NATIVE_FAST=1       HAL_Delay advances the clock without sleeping
+ *   NATIVE_TRACE=1      log GPIO output edges on stderr
+ *   NATIVE_CAPTURE=<f>  record USART2 traffic to a capture file (common/uart_capture.h)
+ *   NATIVE_CAPTURE_KB=n bound of that file, default 16384
+ *   NATIVE_HEAP_TRACE=<f> write every malloc/free to a trace for sim/pool_bench.c
+ *                       (needs -DHEAP_STATS=1 and the malloc wraps, as in the native env)
+ *   NATIVE_METER=<V>,<A>,<PF> line and load seen by ADC1, default 230,16,0.98;
+ *                       the load draws current while PA5 (the relay) is high
+ *
+ * ADC1 converts once per TIM3 update from native/waveform.c, with DMA into
+ * the buffer given to HAL_ADC_Start_DMA(). The conversions and their half-
+ * and full-transfer callbacks catch up with the firmware clock in HAL_Delay().
+ */
+
+typedef void (*ShimUartTxHook)(void *ctx, const uint8_t *data, uint16_t len);
+
+typedef struct {
+    uint32_t rxBytes;
+    uint32_t rxOverruns; // Bytes that arrived while no receive was armed
+    uint32_t txBytes;
+} ShimUartStats;
+
+/* Routes TX of an instance to hook instead of the pty (call before HAL_UART_Init) */
+void shimUartSetTxHook(USART_TypeDef *instance, ShimUartTxHook hook, void *ctx);
+
+/* Delivers one RX byte as if it came off the wire; runs the RX ISR path */
+void shimUartInject(USART_TypeDef *instance, uint8_t byte);
+
+const ShimUartStats *shimUartStats(USART_TypeDef *instance);
+
+void shimGpioSetInput(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state);
+uint32_t shimGpioOutputEdges(GPIO_TypeDef *port, uint16_t pin);
+
+/* Host time the firmware clock is based on (CLOCK_MONOTONIC + skipped delays) */
+uint64_t shimNowUs(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_SHIM_H */
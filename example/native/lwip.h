@@ -0,0 +1,6 @@
+#ifndef LWIP_H
+#define LWIP_H
+
+/* Native build: the host network stack replaces lwIP, nothing to declare */
+
+#endif /* LWIP_H */
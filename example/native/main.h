@@ -0,0 +1,7 @@
+#ifndef MAIN_H
+#define MAIN_H
+
+/* Native build: the CubeMX main.h only pulls in the HAL */
+#include "stm32f0xx_hal.h"
+
+#endif /* MAIN_H */
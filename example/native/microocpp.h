@@ -0,0 +1,38 @@
+#ifndef MICROOCPP_H
+#define MICROOCPP_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Native stand-in for the subset of the MicroOcpp C API used by the STM32
+ * example. It keeps the transaction and connector state the firmware polls
+ * and samples the registered inputs on every mocpp_loop(), but has no
+ * network side. Transactions allocate a record and a request on the heap, so
+ * the heap statistics (common/heap_stats.h) see some traffic.
+ *
+ * The real library is not linked: its sources are not part of this tree, and
+ * this build fetches no dependencies. A profile of the native build therefore
+ * covers stm32/main.c and the shim only, never MicroOcpp.
+ */
+
+void mocpp_initialize(const char *backendUrl, const char *chargeBoxId,
+                      const char *chargePointModel, const char *chargePointVendor);
+void mocpp_loop(void);
+
+void setEnergyMeterInput(float (*input)(void));
+void setConnectorPluggedInput(bool (*input)(void));
+void setSmartChargingCurrentOutput(void (*output)(float));
+
+void beginTransaction(const char *idTag);
+void endTransaction(void);
+bool ocppPermitsCharge(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MICROOCPP_H */
@@ -0,0 +1,91 @@
+#include "microocpp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRANSACTION_RECORD_SIZE 184 // Assumed, only gives the heap statistics a realistic block
+
+static float (*energyInput)(void);
+static bool (*pluggedInput)(void);
+static void (*currentOutput)(float);
+static bool transactionActive;
+static bool plugged;
+static char activeIdTag[21];
+static void *transactionRecord; // The library's per-transaction object, freed at the end
+static char *pendingRequest;    // StartTransaction/StopTransaction until the next loop "sends" it
+static unsigned long loops;
+static unsigned long transactions;
+static float lastEnergy;
+
+static void printSummary(void) {
+    fprintf(stderr, "[native] mocpp stand-in: %lu loops, %lu transactions, last meter %.1f Wh\n",
+            loops, transactions, lastEnergy);
+}
+
+void mocpp_initialize(const char *backendUrl, const char *chargeBoxId,
+                      const char *chargePointModel, const char *chargePointVendor) {
+    fprintf(stderr, "[native] mocpp stand-in: %s as %s (%s, %s)\n", backendUrl, chargeBoxId,
+            chargePointModel, chargePointVendor);
+    if (getenv("NATIVE_RUN_MS")) {
+        atexit(printSummary);
+    }
+}
+
+static void queueRequest(const char *action) {
+    free(pendingRequest);
+    pendingRequest = malloc(strlen(action) + 160);
+    if (pendingRequest) {
+        sprintf(pendingRequest, "[2,\"%lu\",\"%s\",{\"connectorId\":1,\"idTag\":\"%s\",\"meter\":%.0f}]",
+                transactions, action, activeIdTag, lastEnergy);
+    }
+}
+
+void mocpp_loop(void) {
+    loops++;
+    free(pendingRequest);
+    pendingRequest = NULL;
+    if (pluggedInput) {
+        plugged = pluggedInput();
+    }
+    if (energyInput) {
+        lastEnergy = energyInput();
+    }
+}
+
+void setEnergyMeterInput(float (*input)(void)) {
+    energyInput = input;
+}
+
+void setConnectorPluggedInput(bool (*input)(void)) {
+    pluggedInput = input;
+}
+
+void setSmartChargingCurrentOutput(void (*output)(float)) {
+    currentOutput = output;
+}
+
+void beginTransaction(const char *idTag) {
+    if (transactionActive) {
+        return;
+    }
+    strncpy(activeIdTag, idTag, sizeof(activeIdTag) - 1);
+    transactionActive = true;
+    transactions++;
+    transactionRecord = calloc(1, TRANSACTION_RECORD_SIZE);
+    queueRequest("StartTransaction");
+}
+
+void endTransaction(void) {
+    if (transactionActive) {
+        queueRequest("StopTransaction");
+    }
+    transactionActive = false;
+    activeIdTag[0] = '\0';
+    free(transactionRecord);
+    transactionRecord = NULL;
+}
+
+bool ocppPermitsCharge(void) {
+    return transactionActive && (plugged || !pluggedInput);
+}
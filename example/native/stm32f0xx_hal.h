@@ -0,0 +1,352 @@
+#ifndef STM32F0XX_HAL_H
+#define STM32F0XX_HAL_H
+
+/*
+ * Native (Linux) stand-in for the STM32Cube HAL.
+ *
+ * Implements the subset of HAL_UART_*, HAL_GPIO_*, HAL_ADC_*, HAL_TIM_*,
+ * HAL_GetTick/HAL_Delay and SysTick used by the example firmware on top of
+ * ptys, simulated GPIO ports, a synthetic waveform and CLOCK_MONOTONIC, so the
+ * firmware sources build and run unmodified on a workstation. See hal_shim.h for the hooks used by host-side harnesses.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Status and Pin Types ------------------------------------------------------*/
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0U,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef enum {
+    DISABLE = 0U,
+    ENABLE = !DISABLE
+} FunctionalState;
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+/* GPIO ----------------------------------------------------------------------*/
+typedef struct {
+    volatile uint32_t IDR; // Input levels, driven by the harness
+    volatile uint32_t ODR; // Output levels, driven by the firmware
+    uint32_t outputMask;   // Pins configured as outputs
+    const char *name;
+} GPIO_TypeDef;
+
+typedef struct {
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+extern GPIO_TypeDef shimGpioA, shimGpioB, shimGpioC, shimGpioF;
+#define GPIOA (&shimGpioA)
+#define GPIOB (&shimGpioB)
+#define GPIOC (&shimGpioC)
+#define GPIOF (&shimGpioF)
+
+#define GPIO_PIN_0   ((uint16_t)0x0001)
+#define GPIO_PIN_1   ((uint16_t)0x0002)
+#define GPIO_PIN_2   ((uint16_t)0x0004)
+#define GPIO_PIN_3   ((uint16_t)0x0008)
+#define GPIO_PIN_4   ((uint16_t)0x0010)
+#define GPIO_PIN_5   ((uint16_t)0x0020)
+#define GPIO_PIN_6   ((uint16_t)0x0040)
+#define GPIO_PIN_7   ((uint16_t)0x0080)
+#define GPIO_PIN_8   ((uint16_t)0x0100)
+#define GPIO_PIN_9   ((uint16_t)0x0200)
+#define GPIO_PIN_10  ((uint16_t)0x0400)
+#define GPIO_PIN_11  ((uint16_t)0x0800)
+#define GPIO_PIN_12  ((uint16_t)0x1000)
+#define GPIO_PIN_13  ((uint16_t)0x2000)
+#define GPIO_PIN_14  ((uint16_t)0x4000)
+#define GPIO_PIN_15  ((uint16_t)0x8000)
+
+#define GPIO_MODE_INPUT      0x00000000U
+#define GPIO_MODE_OUTPUT_PP  0x00000001U
+#define GPIO_MODE_OUTPUT_OD  0x00000011U
+#define GPIO_MODE_AF_PP      0x00000002U
+#define GPIO_MODE_ANALOG     0x00000003U
+#define GPIO_MODE_IT_FALLING 0x10210000U
+#define GPIO_MODE_IT_RISING  0x10110000U
+#define GPIO_NOPULL          0x00000000U
+#define GPIO_PULLUP          0x00000001U
+#define GPIO_PULLDOWN        0x00000002U
+#define GPIO_SPEED_FREQ_LOW  0x00000000U
+#define GPIO_SPEED_FREQ_HIGH 0x00000003U
+#define GPIO_AF1_USART1      ((uint8_t)0x01U)
+#define GPIO_AF1_USART2      ((uint8_t)0x01U)
+#define GPIO_AF2_TIM1        ((uint8_t)0x02U)
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+/* UART ----------------------------------------------------------------------*/
+typedef struct {
+    const char *name;
+    int index;
+} USART_TypeDef;
+
+extern USART_TypeDef shimUsart1, shimUsart2;
+#define USART1 (&shimUsart1)
+#define USART2 (&shimUsart2)
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+    uint32_t OneBitSampling;
+} UART_InitTypeDef;
+
+typedef struct {
+    uint32_t AdvFeatureInit;
+} UART_AdvFeatureInitTypeDef;
+
+typedef struct __UART_HandleTypeDef {
+    USART_TypeDef *Instance;
+    UART_InitTypeDef Init;
+    UART_AdvFeatureInitTypeDef AdvancedInit;
+} UART_HandleTypeDef;
+
+#define UART_WORDLENGTH_8B          0x00000000U
+#define UART_STOPBITS_1             0x00000000U
+#define UART_PARITY_NONE            0x00000000U
+#define UART_MODE_TX_RX             0x0000000CU
+#define UART_HWCONTROL_NONE         0x00000000U
+#define UART_OVERSAMPLING_16        0x00000000U
+#define UART_ONE_BIT_SAMPLE_DISABLE 0x00000000U
+#define UART_ADVFEATURE_NO_INIT     0x00000000U
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_IT(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_IT(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+
+/* ADC, DMA and TIM ----------------------------------------------------------*/
+typedef struct {
+    const char *name;
+} ADC_TypeDef, DMA_Channel_TypeDef;
+
+typedef struct {
+    const char *name;
+    volatile uint32_t ARR;
+    volatile uint32_t CCR1; // Only channel 1 is modelled
+    bool pwm;               // Channel 1 output running
+} TIM_TypeDef;
+
+extern ADC_TypeDef shimAdc1;
+extern DMA_Channel_TypeDef shimDma1Channel1;
+extern TIM_TypeDef shimTim1, shimTim3;
+#define ADC1          (&shimAdc1)
+#define DMA1_Channel1 (&shimDma1Channel1)
+#define TIM1          (&shimTim1)
+#define TIM3          (&shimTim3)
+
+typedef struct {
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+} DMA_InitTypeDef;
+
+typedef struct {
+    DMA_Channel_TypeDef *Instance;
+    DMA_InitTypeDef Init;
+    void *Parent;
+} DMA_HandleTypeDef;
+
+typedef struct {
+    uint32_t ClockPrescaler;
+    uint32_t Resolution;
+    uint32_t DataAlign;
+    uint32_t ScanConvMode;
+    uint32_t EOCSelection;
+    uint32_t LowPowerAutoWait;
+    uint32_t LowPowerAutoPowerOff;
+    uint32_t ContinuousConvMode;
+    uint32_t DiscontinuousConvMode;
+    uint32_t ExternalTrigConv;
+    uint32_t ExternalTrigConvEdge;
+    uint32_t DMAContinuousRequests;
+    uint32_t Overrun;
+} ADC_InitTypeDef;
+
+typedef struct {
+    uint32_t Channel;
+    uint32_t Rank;
+    uint32_t SamplingTime;
+} ADC_ChannelConfTypeDef;
+
+typedef struct __ADC_HandleTypeDef {
+    ADC_TypeDef *Instance;
+    ADC_InitTypeDef Init;
+    DMA_HandleTypeDef *DMA_Handle;
+} ADC_HandleTypeDef;
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t CounterMode;
+    uint32_t Period;
+    uint32_t ClockDivision;
+    uint32_t RepetitionCounter;
+    uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+    TIM_TypeDef *Instance;
+    TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+typedef struct {
+    uint32_t MasterOutputTrigger;
+    uint32_t MasterSlaveMode;
+} TIM_MasterConfigTypeDef;
+
+typedef struct {
+    uint32_t OCMode;
+    uint32_t Pulse;
+    uint32_t OCPolarity;
+    uint32_t OCNPolarity;
+    uint32_t OCFastMode;
+    uint32_t OCIdleState;
+    uint32_t OCNIdleState;
+} TIM_OC_InitTypeDef;
+
+#define __HAL_TIM_SET_COMPARE(handle, channel, compare) ((void)(channel), (handle)->Instance->CCR1 = (compare))
+
+#define __HAL_LINKDMA(handle, field, dma) \
+    do {                                 \
+        (handle)->field = &(dma);        \
+        (dma).Parent = (handle);         \
+    } while (0)
+
+#define ADC_CLOCK_ASYNC_DIV1            0x00000000U
+#define ADC_RESOLUTION_12B              0x00000000U
+#define ADC_DATAALIGN_RIGHT             0x00000000U
+#define ADC_SCAN_DIRECTION_FORWARD      0x00000001U
+#define ADC_EOC_SEQ_CONV                0x00000008U
+#define ADC_EXTERNALTRIGCONV_T3_TRGO    0x000000C0U
+#define ADC_EXTERNALTRIGCONVEDGE_RISING 0x00000400U
+#define ADC_OVR_DATA_OVERWRITTEN        0x00001000U
+#define ADC_CHANNEL_0                   0x00000000U
+#define ADC_CHANNEL_1                   0x04000001U
+#define ADC_RANK_CHANNEL_NUMBER         0x00001000U
+#define ADC_SAMPLETIME_7CYCLES_5        0x00000001U
+#define DMA_PERIPH_TO_MEMORY            0x00000000U
+#define DMA_PINC_DISABLE                0x00000000U
+#define DMA_MINC_ENABLE                 0x00000080U
+#define DMA_PDATAALIGN_HALFWORD         0x00000100U
+#define DMA_MDATAALIGN_HALFWORD         0x00000400U
+#define DMA_CIRCULAR                    0x00000020U
+#define DMA_PRIORITY_HIGH               0x00002000U
+#define TIM_COUNTERMODE_UP              0x00000000U
+#define TIM_CLOCKDIVISION_DIV1          0x00000000U
+#define TIM_AUTORELOAD_PRELOAD_DISABLE  0x00000000U
+#define TIM_TRGO_UPDATE                 0x00000020U
+#define TIM_MASTERSLAVEMODE_DISABLE     0x00000000U
+#define TIM_CHANNEL_1                   0x00000000U
+#define TIM_OCMODE_PWM1                 0x00000060U
+#define TIM_OCPOLARITY_HIGH             0x00000000U
+#define TIM_OCFAST_DISABLE              0x00000000U
+
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef *hadc, ADC_ChannelConfTypeDef *sConfig);
+HAL_StatusTypeDef HAL_ADCEx_Calibration_Start(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData, uint32_t Length);
+HAL_StatusTypeDef HAL_ADC_Stop_DMA(ADC_HandleTypeDef *hadc);
+void HAL_ADC_MspInit(ADC_HandleTypeDef *hadc);
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc);
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, TIM_MasterConfigTypeDef *sMasterConfig);
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *sConfig, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+
+/* Core, Tick and SysTick ----------------------------------------------------*/
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t LOAD;
+    volatile uint32_t VAL;
+    volatile uint32_t CALIB;
+} SysTick_Type;
+
+SysTick_Type *shimSysTick(void);
+#define SysTick (shimSysTick()) // VAL is refreshed from the host clock on every access
+
+typedef struct {
+    volatile uint32_t CPUID;
+    volatile uint32_t ICSR;
+} SCB_Type;
+
+SCB_Type *shimScb(void);
+#define SCB (shimScb()) // ICSR never has a SysTick pending, the host tick does not wait for interrupts
+#define SCB_ICSR_PENDSTSET_Msk (1UL << 26)
+
+#define SHIM_CORE_CLOCK_HZ 48000000U // Nominal F030 HCLK for SysTick emulation
+extern uint32_t SystemCoreClock;
+
+HAL_StatusTypeDef HAL_Init(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+void HAL_IncTick(void);
+
+void __disable_irq(void);
+void __enable_irq(void);
+
+typedef int IRQn_Type;
+#define USART1_IRQn        27
+#define USART2_IRQn        28
+#define DMA1_Channel1_IRQn 9
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+
+/* Clock enables are no-ops on the host */
+#define __HAL_RCC_GPIOA_CLK_ENABLE()  do { } while (0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()  do { } while (0)
+#define __HAL_RCC_GPIOC_CLK_ENABLE()  do { } while (0)
+#define __HAL_RCC_GPIOF_CLK_ENABLE()  do { } while (0)
+#define __HAL_RCC_USART1_CLK_ENABLE() do { } while (0)
+#define __HAL_RCC_USART2_CLK_ENABLE() do { } while (0)
+#define __HAL_RCC_PWR_CLK_ENABLE()    do { } while (0)
+#define __HAL_RCC_ADC1_CLK_ENABLE()   do { } while (0)
+#define __HAL_RCC_DMA1_CLK_ENABLE()   do { } while (0)
+#define __HAL_RCC_TIM1_CLK_ENABLE()   do { } while (0)
+#define __HAL_RCC_TIM3_CLK_ENABLE()   do { } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STM32F0XX_HAL_H */
@@ -0,0 +1,131 @@
+#define _GNU_SOURCE
+#include "uart_capture_file.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HEX_TAG "[UCAP] "
+
+static void syncHeader(UartCaptureFile *file) {
+    UartCaptureHeader header;
+    uartCaptureGetHeader(&file->cap, &header);
+    uartCaptureEncodeHeader(&header, file->map);
+}
+
+int uartCaptureFileCreate(UartCaptureFile *file, const char *path, size_t maxBytes, uint32_t baud,
+                          UartCaptureClockFn clock) {
+    memset(file, 0, sizeof(*file));
+    file->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file->fd < 0) {
+        return -1;
+    }
+    file->mapSize = UART_CAPTURE_HEADER_SIZE + maxBytes;
+    if (ftruncate(file->fd, (off_t)file->mapSize)) { // Sparse until written
+        close(file->fd);
+        return -1;
+    }
+    file->map = mmap(NULL, file->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+    if (file->map == MAP_FAILED) {
+        close(file->fd);
+        file->map = NULL;
+        return -1;
+    }
+    uartCaptureInit(&file->cap, file->map + UART_CAPTURE_HEADER_SIZE, (uint32_t)maxBytes, false, baud, clock);
+    syncHeader(file);
+    return 0;
+}
+
+void uartCaptureFileAppend(UartCaptureFile *file, UartCaptureDir dir, const uint8_t *data, size_t len) {
+    if (!file->map) {
+        return;
+    }
+    uartCaptureAppend(&file->cap, dir, data, len);
+    syncHeader(file); // Concurrent appenders write the same final values
+}
+
+void uartCaptureFileClose(UartCaptureFile *file) {
+    if (!file->map) {
+        return;
+    }
+    file->cap.paused = true;
+    syncHeader(file);
+    size_t used = UART_CAPTURE_HEADER_SIZE + file->cap.head;
+    msync(file->map, file->mapSize, MS_SYNC);
+    munmap(file->map, file->mapSize);
+    if (ftruncate(file->fd, (off_t)used)) {
+        perror("[capture] truncate");
+    }
+    close(file->fd);
+    file->map = NULL;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Collects the bytes of all "[UCAP] <hex>" lines, wherever they start in a line */
+static size_t decodeHexLog(uint8_t *data, size_t size) {
+    size_t out = 0;
+    const char *text = (const char *)data;
+    const char *end = text + size;
+
+    for (const char *p = text; p < end;) {
+        const char *tag = memmem(p, (size_t)(end - p), HEX_TAG, strlen(HEX_TAG));
+        if (!tag) {
+            break;
+        }
+        p = tag + strlen(HEX_TAG);
+        while (p + 1 < end && hexValue(p[0]) >= 0 && hexValue(p[1]) >= 0) {
+            data[out++] = (uint8_t)(hexValue(p[0]) << 4 | hexValue(p[1])); // out < read position
+            p += 2;
+        }
+    }
+    return out;
+}
+
+int uartCaptureLoad(const char *path, UartCaptureImage *image) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    memset(image, 0, sizeof(*image));
+    if (fd < 0 || fstat(fd, &st)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    image->data = malloc(st.st_size ? (size_t)st.st_size : 1);
+    size_t size = image->data ? (size_t)read(fd, image->data, (size_t)st.st_size) : 0;
+    close(fd);
+    if (!image->data || size != (size_t)st.st_size) {
+        uartCaptureImageFree(image);
+        return -1;
+    }
+
+    if (size < 4 || memcmp(image->data, UART_CAPTURE_MAGIC, 4)) {
+        size = decodeHexLog(image->data, size);
+    }
+    if (!uartCaptureDecodeHeader(image->data, size, &image->header)) {
+        uartCaptureImageFree(image);
+        return -1;
+    }
+    image->area = image->data + image->header.headerSize;
+    image->areaBytes = (uint32_t)(size - image->header.headerSize);
+    if (image->header.bytes < image->areaBytes) {
+        image->areaBytes = image->header.bytes; // Ignore anything after the recorded area
+    }
+    return 0;
+}
+
+void uartCaptureImageFree(UartCaptureImage *image) {
+    free(image->data);
+    memset(image, 0, sizeof(*image));
+}
@@ -0,0 +1,46 @@
+#ifndef UART_CAPTURE_FILE_H
+#define UART_CAPTURE_FILE_H
+
+#include "../common/uart_capture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Host backends of the UART capture.
+ *
+ * The recorder maps the capture file and appends records in place, keeping
+ * the header current, so a crashed run still leaves a readable capture. The
+ * loader accepts such a file or any log containing the "[UCAP]" hex lines of
+ * a firmware dump (uartCaptureDumpHex).
+ */
+
+typedef struct {
+    UartCapture cap;
+    int fd;
+    uint8_t *map;
+    size_t mapSize;
+} UartCaptureFile;
+
+typedef struct {
+    UartCaptureHeader header;
+    uint8_t *data;       // Whole image, header included
+    const uint8_t *area; // Record area
+    uint32_t areaBytes;
+} UartCaptureImage;
+
+/* maxBytes bounds the file; records beyond it are counted as dropped */
+int uartCaptureFileCreate(UartCaptureFile *file, const char *path, size_t maxBytes, uint32_t baud,
+                          UartCaptureClockFn clock);
+void uartCaptureFileAppend(UartCaptureFile *file, UartCaptureDir dir, const uint8_t *data, size_t len);
+void uartCaptureFileClose(UartCaptureFile *file); // Truncates the file to what was recorded
+
+int uartCaptureLoad(const char *path, UartCaptureImage *image);
+void uartCaptureImageFree(UartCaptureImage *image);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UART_CAPTURE_FILE_H */
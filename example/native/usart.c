@@ -0,0 +1,4 @@
+#include "main.h"
+
+/* Peripheral handles that CubeMX generates into usart.c on the target */
+UART_HandleTypeDef huart2;
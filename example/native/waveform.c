@@ -0,0 +1,68 @@
+#include "waveform.h"
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define ADC_MAX 4095
+
+void waveformInit(Waveform *w, uint32_t sampleHz, double voltsPerCount, double ampsPerCount) {
+    *w = (Waveform){0};
+    w->vrms = 230.0;
+    w->freqHz = 50.0;
+    w->biasV = 2048.0;
+    w->biasI = 2048.0;
+    w->skewUs = 1.5; // 12.5 + 7.5 ADC clocks at 14 MHz
+    w->voltsPerCount = voltsPerCount;
+    w->ampsPerCount = ampsPerCount;
+    w->sampleHz = sampleHz;
+    w->rng = 0x2545F491u;
+}
+
+/* Uniform in (0, 1), xorshift32 */
+static double uniform(Waveform *w) {
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 17;
+    w->rng ^= w->rng << 5;
+    return ((double)w->rng + 1.0) / 4294967297.0;
+}
+
+static double gaussian(Waveform *w) {
+    return sqrt(-2.0 * log(uniform(w))) * cos(2.0 * M_PI * uniform(w));
+}
+
+static uint16_t quantize(Waveform *w, double counts) {
+    long q = lround(counts);
+    if (q <= 0 || q >= ADC_MAX) {
+        w->clipped++;
+        q = q <= 0 ? 0 : ADC_MAX;
+    }
+    return (uint16_t)q;
+}
+
+void waveformFill(Waveform *w, uint16_t *pairs, uint32_t count) {
+    double omega = 2.0 * M_PI * w->freqHz;
+    double phi = w->phaseDeg * M_PI / 180.0;
+
+    for (uint32_t k = 0; k < count; k++, w->n++) {
+        double t = (double)w->n / w->sampleHz;
+        double ti = t + w->skewUs * 1e-6;
+        double v = M_SQRT2 * w->vrms * sin(omega * t);
+        double i = M_SQRT2 * w->irms * (sin(omega * ti - phi) + w->harmonic3 * sin(3.0 * omega * ti - 3.0 * phi));
+        double noiseV = w->noiseCounts > 0.0 ? w->noiseCounts * gaussian(w) : 0.0;
+        double noiseI = w->noiseCounts > 0.0 ? w->noiseCounts * gaussian(w) : 0.0;
+
+        pairs[2 * k] = quantize(w, w->biasV + v / w->voltsPerCount + noiseV);
+        pairs[2 * k + 1] = quantize(w, w->biasI + i / w->ampsPerCount + noiseI);
+    }
+}
+
+double waveformIrms(const Waveform *w) {
+    return w->irms * sqrt(1.0 + w->harmonic3 * w->harmonic3);
+}
+
+double waveformPower(const Waveform *w) {
+    return w->vrms * w->irms * cos(w->phaseDeg * M_PI / 180.0);
+}
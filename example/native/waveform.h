@@ -0,0 +1,55 @@
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Synthetic line voltage and load current as 12-bit ADC samples.
+ *
+ * Feeds the ADC of the native HAL and the accuracy runs of sim/meter_sim.c.
+ * The voltage is a pure sine; the current lags it by phaseDeg and can carry
+ * a third harmonic. Both channels get Gaussian noise, are quantized around
+ * their bias and clip at the ends of the range like the real converter. The
+ * current is sampled skewUs after the voltage, as the ADC converts the
+ * channels one after the other.
+ *
+ * The true values follow from the parameters: the third harmonic adds to
+ * Irms but, against a sine voltage, not to the real power.
+ */
+
+typedef struct {
+    double vrms;        // Fundamental
+    double irms;
+    double phaseDeg;    // Current behind voltage
+    double freqHz;
+    double harmonic3;   // Third harmonic of the current, fraction of irms
+    double noiseCounts; // rms, both channels
+    double biasV;       // ADC counts at 0 V and 0 A
+    double biasI;
+    double skewUs;
+    double voltsPerCount;
+    double ampsPerCount;
+    uint32_t sampleHz;
+    uint64_t n; // Samples generated
+    uint32_t rng;
+    uint32_t clipped;
+} Waveform;
+
+/* 230 V 50 Hz, no load, mid-scale bias, no noise */
+void waveformInit(Waveform *w, uint32_t sampleHz, double voltsPerCount, double ampsPerCount);
+
+/* count V, I pairs, V first, as the ADC's DMA writes them */
+void waveformFill(Waveform *w, uint16_t *pairs, uint32_t count);
+
+double waveformIrms(const Waveform *w);
+double waveformPower(const Waveform *w); // W
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WAVEFORM_H */
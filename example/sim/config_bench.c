@@ -0,0 +1,247 @@
+/*
+ * RAM and lookup cost of the split configuration registry (common/ocpp_config.c)
+ * against an all-RAM registry model.
+ *
+ * The model is what an in-memory store such as MicroOcpp's
+ * FilesystemOpt::Use_InMemory keeps: one heap entry per key holding the name,
+ * the type and the value, with the name and string values copied into their
+ * own heap blocks, found by a linear strcmp() scan. Its RAM is computed for a
+ * 32-bit target with newlib-nano chunks (4-byte header, 8-byte rounding, 16
+ * bytes minimum). The split registry's RAM is sizeof(OcppConfigValues), which
+ * is the same on the host and the target as it is packed.
+ *
+ * Lookup times are host nanoseconds per call; compare the two columns, not
+ * the absolute numbers. The run also checks the GetConfiguration and
+ * ChangeConfiguration answers and exits with 1 if one is wrong.
+ *
+ * Usage: config_bench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ocpp_config.h"
+
+#define TARGET_POINTER   4
+#define TARGET_KEY_BYTES 16 // OcppConfigKey with 32-bit pointers
+#define MODEL_ENTRY      16 // vtable, name*, value* or int, type and flags
+#define UNKNOWN_KEYS     4
+
+typedef struct {
+    char *name;
+    uint8_t type;
+    uint8_t readonly;
+    int32_t intValue;
+    char *stringValue;
+} ModelEntry;
+
+static ModelEntry model[OCPP_CONFIG_KEY_COUNT];
+
+static uint32_t chunk(uint32_t bytes) {
+    uint32_t size = (bytes + 4 + 7) & ~7u;
+    return size < 16 ? 16 : size;
+}
+
+static uint32_t buildModel(void) {
+    uint32_t ram = 0;
+    for (uint32_t id = 0; id < OCPP_CONFIG_KEY_COUNT; id++) {
+        const OcppConfigKey *key = &ocppConfigKeys[id];
+        ModelEntry *entry = &model[id];
+        entry->name = strdup(key->name);
+        entry->type = key->type;
+        entry->readonly = key->flags & OCPP_CONFIG_READONLY;
+        entry->intValue = key->defaultInt;
+        ram += chunk(MODEL_ENTRY) + chunk((uint32_t)strlen(key->name) + 1);
+        if (key->type == OCPP_CONFIG_STRING) {
+            uint32_t bytes = key->bytes ? key->bytes : (uint32_t)strlen(key->defaultString) + 1;
+            entry->stringValue = calloc(1, bytes);
+            strcpy(entry->stringValue, key->defaultString);
+            ram += chunk(bytes);
+        }
+    }
+    return ram;
+}
+
+static int modelFind(const char *name) {
+    for (int i = 0; i < OCPP_CONFIG_KEY_COUNT; i++) {
+        if (!strcmp(model[i].name, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static bool modelChange(const char *name, const char *value) {
+    int i = modelFind(name);
+    if (i < 0 || model[i].readonly) {
+        return false;
+    }
+    if (model[i].type == OCPP_CONFIG_STRING) {
+        strcpy(model[i].stringValue, value);
+    } else {
+        model[i].intValue = (int32_t)strtol(value, NULL, 10);
+    }
+    return true;
+}
+
+static uint64_t monotonicNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Counts the bytes of a reply, and keeps the first 512 of them for the checks */
+typedef struct {
+    char text[512];
+    size_t len;
+} Sink;
+
+static void sinkWrite(void *ctx, const char *data, size_t len) {
+    Sink *sink = ctx;
+    for (size_t i = 0; i < len && sink->len + i < sizeof(sink->text) - 1; i++) {
+        sink->text[sink->len + i] = data[i];
+    }
+    sink->len += len;
+    sink->text[sink->len < sizeof(sink->text) ? sink->len : sizeof(sink->text) - 1] = '\0';
+}
+
+static volatile int sinkHole; // Keeps the timed calls from being optimized away
+
+static int failures;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static void checkAnswers(void) {
+    Sink sink = {{0}, 0};
+
+    ocppConfigGet("{\"key\":[\"HeartbeatInterval\",\"NoSuchKey\",\"NumberOfConnectors\"]}", sinkWrite, &sink);
+    check(!strcmp(sink.text, "{\"configurationKey\":[{\"key\":\"HeartbeatInterval\",\"readonly\":false,"
+                             "\"value\":\"86400\"},{\"key\":\"NumberOfConnectors\",\"readonly\":true,"
+                             "\"value\":\"1\"}],\"unknownKey\":[\"NoSuchKey\"]}"),
+          "GetConfiguration with keys");
+    check(ocppConfigChange("{\"key\":\"HeartbeatInterval\",\"value\":\"300\"}") == OCPP_CONFIG_ACCEPTED &&
+              OCPP_CONFIG_GET_INT(HeartbeatInterval) == 300,
+          "ChangeConfiguration of an int");
+    check(ocppConfigChange("{\"value\":\"FALSE\",\"key\":\"LocalAuthorizeOffline\"}") == OCPP_CONFIG_ACCEPTED &&
+              !OCPP_CONFIG_GET_BOOL(LocalAuthorizeOffline),
+          "ChangeConfiguration of a bool");
+    check(ocppConfigChange("{\"key\":\"MeterValuesSampledData\",\"value\":\"Power.Active.Import\"}") ==
+                  OCPP_CONFIG_ACCEPTED &&
+              !strcmp(OCPP_CONFIG_GET_STRING(MeterValuesSampledData), "Power.Active.Import"),
+          "ChangeConfiguration of a string");
+    check(ocppConfigChange("{\"key\":\"NumberOfConnectors\",\"value\":\"2\"}") == OCPP_CONFIG_REJECTED,
+          "read-only key");
+    check(ocppConfigChange("{\"key\":\"HeartbeatInterval\",\"value\":\"-5\"}") == OCPP_CONFIG_REJECTED,
+          "negative interval");
+    check(ocppConfigChange("{\"key\":\"ConnectorPhaseRotation\",\"value\":\"0.RST 1.RST 2.RST 3.RST\"}") ==
+              OCPP_CONFIG_REJECTED,
+          "string longer than its RAM");
+    check(ocppConfigChange("{\"key\":\"WebSocketPingInterval\",\"value\":\"30\"}") == OCPP_CONFIG_REBOOT_REQUIRED,
+          "reboot key");
+    check(ocppConfigChange("{\"key\":\"Heartbeat\",\"value\":\"30\"}") == OCPP_CONFIG_NOT_SUPPORTED,
+          "unknown key");
+    sink.len = 0;
+    ocppConfigGet("{\"key\":[]}", sinkWrite, &sink);
+    check(strstr(sink.text, "\"AllowOfflineTxForUnknownId\"") != NULL, "GetConfiguration of every key");
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 200000;
+    static const char *unknown[UNKNOWN_KEYS] = {"Heartbeat", "ZZZ", "AAA", "MeterValuesSampledDataMaxLength"};
+    uint32_t nameBytes = 0, defaultBytes = 0, readonly = 0;
+
+    if (!ocppConfigInit()) {
+        fprintf(stderr, "config_bench: OCPP_CONFIG_KEYS is not sorted by name\n");
+        return 1;
+    }
+    for (uint32_t id = 0; id < OCPP_CONFIG_KEY_COUNT; id++) {
+        const OcppConfigKey *key = &ocppConfigKeys[id];
+        nameBytes += (uint32_t)strlen(key->name) + 1;
+        readonly += key->flags & OCPP_CONFIG_READONLY;
+        if (key->defaultString) {
+            defaultBytes += (uint32_t)strlen(key->defaultString) + 1;
+        }
+    }
+    uint32_t modelRam = buildModel() + OCPP_CONFIG_KEY_COUNT * TARGET_POINTER; // Plus the list of entries
+    uint32_t splitRam = (uint32_t)sizeof(OcppConfigValues);
+
+    printf("keys       %u (%u read-only)\n", (unsigned)OCPP_CONFIG_KEY_COUNT, (unsigned)readonly);
+    printf("ram        all-RAM model %u B, split %u B: %u B saved\n", (unsigned)modelRam, (unsigned)splitRam,
+           (unsigned)(modelRam - splitRam));
+    printf("flash      %u B table + %u B names + %u B string defaults (32-bit layout)\n",
+           (unsigned)(OCPP_CONFIG_KEY_COUNT * TARGET_KEY_BYTES), (unsigned)nameBytes, (unsigned)defaultBytes);
+
+    checkAnswers();
+
+    /* Name lookups: every key once plus a few unknown names */
+    uint64_t t0 = monotonicNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (uint32_t id = 0; id < OCPP_CONFIG_KEY_COUNT; id++) {
+            const char *name = ocppConfigKeys[id].name;
+            sinkHole += ocppConfigFind(name, strlen(name));
+        }
+        for (uint32_t u = 0; u < UNKNOWN_KEYS; u++) {
+            sinkHole += ocppConfigFind(unknown[u], strlen(unknown[u]));
+        }
+    }
+    double splitFind = (double)(monotonicNs() - t0) / iterations / (OCPP_CONFIG_KEY_COUNT + UNKNOWN_KEYS);
+    t0 = monotonicNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (uint32_t id = 0; id < OCPP_CONFIG_KEY_COUNT; id++) {
+            sinkHole += modelFind(ocppConfigKeys[id].name);
+        }
+        for (uint32_t u = 0; u < UNKNOWN_KEYS; u++) {
+            sinkHole += modelFind(unknown[u]);
+        }
+    }
+    double modelFindNs = (double)(monotonicNs() - t0) / iterations / (OCPP_CONFIG_KEY_COUNT + UNKNOWN_KEYS);
+
+    /* ChangeConfiguration: find and store a value given as text, then the whole payload */
+    t0 = monotonicNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        int id = ocppConfigFind("MeterValueSampleInterval", 24);
+        sinkHole += ocppConfigSet((OcppConfigId)id, "30", 2);
+    }
+    double splitChange = (double)(monotonicNs() - t0) / iterations;
+    t0 = monotonicNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        sinkHole += ocppConfigChange("{\"key\":\"MeterValueSampleInterval\",\"value\":\"30\"}");
+    }
+    double changePayload = (double)(monotonicNs() - t0) / iterations;
+    t0 = monotonicNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        sinkHole += modelChange("MeterValueSampleInterval", "30");
+    }
+    double modelChangeNs = (double)(monotonicNs() - t0) / iterations;
+
+    /* GetConfiguration: three keys and every key, rendered into a counting sink */
+    Sink sink = {{0}, 0};
+    t0 = monotonicNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        sink.len = 0;
+        ocppConfigGet("{\"key\":[\"HeartbeatInterval\",\"MeterValueSampleInterval\",\"StopTxnSampledData\"]}",
+                      sinkWrite, &sink);
+    }
+    double getThree = (double)(monotonicNs() - t0) / iterations;
+    t0 = monotonicNs();
+    for (uint32_t i = 0; i < iterations / 10 + 1; i++) {
+        sink.len = 0;
+        ocppConfigGet("{}", sinkWrite, &sink);
+    }
+    double getAll = (double)(monotonicNs() - t0) / (iterations / 10 + 1);
+
+    printf("%-32s %10s %10s\n", "ns/call", "split", "all-RAM");
+    printf("%-32s %10.1f %10.1f\n", "find by name (32 names)", splitFind, modelFindNs);
+    printf("%-32s %10.1f %10.1f\n", "find and set a value", splitChange, modelChangeNs);
+    printf("%-32s %10.1f %10s\n", "ChangeConfiguration payload", changePayload, "-");
+    printf("%-32s %10.1f %10s\n", "GetConfiguration, 3 keys", getThree, "-");
+    printf("%-32s %10.1f %10s\n", "GetConfiguration, all keys", getAll, "-");
+    printf("GetConfiguration of all keys: %zu B reply, written in pieces\n", sink.len);
+    printf("%s\n", failures ? "answers: FAILED" : "answers: ok");
+    return failures ? 1 : 0;
+}
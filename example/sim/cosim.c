@@ -0,0 +1,462 @@
+/*
+ * In-process co-simulation of the ESP32 bridge and the STM32 firmware.
+ *
+ * stm32/main.c runs unmodified on the native HAL shim in its own thread
+ * (built with -Dmain=stm32_main). The ESP32 side is the text-mode bridge:
+ * backend messages go through the real uart_stream.c into a 1024 byte TX
+ * ring, and STM32 output is read from a 256 byte RX buffer line by line and
+ * forwarded to the backend, as in esp32/main.c. Both directions run over
+ * virtual_uart.c lines with baud-rate byte timing and optional bit errors.
+ * The STM32 receiver has a one byte data register read by an interrupt
+ * thread: a byte that arrives while the previous one has not been picked up
+ * (interrupts disabled, or the RX callback still busy) is an overrun.
+ *
+ * Each scenario sends RemoteStart/RemoteStopTransaction CALLs with unique
+ * IDs from a stand-in backend and matches them against the echo the STM32
+ * sends back. It reports end-to-end latency (backend send to echo forwarded
+ * by the bridge) and the messages that never came back, followed by the
+ * per-stage probe histograms (common/probe.h) on stderr, since both sides
+ * share one clock here.
+ *
+ * The "stream" check pushes 64 KB messages through uart_stream.c, whole and
+ * in WebSocket-sized fragments, and compares the bytes on the wire with the
+ * message. It then aborts a fragmented CALL as a disconnect does and checks
+ * that the STM32 discards it and still answers the next one. Exits 1 if any
+ * of these fail.
+ *
+ * Usage: cosim [scenario|stream|all]
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "hal_shim.h"
+#include "probe.h"
+#include "uart_stream.h"
+#include "virtual_uart.h"
+
+#undef main // stm32/main.c is built with -Dmain=stm32_main
+
+#define ESP_TX_RING_SIZE   1024 // uart.setTxBufferSize() in esp32/main.c
+#define ESP_RX_BUFFER_SIZE 256  // HardwareSerial default
+#define ESP_LINE_MAX       1024
+#define PUMP_INTERVAL_US   20
+#define DRAIN_MS           2000 // Wait for late echoes after the last send
+#define MAX_MESSAGES       256
+#define UID_PREFIX         "cosim-"
+#define STREAM_BYTES       65536
+#define STREAM_BAUD        921600 // Keeps each 64 KB message under a second
+
+typedef struct {
+    const char *name;
+    uint32_t baud;
+    double bitErrorRate;
+    uint32_t messages;
+    uint32_t intervalMs;   // 0 = back to back
+    uint32_t payloadBytes; // Approximate size of each CALL
+} Scenario;
+
+static const Scenario scenarios[] = {
+    {"nominal", 115200, 0.0, 20, 100, 96},
+    {"burst", 115200, 0.0, 20, 0, 96},
+    {"large", 115200, 0.0, 10, 200, 400},
+    {"noisy", 115200, 1e-4, 40, 100, 96},
+    {"slow", 9600, 0.0, 10, 300, 96},
+};
+
+/* Per-scenario results */
+typedef struct {
+    uint64_t sentUs[MAX_MESSAGES];
+    uint32_t latencyUs[MAX_MESSAGES];
+    bool received[MAX_MESSAGES];
+    uint32_t sent;
+    uint32_t delivered;
+    uint32_t linesForwarded;
+} Results;
+
+int stm32_main(void);
+
+static VirtualUart espToStm;
+static VirtualUart stmToEsp;
+static UartStream uartStream;
+static Results results;
+
+/* STM32 receive data register (USART RDR), emptied by the RX interrupt thread */
+static uint8_t rdr;
+static bool rdrFull;
+static bool irqBusy;        // RX callback running or interrupts disabled
+static uint64_t rdrFilledUs;
+static uint32_t rdrOverruns;
+
+/* Bytes on the ESP32 -> STM32 wire, recorded during the stream check */
+static uint8_t *wireTap;
+static size_t wireTapLen, wireTapSize;
+
+/* ESP32 receive side */
+static uint8_t espRx[ESP_RX_BUFFER_SIZE];
+static uint32_t espRxHead, espRxCount, espRxDrops;
+static char espLine[ESP_LINE_MAX];
+static size_t espLineLen;
+
+/*
+ * A byte is only counted as an overrun when the firmware kept the interrupt
+ * busy for longer than one byte time. If the interrupt thread merely has not
+ * been scheduled yet, the wire waits for it instead of blaming the firmware.
+ */
+static void deliverToStm(void *ctx, uint8_t byte) {
+    uint64_t byteUs = 10000000ull / espToStm.cfg.baud;
+    (void)ctx;
+    if (wireTap && wireTapLen < wireTapSize) {
+        wireTap[wireTapLen++] = byte;
+    }
+    while (__atomic_load_n(&rdrFull, __ATOMIC_ACQUIRE)) {
+        if (__atomic_load_n(&irqBusy, __ATOMIC_ACQUIRE) && shimNowUs() - rdrFilledUs > byteUs) {
+            rdrOverruns++; // Previous byte not read in time, the new one is lost
+            return;
+        }
+        sched_yield();
+    }
+    rdr = byte;
+    rdrFilledUs = shimNowUs();
+    __atomic_store_n(&rdrFull, true, __ATOMIC_RELEASE);
+}
+
+static void deliverToEsp(void *ctx, uint8_t byte) {
+    (void)ctx;
+    if (espRxCount == ESP_RX_BUFFER_SIZE) {
+        espRxDrops++;
+        return;
+    }
+    espRx[(espRxHead + espRxCount++) % ESP_RX_BUFFER_SIZE] = byte;
+}
+
+/* Backend stand-in: matches echoed CALL IDs */
+static void backendReceive(const char *line, uint64_t nowUs) {
+    const char *uid = strstr(line, "\"" UID_PREFIX);
+    results.linesForwarded++;
+    if (!uid) {
+        return;
+    }
+    unsigned long index = strtoul(uid + 1 + strlen(UID_PREFIX), NULL, 10);
+    if (index < results.sent && !results.received[index]) {
+        results.received[index] = true;
+        results.latencyUs[results.delivered++] = (uint32_t)(nowUs - results.sentUs[index]);
+    }
+}
+
+/* ESP32 loop(): forward complete STM32 lines */
+static void espLoop(uint64_t nowUs) {
+    while (espRxCount > 0) {
+        char c = (char)espRx[espRxHead];
+        espRxHead = (espRxHead + 1) % ESP_RX_BUFFER_SIZE;
+        espRxCount--;
+        if (c == '\n') {
+            espLine[espLineLen] = '\0';
+            backendReceive(espLine, nowUs);
+            espLineLen = 0;
+        } else if (espLineLen < ESP_LINE_MAX - 1) {
+            espLine[espLineLen++] = c;
+        }
+    }
+}
+
+/* Advances both wires and the ESP32 receive path to the current time */
+static void pump(void) {
+    uint64_t now = shimNowUs();
+    vuartPoll(&espToStm, now, deliverToStm, NULL);
+    vuartPoll(&stmToEsp, now, deliverToEsp, NULL);
+    espLoop(now);
+}
+
+/* uart_stream.c backend of the ESP32 TX ring */
+static size_t espUartWrite(void *ctx, const uint8_t *data, size_t len) {
+    (void)ctx;
+    return vuartWrite(&espToStm, data, len, shimNowUs());
+}
+
+static void espUartWait(void *ctx) {
+    (void)ctx;
+    pump();
+    usleep(PUMP_INTERVAL_US);
+}
+
+/* HAL_UART_Transmit of the STM32: blocks until every byte is on the wire */
+static void stmUartTx(void *ctx, const uint8_t *data, uint16_t len) {
+    (void)ctx;
+    while (len > 0) {
+        size_t n = vuartWrite(&stmToEsp, data, len, shimNowUs());
+        data += n;
+        len -= (uint16_t)n;
+        if (len > 0) {
+            usleep(PUMP_INTERVAL_US);
+        }
+    }
+}
+
+static void *stm32Thread(void *arg) {
+    (void)arg;
+    stm32_main();
+    return NULL;
+}
+
+/* USART2 RX interrupt: reading RDR frees it, then the HAL callback runs */
+static void *stm32RxIrqThread(void *arg) {
+    (void)arg;
+    for (;;) {
+        if (!__atomic_load_n(&rdrFull, __ATOMIC_ACQUIRE)) {
+            sched_yield();
+            continue;
+        }
+        uint8_t byte = rdr;
+        __atomic_store_n(&irqBusy, true, __ATOMIC_RELEASE);
+        __atomic_store_n(&rdrFull, false, __ATOMIC_RELEASE);
+        shimUartInject(USART2, byte); // Waits while the firmware has interrupts disabled
+        __atomic_store_n(&irqBusy, false, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void waitMs(uint32_t ms) {
+    uint64_t end = shimNowUs() + (uint64_t)ms * 1000;
+    while (shimNowUs() < end) {
+        pump();
+        usleep(PUMP_INTERVAL_US);
+    }
+}
+
+static size_t buildCall(char *buf, size_t size, uint32_t index, uint32_t payloadBytes) {
+    int len;
+    if (index % 2 == 0) {
+        len = snprintf(buf, size, "[2,\"" UID_PREFIX "%u\",\"RemoteStartTransaction\",{\"connectorId\":1,\"idTag\":\"ABC123\",\"pad\":\"",
+                       (unsigned)index);
+    } else {
+        len = snprintf(buf, size, "[2,\"" UID_PREFIX "%u\",\"RemoteStopTransaction\",{\"transactionId\":1,\"pad\":\"",
+                       (unsigned)index);
+    }
+    while ((uint32_t)len + 4 < payloadBytes && (size_t)len + 4 < size) {
+        buf[len++] = 'x';
+    }
+    len += snprintf(buf + len, size - len, "\"}]");
+    return (size_t)len;
+}
+
+static int compareU32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentileMs(const uint32_t *sorted, uint32_t n, uint32_t pct) {
+    if (n == 0) {
+        return 0.0;
+    }
+    return sorted[(n - 1) * pct / 100] / 1000.0;
+}
+
+static void printProbeLine(void *ctx, const char *line) {
+    (void)ctx;
+    fprintf(stderr, "%s\n", line);
+}
+
+static void runScenario(const Scenario *sc) {
+    char call[1024];
+    uint32_t overrunsBefore = rdrOverruns + shimUartStats(USART2)->rxOverruns;
+    uint32_t espDropsBefore = espRxDrops;
+    uint32_t corruptedBefore = espToStm.corruptedBytes + stmToEsp.corruptedBytes;
+    uint32_t stallsBefore = uartStream.stalls;
+
+    waitMs(100);
+    vuartConfigure(&espToStm, sc->baud, sc->bitErrorRate);
+    vuartConfigure(&stmToEsp, sc->baud, sc->bitErrorRate);
+    memset(&results, 0, sizeof(results));
+
+    uartStreamMessage(&uartStream, (const uint8_t *)"", 0); // Flush a partial line left by the last scenario
+    waitMs(100);
+    results.linesForwarded = 0;
+    probeReset();
+
+    for (uint32_t i = 0; i < sc->messages && i < MAX_MESSAGES; i++) {
+        size_t len = buildCall(call, sizeof(call), i, sc->payloadBytes);
+        results.sentUs[i] = shimNowUs();
+        results.sent = i + 1;
+        PROBE(PROBE_WS_RX);
+        uartStreamMessage(&uartStream, (const uint8_t *)call, len);
+        PROBE(PROBE_UART_TX);
+        waitMs(sc->intervalMs);
+    }
+    while (!vuartIdle(&espToStm)) {
+        waitMs(1);
+    }
+    waitMs(DRAIN_MS);
+
+    qsort(results.latencyUs, results.delivered, sizeof(uint32_t), compareU32);
+    printf("%-8s %6u %7.0e %4u %4u %4u %8.1f %8.1f %8.1f %5u %5u %5u %5u\n",
+           sc->name, (unsigned)sc->baud, sc->bitErrorRate, (unsigned)results.sent,
+           (unsigned)results.delivered, (unsigned)(results.sent - results.delivered),
+           percentileMs(results.latencyUs, results.delivered, 50),
+           percentileMs(results.latencyUs, results.delivered, 95),
+           percentileMs(results.latencyUs, results.delivered, 100),
+           (unsigned)(rdrOverruns + shimUartStats(USART2)->rxOverruns - overrunsBefore),
+           (unsigned)(espRxDrops - espDropsBefore),
+           (unsigned)(espToStm.corruptedBytes + stmToEsp.corruptedBytes - corruptedBefore),
+           (unsigned)(uartStream.stalls - stallsBefore));
+    fflush(stdout);
+    probeExport(printProbeLine, NULL);
+}
+
+/* JSON-ish text with the bytes uart_stream.c has to replace mixed in */
+static void fillMessage(uint8_t *msg, size_t len, uint32_t seed) {
+    static const char special[] = {'\n', '\r', UART_STREAM_CANCEL};
+    size_t header = (size_t)snprintf((char *)msg, len, "[2,\"stream-%u\",\"DataTransfer\",{\"data\":\"", (unsigned)seed);
+    for (size_t i = header; i + 3 < len; i++) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t r = seed >> 16;
+        msg[i] = r % 97 == 0 ? (uint8_t)special[r % 3] : (uint8_t)('a' + r % 26);
+    }
+    memcpy(msg + len - 3, "\"}]", 3);
+}
+
+/* What the wire has to carry for a message: breaks and CAN as spaces */
+static size_t expectedWire(uint8_t *out, const uint8_t *msg, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        out[i] = msg[i] == '\n' || msg[i] == '\r' || msg[i] == UART_STREAM_CANCEL ? ' ' : msg[i];
+    }
+    return len;
+}
+
+static void tapStart(void) {
+    while (!vuartIdle(&espToStm)) {
+        waitMs(1);
+    }
+    waitMs(5);
+    wireTapLen = 0;
+}
+
+static size_t tapStop(void) {
+    while (!vuartIdle(&espToStm)) {
+        waitMs(1);
+    }
+    waitMs(5);
+    return wireTapLen;
+}
+
+static bool checkWire(const char *name, const uint8_t *expected, size_t len) {
+    size_t got = tapStop();
+    size_t mismatch = 0;
+    while (mismatch < len && mismatch < got && wireTap[mismatch] == expected[mismatch]) {
+        mismatch++;
+    }
+    bool ok = got == len && mismatch == len;
+    printf("stream %-12s %6zu bytes sent, %6zu on the wire, %s", name, len, got, ok ? "intact\n" : "");
+    if (!ok) {
+        printf("first difference at byte %zu\n", mismatch);
+    }
+    return ok;
+}
+
+static bool runStreamChecks(void) {
+    uint8_t *msg = malloc(STREAM_BYTES);
+    uint8_t *expected = malloc(STREAM_BYTES + 256);
+    char call[256];
+    bool ok = true;
+
+    wireTapSize = STREAM_BYTES + 256;
+    wireTap = malloc(wireTapSize);
+    if (!msg || !expected || !wireTap) {
+        fprintf(stderr, "cosim: out of memory\n");
+        return false;
+    }
+    vuartConfigure(&espToStm, STREAM_BAUD, 0.0);
+    vuartConfigure(&stmToEsp, STREAM_BAUD, 0.0);
+
+    // One WStype_TEXT frame holding the whole message
+    fillMessage(msg, STREAM_BYTES, 1);
+    expectedWire(expected, msg, STREAM_BYTES);
+    expected[STREAM_BYTES] = '\n';
+    tapStart();
+    uartStreamMessage(&uartStream, msg, STREAM_BYTES);
+    ok &= checkWire("unfragmented", expected, STREAM_BYTES + 1);
+
+    // WStype_FRAGMENT_TEXT_START, FRAGMENT..., FRAGMENT_FIN in uneven pieces
+    fillMessage(msg, STREAM_BYTES, 2);
+    expectedWire(expected, msg, STREAM_BYTES);
+    expected[STREAM_BYTES] = '\n';
+    tapStart();
+    uartStreamBegin(&uartStream);
+    for (size_t pos = 0, piece = 1; pos < STREAM_BYTES; piece = piece * 7 % 4093 + 1) {
+        size_t n = STREAM_BYTES - pos < piece ? STREAM_BYTES - pos : piece;
+        uartStreamChunk(&uartStream, msg + pos, n);
+        pos += n;
+    }
+    uartStreamEnd(&uartStream);
+    ok &= checkWire("fragmented", expected, STREAM_BYTES + 1);
+
+    // WStype_DISCONNECTED halfway through a fragmented RemoteStart, then a complete one
+    memset(&results, 0, sizeof(results));
+    results.sent = 3;
+    size_t len = buildCall(call, sizeof(call), 0, 96);
+    tapStart();
+    uartStreamBegin(&uartStream);
+    uartStreamChunk(&uartStream, (const uint8_t *)call, len / 2);
+    uartStreamAbort(&uartStream);
+    size_t expectedLen = expectedWire(expected, (const uint8_t *)call, len / 2);
+    expected[expectedLen++] = UART_STREAM_CANCEL;
+    size_t next = buildCall(call, sizeof(call), 2, 96);
+    uartStreamMessage(&uartStream, (const uint8_t *)call, next);
+    expectedLen += expectedWire(expected + expectedLen, (const uint8_t *)call, next);
+    expected[expectedLen++] = '\n';
+    ok &= checkWire("aborted", expected, expectedLen);
+    waitMs(DRAIN_MS);
+    printf("stream %-12s aborted CALL %s, next CALL %s\n", "abort",
+           results.received[0] ? "dispatched" : "discarded", results.received[2] ? "answered" : "lost");
+    ok &= !results.received[0] && results.received[2];
+
+    free(wireTap);
+    wireTap = NULL;
+    free(msg);
+    free(expected);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char *which = argc > 1 ? argv[1] : "all";
+    VirtualUartConfig espCfg = {115200, ESP_TX_RING_SIZE, 0.0, 0x1234u};
+    VirtualUartConfig stmCfg = {115200, 1, 0.0, 0x5678u}; // Blocking transmit, no ring
+    pthread_t thread, irqThread;
+    int ran = 0;
+
+    if (vuartInit(&espToStm, &espCfg) || vuartInit(&stmToEsp, &stmCfg)) {
+        fprintf(stderr, "cosim: out of memory\n");
+        return 1;
+    }
+    uartStreamInit(&uartStream, espUartWrite, espUartWait, NULL);
+    shimUartSetTxHook(USART2, stmUartTx, NULL);
+    shimGpioSetInput(GPIOB, GPIO_PIN_0, GPIO_PIN_SET); // EV plugged in, so RemoteStart closes the relay
+    if (pthread_create(&thread, NULL, stm32Thread, NULL) ||
+        pthread_create(&irqThread, NULL, stm32RxIrqThread, NULL)) {
+        fprintf(stderr, "cosim: cannot start the STM32 thread\n");
+        return 1;
+    }
+    waitMs(200); // Let the firmware initialise and arm its receive interrupt
+
+    printf("%-8s %6s %7s %4s %4s %4s %8s %8s %8s %5s %5s %5s %5s\n", "scenario", "baud", "ber",
+           "sent", "ok", "drop", "p50_ms", "p95_ms", "max_ms", "ovr", "rxdrp", "flips", "stall");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        if (!strcmp(which, "all") || !strcmp(which, scenarios[i].name)) {
+            runScenario(&scenarios[i]);
+            ran++;
+        }
+    }
+    if (!strcmp(which, "all") || !strcmp(which, "stream")) {
+        if (!runStreamChecks()) {
+            return 1;
+        }
+        ran++;
+    }
+    if (!ran) {
+        fprintf(stderr, "cosim: unknown scenario '%s'\n", which);
+        return 1;
+    }
+    return 0; // Ends the firmware thread with the process
+}
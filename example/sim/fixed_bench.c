@@ -0,0 +1,347 @@
+/*
+ * Checks of the fixed-point kernels (common/fixed_point.c) and their cost
+ * against float (common/fixed_bench.c).
+ *
+ * Every kernel is compared bit for bit with a reference that computes the
+ * documented result exactly: 128-bit integer math for the products, sums and
+ * divisions, r² <= x < (r + 1)² for the square root, and double for the float
+ * conversion and the pilot duty cycle, where the inputs keep it exact. The
+ * vectors are the edges of each range plus random ones from a fixed seed.
+ *
+ * The times are host nanoseconds of the fixed-point kernels only: the host
+ * has an FPU, so float is not timed (FX_BENCH_FLOAT). The firmware runs the
+ * same bench against soft-float with cycleStamp() (FIXED_BENCH in stm32/main.c).
+ *
+ * Usage: fixed_bench [random vectors per kernel] [bench rounds]
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fixed_bench.h"
+#include "fixed_point.h"
+
+typedef __int128 i128;
+typedef unsigned __int128 u128;
+
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+static int failures;
+
+/* xorshift64* */
+static uint64_t random64(void) {
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545F4914F6CDD1Dull;
+}
+
+/* Uniform in [0, 2^bits), bits 0..64 */
+static uint64_t randomBits(unsigned bits) {
+    return bits >= 64 ? random64() : random64() & (((uint64_t)1 << bits) - 1);
+}
+
+/* A random number of bits up to maxBits: small magnitudes as often as large ones */
+static uint64_t randomMagnitude(unsigned maxBits) {
+    return randomBits((unsigned)(random64() % (maxBits + 1)));
+}
+
+/* n / 2^shift, ties away from zero */
+static i128 roundShift(i128 n, unsigned shift) {
+    u128 mag = n < 0 ? (u128)0 - (u128)n : (u128)n;
+    mag = (mag + ((u128)1 << (shift - 1))) >> shift;
+    return n < 0 ? -(i128)mag : (i128)mag;
+}
+
+static void report(const char *kernel, uint32_t checks, uint32_t bad) {
+    printf("%-16s %8u checks %s\n", kernel, (unsigned)checks, bad ? "FAIL" : "ok");
+    failures += bad != 0;
+}
+
+static void mismatch(uint32_t *bad, const char *kernel, const char *detail) {
+    if (*bad < 5) {
+        printf("  %s: %s\n", kernel, detail);
+    }
+    (*bad)++;
+}
+
+typedef void (*SumPairsFn)(const uint16_t *pairs, uint32_t n, int32_t biasV, int32_t biasI, FxPairSums *s);
+
+static void checkSumPairs(const char *kernel, SumPairsFn sumPairs, uint32_t vectors) {
+    static uint16_t pairs[2 * 600 + 1];
+    uint32_t checks = 0, bad = 0;
+
+    for (uint32_t t = 0; t < vectors / 100 + 4; t++) {
+        uint32_t n = t < 4 ? (uint32_t[]){0, 1, FX_PAIR_CHUNK, 600}[t] : (uint32_t)(random64() % 601);
+        uint32_t skew = t < 4 ? 0 : (uint32_t)(random64() & 1); // Pairs at odd halfwords: no aligned words
+        uint16_t *block = pairs + skew;
+        int32_t biasV = t < 4 ? 0 : (int32_t)(random64() % 4096), biasI = t < 4 ? 4095 : (int32_t)(random64() % 4096);
+        FxPairSums s = {1, 2, 3, 4, -5, 6}; // Adds to what is there
+        uint64_t rawV = 1, rawI = 2, vv = 3, ii = 4, clipped = 6;
+        int64_t vi = -5;
+
+        for (uint32_t k = 0; k < 2 * n; k++) {
+            block[k] = t < 4 ? (k & 2 ? 4095 : 0) : (uint16_t)(random64() % 4096); // Worst case first
+            block[k] = t % 8 == 5 && random64() % 4 == 0 ? (uint16_t)(random64() & 1 ? 4095 : 0) : block[k]; // Clipping
+        }
+        sumPairs(block, n, biasV, biasI, &s);
+        for (uint32_t k = 0; k < n; k++) {
+            int64_t v = (int64_t)block[2 * k] - biasV, i = (int64_t)block[2 * k + 1] - biasI;
+            rawV += block[2 * k];
+            rawI += block[2 * k + 1];
+            vv += (uint64_t)(v * v);
+            ii += (uint64_t)(i * i);
+            vi += v * i;
+            clipped += (block[2 * k] == 0 || block[2 * k] == 4095) + (block[2 * k + 1] == 0 || block[2 * k + 1] == 4095);
+        }
+        if (s.rawV != rawV || s.rawI != rawI || s.vv != vv || s.ii != ii || s.vi != vi || s.clipped != clipped) {
+            char detail[64];
+            snprintf(detail, sizeof(detail), "%u pairs, biases %d/%d", (unsigned)n, (int)biasV, (int)biasI);
+            mismatch(&bad, kernel, detail);
+        }
+        checks++;
+    }
+    report(kernel, checks, bad);
+}
+
+static void checkSqrt(uint32_t vectors) {
+    uint32_t checks = 0, bad = 0;
+
+    for (uint32_t t = 0; t < vectors + 8; t++) {
+        uint64_t x;
+        if (t < 8) {
+            x = (uint64_t[]){0, 1, 2, 3, 4, UINT64_MAX, 0xFFFFFFFE00000001ull, 0xFFFFFFFE00000000ull}[t];
+        } else if (t % 2) {
+            uint64_t r = randomBits(32);
+            x = r * r - (random64() % 3 == 0 && r ? 1 : 0); // Squares and one below
+        } else {
+            x = randomMagnitude(64);
+        }
+        u128 r = fxSqrt64(x);
+        if (!(r * r <= x && (r + 1) * (r + 1) > x)) {
+            char detail[64];
+            snprintf(detail, sizeof(detail), "sqrt(%llu) = %llu", (unsigned long long)x, (unsigned long long)r);
+            mismatch(&bad, "fxSqrt64", detail);
+        }
+        checks++;
+    }
+    report("fxSqrt64", checks, bad);
+}
+
+static void checkRmsMean(uint32_t vectors) {
+    uint32_t checks = 0, badRms = 0, badMean = 0;
+
+    for (uint32_t t = 0; t < vectors; t++) {
+        unsigned frac = (unsigned)(random64() % 16);
+        uint32_t n = t % 4 ? (uint32_t)randomMagnitude(32) : 4000;
+        uint64_t squares = randomMagnitude(64);
+        int64_t products = (int64_t)randomMagnitude(63) * (random64() & 1 ? -1 : 1);
+        q31_t rms, mean;
+        i128 expect;
+
+        /* RMS: floor(sqrt(floor(squares / n) * 2^(62 - 2 frac))) */
+        rms = fxRmsQ31(squares, n, frac);
+        if (!n) {
+            expect = 0;
+        } else if (squares / n >= (uint64_t)1 << (2 * frac)) {
+            expect = FX_Q31_MAX;
+        } else {
+            u128 x = (u128)(squares / n) << (62 - 2 * frac);
+            expect = rms;
+            if (!((u128)rms * rms <= x && ((u128)rms + 1) * ((u128)rms + 1) > x)) {
+                expect = -1;
+            }
+        }
+        if (rms != expect) {
+            char detail[96];
+            snprintf(detail, sizeof(detail), "rms(%llu / %u, Q%u) = %ld", (unsigned long long)squares, (unsigned)n,
+                     frac, (long)rms);
+            mismatch(&badRms, "fxRmsQ31", detail);
+        }
+
+        /* Mean: products * 2^(31 - 2 frac) / n rounded, saturated */
+        mean = fxMeanQ31(products, n, frac);
+        if (!n) {
+            expect = 0;
+        } else {
+            i128 scaled = (i128)products << (31 - 2 * frac);
+            u128 mag = scaled < 0 ? (u128)-scaled : (u128)scaled;
+            mag = (mag + n / 2) / n;
+            mag = mag > FX_Q31_MAX ? FX_Q31_MAX : mag;
+            expect = scaled < 0 ? -(i128)mag : (i128)mag;
+        }
+        if (mean != expect) {
+            char detail[96];
+            snprintf(detail, sizeof(detail), "mean(%lld / %u, Q%u) = %ld", (long long)products, (unsigned)n, frac,
+                     (long)mean);
+            mismatch(&badMean, "fxMeanQ31", detail);
+        }
+        checks++;
+    }
+    report("fxRmsQ31", checks, badRms);
+    report("fxMeanQ31", checks, badMean);
+}
+
+static void checkScale(uint32_t vectors) {
+    uint32_t checks = 0, bad = 0;
+
+    for (uint32_t t = 0; t < vectors + 4; t++) {
+        q31_t x = t < 4 ? (q31_t[]){FX_Q31_MAX, -FX_Q31_MAX, 1 << 30, -(1 << 30)}[t] : (q31_t)random64();
+        int32_t fullScale = t < 4 ? INT32_MAX : (int32_t)randomMagnitude(31) * (random64() & 1 ? -1 : 1);
+        i128 expect = roundShift((i128)x * fullScale, 31);
+        int32_t got = fxScaleQ31(x, fullScale);
+
+        if (got != expect) {
+            char detail[64];
+            snprintf(detail, sizeof(detail), "%ld * %ld = %ld", (long)x, (long)fullScale, (long)got);
+            mismatch(&bad, "fxScaleQ31", detail);
+        }
+        checks++;
+    }
+    report("fxScaleQ31", checks, bad);
+}
+
+static void checkMulShift(uint32_t vectors) {
+    uint32_t checks = 0, bad = 0;
+
+    for (uint32_t t = 0; t < vectors + 6; t++) {
+        int64_t a;
+        uint32_t mantissa;
+        unsigned shift;
+        i128 expect;
+
+        if (t < 6) {
+            a = (int64_t[]){INT64_MAX, -INT64_MAX, INT64_MAX, 1, -1, (int64_t)1 << 40}[t];
+            mantissa = (uint32_t[]){UINT32_MAX, UINT32_MAX, 1, 1, 1, 3}[t];
+            shift = (unsigned[]){95, 95, 1, 1, 1, 32}[t];
+        } else {
+            a = (int64_t)randomMagnitude(63) * (random64() & 1 ? -1 : 1);
+            mantissa = (uint32_t)randomMagnitude(32);
+            shift = 1 + (unsigned)(random64() % 95);
+        }
+        expect = roundShift((i128)a * mantissa, shift);
+        expect = expect > INT64_MAX ? INT64_MAX : expect < -INT64_MAX ? -INT64_MAX : expect;
+        if (fxMulShift(a, mantissa, shift) != expect) {
+            char detail[96];
+            snprintf(detail, sizeof(detail), "%lld * %lu >> %u = %lld", (long long)a, (unsigned long)mantissa, shift,
+                     (long long)fxMulShift(a, mantissa, shift));
+            mismatch(&bad, "fxMulShift", detail);
+        }
+        checks++;
+    }
+    report("fxMulShift", checks, bad);
+}
+
+static void checkRatio(uint32_t vectors) {
+    uint32_t checks = 0, bad = 0;
+
+    for (uint32_t t = 0; t < vectors + 3; t++) {
+        uint64_t num, den;
+        uint32_t mantissa;
+        uint8_t shift;
+
+        if (t < 3) {
+            num = (uint64_t[]){20971520, 1, INT32_MAX}[t]; // The meter's full-scale mW per sample-hour
+            den = (uint64_t[]){14400000, (uint64_t)1 << 40, 1}[t];
+        } else {
+            num = 1 + randomMagnitude(40); // num << shift stays in 128 bits
+            den = 1 + randomMagnitude(40);
+            den = num / den >> 31 ? (num >> 31) + 1 : den; // num / den < 2^31
+        }
+        mantissa = fxRatio(num, den, &shift);
+        u128 scaled = (u128)num << shift;
+        if (mantissa < 0x80000000u || (u128)mantissa * den > scaled || ((u128)mantissa + 1) * den <= scaled) {
+            char detail[96];
+            snprintf(detail, sizeof(detail), "%llu / %llu = %lu >> %u", (unsigned long long)num,
+                     (unsigned long long)den, (unsigned long)mantissa, (unsigned)shift);
+            mismatch(&bad, "fxRatio", detail);
+        }
+        checks++;
+    }
+    report("fxRatio", checks, bad);
+}
+
+static void checkFromFloat(uint32_t vectors) {
+    static const uint32_t edges[] = {0x00000000, 0x80000000, 0x00000001, 0x3F000000, 0xBF000000, 0x3EFFFFFF,
+                                     0x4EFFFFFF, 0x4F000000, 0xCF000000, 0x7F800000, 0xFF800000, 0x7FC00000};
+    uint32_t checks = 0, bad = 0;
+
+    for (uint32_t t = 0; t < vectors + sizeof(edges) / sizeof(edges[0]); t++) {
+        uint32_t bits = t < sizeof(edges) / sizeof(edges[0]) ? edges[t] : (uint32_t)random64();
+        unsigned frac = (unsigned)(random64() % 32);
+        double expect;
+        float f;
+
+        if (t % 2 && t >= sizeof(edges) / sizeof(edges[0])) {
+            bits = (bits & 0x807FFFFF) | ((uint32_t)(100 + random64() % 60) << 23); // Around the Q ranges
+        }
+        memcpy(&f, &bits, sizeof(f));
+        expect = isnan(f) ? 0.0 : round(ldexp((double)f, (int)frac)); // Exact in double; ties away from zero
+        expect = expect > INT32_MAX ? INT32_MAX : expect < -INT32_MAX ? -INT32_MAX : expect;
+        if (fxFromFloat(f, frac) != (int32_t)expect) {
+            char detail[64];
+            snprintf(detail, sizeof(detail), "0x%08lx Q%u = %ld", (unsigned long)bits, frac,
+                     (long)fxFromFloat(f, frac));
+            mismatch(&bad, "fxFromFloat", detail);
+        }
+        checks++;
+    }
+    report("fxFromFloat", checks, bad);
+}
+
+static void checkPilotDuty(void) {
+    uint32_t checks = 0, bad = 0;
+
+    for (int32_t mA = -1000; mA <= 100000; mA++) {
+        double amps = mA / 1000.0, expect;
+
+        if (amps < 6.0) {
+            expect = 1000.0;
+        } else if (amps <= 51.0) {
+            expect = floor(mA / 60.0 + 0.5); // A / 0.6 in 0.1%
+        } else {
+            expect = floor((mA < 80000 ? mA : 80000) / 250.0 + 0.5) + 640.0; // A / 2.5 + 64 in 0.1%
+        }
+        if (fxPilotDuty(mA) != (uint16_t)expect) {
+            char detail[64];
+            snprintf(detail, sizeof(detail), "%ld mA = %u", (long)mA, (unsigned)fxPilotDuty(mA));
+            mismatch(&bad, "fxPilotDuty", detail);
+        }
+        checks++;
+    }
+    report("fxPilotDuty", checks, bad);
+}
+
+static uint32_t hostNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
+
+static void printLine(void *ctx, const char *line) {
+    (void)ctx;
+    puts(line);
+}
+
+int main(int argc, char **argv) {
+    uint32_t vectors = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1000000;
+    uint32_t rounds = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 100000;
+
+    checkSumPairs("fxSumPairsScalar", fxSumPairsScalar, vectors);
+#if FX_SIMD_KERNEL
+    checkSumPairs("fxSumPairsSimd", fxSumPairsSimd, vectors);
+#endif
+    checkSqrt(vectors);
+    checkRmsMean(vectors);
+    checkScale(vectors);
+    checkMulShift(vectors);
+    checkRatio(vectors);
+    checkFromFloat(vectors);
+    checkPilotDuty();
+    fxBench(hostNs, "ns", rounds, printLine, NULL);
+    if (failures) {
+        printf("%d kernels do not match their references\n", failures);
+        return 1;
+    }
+    return 0;
+}
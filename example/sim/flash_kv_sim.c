@@ -0,0 +1,325 @@
+/*
+ * Host flash simulation for the key-value store (common/flash_kv.c).
+ *
+ * The flash is the 4 KB reserved at the end of the STM32F030R8: four 1 KB
+ * pages, programmed in half-words. Like the real part, the simulated flash
+ * refuses to program a half-word that is not erased, unless the new value is
+ * 0x0000. It counts the erases of every page.
+ *
+ * The workload is what a charger keeps across resets: the energy register
+ * (changes every second), the running transaction and its counter,
+ * configuration changes and authorization cache entries. It runs twice, once
+ * flushed every 60 s and once flushed after every change, so the batching
+ * gain shows in the write amplification: flash bytes programmed per value
+ * byte the application wrote. Wear is the most-erased page's cycles per day
+ * against the F030's 1000-cycle endurance.
+ *
+ * A third run cuts the power at random points, inside programs and erases. A
+ * cut program writes only some of its half-words, a cut erase leaves the
+ * page half old, half erased. After every cut the store is mounted again and
+ * each key must hold either its last flushed value or the one that was being
+ * flushed. The run exits with 1 if one does not.
+ *
+ * Usage: flash_kv_sim [days] [power cuts]
+ */
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flash_kv.h"
+
+#define PAGE_SIZE  1024
+#define PAGES      4
+#define ENDURANCE  1000 // Cycles, STM32F030 datasheet minimum
+
+/* Keys */
+#define KEY_ENERGY  0
+#define KEY_TX      1
+#define KEY_TX_SEQ  2
+#define KEY_CONFIG  3  // 8 keys
+#define KEY_AUTH    32 // 16 entries
+#define CONFIG_KEYS 8
+#define AUTH_KEYS   16
+
+typedef struct {
+    uint8_t mem[PAGES * PAGE_SIZE];
+    uint32_t erases[PAGES];
+    long cutAfter; // Program half-words and erases until the power cut, -1 for none
+} SimFlash;
+
+typedef struct {
+    int len; // -1: absent
+    uint8_t data[FLASH_KV_MAX_VALUE];
+} Value;
+
+static SimFlash flash;
+static FlashKv kv;
+static jmp_buf powerCut;
+
+static Value committed[FLASH_KV_MAX_KEYS]; // In flash for sure
+static Value pending[FLASH_KV_MAX_KEYS];   // Staged since the last flush
+static bool hasPending[FLASH_KV_MAX_KEYS];
+
+static uint32_t flushEvery; // Seconds, 0: after every change
+static uint32_t appBytes, cuts, skipped;
+static int failures;
+
+static void cutPoint(void) {
+    if (flash.cutAfter == 0) {
+        flash.cutAfter = -1;
+        longjmp(powerCut, 1);
+    }
+    if (flash.cutAfter > 0) {
+        flash.cutAfter--;
+    }
+}
+
+static bool simProgram(void *ctx, uint32_t offset, const uint16_t *data, uint32_t halfWords) {
+    SimFlash *f = ctx;
+    for (uint32_t i = 0; i < halfWords; i++, offset += 2) {
+        uint16_t old;
+        cutPoint();
+        memcpy(&old, &f->mem[offset], 2);
+        if (old != 0xFFFF && data[i] != 0) {
+            fprintf(stderr, "flash_kv_sim: program over written flash at 0x%04x\n", (unsigned)offset);
+            exit(1);
+        }
+        memcpy(&f->mem[offset], &data[i], 2);
+    }
+    return true;
+}
+
+static bool simErase(void *ctx, uint32_t page) {
+    SimFlash *f = ctx;
+    f->erases[page]++;
+    if (f->cutAfter == 0) {
+        for (uint32_t i = 0; i < PAGE_SIZE; i++) {
+            if (rand() & 1) {
+                f->mem[page * PAGE_SIZE + i] = 0xFF;
+            }
+        }
+    } else {
+        memset(&f->mem[page * PAGE_SIZE], 0xFF, PAGE_SIZE);
+    }
+    cutPoint();
+    return true;
+}
+
+static const FlashKvDevice device = {flash.mem, PAGE_SIZE, PAGES, simProgram, simErase, &flash};
+
+static void mount(void) {
+    if (flashKvMount(&kv, &device) != FLASH_KV_OK) {
+        printf("FAIL mount\n");
+        exit(1);
+    }
+}
+
+static void commitPending(void) {
+    for (uint32_t key = 0; key < FLASH_KV_MAX_KEYS; key++) {
+        if (hasPending[key]) {
+            committed[key] = pending[key];
+            hasPending[key] = false;
+        }
+    }
+}
+
+static bool same(const Value *a, const uint8_t *data, int len) {
+    return a->len == len && (len < 0 || !memcmp(a->data, data, (size_t)len));
+}
+
+/* Every key against the model; after a power cut the value being flushed counts as well */
+static void verify(const char *when) {
+    for (uint16_t key = 0; key < FLASH_KV_MAX_KEYS; key++) {
+        uint8_t data[FLASH_KV_MAX_VALUE];
+        int len = flashKvGet(&kv, key, data, sizeof(data));
+        if (len == FLASH_KV_NOT_FOUND) {
+            len = -1;
+        }
+        if (!same(&committed[key], data, len) && !(hasPending[key] && same(&pending[key], data, len))) {
+            printf("FAIL key %u after %s: %d bytes\n", (unsigned)key, when, len);
+            failures++;
+        }
+        committed[key].len = len;
+        memcpy(committed[key].data, data, len > 0 ? (size_t)len : 0);
+        hasPending[key] = false;
+    }
+}
+
+static void flush(void) {
+    if (flashKvFlush(&kv) != FLASH_KV_OK) {
+        printf("FAIL flush\n");
+        exit(1);
+    }
+    commitPending();
+}
+
+static void set(uint16_t key, const void *data, int len) {
+    uint32_t flushes = kv.stats.flushes;
+    const Value *current = hasPending[key] ? &pending[key] : &committed[key];
+    FlashKvResult result;
+
+    if (len < 0 && current->len < 0) {
+        return;
+    }
+    result = len < 0 ? flashKvDelete(&kv, key) : flashKvSet(&kv, key, data, (uint32_t)len);
+    if (result != FLASH_KV_OK) {
+        printf("FAIL set key %u: %d\n", (unsigned)key, (int)result);
+        exit(1);
+    }
+    if (kv.stats.flushes != flushes) {
+        commitPending(); // The batch was full
+    }
+    pending[key].len = len;
+    memcpy(pending[key].data, data, len > 0 ? (size_t)len : 0);
+    hasPending[key] = true;
+    appBytes += len > 0 ? (uint32_t)len : 0;
+    if (flushEvery == 0) {
+        flush();
+    }
+}
+
+typedef struct {
+    uint32_t energy; // Wh
+    uint32_t txSeq;
+    bool charging;
+} Charger;
+
+/* One second of the charger's life */
+static void tick(Charger *c, uint32_t t) {
+    c->energy += c->charging ? 3 : 0; // 11 kW
+    set(KEY_ENERGY, &c->energy, sizeof(c->energy));
+
+    if (t % 7200 == 600) { // Start
+        uint8_t tx[28];
+        c->txSeq++;
+        c->charging = true;
+        memcpy(tx, &c->txSeq, 4);
+        memcpy(tx + 4, &c->energy, 4);
+        snprintf((char *)tx + 8, 20, "TAG%08u", (unsigned)(rand() % 1000));
+        set(KEY_TX_SEQ, &c->txSeq, sizeof(c->txSeq));
+        set(KEY_TX, tx, sizeof(tx));
+        flush(); // Must survive a reset
+    } else if (t % 7200 == 4200) { // Stop
+        c->charging = false;
+        set(KEY_TX, NULL, -1);
+        flush();
+    }
+    if (t % 3600 == 1800) { // ChangeConfiguration
+        char value[41];
+        int len = 2 + rand() % 39;
+        memset(value, 'a' + rand() % 26, (size_t)len);
+        set((uint16_t)(KEY_CONFIG + rand() % CONFIG_KEYS), value, len);
+        flush();
+    }
+    if (t % 600 == 300) { // Authorization cache entry
+        uint8_t entry[24] = {0};
+        uint32_t expiry = t + 86400;
+        snprintf((char *)entry, 20, "TAG%08u", (unsigned)(rand() % 1000));
+        memcpy(entry + 20, &expiry, 4);
+        set((uint16_t)(KEY_AUTH + rand() % AUTH_KEYS), entry, sizeof(entry));
+    }
+    if (flushEvery && t % flushEvery == flushEvery - 1) {
+        flush();
+    }
+}
+
+static void reset(void) {
+    memset(&flash, 0, sizeof(flash));
+    memset(flash.mem, 0xFF, sizeof(flash.mem));
+    flash.cutAfter = -1;
+    for (uint32_t key = 0; key < FLASH_KV_MAX_KEYS; key++) {
+        committed[key].len = -1;
+        hasPending[key] = false;
+    }
+    appBytes = 0;
+    srand(1);
+    mount();
+}
+
+static void report(const char *name, const FlashKvStats *stats, uint32_t programmed, uint32_t days) {
+    uint32_t min = flash.erases[0], max = flash.erases[0];
+    for (uint32_t page = 1; page < PAGES; page++) {
+        min = flash.erases[page] < min ? flash.erases[page] : min;
+        max = flash.erases[page] > max ? flash.erases[page] : max;
+    }
+    double perDay = (double)max / days;
+    printf("%-10s %u sets (%u merged), %u records, %u copied by GC, %u flushes\n", name, (unsigned)stats->sets,
+           (unsigned)stats->merged, (unsigned)stats->records, (unsigned)stats->copied,
+           (unsigned)stats->flushes);
+    printf("           %u B written, %u B programmed: write amplification %.2f\n", (unsigned)appBytes,
+           (unsigned)programmed, (double)programmed / appBytes);
+    printf("           erases per page %u..%u, %.1f/day: %.0f days to %u cycles\n", (unsigned)min, (unsigned)max,
+           perDay, perDay > 0 ? ENDURANCE / perDay : 0.0, ENDURANCE);
+}
+
+static void run(const char *name, uint32_t days, uint32_t seconds) {
+    Charger charger = {0, 0, false};
+    FlashKvStats stats;
+    uint32_t programmed;
+
+    flushEvery = seconds;
+    reset();
+    for (uint32_t t = 0; t < days * 86400; t++) {
+        tick(&charger, t);
+    }
+    flush();
+    verify("the run");
+    stats = kv.stats;
+    programmed = kv.ring.bytesProgrammed;
+    mount();
+    verify("a remount");
+    report(name, &stats, programmed, days);
+}
+
+/* State that must survive the longjmp */
+static Charger cutCharger;
+static uint32_t cutTime, cutEnd;
+
+static void runPowerCuts(uint32_t count) {
+    flushEvery = 60;
+    reset();
+    memset(&cutCharger, 0, sizeof(cutCharger));
+    cutTime = 0;
+    cutEnd = 0xFFFFFFFFu;
+    flash.cutAfter = rand() % 2000;
+    if (setjmp(powerCut)) {
+        cuts++;
+        mount();
+        skipped += kv.stats.skipped;
+        verify("a power cut");
+        cutCharger.charging = false;
+        cutTime++;
+        flash.cutAfter = cuts < count ? rand() % 2000 : -1;
+        if (cuts == count) {
+            cutEnd = cutTime + 86400;
+        }
+    }
+    for (; cutTime < cutEnd; cutTime++) {
+        tick(&cutCharger, cutTime);
+    }
+    flush();
+    mount();
+    verify("the last remount");
+    printf("power cuts %u over %u simulated days, every remount checked: %u torn records skipped\n",
+           (unsigned)cuts, (unsigned)(cutTime / 86400), (unsigned)skipped);
+}
+
+int main(int argc, char **argv) {
+    uint32_t days = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 30;
+    uint32_t powerCuts = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 1000;
+
+    printf("region     %u pages x %u B, live data up to %u B, batch %u B\n", (unsigned)PAGES, (unsigned)PAGE_SIZE,
+           (unsigned)((PAGES - 2) * (PAGE_SIZE - FLASH_KV_PAGE_HEADER)), (unsigned)FLASH_KV_BATCH_SIZE);
+    printf("workload   %u days: energy every second, a transaction every 2 h, a config change every hour,\n"
+           "           an auth cache entry every 10 min\n",
+           (unsigned)days);
+    run("unbatched", days, 0);
+    run("60 s", days, 60);
+    run("15 min", days, 900);
+    runPowerCuts(powerCuts);
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,802 @@
+/*
+ * Fleet simulator: N chargers in one process for backend capacity planning.
+ *
+ * Each simulated charger is an adaptation, not the firmware: only its
+ * connect schedule comes from the real reconnect_policy.c. The charge point
+ * behaviour below is a small re-implementation of what stm32/main.c and
+ * MicroOcpp put on the wire, written for one process holding thousands of
+ * chargers (stm32/main.c keeps its state in globals, and MicroOcpp is not in
+ * this tree), so it does not exercise their code. A charger sends
+ * BootNotification, Heartbeat, StatusNotification, Start/StopTransaction and
+ * periodic MeterValues, and it accepts RemoteStart/RemoteStopTransaction.
+ * Every charger has its own meter curve (power class, taper at a random
+ * battery capacity) and a random plug-in/plug-out schedule. A plug-in starts
+ * a transaction like an RFID swipe would.
+ *
+ * Chargers are sharded over a pool of worker threads. Each worker runs one
+ * epoll loop for all of its sockets plus a 10 ms timer tick, so there is no
+ * thread per charger. The report covers OCPP traffic and CALL latency. It
+ * also shows memory per charger, both the struct size and the measured RSS
+ * growth, and worker CPU load. The sustainable chargers per core figure is a
+ * linear extrapolation of that load; check the timer lag to see whether the
+ * workers were saturated.
+ *
+ * Usage: fleet_sim [-n chargers] [-w workers] [-d duration_s] [-x time_scale]
+ *                  [-h host] [-p port] [-P path] [-s start_spread_ms]
+ * Intervals (meter 60 s, plug cycle ~30 min idle / ~2 h plugged) are divided
+ * by time_scale; the network side always runs in real time.
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "reconnect_policy.h"
+
+#define TICK_MS             10
+#define RX_BUF_SIZE         2048 // Largest backend message we expect, plus framing
+#define TX_BUF_SIZE         1024
+#define CALL_TIMEOUT_MS     30000
+#define METER_INTERVAL_MS   60000 // MeterValueSampleInterval
+#define MEAN_IDLE_MS        (30 * 60000)
+#define MEAN_PLUGGED_MS     (120 * 60000)
+#define LATENCY_BUCKETS     24
+#define MAX_EVENTS          256
+
+typedef enum {
+    CONN_DOWN,
+    CONN_TCP,       // Non-blocking connect in progress
+    CONN_UPGRADE,   // HTTP upgrade sent, waiting for 101
+    CONN_OPEN
+} ConnState;
+
+/* Messages owed to the backend; OCPP-J allows one CALL in flight at a time */
+enum {
+    OWE_BOOT = 1 << 0,
+    OWE_STATUS = 1 << 1,
+    OWE_START = 1 << 2,
+    OWE_STOP = 1 << 3,
+    OWE_METER = 1 << 4,
+    OWE_HEARTBEAT = 1 << 5,
+};
+
+typedef struct {
+    /* Link */
+    int fd;
+    uint8_t conn;
+    bool booted;
+    ReconnectPolicy reconnect;
+    uint16_t rxLen;
+    uint16_t txLen;
+    uint32_t maskRng;
+    uint8_t rx[RX_BUF_SIZE];
+    uint8_t tx[TX_BUF_SIZE];
+
+    /* OCPP */
+    uint8_t owed;
+    uint8_t inFlight;      // OWE_* of the CALL awaiting its answer, 0 = none
+    uint32_t callSeq;
+    uint64_t callSentUs;
+    uint32_t heartbeatMs;
+    uint32_t nextHeartbeatMs;
+
+    /* Charger model (what stm32/main.c and MicroOcpp keep) */
+    bool plugged;
+    bool transaction;
+    bool relay;
+    int32_t transactionId;  // 0 until StartTransaction.conf
+    uint32_t energyWh;
+    float energyFraction;
+    uint32_t powerW;
+    uint32_t maxPowerW;
+    uint32_t sessionWh;
+    uint32_t capacityWh;
+    uint32_t nextPlugMs;
+    uint32_t nextMeterMs;
+    uint32_t lastModelMs;
+    uint32_t rng;
+    uint32_t index;
+} Charger;
+
+typedef struct {
+    pthread_t thread;
+    int epfd;
+    Charger **chargers;
+    uint32_t count;
+    /* Statistics, only touched by the worker */
+    uint64_t callsSent;
+    uint64_t callAnswers;
+    uint64_t callTimeouts;
+    uint64_t backendCalls;
+    uint64_t connects;
+    uint64_t disconnects;
+    uint64_t bytesOut;
+    uint64_t bytesIn;
+    uint64_t latency[LATENCY_BUCKETS]; // log2 microseconds
+    uint64_t lag[LATENCY_BUCKETS];     // Tick lateness, log2 microseconds
+    double cpuSeconds;
+} Worker;
+
+static const char *host = "127.0.0.1";
+static int port = 8180;
+static const char *path = "/steve/websocket/CentralSystemService";
+static double timeScale = 1.0;
+static uint32_t startSpreadMs = 5000;
+static struct sockaddr_in backendAddr;
+static volatile bool running = true;
+static uint64_t epochUs;
+
+static uint64_t monotonicUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint32_t nowMs(void) {
+    return (uint32_t)((monotonicUs() - epochUs) / 1000);
+}
+
+static uint32_t nextRandom(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* Exponentially distributed delay with the given mean, scaled by timeScale */
+static uint32_t randomDelay(Charger *cp, uint32_t meanMs) {
+    double u = (nextRandom(&cp->rng) + 1.0) / 4294967297.0;
+    double ms = -(double)meanMs * log(u) / timeScale;
+    return ms > 1e9 ? 1000000000u : (uint32_t)ms + 1;
+}
+
+static void addLog2(uint64_t *buckets, uint64_t us) {
+    int b = 0;
+    while (us && b < LATENCY_BUCKETS - 1) {
+        us >>= 1;
+        b++;
+    }
+    buckets[b]++;
+}
+
+/* WebSocket client ----------------------------------------------------------*/
+static void closeLink(Worker *worker, Charger *cp) {
+    if (cp->fd >= 0) {
+        epoll_ctl(worker->epfd, EPOLL_CTL_DEL, cp->fd, NULL);
+        close(cp->fd);
+        cp->fd = -1;
+    }
+    if (cp->conn == CONN_OPEN) {
+        worker->disconnects++;
+    }
+    cp->conn = CONN_DOWN;
+    cp->booted = false;
+    cp->rxLen = 0;
+    cp->txLen = 0;
+    cp->inFlight = 0;
+}
+
+static void dropLink(Worker *worker, Charger *cp) {
+    closeLink(worker, cp);
+    reconnectOnDisconnected(&cp->reconnect, nowMs());
+}
+
+static void flushTx(Worker *worker, Charger *cp) {
+    while (cp->txLen > 0) {
+        ssize_t n = send(cp->fd, cp->tx, cp->txLen, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            break; // EPOLLOUT resumes
+        }
+        if (n <= 0) {
+            dropLink(worker, cp);
+            return;
+        }
+        worker->bytesOut += (uint64_t)n;
+        memmove(cp->tx, cp->tx + n, cp->txLen - (size_t)n);
+        cp->txLen -= (uint16_t)n;
+    }
+    struct epoll_event ev = {EPOLLIN | (cp->txLen ? EPOLLOUT : 0), {.ptr = cp}};
+    epoll_ctl(worker->epfd, EPOLL_CTL_MOD, cp->fd, &ev);
+}
+
+static bool queueTx(Worker *worker, Charger *cp, const void *data, size_t len) {
+    if (cp->txLen + len > TX_BUF_SIZE) {
+        dropLink(worker, cp); // Backend not reading, give up like a full TCP window would
+        return false;
+    }
+    memcpy(cp->tx + cp->txLen, data, len);
+    cp->txLen += (uint16_t)len;
+    return true;
+}
+
+static void sendFrame(Worker *worker, Charger *cp, uint8_t opcode, const char *payload, size_t len) {
+    uint8_t header[8];
+    size_t headerLen = 2;
+    uint32_t mask = nextRandom(&cp->maskRng);
+    uint8_t maskBytes[4] = {(uint8_t)mask, (uint8_t)(mask >> 8), (uint8_t)(mask >> 16), (uint8_t)(mask >> 24)};
+    uint8_t masked[TX_BUF_SIZE];
+
+    if (len > sizeof(masked)) {
+        return;
+    }
+    header[0] = 0x80 | opcode;
+    if (len < 126) {
+        header[1] = 0x80 | (uint8_t)len;
+    } else {
+        header[1] = 0x80 | 126;
+        header[2] = (uint8_t)(len >> 8);
+        header[3] = (uint8_t)len;
+        headerLen = 4;
+    }
+    memcpy(header + headerLen, maskBytes, 4);
+    for (size_t i = 0; i < len; i++) {
+        masked[i] = (uint8_t)payload[i] ^ maskBytes[i & 3];
+    }
+    if (queueTx(worker, cp, header, headerLen + 4) && queueTx(worker, cp, masked, len)) {
+        flushTx(worker, cp);
+    }
+}
+
+static void sendText(Worker *worker, Charger *cp, const char *text, int len) {
+    if (len > 0) {
+        sendFrame(worker, cp, 0x1, text, (size_t)len);
+    }
+}
+
+static void startConnect(Worker *worker, Charger *cp) {
+    cp->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (cp->fd < 0) {
+        reconnectOnDisconnected(&cp->reconnect, nowMs());
+        return;
+    }
+    int one = 1;
+    setsockopt(cp->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(cp->fd, (struct sockaddr *)&backendAddr, sizeof(backendAddr)) && errno != EINPROGRESS) {
+        dropLink(worker, cp);
+        return;
+    }
+    cp->conn = CONN_TCP;
+    struct epoll_event ev = {EPOLLIN | EPOLLOUT, {.ptr = cp}};
+    epoll_ctl(worker->epfd, EPOLL_CTL_ADD, cp->fd, &ev);
+}
+
+static void sendUpgrade(Worker *worker, Charger *cp) {
+    char request[512];
+    int len = snprintf(request, sizeof(request),
+                       "GET %s/sim-%05u HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                       "Sec-WebSocket-Key: c2ltLWNoYXJnZXItbm9uY2U=\r\nSec-WebSocket-Version: 13\r\n"
+                       "Sec-WebSocket-Protocol: ocpp1.6\r\n\r\n",
+                       path, (unsigned)cp->index, host, port);
+    cp->conn = CONN_UPGRADE;
+    if (queueTx(worker, cp, request, (size_t)len)) {
+        flushTx(worker, cp);
+    }
+}
+
+/* OCPP charge point ---------------------------------------------------------*/
+static void isoTime(char *buf, size_t size) {
+    time_t now = time(NULL);
+    strftime(buf, size, "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+}
+
+static const char *statusName(const Charger *cp) {
+    return cp->transaction ? "Charging" : cp->plugged ? "Preparing" : "Available";
+}
+
+/* Sends the most urgent owed CALL if none is in flight */
+static void sendNextCall(Worker *worker, Charger *cp) {
+    char msg[768], timestamp[32];
+    int len = 0;
+    uint8_t what = 0;
+
+    if (cp->conn != CONN_OPEN || cp->inFlight || !cp->owed) {
+        return;
+    }
+    if (!cp->booted) {
+        if (!(cp->owed & OWE_BOOT)) {
+            return; // Nothing else may be sent before BootNotification is accepted
+        }
+        what = OWE_BOOT;
+    } else {
+        for (what = OWE_STATUS; what <= OWE_HEARTBEAT && !(cp->owed & what); what <<= 1) {
+        }
+    }
+
+    isoTime(timestamp, sizeof(timestamp));
+    cp->callSeq++;
+    switch (what) {
+        case OWE_BOOT:
+            len = snprintf(msg, sizeof(msg), "[2,\"%u\",\"BootNotification\",{\"chargePointModel\":\"STM32 Charger\","
+                           "\"chargePointVendor\":\"My Company\",\"chargePointSerialNumber\":\"sim-%05u\"}]",
+                           (unsigned)cp->callSeq, (unsigned)cp->index);
+            break;
+        case OWE_STATUS:
+            len = snprintf(msg, sizeof(msg), "[2,\"%u\",\"StatusNotification\",{\"connectorId\":1,\"errorCode\":\"NoError\","
+                           "\"status\":\"%s\",\"timestamp\":\"%s\"}]", (unsigned)cp->callSeq, statusName(cp), timestamp);
+            break;
+        case OWE_START:
+            len = snprintf(msg, sizeof(msg), "[2,\"%u\",\"StartTransaction\",{\"connectorId\":1,\"idTag\":\"SIM%05u\","
+                           "\"meterStart\":%u,\"timestamp\":\"%s\"}]", (unsigned)cp->callSeq, (unsigned)cp->index,
+                           (unsigned)cp->energyWh, timestamp);
+            break;
+        case OWE_STOP:
+            len = snprintf(msg, sizeof(msg), "[2,\"%u\",\"StopTransaction\",{\"transactionId\":%d,\"meterStop\":%u,"
+                           "\"timestamp\":\"%s\",\"reason\":\"EVDisconnected\"}]", (unsigned)cp->callSeq,
+                           (int)cp->transactionId, (unsigned)cp->energyWh, timestamp);
+            break;
+        case OWE_METER: {
+            char transaction[32] = "";
+            if (cp->transactionId) {
+                snprintf(transaction, sizeof(transaction), "\"transactionId\":%d,", (int)cp->transactionId);
+            }
+            len = snprintf(msg, sizeof(msg), "[2,\"%u\",\"MeterValues\",{\"connectorId\":1,%s\"meterValue\":[{"
+                           "\"timestamp\":\"%s\",\"sampledValue\":[{\"value\":\"%u\",\"measurand\":"
+                           "\"Energy.Active.Import.Register\",\"unit\":\"Wh\"},{\"value\":\"%u\",\"measurand\":"
+                           "\"Power.Active.Import\",\"unit\":\"W\"}]}]}]", (unsigned)cp->callSeq, transaction,
+                           timestamp, (unsigned)cp->energyWh, (unsigned)cp->powerW);
+            break;
+        }
+        case OWE_HEARTBEAT:
+            len = snprintf(msg, sizeof(msg), "[2,\"%u\",\"Heartbeat\",{}]", (unsigned)cp->callSeq);
+            break;
+        default:
+            return;
+    }
+    cp->owed &= (uint8_t)~what;
+    cp->inFlight = what;
+    cp->callSentUs = monotonicUs();
+    worker->callsSent++;
+    sendText(worker, cp, msg, len);
+}
+
+static long jsonNumber(const char *msg, const char *key, long fallback) {
+    const char *p = strstr(msg, key);
+    return p ? strtol(p + strlen(key), NULL, 10) : fallback;
+}
+
+static void handleCallResult(Worker *worker, Charger *cp, const char *msg) {
+    uint32_t now = nowMs();
+
+    worker->callAnswers++;
+    addLog2(worker->latency, monotonicUs() - cp->callSentUs);
+    switch (cp->inFlight) {
+        case OWE_BOOT:
+            if (strstr(msg, "\"Accepted\"")) {
+                cp->booted = true;
+                cp->heartbeatMs = (uint32_t)jsonNumber(msg, "\"interval\":", 300) * 1000u;
+                cp->nextHeartbeatMs = now + cp->heartbeatMs;
+                cp->owed |= OWE_STATUS;
+            } else {
+                cp->owed |= OWE_BOOT; // Pending/Rejected: retry on the next heartbeat slot
+            }
+            break;
+        case OWE_START:
+            cp->transactionId = (int32_t)jsonNumber(msg, "\"transactionId\":", 1);
+            break;
+        default:
+            break;
+    }
+    cp->inFlight = 0;
+}
+
+static void handleBackendCall(Worker *worker, Charger *cp, const char *uid, const char *action) {
+    char reply[192];
+    const char *status = "Rejected";
+
+    worker->backendCalls++;
+    if (!strcmp(action, "RemoteStartTransaction")) {
+        if (cp->plugged && !cp->transaction) {
+            cp->transaction = true;
+            cp->transactionId = 0;
+            cp->owed |= OWE_START | OWE_STATUS;
+            status = "Accepted";
+        }
+    } else if (!strcmp(action, "RemoteStopTransaction")) {
+        if (cp->transaction) {
+            cp->transaction = false;
+            cp->owed |= OWE_STOP | OWE_STATUS;
+            status = "Accepted";
+        }
+    } else {
+        int len = snprintf(reply, sizeof(reply), "[4,\"%s\",\"NotImplemented\",\"\",{}]", uid);
+        sendText(worker, cp, reply, len);
+        return;
+    }
+    int len = snprintf(reply, sizeof(reply), "[3,\"%s\",{\"status\":\"%s\"}]", uid, status);
+    sendText(worker, cp, reply, len);
+}
+
+static void handleMessage(Worker *worker, Charger *cp, char *msg) {
+    char uid[40] = "", action[40] = "";
+    int type = 0;
+
+    if (sscanf(msg, " [ %d , \"%39[^\"]\" , \"%39[^\"]\"", &type, uid, action) < 2) {
+        return;
+    }
+    if (type == 2) {
+        handleBackendCall(worker, cp, uid, action);
+    } else if ((type == 3 || type == 4) && cp->inFlight && strtoul(uid, NULL, 10) == cp->callSeq) {
+        if (type == 4) {
+            cp->inFlight = 0; // CALLERROR: give up on this message
+            worker->callAnswers++;
+        } else {
+            handleCallResult(worker, cp, msg);
+        }
+    }
+}
+
+/* Parses complete server frames (unmasked) from rx */
+static void handleFrames(Worker *worker, Charger *cp) {
+    size_t pos = 0;
+    while (cp->rxLen - pos >= 2) {
+        uint8_t *p = cp->rx + pos;
+        uint8_t opcode = p[0] & 0x0F;
+        size_t len = p[1] & 0x7F, header = 2;
+        if (len == 126) {
+            if (cp->rxLen - pos < 4) {
+                break;
+            }
+            len = (size_t)p[2] << 8 | p[3];
+            header = 4;
+        } else if (len == 127 || header + len >= RX_BUF_SIZE) {
+            dropLink(worker, cp); // Larger than anything the charger accepts
+            return;
+        }
+        if (cp->rxLen - pos < header + len) {
+            break;
+        }
+
+        char *payload = (char *)p + header;
+        char saved = payload[len];
+        payload[len] = '\0';
+        if (opcode == 0x1) {
+            handleMessage(worker, cp, payload);
+        } else if (opcode == 0x9) {
+            sendFrame(worker, cp, 0xA, payload, len);
+        } else if (opcode == 0x8) {
+            dropLink(worker, cp);
+            return;
+        }
+        payload[len] = saved;
+        if (cp->fd < 0) {
+            return;
+        }
+        pos += header + len;
+    }
+    memmove(cp->rx, cp->rx + pos, cp->rxLen - pos);
+    cp->rxLen -= (uint16_t)pos;
+}
+
+static void onReadable(Worker *worker, Charger *cp) {
+    ssize_t n = recv(cp->fd, cp->rx + cp->rxLen, RX_BUF_SIZE - 1 - cp->rxLen, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (n <= 0) {
+        dropLink(worker, cp);
+        return;
+    }
+    worker->bytesIn += (uint64_t)n;
+    cp->rxLen += (uint16_t)n;
+
+    if (cp->conn == CONN_UPGRADE) {
+        cp->rx[cp->rxLen] = '\0';
+        char *end = strstr((char *)cp->rx, "\r\n\r\n");
+        if (!end) {
+            return;
+        }
+        if (strncmp((char *)cp->rx, "HTTP/1.1 101", 12)) {
+            dropLink(worker, cp);
+            return;
+        }
+        size_t consumed = (size_t)(end + 4 - (char *)cp->rx);
+        memmove(cp->rx, cp->rx + consumed, cp->rxLen - consumed);
+        cp->rxLen -= (uint16_t)consumed;
+        cp->conn = CONN_OPEN;
+        worker->connects++;
+        reconnectOnConnected(&cp->reconnect, nowMs());
+        cp->owed |= OWE_BOOT;
+    }
+    handleFrames(worker, cp);
+}
+
+/* Charger model: plug events and the meter curve */
+static void updateModel(Charger *cp, uint32_t now) {
+    uint32_t elapsedMs = now - cp->lastModelMs;
+    cp->lastModelMs = now;
+
+    if ((int32_t)(now - cp->nextPlugMs) >= 0) {
+        cp->plugged = !cp->plugged;
+        cp->nextPlugMs = now + randomDelay(cp, cp->plugged ? MEAN_PLUGGED_MS : MEAN_IDLE_MS);
+        cp->owed |= OWE_STATUS;
+        if (cp->plugged) {
+            cp->transaction = true; // Local authorization, as with an RFID swipe
+            cp->transactionId = 0;
+            cp->sessionWh = 0;
+            cp->capacityWh = 10000 + nextRandom(&cp->rng) % 50000;
+            cp->owed |= OWE_START;
+        } else if (cp->transaction) {
+            cp->transaction = false;
+            cp->owed |= OWE_STOP;
+        }
+    }
+
+    /* Constant power until 80 % of the battery, then a linear taper */
+    cp->relay = cp->transaction && cp->plugged;
+    cp->powerW = 0;
+    if (cp->relay && cp->sessionWh < cp->capacityWh) {
+        uint32_t knee = cp->capacityWh / 5 * 4;
+        cp->powerW = cp->sessionWh < knee ? cp->maxPowerW
+                                          : (uint32_t)((uint64_t)cp->maxPowerW * (cp->capacityWh - cp->sessionWh) /
+                                                       (cp->capacityWh - knee));
+    }
+    float wh = cp->powerW * (elapsedMs * (float)timeScale) / 3600000.0f + cp->energyFraction;
+    cp->energyWh += (uint32_t)wh;
+    cp->sessionWh += (uint32_t)wh;
+    cp->energyFraction = wh - (uint32_t)wh;
+}
+
+static void tickCharger(Worker *worker, Charger *cp, uint32_t now) {
+    switch (reconnectPoll(&cp->reconnect, now)) {
+        case RECONNECT_BEGIN:
+            startConnect(worker, cp);
+            break;
+        case RECONNECT_ABORT:
+            closeLink(worker, cp);
+            break;
+        default:
+            break;
+    }
+
+    updateModel(cp, now);
+    if ((int32_t)(now - cp->nextMeterMs) >= 0) {
+        cp->nextMeterMs = now + (uint32_t)(METER_INTERVAL_MS / timeScale);
+        if (cp->relay) {
+            cp->owed |= OWE_METER;
+        }
+    }
+    if (cp->booted && (int32_t)(now - cp->nextHeartbeatMs) >= 0) {
+        cp->nextHeartbeatMs = now + cp->heartbeatMs;
+        cp->owed |= OWE_HEARTBEAT;
+    }
+    if (cp->inFlight && monotonicUs() - cp->callSentUs > CALL_TIMEOUT_MS * 1000ull) {
+        worker->callTimeouts++;
+        cp->inFlight = 0;
+    }
+    sendNextCall(worker, cp);
+}
+
+static void *workerMain(void *arg) {
+    Worker *worker = arg;
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t nextTickUs = monotonicUs();
+    struct timespec cpu;
+
+    while (running) {
+        uint64_t nowUs = monotonicUs();
+        int timeoutMs = nextTickUs > nowUs ? (int)((nextTickUs - nowUs + 999) / 1000) : 0;
+        int n = epoll_wait(worker->epfd, events, MAX_EVENTS, timeoutMs);
+
+        for (int i = 0; i < n; i++) {
+            Charger *cp = events[i].data.ptr;
+            if (cp->fd < 0) {
+                continue; // Closed earlier in this batch
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                dropLink(worker, cp);
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && cp->conn == CONN_TCP) {
+                sendUpgrade(worker, cp);
+            } else if (events[i].events & EPOLLOUT) {
+                flushTx(worker, cp);
+            }
+            if (cp->fd >= 0 && (events[i].events & EPOLLIN)) {
+                onReadable(worker, cp);
+            }
+        }
+
+        nowUs = monotonicUs();
+        if (nowUs >= nextTickUs) {
+            addLog2(worker->lag, nowUs - nextTickUs);
+            uint32_t now = nowMs();
+            for (uint32_t i = 0; i < worker->count; i++) {
+                tickCharger(worker, worker->chargers[i], now);
+            }
+            nextTickUs += TICK_MS * 1000;
+            if (nextTickUs < nowUs) {
+                nextTickUs = nowUs + TICK_MS * 1000; // Overloaded, do not try to catch up
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    worker->cpuSeconds = cpu.tv_sec + cpu.tv_nsec / 1e9;
+    return NULL;
+}
+
+/* Report --------------------------------------------------------------------*/
+static long residentKb(void) {
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static double percentileMs(const uint64_t *buckets, double pct) {
+    uint64_t total = 0, seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        total += buckets[b];
+    }
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += buckets[b];
+        if (total && seen >= total * pct) {
+            return (1u << b) / 1000.0; // Upper bound of the bucket
+        }
+    }
+    return 0.0;
+}
+
+static void initCharger(Charger *cp, uint32_t index, uint32_t now) {
+    static const uint32_t powerClasses[] = {3700, 7400, 11000, 22000};
+    ReconnectConfig config;
+
+    memset(cp, 0, sizeof(*cp));
+    cp->fd = -1;
+    cp->index = index;
+    cp->rng = 0x9E3779B9u * (index + 1);
+    cp->maskRng = cp->rng ^ 0xA5A5A5A5u;
+    cp->maxPowerW = powerClasses[nextRandom(&cp->rng) % 4];
+    cp->energyWh = nextRandom(&cp->rng) % 1000000;
+    cp->lastModelMs = now;
+    cp->nextPlugMs = now + randomDelay(cp, MEAN_IDLE_MS);
+    cp->nextMeterMs = now + (uint32_t)(METER_INTERVAL_MS / timeScale);
+
+    reconnectConfigDefaults(&config);
+    config.maxOffsetMs = startSpreadMs ? startSpreadMs : 1;
+    reconnectInit(&cp->reconnect, &config, cp->rng, now);
+}
+
+int main(int argc, char **argv) {
+    uint32_t chargers = 100;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t workers = cores > 0 ? (uint32_t)cores : 1;
+    uint32_t durationS = 60;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:w:d:x:h:p:P:s:")) != -1) {
+        switch (opt) {
+            case 'n': chargers = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'w': workers = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'd': durationS = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'x': timeScale = atof(optarg); break;
+            case 'h': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'P': path = optarg; break;
+            case 's': startSpreadMs = (uint32_t)strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "usage: %s [-n chargers] [-w workers] [-d duration_s] [-x time_scale] "
+                                "[-h host] [-p port] [-P path] [-s start_spread_ms]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (!chargers || !workers || timeScale <= 0.0) {
+        fprintf(stderr, "fleet_sim: invalid parameters\n");
+        return 2;
+    }
+
+    struct addrinfo hints = {0}, *resolved;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, NULL, &hints, &resolved)) {
+        fprintf(stderr, "fleet_sim: cannot resolve %s\n", host);
+        return 1;
+    }
+    backendAddr = *(struct sockaddr_in *)resolved->ai_addr;
+    backendAddr.sin_port = htons((uint16_t)port);
+    freeaddrinfo(resolved);
+
+    epochUs = monotonicUs();
+    long rssBeforeKb = residentKb();
+    Worker *pool = calloc(workers, sizeof(Worker));
+    Charger *fleet = calloc(chargers, sizeof(Charger));
+    if (!pool || !fleet) {
+        fprintf(stderr, "fleet_sim: out of memory\n");
+        return 1;
+    }
+    for (uint32_t w = 0; w < workers; w++) {
+        pool[w].epfd = epoll_create1(0);
+        pool[w].chargers = calloc(chargers / workers + 1, sizeof(Charger *));
+    }
+    for (uint32_t i = 0; i < chargers; i++) {
+        Worker *worker = &pool[i % workers];
+        initCharger(&fleet[i], i, nowMs());
+        worker->chargers[worker->count++] = &fleet[i];
+    }
+
+    fprintf(stderr, "[fleet] %u chargers on %u workers -> ws://%s:%d%s/sim-NNNNN, time x%.0f\n",
+            (unsigned)chargers, (unsigned)workers, host, port, path, timeScale);
+    uint64_t startUs = monotonicUs();
+    for (uint32_t w = 0; w < workers; w++) {
+        pthread_create(&pool[w].thread, NULL, workerMain, &pool[w]);
+    }
+    for (uint32_t s = 1; s <= durationS; s++) {
+        sleep(1);
+        if (s % 10 == 0 || s == durationS) {
+            uint32_t open = 0, charging = 0;
+            for (uint32_t i = 0; i < chargers; i++) {
+                open += fleet[i].conn == CONN_OPEN;
+                charging += fleet[i].relay;
+            }
+            fprintf(stderr, "[fleet] %3us: %u connected, %u charging\n", (unsigned)s, (unsigned)open,
+                    (unsigned)charging);
+        }
+    }
+    long rssAfterKb = residentKb();
+    running = false;
+
+    Worker total = {0};
+    double wallS = (monotonicUs() - startUs) / 1e6;
+    for (uint32_t w = 0; w < workers; w++) {
+        pthread_join(pool[w].thread, NULL);
+        total.callsSent += pool[w].callsSent;
+        total.callAnswers += pool[w].callAnswers;
+        total.callTimeouts += pool[w].callTimeouts;
+        total.backendCalls += pool[w].backendCalls;
+        total.connects += pool[w].connects;
+        total.disconnects += pool[w].disconnects;
+        total.bytesOut += pool[w].bytesOut;
+        total.bytesIn += pool[w].bytesIn;
+        total.cpuSeconds += pool[w].cpuSeconds;
+        for (int b = 0; b < LATENCY_BUCKETS; b++) {
+            total.latency[b] += pool[w].latency[b];
+            total.lag[b] += pool[w].lag[b];
+        }
+    }
+
+    double load = total.cpuSeconds / wallS; // Cores busy on average
+    printf("chargers            %u on %u workers, %.0f s\n", (unsigned)chargers, (unsigned)workers, wallS);
+    printf("connects            %llu (%llu disconnects)\n", (unsigned long long)total.connects,
+           (unsigned long long)total.disconnects);
+    printf("CALLs sent          %llu (%.1f/s), answered %llu, timed out %llu\n",
+           (unsigned long long)total.callsSent, total.callsSent / wallS, (unsigned long long)total.callAnswers,
+           (unsigned long long)total.callTimeouts);
+    printf("backend CALLs       %llu\n", (unsigned long long)total.backendCalls);
+    printf("traffic             %.1f kB/s out, %.1f kB/s in\n", total.bytesOut / wallS / 1024,
+           total.bytesIn / wallS / 1024);
+    printf("CALL latency        p50 < %.2f ms, p99 < %.2f ms\n", percentileMs(total.latency, 0.50),
+           percentileMs(total.latency, 0.99));
+    printf("tick lag            p50 < %.2f ms, p99 < %.2f ms (tick %d ms)\n", percentileMs(total.lag, 0.50),
+           percentileMs(total.lag, 0.99), TICK_MS);
+    printf("memory per charger  %zu B struct, %.1f kB RSS (incl. socket and epoll bookkeeping)\n",
+           sizeof(Charger), (double)(rssAfterKb - rssBeforeKb) / chargers);
+    printf("worker CPU          %.3f cores busy (%.2f%% of one core per 100 chargers)\n", load,
+           load * 100.0 * 100.0 / chargers);
+    if (load > 0.0) {
+        printf("per core            ~%.0f chargers at this traffic mix (linear extrapolation)\n",
+               chargers / load);
+    }
+    return 0;
+}
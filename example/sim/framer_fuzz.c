@@ -0,0 +1,439 @@
+/*
+ * Integrity suite, fuzz target and throughput benchmark for the newline
+ * message assemblers in sim/framers.c.
+ *
+ * Every input is fed byte by byte to every framer, and the delivered messages
+ * are compared with the lines of the input. The input is cut at '\n', with
+ * '\r' removed if the framer strips it and empty lines kept if the framer
+ * delivers them. Lines longer than the framer's limit must not be delivered
+ * at all. The comparison counts lost messages and bogus ones: fragments of an
+ * over-long line, or messages cut at an embedded NUL. Some invariants hold
+ * for every framer: no message is longer than the limit or contains '\n',
+ * and no message contains '\r' if the framer strips it. A breach of these
+ * counts as "inv" and aborts the fuzzer. Strict framers (replacement
+ * candidates) must also have no lost or bogus messages.
+ *
+ * Usage: framer_fuzz              adversarial and random suite (exit 1 if a strict framer fails)
+ *        framer_fuzz bench [MB]   throughput on OCPP-like traffic, default 16 MB
+ *        framer_fuzz <file>...    run saved inputs (e.g. libFuzzer crashes) through the checks
+ *
+ * libFuzzer: clang -g -O1 -fsanitize=fuzzer,address -DFRAMER_LIBFUZZER \
+ *                  sim/framer_fuzz.c sim/framers.c -o framer_libfuzzer
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "framers.h"
+
+#define RANDOM_CASES  2000
+#define BENCH_REPEATS 3
+
+typedef struct {
+    uint8_t *bytes;
+    size_t used;
+    size_t cap;
+    size_t *offsets; // Start of each frame in bytes; frame i ends at offsets[i + 1]
+    size_t count;
+    size_t slots;
+} FrameList;
+
+typedef struct {
+    uint32_t cases;
+    uint32_t expected;
+    uint32_t ok;
+    uint32_t lost;
+    uint32_t bogus;
+    uint32_t invariant;
+    const char *firstFailure;
+} FramerStats;
+
+typedef struct {
+    FrameList *list;
+    const Framer *framer;
+    uint32_t invariant;
+    uint64_t frames; // Benchmark only
+} SinkCtx;
+
+/* Frame lists -----------------------------------------------------------------*/
+static void listClear(FrameList *list) {
+    list->used = 0;
+    list->count = 0;
+}
+
+static void listAdd(FrameList *list, const uint8_t *frame, size_t len) {
+    if (list->used + len > list->cap) {
+        list->cap = (list->used + len) * 2 + 256;
+        list->bytes = realloc(list->bytes, list->cap);
+    }
+    if (list->count + 2 > list->slots) {
+        list->slots = list->slots * 2 + 64;
+        list->offsets = realloc(list->offsets, list->slots * sizeof(size_t));
+    }
+    if (!list->bytes || !list->offsets) {
+        fprintf(stderr, "framer_fuzz: out of memory\n");
+        exit(2);
+    }
+    memcpy(list->bytes + list->used, frame, len);
+    list->offsets[list->count] = list->used;
+    list->used += len;
+    list->offsets[++list->count] = list->used;
+}
+
+static bool frameEquals(const FrameList *a, size_t i, const FrameList *b, size_t j) {
+    size_t lenA = a->offsets[i + 1] - a->offsets[i];
+    size_t lenB = b->offsets[j + 1] - b->offsets[j];
+    return lenA == lenB && !memcmp(a->bytes + a->offsets[i], b->bytes + b->offsets[j], lenA);
+}
+
+/* Expected messages of an input for a framer's declared behaviour */
+static void expectedFrames(const Framer *framer, const uint8_t *data, size_t len, FrameList *out) {
+    size_t lineLen = 0;
+    uint8_t *buf = malloc(len + 1);
+
+    listClear(out);
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '\n') {
+            if (lineLen <= framer->maxFrame && (lineLen > 0 || framer->emitsEmpty)) {
+                listAdd(out, buf, lineLen);
+            }
+            lineLen = 0;
+        } else if (data[i] != '\r' || !framer->stripsCr) {
+            buf[lineLen++] = data[i];
+        }
+    }
+    free(buf);
+}
+
+static void collectFrame(void *ctx, const uint8_t *frame, size_t len) {
+    SinkCtx *sink = ctx;
+    const Framer *framer = sink->framer;
+
+    if (len > framer->maxFrame || memchr(frame, '\n', len) || (framer->stripsCr && memchr(frame, '\r', len))) {
+        sink->invariant++;
+    }
+    listAdd(sink->list, frame, len);
+}
+
+/* Runs one input through a framer and scores it; returns true if it met the framer's contract */
+static bool checkInput(const Framer *framer, const uint8_t *data, size_t len, FramerStats *stats,
+                       const char *name) {
+    static FrameList expected, delivered;
+    SinkCtx sink = {&delivered, framer, 0, 0};
+    uint32_t lost = 0, bogus = 0, ok = 0;
+    size_t next = 0;
+
+    expectedFrames(framer, data, len, &expected);
+    listClear(&delivered);
+    framer->reset();
+    for (size_t i = 0; i < len; i++) {
+        framer->feed(data[i], collectFrame, &sink);
+    }
+
+    /* Delivered messages must appear in the expected list, in order */
+    for (size_t d = 0; d < delivered.count; d++) {
+        size_t e = next;
+        while (e < expected.count && !frameEquals(&expected, e, &delivered, d)) {
+            e++;
+        }
+        if (e == expected.count) {
+            bogus++;
+        } else {
+            lost += (uint32_t)(e - next);
+            ok++;
+            next = e + 1;
+        }
+    }
+    lost += (uint32_t)(expected.count - next);
+
+    stats->cases++;
+    stats->expected += (uint32_t)expected.count;
+    stats->ok += ok;
+    stats->lost += lost;
+    stats->bogus += bogus;
+    stats->invariant += sink.invariant;
+    bool passed = sink.invariant == 0 && (!framer->strict || (lost == 0 && bogus == 0));
+    if ((sink.invariant || lost || bogus) && !stats->firstFailure) {
+        stats->firstFailure = name;
+    }
+    return passed;
+}
+
+#ifdef FRAMER_LIBFUZZER
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    for (size_t f = 0; f < framerCount; f++) {
+        FramerStats stats = {0};
+        if (!checkInput(&framers[f], data, size, &stats, "fuzz")) {
+            fprintf(stderr, "framer %s: lost %u, bogus %u, invariant %u\n", framers[f].name, stats.lost,
+                    stats.bogus, stats.invariant);
+            abort();
+        }
+    }
+    return 0;
+}
+#else
+
+/* Input generation -------------------------------------------------------------*/
+static uint32_t rngState = 0x2545F491u;
+
+static uint32_t nextRandom(void) {
+    uint32_t x = rngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rngState = x;
+    return x;
+}
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} Stream;
+
+static void put(Stream *s, const void *data, size_t len) {
+    if (s->len + len > s->cap) {
+        s->cap = (s->len + len) * 2 + 1024;
+        s->data = realloc(s->data, s->cap);
+        if (!s->data) {
+            fprintf(stderr, "framer_fuzz: out of memory\n");
+            exit(2);
+        }
+    }
+    memcpy(s->data + s->len, data, len);
+    s->len += len;
+}
+
+static void putText(Stream *s, const char *text) {
+    put(s, text, strlen(text));
+}
+
+static void putRun(Stream *s, char c, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        put(s, &c, 1);
+    }
+}
+
+/* An OCPP-J CALL of roughly the given size, as the bridge forwards it */
+static void putCall(Stream *s, uint32_t id, size_t size) {
+    char head[96];
+    int len = snprintf(head, sizeof(head), "[2,\"%u\",\"RemoteStartTransaction\",{\"idTag\":\"", (unsigned)id);
+    put(s, head, (size_t)len);
+    putRun(s, 'A' + (char)(id % 26), size > (size_t)len + 3 ? size - (size_t)len - 3 : 1);
+    putText(s, "\"}]");
+}
+
+typedef void (*CaseFn)(Stream *s);
+
+static void caseLf(Stream *s) {
+    for (uint32_t i = 0; i < 20; i++) {
+        putCall(s, i, 40 + i * 10);
+        putText(s, "\n");
+    }
+}
+
+static void caseCrLf(Stream *s) {
+    for (uint32_t i = 0; i < 20; i++) {
+        putText(s, i % 2 ? "Heartbeat\r\n" : "Status: OK\r\n");
+    }
+}
+
+static void caseEmptyLines(Stream *s) {
+    putText(s, "\n\r\n\n\r\r\nHeartbeat\n\n");
+}
+
+static void caseBoundaries(Stream *s) {
+    static const size_t lengths[] = {62, 63, 64, 65, 126, 127, 128, 253, 254, 255, 256, 257};
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        putRun(s, 'x', lengths[i]);
+        putText(s, "\nHeartbeat\n");
+        putRun(s, 'y', lengths[i]);
+        putText(s, "\r\nHeartbeat\r\n");
+    }
+}
+
+static void caseLongThenValid(Stream *s) {
+    putRun(s, 'A', 2000);
+    putText(s, "\nHeartbeat\n");
+    putCall(s, 7, 300);
+    putText(s, "\nHeartbeat\n");
+}
+
+static void caseCrOnly(Stream *s) {
+    putText(s, "Heartbeat\rHeartbeat\rStatus: OK\r\n");
+}
+
+static void caseEmbeddedNul(Stream *s) {
+    put(s, "Heart\0beat\n", 11);
+    put(s, "\0\n", 2);
+    putText(s, "Heartbeat\n");
+}
+
+static void caseNewlineStorm(Stream *s) {
+    putRun(s, '\n', 1000);
+    putText(s, "Heartbeat\n");
+}
+
+static void caseNoTerminator(Stream *s) {
+    putText(s, "Heartbeat\nHeartbeat");
+}
+
+static void caseBinary(Stream *s) {
+    for (int i = 0; i < 4096; i++) {
+        uint8_t b = (uint8_t)nextRandom();
+        put(s, &b, 1);
+    }
+    putText(s, "\nHeartbeat\n");
+}
+
+static const struct {
+    const char *name;
+    CaseFn build;
+} cases[] = {
+    {"lf", caseLf},
+    {"crlf", caseCrLf},
+    {"empty_lines", caseEmptyLines},
+    {"boundaries", caseBoundaries},
+    {"long_then_valid", caseLongThenValid},
+    {"cr_only", caseCrOnly},
+    {"embedded_nul", caseEmbeddedNul},
+    {"newline_storm", caseNewlineStorm},
+    {"no_terminator", caseNoTerminator},
+    {"binary", caseBinary},
+};
+
+/* Random lines: lengths across every limit, stray '\r', occasional NULs */
+static void randomStream(Stream *s) {
+    uint32_t lines = 1 + nextRandom() % 20;
+    for (uint32_t l = 0; l < lines; l++) {
+        uint32_t len = nextRandom() % 400;
+        for (uint32_t i = 0; i < len; i++) {
+            uint32_t r = nextRandom() % 1000;
+            uint8_t b = r < 5 ? '\r' : r < 7 ? '\0' : (uint8_t)(' ' + nextRandom() % 95);
+            put(s, &b, 1);
+        }
+        putText(s, nextRandom() % 2 ? "\r\n" : "\n");
+    }
+}
+
+static int runSuite(void) {
+    FramerStats *stats = calloc(framerCount, sizeof(FramerStats));
+    Stream s = {0};
+    int failed = 0;
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        s.len = 0;
+        cases[c].build(&s);
+        for (size_t f = 0; f < framerCount; f++) {
+            failed |= !checkInput(&framers[f], s.data, s.len, &stats[f], cases[c].name) && framers[f].strict;
+        }
+    }
+    for (int r = 0; r < RANDOM_CASES; r++) {
+        s.len = 0;
+        randomStream(&s);
+        for (size_t f = 0; f < framerCount; f++) {
+            failed |= !checkInput(&framers[f], s.data, s.len, &stats[f], "random") && framers[f].strict;
+        }
+    }
+
+    printf("%-20s %5s %6s %6s %5s %5s %4s %-8s %s\n", "framer", "cases", "expect", "ok", "lost", "bogus",
+           "inv", "result", "first failing case");
+    for (size_t f = 0; f < framerCount; f++) {
+        const FramerStats *st = &stats[f];
+        bool clean = !st->lost && !st->bogus && !st->invariant;
+        printf("%-20s %5u %6u %6u %5u %5u %4u %-8s %s\n", framers[f].name, st->cases, st->expected, st->ok,
+               st->lost, st->bogus, st->invariant, clean ? "pass" : framers[f].strict ? "FAIL" : "findings",
+               st->firstFailure ? st->firstFailure : "-");
+    }
+    free(s.data);
+    free(stats);
+    return failed;
+}
+
+/* Benchmark -------------------------------------------------------------------*/
+static void countFrame(void *ctx, const uint8_t *frame, size_t len) {
+    (void)frame;
+    (void)len;
+    ((SinkCtx *)ctx)->frames++;
+}
+
+static double nowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int runBench(size_t megabytes) {
+    Stream s = {0};
+    uint32_t id = 0;
+
+    /* Heartbeats, status lines and CALLs of 60..300 bytes, CRLF terminated */
+    while (s.len < megabytes << 20) {
+        switch (nextRandom() % 4) {
+            case 0: putText(&s, "Heartbeat\r\n"); break;
+            case 1: putText(&s, "Status: OK\r\n"); break;
+            default:
+                putCall(&s, id++, 60 + nextRandom() % 240);
+                putText(&s, "\r\n");
+                break;
+        }
+    }
+
+    printf("%-20s %10s %8s %10s\n", "framer", "MB/s", "ns/byte", "messages");
+    for (size_t f = 0; f < framerCount; f++) {
+        SinkCtx sink = {NULL, &framers[f], 0, 0};
+        double best = 1e30;
+        for (int r = 0; r < BENCH_REPEATS; r++) {
+            sink.frames = 0;
+            framers[f].reset();
+            double start = nowSeconds();
+            for (size_t i = 0; i < s.len; i++) {
+                framers[f].feed(s.data[i], countFrame, &sink);
+            }
+            double elapsed = nowSeconds() - start;
+            best = elapsed < best ? elapsed : best;
+        }
+        printf("%-20s %10.1f %8.2f %10llu\n", framers[f].name, s.len / best / 1e6, best * 1e9 / s.len,
+               (unsigned long long)sink.frames);
+    }
+    free(s.data);
+    return 0;
+}
+
+static int runFiles(int count, char **paths) {
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        FILE *file = fopen(paths[i], "rb");
+        Stream s = {0};
+        uint8_t chunk[4096];
+        size_t n;
+        if (!file) {
+            perror(paths[i]);
+            return 2;
+        }
+        while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            put(&s, chunk, n);
+        }
+        fclose(file);
+        for (size_t f = 0; f < framerCount; f++) {
+            FramerStats stats = {0};
+            bool passed = checkInput(&framers[f], s.data, s.len, &stats, paths[i]);
+            printf("%s: %-20s lost %u, bogus %u, inv %u%s\n", paths[i], framers[f].name, stats.lost, stats.bogus,
+                   stats.invariant, passed ? "" : " FAIL");
+            failed |= !passed;
+        }
+        free(s.data);
+    }
+    return failed;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && !strcmp(argv[1], "bench")) {
+        return runBench(argc > 2 ? strtoul(argv[2], NULL, 10) : 16);
+    }
+    if (argc > 1) {
+        return runFiles(argc - 1, argv + 1);
+    }
+    return runSuite();
+}
+#endif
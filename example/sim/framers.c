@@ -0,0 +1,90 @@
+#include "framers.h"
+
+#include <string.h>
+
+/* STM32F030_UART/src/main.c: messageBuffer, filled from the RX ring in the main loop */
+#include "../../esp32-stm32-uartcomm/STM32F030_UART/src/message_assembler.c"
+
+static MessageAssembler f030Assembler;
+
+static void f030Reset(void) {
+    f030Assembler.index = 0;
+}
+
+static void f030Feed(uint8_t c, FrameSink sink, void *ctx) {
+    if (messageAssemblerFeed(&f030Assembler, c) == MESSAGE_COMPLETE) {
+        // strcmp() on the message; "Error: Msg too long" leaves the rest of the line as a new message
+        sink(ctx, f030Assembler.buffer, strlen((char *)f030Assembler.buffer));
+    }
+}
+
+/* ESP32C3_UART/src/main.cpp: receivedMsg, filled in loop() */
+#include "../../esp32-stm32-uartcomm/ESP32C3_UART/src/msg_assembler.c"
+
+static MsgAssembler c3Assembler;
+
+static void c3Reset(void) {
+    c3Assembler.index = 0;
+}
+
+static void c3Feed(uint8_t byte, FrameSink sink, void *ctx) {
+    if (msgAssemblerFeed(&c3Assembler, (char)byte) == MSG_COMPLETE) {
+        sink(ctx, (const uint8_t *)c3Assembler.msg, strlen(c3Assembler.msg)); // Serial.println(receivedMsg.msg)
+    }
+}
+
+/* example/stm32/main.c (text mode): uartRxLine, the RX interrupt writes each byte in place */
+#include "../stm32/uart_rx_line.h"
+
+static UartRxLine stm32Line;
+
+static void stm32Reset(void) {
+    stm32Line.index = 0;
+}
+
+static void stm32Feed(uint8_t byte, FrameSink sink, void *ctx) {
+    *uartRxLineSlot(&stm32Line) = byte; // HAL_UART_Receive_IT(uartRxLineSlot(&uartRxLine), 1)
+    if (uartRxLineStore(&stm32Line) == UART_RX_COMPLETE) {
+        sink(ctx, (const uint8_t *)stm32Line.buffer, strlen(stm32Line.buffer)); // handleBackendMessage()
+    }
+}
+
+/* Reference: the expected behaviour, length-delimited and overflow-safe */
+#define REFERENCE_MAX_FRAME 254
+
+static uint8_t referenceBuffer[REFERENCE_MAX_FRAME];
+static size_t referenceLen;
+static bool referenceOverflow; // Discarding an over-long line up to its '\n'
+
+static void referenceReset(void) {
+    referenceLen = 0;
+    referenceOverflow = false;
+}
+
+static void referenceFeed(uint8_t c, FrameSink sink, void *ctx) {
+    if (c == '\r') {
+        return;
+    }
+    if (c == '\n') {
+        if (!referenceOverflow && referenceLen > 0) {
+            sink(ctx, referenceBuffer, referenceLen);
+        }
+        referenceReset();
+    } else if (referenceOverflow || referenceLen == REFERENCE_MAX_FRAME) {
+        referenceOverflow = true;
+    } else {
+        referenceBuffer[referenceLen++] = c;
+    }
+}
+
+const Framer framers[] = {
+    {"reference", "sim/framers.c", REFERENCE_MAX_FRAME, true, false, true, referenceReset, referenceFeed},
+    {"f030_messageBuffer", "esp32-stm32-uartcomm/STM32F030_UART/src/message_assembler.c", MESSAGE_BUFFER_SIZE - 1,
+     true, false, false, f030Reset, f030Feed},
+    {"c3_receivedMsg", "esp32-stm32-uartcomm/ESP32C3_UART/src/msg_assembler.c", MAX_MSG_LEN - 1, true, false,
+     false, c3Reset, c3Feed},
+    {"stm32_uartRxBuffer", "example/stm32/uart_rx_line.c", UART_RX_BUFFER_SIZE - 2, false, true, false,
+     stm32Reset, stm32Feed},
+};
+
+const size_t framerCount = sizeof(framers) / sizeof(framers[0]);
@@ -0,0 +1,47 @@
+#ifndef FRAMERS_H
+#define FRAMERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Newline message assemblers under test (sim/framer_fuzz.c).
+ *
+ * The three assemblers in the tree live in their own files, which the
+ * firmware and this suite both compile: message_assembler.c (STM32F030_UART),
+ * msg_assembler.c (ESP32C3_UART) and stm32/uart_rx_line.c. Each one is
+ * wrapped here as a byte-at-a-time function that hands the message on the
+ * way its firmware does, as a NUL-terminated string.
+ *
+ * The reference framer implements the behaviour the suite checks for: strip
+ * '\r', skip empty lines, drop an over-long line completely, and keep
+ * embedded NULs. A replacement assembler is added here with strict = true
+ * and has to match the reference on every input.
+ */
+
+typedef void (*FrameSink)(void *ctx, const uint8_t *frame, size_t len);
+
+typedef struct {
+    const char *name;
+    const char *origin;     // Where the original lives
+    size_t maxFrame;        // Longest message it can deliver
+    bool stripsCr;
+    bool emitsEmpty;        // Delivers "" for an empty line
+    bool strict;            // Must match the reference exactly
+    void (*reset)(void);
+    void (*feed)(uint8_t byte, FrameSink sink, void *ctx);
+} Framer;
+
+extern const Framer framers[];
+extern const size_t framerCount;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FRAMERS_H */
@@ -0,0 +1,217 @@
+/*
+ * RAM per open transaction with strings copied into every message, against
+ * interned strings (common/str_intern.c).
+ *
+ * The model is the charge point side of one transaction while it is open:
+ * the transaction record, the Authorize, StartTransaction and StopTransaction
+ * requests queued for it, and its queued MeterValues with two samples each
+ * (energy and power, as esp32/ocpp_split.cpp sends them). In the copying
+ * layout every record carries its idTag, action, measurand, unit and context
+ * as char arrays sized for the longest value. In the interned layout they are
+ * StrHandles, and the transaction holds one slot of the RAM table for its
+ * idTag. The structs hold no pointers, so their sizes are the same on the
+ * 32-bit target.
+ *
+ * Times are host nanoseconds per call. The run also checks the reference
+ * counting and the constant table and exits with 1 if something is wrong.
+ *
+ * Usage: intern_bench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "str_intern.h"
+
+#define ACTION_LEN    23 // "RemoteStartTransaction"
+#define MEASURAND_LEN 30 // "Energy.Active.Import.Register"
+#define UNIT_LEN      8  // "Celsius"
+#define CONTEXT_LEN   18 // "Transaction.Begin"
+#define SAMPLES       2  // Per MeterValues
+
+/* Copying layout */
+typedef struct {
+    int32_t transactionId;
+    int32_t meterStart;
+    uint32_t startTime;
+    uint8_t connectorId;
+    char idTag[STR_INTERN_LEN + 1];
+} CopyTransaction;
+
+typedef struct {
+    uint32_t uid;
+    char action[ACTION_LEN];
+    char idTag[STR_INTERN_LEN + 1];
+    int32_t transactionId;
+    int32_t meter;
+    uint32_t timestamp;
+} CopyRequest; // Authorize, StartTransaction, StopTransaction
+
+typedef struct {
+    int32_t value;
+    uint32_t timestamp;
+    char measurand[MEASURAND_LEN];
+    char unit[UNIT_LEN];
+    char context[CONTEXT_LEN];
+} CopySample;
+
+typedef struct {
+    uint32_t uid;
+    char action[ACTION_LEN];
+    int32_t transactionId;
+    CopySample samples[SAMPLES];
+} CopyMeterValues;
+
+/* Interned layout */
+typedef struct {
+    int32_t transactionId;
+    int32_t meterStart;
+    uint32_t startTime;
+    uint8_t connectorId;
+    StrHandle idTag;
+} InternTransaction;
+
+typedef struct {
+    uint32_t uid;
+    StrHandle action;
+    StrHandle idTag;
+    int32_t transactionId;
+    int32_t meter;
+    uint32_t timestamp;
+} InternRequest;
+
+typedef struct {
+    int32_t value;
+    uint32_t timestamp;
+    StrHandle measurand;
+    StrHandle unit;
+    StrHandle context;
+} InternSample;
+
+typedef struct {
+    uint32_t uid;
+    StrHandle action;
+    int32_t transactionId;
+    InternSample samples[SAMPLES];
+} InternMeterValues;
+
+#define SLOT_BYTES (1 + STR_INTERN_LEN + 1) // Reference count and text
+
+static int failures;
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static uint64_t monotonicNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static volatile uint32_t sinkHole; // Keeps the timed calls from being optimized away
+
+static void checkTable(void) {
+    StrHandle handles[STR_INTERN_SLOTS + 1];
+    StrInternStats stats;
+    StrHandle tag;
+
+    for (StrHandle h = 1; h <= STR_CONSTANT_COUNT; h++) {
+        const char *text = strText(h);
+        check(strFind(text, strlen(text)) == h, "constant round trip");
+    }
+    check(strFind("Power", 5) == STR_INVALID, "prefix of a constant");
+    check(strFind("Energy.Active.Import.Register.X", 31) == STR_INVALID, "constant is a prefix");
+    check(strIntern("Wh", 2) == STR_Wh, "constant interned as its handle");
+    check(strIntern("", 0) == STR_NONE && strText(STR_NONE)[0] == '\0', "empty string");
+    check(strIntern("ABCDEFGHIJKLMNOPQRSTU", 21) == STR_INVALID, "idTag longer than 20");
+
+    /* One transaction: record, Authorize, StartTransaction, StopTransaction share one slot */
+    tag = strIntern("04A2B3C4D5E6F7", 14);
+    for (int i = 0; i < 3; i++) {
+        check(strIntern("04A2B3C4D5E6F7", 14) == tag, "same idTag, same handle");
+    }
+    strInternStats(&stats);
+    check(stats.inUse == 1 && stats.shared == 3, "shared slot");
+    for (int i = 0; i < 4; i++) {
+        check(!strcmp(strText(tag), "04A2B3C4D5E6F7"), "text while referenced");
+        strRelease(tag);
+    }
+    strInternStats(&stats);
+    check(stats.inUse == 0 && strText(tag)[0] == '\0', "slot free after the last release");
+
+    for (int i = 0; i <= STR_INTERN_SLOTS; i++) {
+        char text[16];
+        snprintf(text, sizeof(text), "TAG-%d", i);
+        handles[i] = strIntern(text, strlen(text));
+    }
+    strInternStats(&stats);
+    check(handles[STR_INTERN_SLOTS] == STR_INVALID && stats.full == 1, "table full");
+    for (int i = 0; i < STR_INTERN_SLOTS; i++) {
+        strRelease(handles[i]);
+    }
+}
+
+static void printRam(uint32_t queued) {
+    uint32_t copy = (uint32_t)(sizeof(CopyTransaction) + 3 * sizeof(CopyRequest) + queued * sizeof(CopyMeterValues));
+    uint32_t intern = (uint32_t)(sizeof(InternTransaction) + 3 * sizeof(InternRequest) +
+                                 queued * sizeof(InternMeterValues)) + SLOT_BYTES;
+    printf("%-28u %8u %10u %9u\n", (unsigned)queued, (unsigned)copy, (unsigned)intern, (unsigned)(copy - intern));
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1000000;
+    static const char *names[] = {"StartTransaction", "Energy.Active.Import.Register", "Wh", "Sample.Periodic"};
+    char copy[MEASURAND_LEN];
+
+    if (!strInternInit()) {
+        fprintf(stderr, "intern_bench: STR_CONSTANTS is not sorted by text\n");
+        return 1;
+    }
+    checkTable();
+
+    printf("constants  %u in flash, RAM table %u slots x %u B\n", (unsigned)STR_CONSTANT_COUNT,
+           (unsigned)STR_INTERN_SLOTS, (unsigned)SLOT_BYTES);
+    printf("bytes                          copied   interned\n");
+    printf("transaction record           %8u %10u\n", (unsigned)sizeof(CopyTransaction),
+           (unsigned)sizeof(InternTransaction));
+    printf("Authorize/Start/StopTx       %8u %10u\n", (unsigned)sizeof(CopyRequest), (unsigned)sizeof(InternRequest));
+    printf("MeterValues, %u samples       %8u %10u\n", (unsigned)SAMPLES, (unsigned)sizeof(CopyMeterValues),
+           (unsigned)sizeof(InternMeterValues));
+    printf("RAM per open transaction, by MeterValues queued (interned incl. its idTag slot)\n");
+    printf("queued MeterValues             copied   interned     saved\n");
+    printRam(1);
+    printRam(10);
+    printRam(60);
+
+    /* Timings */
+    uint64_t t0 = monotonicNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        const char *name = names[i & 3];
+        sinkHole += strFind(name, strlen(name));
+    }
+    double find = (double)(monotonicNs() - t0) / iterations;
+    StrHandle tag = strIntern("04A2B3C4D5E6F7", 14);
+    t0 = monotonicNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        StrHandle h = strIntern("04A2B3C4D5E6F7", 14);
+        sinkHole += h;
+        strRelease(h);
+    }
+    double shared = (double)(monotonicNs() - t0) / iterations;
+    t0 = monotonicNs();
+    for (uint32_t i = 0; i < iterations; i++) {
+        strcpy(copy, names[i & 3]);
+        sinkHole += (uint8_t)copy[0];
+    }
+    double strcpyNs = (double)(monotonicNs() - t0) / iterations;
+    strRelease(tag);
+    printf("ns/call: constant lookup %.1f, intern+release of a held idTag %.1f, strcpy of the text %.1f\n", find,
+           shared, strcpyNs);
+
+    printf("checks: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,328 @@
+/*
+ * Meter value aggregation (common/meter_agg.c) over two days of 1 s readings.
+ *
+ * The readings follow a charger: energy register, power, voltage and current
+ * of two charging sessions a day, each a constant-current phase at 32 A that
+ * tapers off towards the end, with the line voltage drifting around 230 V.
+ * Along the way the sampled interval runs only during the sessions, the
+ * clock-aligned interval changes from 15 min to 7 min (which does not divide
+ * the day), the link drops readings for 10 min, some seconds carry two
+ * readings or none, and the wall clock is stepped forward by an hour and back
+ * by two minutes, as an NTP sync would.
+ *
+ * Every reading goes into a log as well. Each batch the sender takes must
+ * hold exactly the next readings of the log for its kind: min, max, average
+ * and last recomputed from them must match, every reading must lie inside the
+ * batch, and the batch must end on a boundary of its interval unless the
+ * transaction ended, the interval changed or the clock went back. A second
+ * run leaves the sender offline for three hours to show the queue stays
+ * bounded and keeps the newest batches. The run exits with 1 on a mismatch.
+ *
+ * Usage: meter_agg_sim
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fixed_point.h"
+#include "meter_agg.h"
+
+#define DAY0      1760918400u // 2025-10-20 00:00:00 UTC
+#define DAYS      2
+#define LOG_MAX   (DAYS * METER_AGG_DAY + 8192)
+#define CHANNELS  4
+
+typedef struct {
+    uint32_t time;
+    bool sampled; // Taken during a transaction
+    int32_t values[CHANNELS];
+} Reading;
+
+typedef struct {
+    uint32_t cursor; // Next log entry the kind has not seen in a batch
+    uint32_t batches;
+} KindCheck;
+
+static Reading logged[LOG_MAX];
+static uint32_t logCount;
+static KindCheck kinds[METER_AGG_KINDS];
+static uint32_t checkInterval[METER_AGG_KINDS]; // The interval the queued batches ran with
+static int failures;
+static uint64_t addNs, adds;
+static double energyMilliWh;
+
+static void printLine(void *ctx, const char *line) {
+    (void)ctx;
+    puts(line);
+}
+
+static uint64_t monotonicNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void fail(const char *what, const MeterAggBatch *b) {
+    if (failures < 10) {
+        printf("  %s batch %lu..%lu (%lu samples): %s\n", b->kind == METER_AGG_SAMPLED ? "sampled" : "aligned",
+               (unsigned long)(b->start - DAY0), (unsigned long)(b->end - DAY0), (unsigned long)b->samples, what);
+    }
+    failures++;
+}
+
+/* A session's current at t seconds into it: 32 A, tapering over its last quarter */
+static double sessionAmps(double t, double length) {
+    double taper = 0.75 * length;
+    return t < taper ? 32.0 : 6.0 + 26.0 * exp(-(t - taper) / (0.08 * length));
+}
+
+static void reading(uint32_t trueTime, bool charging, double sessionT, double sessionLength, int32_t *values) {
+    double volts = 230.0 + 4.0 * sin(trueTime * 2e-4) + 1.5 * sin(trueTime * 0.013);
+    double amps = charging ? sessionAmps(sessionT, sessionLength) : 0.0;
+
+    energyMilliWh += volts * amps / 3.6; // One second
+    values[0] = (int32_t)(energyMilliWh / 1000.0); // Energy.Active.Import.Register, Wh
+    values[1] = (int32_t)lround(volts * amps);     // Power.Active.Import, W
+    values[2] = (int32_t)lround(volts * 10.0);     // Voltage, 0.1 V
+    values[3] = (int32_t)lround(amps * 100.0);     // Current.Import, 0.01 A
+}
+
+static void checkBatch(const MeterAggBatch *b) {
+    KindCheck *k = &kinds[b->kind];
+    uint32_t interval = checkInterval[b->kind], taken = 0, i = k->cursor;
+    bool boundary = b->end == b->start + interval || b->end % METER_AGG_DAY == 0; // Closed at its end
+    MeterAggValues expect[CHANNELS];
+    int64_t sums[CHANNELS] = {0};
+
+    for (; i < logCount && taken < b->samples; i++) {
+        const Reading *r = &logged[i];
+        if (b->kind == METER_AGG_SAMPLED && !r->sampled) {
+            continue;
+        }
+        if (r->time < b->start || r->time > b->end || (r->time == b->end && boundary)) {
+            fail("reading outside the batch", b);
+        }
+        for (int c = 0; c < CHANNELS; c++) {
+            int32_t v = r->values[c];
+            if (!taken) {
+                expect[c].min = expect[c].max = v;
+            }
+            expect[c].min = v < expect[c].min ? v : expect[c].min;
+            expect[c].max = v > expect[c].max ? v : expect[c].max;
+            expect[c].last = v;
+            sums[c] += v;
+        }
+        taken++;
+    }
+    k->cursor = i;
+    k->batches++;
+    if (taken != b->samples) {
+        fail("fewer readings in the log", b);
+        return;
+    }
+    for (int c = 0; c < CHANNELS; c++) {
+        double avg = (double)sums[c] / taken;
+        expect[c].avg = (int32_t)(avg < 0 ? ceil(avg - 0.5) : floor(avg + 0.5));
+        if (b->values[c].min != expect[c].min || b->values[c].max != expect[c].max ||
+            b->values[c].avg != expect[c].avg || b->values[c].last != expect[c].last) {
+            fail("statistics differ from the log", b);
+        }
+    }
+}
+
+/* Boundary checks: full intervals end on the grid */
+static uint32_t onGrid, offGrid;
+
+static void checkBoundary(const MeterAggBatch *b, uint32_t sampledFrom) {
+    uint32_t interval = checkInterval[b->kind];
+    uint32_t anchor = b->kind == METER_AGG_ALIGNED ? b->end - b->end % METER_AGG_DAY : sampledFrom;
+
+    if (b->kind == METER_AGG_ALIGNED && b->end % METER_AGG_DAY == 0) {
+        onGrid++; // Midnight
+    } else if (b->end > anchor && (b->end - anchor) % interval == 0) {
+        onGrid++;
+    } else {
+        offGrid++; // Transaction end, interval change or clock step
+    }
+}
+
+static void drain(MeterAgg *agg, uint32_t sampledFrom, bool check, uint32_t *taken, MeterAggBatch *lastTaken) {
+    MeterAggBatch b;
+
+    while (meterAggTake(agg, &b)) {
+        if (check) {
+            checkBatch(&b);
+            checkBoundary(&b, sampledFrom);
+        }
+        *lastTaken = b;
+        (*taken)++;
+    }
+}
+
+static void setupChannels(MeterAgg *agg) {
+    meterAggInit(agg);
+    meterAggAddChannel(agg, STR_EnergyActiveImportRegister, STR_Wh, METER_AGG_PHASE_NONE, 0, true);
+    meterAggAddChannel(agg, STR_PowerActiveImport, STR_W, METER_AGG_PHASE_NONE, 0, false);
+    meterAggAddChannel(agg, STR_Voltage, STR_V, METER_AGG_PHASE_L1, 1, false);
+    meterAggAddChannel(agg, STR_CurrentImport, STR_A, METER_AGG_PHASE_L1, 2, false);
+}
+
+/* Two sessions a day: 07:30 for 3 h 30 s and 18:00 for 5 h 17 s, true time */
+static bool inSession(uint32_t t, double *sessionT, double *length) {
+    uint32_t s = t % METER_AGG_DAY;
+    if (s >= 27000 && s < 27000 + 10830) {
+        *sessionT = s - 27000;
+        *length = 10830;
+        return true;
+    }
+    if (s >= 64800 && s < 64800 + 18017) {
+        *sessionT = s - 64800;
+        *length = 18017;
+        return true;
+    }
+    return false;
+}
+
+static void run(bool check, uint32_t offlineFrom, uint32_t offlineFor) {
+    static MeterAgg agg;
+    MeterAggBatch lastTaken = {0};
+    uint32_t skew = 0, taken = 0, sampledFrom = 0, rng = 12345;
+    bool charging = false;
+
+    setupChannels(&agg);
+    meterAggSetInterval(&agg, METER_AGG_SAMPLED, 60, DAY0);
+    meterAggSetInterval(&agg, METER_AGG_ALIGNED, 900, DAY0);
+    checkInterval[METER_AGG_SAMPLED] = 60;
+    checkInterval[METER_AGG_ALIGNED] = 900;
+    logCount = 0;
+    kinds[0] = kinds[1] = (KindCheck){0, 0};
+    onGrid = offGrid = 0;
+    energyMilliWh = 0.0;
+
+    for (uint32_t t = DAY0; t < DAY0 + DAYS * METER_AGG_DAY; t++) {
+        double sessionT = 0.0, length = 1.0;
+        bool session = inSession(t, &sessionT, &length);
+        uint32_t wall = t + skew, readings = 1;
+        int32_t values[CHANNELS];
+
+        if (t == DAY0 + 36000) {
+            skew += 3600; // NTP sync steps the clock forward an hour
+            wall = t + skew;
+        }
+        if (t == DAY0 + METER_AGG_DAY + 70000) {
+            skew -= 120; // And back two minutes, inside the evening session
+            wall = t + skew;
+        }
+        if (t == DAY0 + METER_AGG_DAY) {
+            drain(&agg, sampledFrom, check, &taken, &lastTaken);
+            meterAggSetInterval(&agg, METER_AGG_ALIGNED, 420, wall); // 7 min: 205 intervals and 300 s to midnight
+            drain(&agg, sampledFrom, check, &taken, &lastTaken);     // The cut 15 min batch
+            checkInterval[METER_AGG_ALIGNED] = 420;
+        }
+        if (session != charging) {
+            charging = session;
+            if (charging) {
+                meterAggStart(&agg, wall);
+                sampledFrom = wall;
+            } else {
+                meterAggStop(&agg, wall);
+            }
+        }
+
+        rng = rng * 1103515245u + 12345u;
+        if ((rng >> 16) % 97 == 0) {
+            readings = 0; // A reading lost on the link
+        } else if ((rng >> 16) % 89 == 0) {
+            readings = 2; // Two windows in the same second
+        }
+        if (t >= DAY0 + 50000 && t < DAY0 + 50600) {
+            readings = 0; // Link down for 10 min
+        }
+        for (uint32_t n = 0; n < readings; n++) {
+            reading(t, charging, sessionT, length, values);
+            if (logCount < LOG_MAX) {
+                Reading *r = &logged[logCount++];
+                r->time = wall;
+                r->sampled = charging;
+                for (int c = 0; c < CHANNELS; c++) {
+                    r->values[c] = values[c];
+                }
+            }
+            uint64_t t0 = monotonicNs();
+            meterAggAdd(&agg, wall, values);
+            addNs += monotonicNs() - t0;
+            adds++;
+        }
+        if (!readings) {
+            meterAggPoll(&agg, wall);
+        }
+        if (t % 5 == 0 && !(t >= offlineFrom && t < offlineFrom + offlineFor)) {
+            drain(&agg, sampledFrom, check, &taken, &lastTaken); // The sender runs every 5 s
+        }
+    }
+    meterAggPoll(&agg, DAY0 + DAYS * METER_AGG_DAY + skew);
+    drain(&agg, sampledFrom, check, &taken, &lastTaken);
+
+    if (check) {
+        printf("%lu readings, %lu sampled batches, %lu aligned batches, %lu on their grid, %lu cut short\n",
+               (unsigned long)logCount, (unsigned long)kinds[METER_AGG_SAMPLED].batches,
+               (unsigned long)kinds[METER_AGG_ALIGNED].batches, (unsigned long)onGrid, (unsigned long)offGrid);
+        printf("clock steps %lu, dropped %lu, last batch ends %lu s after day 0\n",
+               (unsigned long)agg.clockSteps, (unsigned long)agg.dropped, (unsigned long)(lastTaken.end - DAY0));
+        if (agg.dropped || agg.clockSteps != 2) {
+            printf("  expected no drops and one clock step in each kind\n");
+            failures++;
+        }
+    } else {
+        printf("sender offline %lu s: %lu batches taken, %lu dropped, %u queued at most\n", (unsigned long)offlineFor,
+               (unsigned long)taken, (unsigned long)agg.dropped, (unsigned)METER_AGG_QUEUE);
+        if (!agg.dropped || taken + agg.dropped != agg.batches) {
+            printf("  expected drops, every batch taken or dropped\n");
+            failures++;
+        }
+    }
+    meterAggExport(&agg, printLine, NULL);
+}
+
+int main(void) {
+    static MeterAgg agg;
+    MeterAggBatch b;
+    char text[4][16], low[16], high[16];
+
+    if (!strInternInit()) {
+        return 1;
+    }
+    printf("MeterAgg %u bytes: %u channels, %u queued batches of %u bytes\n", (unsigned)sizeof(MeterAgg),
+           (unsigned)METER_AGG_CHANNELS, (unsigned)METER_AGG_QUEUE, (unsigned)sizeof(MeterAggBatch));
+    run(true, 0, 0);
+    run(false, DAY0 + 64800, 3 * 3600);
+    printf("cpu: meterAggAdd %.1f ns per reading of %u channels (host)\n", (double)addNs / adds, (unsigned)CHANNELS);
+
+    /* One clock-aligned batch as the MeterValues sender renders it */
+    setupChannels(&agg);
+    meterAggSetInterval(&agg, METER_AGG_ALIGNED, 900, DAY0);
+    energyMilliWh = 0.0;
+    for (uint32_t t = DAY0 + 27000; t <= DAY0 + 27900; t++) {
+        int32_t values[CHANNELS];
+        reading(t, true, t - DAY0 - 27000, 10830, values);
+        meterAggAdd(&agg, t, values);
+    }
+    meterAggExport(&agg, printLine, NULL);
+    while (meterAggTake(&agg, &b)) {
+        for (int c = 0; c < agg.channelCount; c++) {
+            uint8_t decimals = agg.channels[c].decimals;
+            fxFormat(text[c], sizeof(text[c]), meterAggValue(&agg, &b, c), decimals);
+            fxFormat(low, sizeof(low), b.values[c].min, decimals);
+            fxFormat(high, sizeof(high), b.values[c].max, decimals);
+            printf("%s %lu..%lu %-29s %-3s %-2s %10s  (min %s max %s, %lu samples)\n",
+                   b.kind == METER_AGG_ALIGNED ? "Sample.Clock" : "Sample.Periodic", (unsigned long)(b.start - DAY0),
+                   (unsigned long)(b.end - DAY0), strText(agg.channels[c].measurand), strText(agg.channels[c].unit),
+                   meterAggPhaseName(agg.channels[c].phase), text[c], low, high, (unsigned long)b.samples);
+        }
+    }
+    if (failures) {
+        printf("%d mismatches\n", failures);
+        return 1;
+    }
+    return 0;
+}
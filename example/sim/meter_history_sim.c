@@ -0,0 +1,553 @@
+/*
+ * Compressed meter history (common/meter_history.c) on modelled charging days.
+ *
+ * A week of 1 s readings as the STM32 sends them in split mode: energy
+ * register, power, voltage and current. Each day has a morning and an evening
+ * session at 16 A or 32 A, with a soft start, a constant-current phase and a
+ * taper over the last quarter. The line voltage drifts around 230 V, and the
+ * voltage and current carry the noise of an ADC reading. The same readings
+ * also go through the MeterValues aggregation (60 s sampled during the
+ * sessions, 900 s aligned), and the batches are stored the way the ESP32
+ * keeps them while offline: the kind and the four reported values.
+ *
+ * For each stream it reports the bits per sample, the bytes stored with the
+ * block headers and padding, and the host time to encode and decode. Then it
+ * fills an F030-sized region (4 x 1 KB) and an ESP32 partition (16 x 4 KB)
+ * with the charging readings until the first sample is dropped, to show how
+ * long an outage they cover.
+ *
+ * The checks decode everything held and compare it with a model, sample for
+ * sample:
+ *   - both streams, and random extremes (time jumps both ways, INT32_MIN and
+ *     INT32_MAX) in RAM only and with flash;
+ *   - uploads of random lengths, overflow of a full history, and resets
+ *     (RAM lost, flash mounted again);
+ *   - 1000 power cuts at random points in programs and erases. After each
+ *     cut the mount must give back the flash contents from just before or
+ *     just after the interrupted operation (an upload over several blocks
+ *     may stop between them), then take new samples.
+ * The run exits with 1 on a mismatch.
+ *
+ * Usage: meter_history_sim [power cuts]
+ */
+#include <math.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "meter_agg.h"
+#include "meter_history.h"
+
+#define DAY0        1760918400u // 2025-10-20 00:00:00 UTC
+#define DAYS        7
+#define READINGS    (DAYS * METER_AGG_DAY)
+#define BATCHES_MAX 16384
+#define CUT_OPS     12000 // Operations of one power cut run
+#define EXPECT_RING 65536
+
+typedef struct {
+    uint32_t time;
+    int32_t values[METER_HISTORY_CHANNELS];
+} Sample;
+
+typedef struct {
+    uint8_t *mem;
+    uint32_t pageSize;
+    uint32_t pages;
+    long cutAfter; // Program half-words and erases until the power cut, -1 for none
+    long points;   // Cut points passed
+} SimFlash;
+
+static Sample readings[READINGS];
+static bool sessionAt[READINGS];
+static Sample charging[READINGS]; // The readings of the sessions only
+static uint32_t chargingCount;
+static Sample batches[BATCHES_MAX];
+static uint32_t batchCount;
+static Sample edges[20000];
+
+static SimFlash flash;
+static MeterHistoryDevice device;
+static MeterHistory history;
+static jmp_buf powerCut;
+static int failures;
+
+static void printLine(void *ctx, const char *line) {
+    (void)ctx;
+    puts(line);
+}
+
+static uint64_t monotonicNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void fail(const char *what, unsigned long at) {
+    if (failures < 10) {
+        printf("  FAIL %s at %lu\n", what, at);
+    }
+    failures++;
+}
+
+/* Flash */
+
+static void cutPoint(void) {
+    flash.points++;
+    if (flash.cutAfter == 0) {
+        flash.cutAfter = -1;
+        longjmp(powerCut, 1);
+    }
+    if (flash.cutAfter > 0) {
+        flash.cutAfter--;
+    }
+}
+
+static bool simProgram(void *ctx, uint32_t offset, const uint16_t *data, uint32_t halfWords) {
+    SimFlash *f = ctx;
+    for (uint32_t i = 0; i < halfWords; i++, offset += 2) {
+        uint16_t old;
+        cutPoint();
+        memcpy(&old, &f->mem[offset], 2);
+        if (old != 0xFFFF && data[i] != 0) {
+            fprintf(stderr, "meter_history_sim: program over written flash at 0x%05x\n", (unsigned)offset);
+            exit(1);
+        }
+        memcpy(&f->mem[offset], &data[i], 2);
+    }
+    return true;
+}
+
+static bool simErase(void *ctx, uint32_t page) {
+    SimFlash *f = ctx;
+    if (f->cutAfter == 0) {
+        for (uint32_t i = 0; i < f->pageSize; i++) {
+            if (rand() & 1) {
+                f->mem[page * f->pageSize + i] = 0xFF;
+            }
+        }
+    } else {
+        memset(&f->mem[page * f->pageSize], 0xFF, f->pageSize);
+    }
+    cutPoint();
+    return true;
+}
+
+/* An erased region of pages x pageSize */
+static const MeterHistoryDevice *newFlash(uint32_t pageSize, uint32_t pages) {
+    free(flash.mem);
+    flash.mem = malloc((size_t)pageSize * pages);
+    memset(flash.mem, 0xFF, (size_t)pageSize * pages);
+    flash.pageSize = pageSize;
+    flash.pages = pages;
+    flash.cutAfter = -1;
+    device = (MeterHistoryDevice){flash.mem, pageSize, pages, simProgram, simErase, &flash};
+    return &device;
+}
+
+/* Workloads */
+
+static double noise(double amplitude) {
+    return amplitude * (2.0 * rand() / RAND_MAX - 1.0);
+}
+
+/* A session's current t seconds into it: 5 s soft start, then constant current, tapering over the last quarter */
+static double sessionAmps(double t, double length, double amps) {
+    double taper = 0.75 * length;
+    if (t < 5.0) {
+        return amps * t / 5.0;
+    }
+    return t < taper ? amps : 6.0 + (amps - 6.0) * exp(-(t - taper) / (0.08 * length));
+}
+
+static void generateReadings(void) {
+    double milliWh = 0.0;
+
+    srand(7);
+    for (uint32_t day = 0; day < DAYS; day++) {
+        uint32_t starts[2], lengths[2];
+        double amps[2];
+        starts[0] = day * METER_AGG_DAY + 7 * 3600 + (uint32_t)(rand() % 3600);
+        starts[1] = day * METER_AGG_DAY + 18 * 3600 + (uint32_t)(rand() % 7200);
+        for (int s = 0; s < 2; s++) {
+            lengths[s] = (uint32_t)(2 + rand() % 4) * 3600 + (uint32_t)(rand() % 1800);
+            amps[s] = rand() % 2 ? 32.0 : 16.0;
+        }
+        for (uint32_t t = day * METER_AGG_DAY; t < (day + 1) * METER_AGG_DAY; t++) {
+            double volts = 230.0 + 4.0 * sin(t * 2e-4) + 1.5 * sin(t * 0.013) + noise(0.3);
+            double current = 0.0;
+            for (int s = 0; s < 2; s++) {
+                if (t >= starts[s] && t < starts[s] + lengths[s]) {
+                    current = sessionAmps(t - starts[s], lengths[s], amps[s]) + noise(0.05);
+                    sessionAt[t] = true;
+                }
+            }
+            milliWh += volts * current * 0.99 / 3.6; // One second at PF 0.99
+            readings[t].time = DAY0 + t;
+            readings[t].values[0] = (int32_t)(milliWh / 1000.0);             // Energy.Active.Import.Register, Wh
+            readings[t].values[1] = (int32_t)lround(volts * current * 0.99); // Power.Active.Import, W
+            readings[t].values[2] = (int32_t)lround(volts * 10.0);           // Voltage, 0.1 V
+            readings[t].values[3] = (int32_t)lround(current * 100.0);        // Current.Import, 0.01 A
+            if (sessionAt[t]) {
+                charging[chargingCount++] = readings[t];
+            }
+        }
+    }
+}
+
+/* What the ESP32 stores for an offline MeterValues batch: kind, then the reported values */
+static void generateBatches(void) {
+    MeterAgg agg;
+    MeterAggBatch batch;
+
+    meterAggInit(&agg);
+    meterAggAddChannel(&agg, STR_EnergyActiveImportRegister, STR_Wh, METER_AGG_PHASE_NONE, 0, true);
+    meterAggAddChannel(&agg, STR_PowerActiveImport, STR_W, METER_AGG_PHASE_NONE, 0, false);
+    meterAggAddChannel(&agg, STR_Voltage, STR_V, METER_AGG_PHASE_L1, 1, false);
+    meterAggAddChannel(&agg, STR_CurrentImport, STR_A, METER_AGG_PHASE_L1, 2, false);
+    meterAggSetInterval(&agg, METER_AGG_SAMPLED, 60, DAY0);
+    meterAggSetInterval(&agg, METER_AGG_ALIGNED, 900, DAY0);
+    for (uint32_t t = 0; t < READINGS; t++) {
+        if (sessionAt[t] != (t && sessionAt[t - 1])) {
+            (sessionAt[t] ? meterAggStart : meterAggStop)(&agg, readings[t].time);
+        }
+        meterAggAdd(&agg, readings[t].time, readings[t].values);
+        while (meterAggTake(&agg, &batch) && batchCount < BATCHES_MAX) {
+            Sample *s = &batches[batchCount++];
+            s->time = batch.end;
+            s->values[0] = batch.kind;
+            for (int c = 0; c < 4; c++) {
+                s->values[1 + c] = meterAggValue(&agg, &batch, c);
+            }
+        }
+    }
+}
+
+static void generateEdges(void) {
+    static const int32_t extremes[] = {0, 1, -1, INT32_MAX, INT32_MIN, 65535, -65536, 15, -16};
+    uint32_t time = 0;
+
+    srand(11);
+    for (uint32_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        uint32_t step = (uint32_t)rand();
+        time += rand() % 4 ? (uint32_t)(rand() % 5) : step ^ ((uint32_t)rand() << 16); // Jumps both ways
+        edges[i].time = time;
+        for (int c = 0; c < METER_HISTORY_CHANNELS; c++) {
+            int32_t prev = i ? edges[i - 1].values[c] : 0;
+            switch (rand() % 4) {
+                case 0:  edges[i].values[c] = extremes[rand() % 9]; break;
+                case 1:  edges[i].values[c] = (int32_t)((uint32_t)rand() << 17 ^ (uint32_t)rand()); break;
+                default: edges[i].values[c] = prev + rand() % 41 - 20; break;
+            }
+        }
+    }
+}
+
+/* Checks */
+
+static bool sameSample(const Sample *a, uint32_t time, const int32_t *values, uint8_t channels) {
+    return a->time == time && !memcmp(a->values, values, channels * sizeof(int32_t));
+}
+
+/* Everything held must be model[from..to), in order */
+static void expectHeld(const Sample *model, uint32_t from, uint32_t to, uint8_t channels, const char *what) {
+    MeterHistoryCursor cursor;
+    uint32_t time, i = from;
+    int32_t values[METER_HISTORY_CHANNELS];
+
+    if (history.count != to - from) {
+        fail(what, (unsigned long)history.count);
+        return;
+    }
+    meterHistoryBegin(&history, &cursor);
+    while (meterHistoryNext(&history, &cursor, &time, values)) {
+        if (i >= to || !sameSample(&model[i], time, values, channels)) {
+            fail(what, (unsigned long)(i - from));
+            return;
+        }
+        i++;
+    }
+    if (i != to) {
+        fail(what, (unsigned long)(i - from));
+    }
+    if (history.stats.appended - history.stats.uploaded - history.stats.dropped != history.count) {
+        fail("sample accounting", (unsigned long)history.count);
+    }
+}
+
+static void expectRing(const Sample *model, const uint32_t *ring, uint32_t front, uint32_t count, uint8_t channels,
+                       const char *what) {
+    MeterHistoryCursor cursor;
+    uint32_t time, i = 0;
+    int32_t values[METER_HISTORY_CHANNELS];
+
+    if (history.count != count) {
+        fail(what, (unsigned long)history.count);
+        return;
+    }
+    meterHistoryBegin(&history, &cursor);
+    while (meterHistoryNext(&history, &cursor, &time, values)) {
+        if (i >= count || !sameSample(&model[ring[(front + i) % EXPECT_RING]], time, values, channels)) {
+            fail(what, (unsigned long)i);
+            return;
+        }
+        i++;
+    }
+    if (i != count) {
+        fail(what, (unsigned long)i);
+    }
+}
+
+static uint32_t ramSamples(void) {
+    uint32_t n = 0;
+    for (uint32_t b = 0; b < history.ramCount; b++) {
+        n += history.ram[(history.ramHead + b) % METER_HISTORY_RAM_BLOCKS].count;
+    }
+    return n;
+}
+
+/*
+ * Appends model[0..n) with uploads of random length every so often. With
+ * resets, the history is mounted again at random points: the RAM blocks are
+ * lost, and the samples already uploaded from a partly uploaded flash block
+ * come back. The expected samples are model indexes in a ring that keeps
+ * the uploaded ones behind its front for that.
+ */
+static void churn(const Sample *model, uint32_t n, uint8_t channels, const MeterHistoryDevice *dev, bool resets,
+                  const char *what) {
+    static uint32_t ring[EXPECT_RING];
+    uint32_t front = 0, count = 0;
+
+    meterHistoryInit(&history, channels, dev);
+    for (uint32_t i = 0; i < n; i++) {
+        meterHistoryAppend(&history, model[i].time, model[i].values);
+        ring[(front + count++) % EXPECT_RING] = i;
+        if (rand() % 50 == 0) {
+            meterHistoryDrop(&history, (uint32_t)(rand() % 120));
+        }
+        front += count - history.count; // Uploads and overflow take the oldest
+        count = history.count;
+        if (resets && rand() % 1500 == 0) {
+            uint32_t flashHeld = history.count + history.skip - ramSamples();
+            front -= flashHeld ? history.skip : 0;
+            count = flashHeld;
+            meterHistoryInit(&history, channels, dev);
+        } else if (i % 97 && i + 1 < n) {
+            continue;
+        }
+        expectRing(model, ring, front, count, channels, what);
+    }
+}
+
+/* Measurements */
+
+static void measure(const char *name, const Sample *s, uint32_t n, uint8_t channels) {
+    MeterHistoryCursor cursor;
+    uint32_t time, stored;
+    int32_t values[METER_HISTORY_CHANNELS];
+    uint64_t start, encodeNs, decodeNs;
+
+    meterHistoryInit(&history, channels, newFlash(4096, 512)); // 2 MB: holds all of it
+    start = monotonicNs();
+    for (uint32_t i = 0; i < n; i++) {
+        meterHistoryAppend(&history, s[i].time, s[i].values);
+    }
+    encodeNs = monotonicNs() - start;
+    start = monotonicNs();
+    meterHistoryBegin(&history, &cursor);
+    while (meterHistoryNext(&history, &cursor, &time, values)) {
+    }
+    decodeNs = monotonicNs() - start;
+    expectHeld(s, 0, n, channels, name);
+
+    stored = (history.stats.spilled + history.ramCount) * METER_HISTORY_BLOCK;
+    printf("%-22s %7lu  %5.2f B  %5.2f B  %3u B  %5.1fx  %5.1f ns  %5.1f ns\n", name, (unsigned long)n,
+           history.stats.bits / 8.0 / n, (double)stored / n, (unsigned)(4 + 4 * channels),
+           (4.0 + 4.0 * channels) * n / stored, (double)encodeNs / n, (double)decodeNs / n);
+}
+
+/* Fills a region until the first sample is dropped */
+static void capacity(const char *name, const Sample *s, uint32_t n, uint8_t channels, uint32_t pageSize,
+                     uint32_t pages) {
+    uint32_t i = 0;
+
+    meterHistoryInit(&history, channels, newFlash(pageSize, pages));
+    while (i < n && !history.stats.dropped) {
+        meterHistoryAppend(&history, s[i].time, s[i].values);
+        i++;
+    }
+    if (!history.stats.dropped) {
+        printf("%-22s %2u x %4u B + %4u B RAM: all %lu samples (%.1f days) in %lu blocks\n", name,
+               (unsigned)pages, (unsigned)pageSize, (unsigned)sizeof(history.ram), (unsigned long)n,
+               (s[n - 1].time - s[0].time) / 86400.0, (unsigned long)(history.stats.spilled + history.ramCount));
+        return;
+    }
+    printf("%-22s %2u x %4u B + %4u B RAM: %lu samples, %.1f h, then the oldest page goes\n", name,
+           (unsigned)pages, (unsigned)pageSize, (unsigned)sizeof(history.ram), (unsigned long)(i - 1),
+           (s[i - 2].time - s[0].time) / 3600.0);
+}
+
+/* Power cuts */
+
+typedef struct {
+    uint32_t start; // Index of the first sample a mount would give back
+    uint32_t end;
+} FlashView;
+
+static int32_t ops[CUT_OPS];             // -1: append the next reading, else upload that many
+static FlashView views[CUT_OPS + 1];     // After each operation, in a run without cuts
+
+static FlashView flashView(uint32_t appended) {
+    uint32_t flashHeld = history.count + history.skip - ramSamples();
+    uint32_t front = appended - history.count;
+    FlashView v = {front - (flashHeld ? history.skip : 0), 0};
+    v.end = v.start + flashHeld;
+    return v;
+}
+
+/* Runs ops until the cut, or to the end; returns the operation the cut hit, or CUT_OPS */
+static uint32_t runOps(uint32_t *appended, bool record) {
+    volatile uint32_t op = 0;
+
+    *appended = 0;
+    if (setjmp(powerCut)) {
+        return op;
+    }
+    for (; op < CUT_OPS; op++) {
+        if (ops[op] < 0) {
+            meterHistoryAppend(&history, charging[*appended].time, charging[*appended].values);
+            (*appended)++;
+        } else {
+            meterHistoryDrop(&history, (uint32_t)ops[op]);
+        }
+        if (record) {
+            views[op + 1] = flashView(*appended);
+        }
+    }
+    return op;
+}
+
+/*
+ * What the mount gives back must be charging[start..end), with start between
+ * the two starts and end one of the two ends. A start may go back: the samples
+ * of a partly uploaded block come back once it is in flash.
+ */
+static bool viewMatches(FlashView before, FlashView after) {
+    MeterHistoryCursor cursor;
+    uint32_t time, lo = 0, hi = chargingCount, i;
+    uint32_t first = before.start < after.start ? before.start : after.start;
+    uint32_t last = before.start < after.start ? after.start : before.start;
+    uint32_t endBefore = before.end, endAfter = after.end;
+    int32_t values[METER_HISTORY_CHANNELS];
+
+    meterHistoryBegin(&history, &cursor);
+    if (!meterHistoryNext(&history, &cursor, &time, values)) {
+        return !history.count && ((endBefore >= first && endBefore <= last) || (endAfter >= first && endAfter <= last));
+    }
+    while (lo < hi) { // Times only go up: find the first sample's index
+        uint32_t mid = (lo + hi) / 2;
+        if (charging[mid].time < time) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < first || lo > last || (lo + history.count != endBefore && lo + history.count != endAfter)) {
+        return false;
+    }
+    for (i = lo;; i++) {
+        if (!sameSample(&charging[i], time, values, 4)) {
+            return false;
+        }
+        if (!meterHistoryNext(&history, &cursor, &time, values)) {
+            return i + 1 == lo + history.count;
+        }
+    }
+}
+
+static void powerCuts(uint32_t cuts) {
+    uint32_t appended, skipped = 0;
+    long points;
+
+    srand(23);
+    for (uint32_t i = 0; i < CUT_OPS; i++) {
+        bool offline = (i / 4000) % 2; // Uploads stop for a while: the flash wraps
+        ops[i] = !offline && rand() % 100 == 0 ? rand() % 150 : -1;
+    }
+    meterHistoryInit(&history, 4, newFlash(1024, 4));
+    flash.points = 0;
+    runOps(&appended, true);
+    points = flash.points;
+    printf("power cut run: %lu operations, %lu samples, %lu uploaded, %lu dropped, %lu blocks spilled, %lu erases\n",
+           (unsigned long)CUT_OPS, (unsigned long)appended, (unsigned long)history.stats.uploaded,
+           (unsigned long)history.stats.dropped, (unsigned long)history.stats.spilled,
+           (unsigned long)history.ring.erases);
+
+    for (uint32_t cut = 0; cut < cuts; cut++) {
+        uint32_t op, more = 0;
+
+        meterHistoryInit(&history, 4, newFlash(1024, 4));
+        flash.cutAfter = rand() % points;
+        op = runOps(&appended, false);
+        flash.cutAfter = -1;
+        meterHistoryInit(&history, 4, &device);
+        skipped += history.stats.skipped;
+
+        /* Either end may be where it was before or after the interrupted operation; an upload may stop between blocks */
+        if (!viewMatches(views[op], views[op + 1])) {
+            fail("power cut", (unsigned long)op);
+            continue;
+        }
+        /* Takes new samples after the mount */
+        uint32_t held = history.count;
+        while (more < 300 && appended + more < chargingCount) {
+            meterHistoryAppend(&history, charging[appended + more].time, charging[appended + more].values);
+            more++;
+        }
+        if (history.count != held + more - history.stats.dropped) {
+            fail("appends after a power cut", (unsigned long)op);
+        }
+    }
+    printf("power cuts %lu over %ld cut points, %lu unfinished blocks skipped by the mount\n",
+           (unsigned long)cuts, points, (unsigned long)skipped);
+}
+
+int main(int argc, char **argv) {
+    uint32_t cuts = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1000;
+
+    generateReadings();
+    generateBatches();
+    generateEdges();
+    printf("MeterHistory %u bytes: %u RAM blocks of %u bytes, up to %u channels\n", (unsigned)sizeof(MeterHistory),
+           (unsigned)METER_HISTORY_RAM_BLOCKS, (unsigned)METER_HISTORY_BLOCK, (unsigned)METER_HISTORY_CHANNELS);
+
+    printf("%-22s %7s  %7s  %7s  %5s  %6s  %8s  %8s\n", "stream", "samples", "encoded", "stored", "raw", "ratio",
+           "encode", "decode");
+    measure("readings 1 s", readings, READINGS, 4);
+    meterHistoryExport(&history, printLine, NULL);
+    measure("readings 1 s, charging", charging, chargingCount, 4);
+    measure("MeterValues batches", batches, batchCount, 5);
+    measure("random extremes", edges, sizeof(edges) / sizeof(edges[0]), METER_HISTORY_CHANNELS);
+
+    capacity("readings 1 s, charging", charging, chargingCount, 4, 1024, 4);
+    capacity("readings 1 s, charging", charging, chargingCount, 4, 4096, 16);
+    capacity("MeterValues batches", batches, batchCount, 5, 4096, 16);
+
+    srand(5);
+    churn(readings, READINGS / 2, 4, NULL, false, "RAM only, uploads");
+    churn(readings, READINGS / 2, 4, newFlash(1024, 4), true, "4 KB flash, uploads and resets");
+    churn(batches, batchCount, 5, newFlash(1024, 2), true, "2 KB flash, batches");
+    churn(edges, sizeof(edges) / sizeof(edges[0]), METER_HISTORY_CHANNELS, NULL, false, "RAM only, extremes");
+    churn(edges, sizeof(edges) / sizeof(edges[0]), METER_HISTORY_CHANNELS, newFlash(1024, 4), true,
+          "4 KB flash, extremes");
+
+    powerCuts(cuts);
+
+    if (failures) {
+        printf("FAIL: %d mismatches\n", failures);
+        return 1;
+    }
+    printf("all checks ok\n");
+    return 0;
+}
@@ -0,0 +1,793 @@
+/*
+ * Local OCPP 1.6-J central system stand-in and load generator.
+ *
+ * Replaces the SteVe instance at 192.168.1.100:8180 for bench tests. It
+ * accepts WebSocket connections on /steve/websocket/CentralSystemService
+ * (subprotocol ocpp1.6) and answers the charge point's own CALLs
+ * (BootNotification, Heartbeat, StatusNotification, MeterValues, Authorize,
+ * Start/StopTransaction). It also scripts CALLs to every connected charge
+ * point at a configurable rate and burst size. With -s it talks
+ * newline-delimited OCPP-J over a serial device instead, e.g. the pty of the
+ * native STM32 build, which is exactly what the ESP32 bridge forwards.
+ *
+ * Every answer to a scripted CALL is recorded: a CALLRESULT, a CALLERROR, or
+ * (text-mode firmware) any line that echoes the CALL's unique ID. The report
+ * has per-action latency percentiles and timeouts.
+ *
+ * Usage: ocpp_server [-p port] [-s device] [-n calls] [-r calls_per_s]
+ *                    [-b burst] [-a Action,Action...] [-t timeout_ms]
+ *                    [-w start_delay_s] [-l frame_log.tsv]
+ * With -n 0 it only serves the charge point and never exits.
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CLIENTS    1024 // Enough for fleet_sim runs
+#define MAX_ACTIONS    8
+#define MAX_CALLS      100000
+#define RX_BUF_SIZE    65536
+#define MSG_MAX        65536
+#define UID_PREFIX     "load-"
+#define WS_PATH        "/steve/websocket/CentralSystemService"
+#define WS_GUID        "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define WS_OP_CONT  0x0
+#define WS_OP_TEXT  0x1
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING  0x9
+#define WS_OP_PONG  0xA
+
+typedef struct {
+    int fd;
+    bool serial;
+    bool upgraded;
+    uint8_t rx[RX_BUF_SIZE];
+    size_t rxLen;
+    char msg[MSG_MAX + 1]; // WebSocket fragments are assembled here
+    size_t msgLen;
+} Client;
+
+typedef enum {
+    ANSWER_NONE = 0,
+    ANSWER_RESULT,
+    ANSWER_ERROR,
+    ANSWER_ECHO
+} AnswerKind;
+
+typedef struct {
+    uint8_t action;
+    uint8_t answer;
+    uint64_t sentUs;
+} Call;
+
+typedef struct {
+    const char *name;
+    uint32_t sent;
+    uint32_t results;
+    uint32_t errors;
+    uint32_t echoes;
+    uint32_t timeouts;
+    uint32_t *latencyUs;
+    uint32_t latencyCount;
+} ActionStats;
+
+/* Configuration */
+static int port = 8180;
+static const char *serialDevice;
+static uint32_t totalCalls = 100;
+static double callsPerSec = 2.0;
+static uint32_t burst = 1;
+static uint32_t timeoutMs = 5000;
+static uint32_t startDelayS = 5;
+static FILE *frameLog;
+
+static Client *clients[MAX_CLIENTS];
+static ActionStats actions[MAX_ACTIONS];
+static int actionCount;
+static Call *calls;
+static uint32_t callsSent;
+static uint32_t callsOpen;
+static int nextClient;
+static int nextTransactionId = 1;
+static uint64_t startUs;
+
+static uint64_t nowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static void logFrame(const char *dir, const char *data, size_t len) {
+    if (frameLog) {
+        fprintf(frameLog, "%.3f\t%s\t%.*s\n", (nowUs() - startUs) / 1000.0, dir, (int)len, data);
+    }
+}
+
+/* SHA-1 and Base64 for the WebSocket handshake ------------------------------*/
+static uint32_t rol(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static void sha1(const uint8_t *data, size_t len, uint8_t out[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint64_t bits = (uint64_t)len * 8;
+    size_t total = ((len + 8) / 64 + 1) * 64;
+    uint8_t block[64];
+
+    for (size_t offset = 0; offset < total; offset += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 64; i++) {
+            size_t pos = offset + i;
+            block[i] = pos < len ? data[pos] : pos == len ? 0x80 : 0;
+            if (pos >= total - 8) {
+                block[i] = (uint8_t)(bits >> (8 * (total - 1 - pos)));
+            }
+        }
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+                   (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 20; i++) {
+        out[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+}
+
+static void base64(const uint8_t *in, size_t len, char *out) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < len ? in[i + 1] << 8 : 0) | (i + 2 < len ? in[i + 2] : 0);
+        out[o++] = table[(v >> 18) & 63];
+        out[o++] = table[(v >> 12) & 63];
+        out[o++] = i + 1 < len ? table[(v >> 6) & 63] : '=';
+        out[o++] = i + 2 < len ? table[v & 63] : '=';
+    }
+    out[o] = '\0';
+}
+
+/* Transport -----------------------------------------------------------------*/
+static void writeAll(int fd, const void *data, size_t len) {
+    const uint8_t *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            poll(&pfd, 1, 100);
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+}
+
+static void sendText(Client *client, const char *text, size_t len) {
+    logFrame(">", text, len);
+    if (client->serial) {
+        writeAll(client->fd, text, len);
+        writeAll(client->fd, "\n", 1);
+        return;
+    }
+
+    uint8_t header[10];
+    size_t headerLen = 2;
+    header[0] = 0x80 | WS_OP_TEXT;
+    if (len < 126) {
+        header[1] = (uint8_t)len;
+    } else if (len <= 0xFFFF) {
+        header[1] = 126;
+        header[2] = (uint8_t)(len >> 8);
+        header[3] = (uint8_t)len;
+        headerLen = 4;
+    } else {
+        header[1] = 127;
+        for (int i = 0; i < 8; i++) {
+            header[2 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+        }
+        headerLen = 10;
+    }
+    writeAll(client->fd, header, headerLen);
+    writeAll(client->fd, text, len);
+}
+
+static void sendControl(Client *client, uint8_t opcode, const uint8_t *payload, size_t len) {
+    uint8_t frame[2 + 125];
+    if (len > 125) {
+        len = 125;
+    }
+    frame[0] = 0x80 | opcode;
+    frame[1] = (uint8_t)len;
+    memcpy(frame + 2, payload, len);
+    writeAll(client->fd, frame, 2 + len);
+}
+
+static void closeClient(int index) {
+    Client *client = clients[index];
+    fprintf(stderr, "[server] charge point %d disconnected\n", index);
+    close(client->fd);
+    free(client);
+    clients[index] = NULL;
+}
+
+/* OCPP-J --------------------------------------------------------------------*/
+
+/* Reads a JSON string starting at the opening quote, returns the position after it */
+static const char *readString(const char *p, char *out, size_t size) {
+    size_t n = 0;
+    if (*p != '"') {
+        return NULL;
+    }
+    for (p++; *p && *p != '"'; p++) {
+        if (*p == '\\' && p[1]) {
+            p++;
+        }
+        if (n + 1 < size) {
+            out[n++] = *p;
+        }
+    }
+    out[n] = '\0';
+    return *p == '"' ? p + 1 : NULL;
+}
+
+static const char *skipSpace(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+        p++;
+    }
+    return p;
+}
+
+/* Parses [type,"uid" and, for CALLs, ,"action"; returns the payload position */
+static const char *parseMessage(const char *msg, int *type, char *uid, size_t uidSize, char *action, size_t actionSize) {
+    const char *p = skipSpace(msg);
+    if (*p++ != '[') {
+        return NULL;
+    }
+    p = skipSpace(p);
+    *type = (int)strtol(p, (char **)&p, 10);
+    p = skipSpace(p);
+    if (*p++ != ',') {
+        return NULL;
+    }
+    p = readString(skipSpace(p), uid, uidSize);
+    if (!p) {
+        return NULL;
+    }
+    p = skipSpace(p);
+    if (*type == 2) {
+        if (*p++ != ',' || !(p = readString(skipSpace(p), action, actionSize))) {
+            return NULL;
+        }
+        p = skipSpace(p);
+    }
+    return *p == ',' ? p + 1 : p;
+}
+
+static void isoTime(char *buf, size_t size) {
+    time_t now = time(NULL);
+    strftime(buf, size, "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+}
+
+/* Answers a CALL from the charge point */
+static void answerCall(Client *client, const char *uid, const char *action) {
+    char reply[512], timestamp[32];
+    int len;
+
+    isoTime(timestamp, sizeof(timestamp));
+    if (!strcmp(action, "BootNotification")) {
+        len = snprintf(reply, sizeof(reply), "[3,\"%s\",{\"status\":\"Accepted\",\"currentTime\":\"%s\",\"interval\":300}]",
+                       uid, timestamp);
+    } else if (!strcmp(action, "Heartbeat")) {
+        len = snprintf(reply, sizeof(reply), "[3,\"%s\",{\"currentTime\":\"%s\"}]", uid, timestamp);
+    } else if (!strcmp(action, "StatusNotification") || !strcmp(action, "MeterValues") ||
+               !strcmp(action, "DataTransfer")) {
+        len = snprintf(reply, sizeof(reply), "[3,\"%s\",{}]", uid);
+    } else if (!strcmp(action, "Authorize") || !strcmp(action, "StopTransaction")) {
+        len = snprintf(reply, sizeof(reply), "[3,\"%s\",{\"idTagInfo\":{\"status\":\"Accepted\"}}]", uid);
+    } else if (!strcmp(action, "StartTransaction")) {
+        len = snprintf(reply, sizeof(reply), "[3,\"%s\",{\"transactionId\":%d,\"idTagInfo\":{\"status\":\"Accepted\"}}]",
+                       uid, nextTransactionId++);
+    } else {
+        len = snprintf(reply, sizeof(reply), "[4,\"%s\",\"NotImplemented\",\"%s\",{}]", uid, action);
+    }
+    sendText(client, reply, (size_t)len);
+}
+
+/* Matches an answer to a scripted CALL by its unique ID */
+static void recordAnswer(const char *uid, AnswerKind kind) {
+    if (strncmp(uid, UID_PREFIX, strlen(UID_PREFIX))) {
+        return;
+    }
+    unsigned long index = strtoul(uid + strlen(UID_PREFIX), NULL, 10);
+    if (index >= callsSent || calls[index].answer != ANSWER_NONE) {
+        return;
+    }
+
+    Call *call = &calls[index];
+    ActionStats *stats = &actions[call->action];
+    uint64_t latency = nowUs() - call->sentUs;
+    if (latency > (uint64_t)timeoutMs * 1000) {
+        return; // Already counted as a timeout
+    }
+    call->answer = (uint8_t)kind;
+    stats->latencyUs[stats->latencyCount++] = (uint32_t)latency;
+    stats->results += kind == ANSWER_RESULT;
+    stats->errors += kind == ANSWER_ERROR;
+    stats->echoes += kind == ANSWER_ECHO;
+    callsOpen--;
+}
+
+static void handleMessage(Client *client, const char *msg, size_t len) {
+    char uid[64], action[64];
+    int type = 0;
+
+    logFrame("<", msg, len);
+    if (!parseMessage(msg, &type, uid, sizeof(uid), action, sizeof(action))) {
+        // Not OCPP-J: the text-mode example firmware echoes CALLs inside log lines
+        const char *echo = strstr(msg, "\"" UID_PREFIX);
+        if (echo && readString(echo, uid, sizeof(uid))) {
+            recordAnswer(uid, ANSWER_ECHO);
+        }
+        return;
+    }
+    if (type == 2 && !strncmp(uid, UID_PREFIX, strlen(UID_PREFIX))) {
+        recordAnswer(uid, ANSWER_ECHO); // One of our CALLs sent back verbatim
+    } else if (type == 2) {
+        answerCall(client, uid, action);
+    } else if (type == 3 || type == 4) {
+        recordAnswer(uid, type == 3 ? ANSWER_RESULT : ANSWER_ERROR);
+    }
+}
+
+/* WebSocket server side -----------------------------------------------------*/
+static bool handleHandshake(Client *client) {
+    char *end = memmem(client->rx, client->rxLen, "\r\n\r\n", 4);
+    if (!end) {
+        return client->rxLen < RX_BUF_SIZE - 1; // Wait for the rest of the request
+    }
+    *end = '\0';
+
+    const char *request = (const char *)client->rx;
+    const char *keyHeader = strcasestr(request, "Sec-WebSocket-Key:");
+    if (strncmp(request, "GET ", 4) || !keyHeader || !strstr(request, WS_PATH)) {
+        const char *notFound = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        writeAll(client->fd, notFound, strlen(notFound));
+        return false;
+    }
+
+    char key[64], keyGuid[128], acceptKey[32], response[256];
+    uint8_t digest[20];
+    keyHeader = skipSpace(keyHeader + strlen("Sec-WebSocket-Key:"));
+    size_t keyLen = strcspn(keyHeader, "\r\n ");
+    snprintf(key, sizeof(key), "%.*s", (int)keyLen, keyHeader);
+    snprintf(keyGuid, sizeof(keyGuid), "%s%s", key, WS_GUID);
+    sha1((const uint8_t *)keyGuid, strlen(keyGuid), digest);
+    base64(digest, sizeof(digest), acceptKey);
+
+    int len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                       "Sec-WebSocket-Accept: %s\r\n%s\r\n",
+                       acceptKey, strcasestr(request, "ocpp1.6") ? "Sec-WebSocket-Protocol: ocpp1.6\r\n" : "");
+    writeAll(client->fd, response, (size_t)len);
+
+    size_t consumed = (size_t)(end + 4 - (char *)client->rx);
+    memmove(client->rx, client->rx + consumed, client->rxLen - consumed);
+    client->rxLen -= consumed;
+    client->upgraded = true;
+    fprintf(stderr, "[server] charge point connected\n");
+    return true;
+}
+
+/* Consumes complete frames from rx, false when the connection should close */
+static bool handleFrames(Client *client) {
+    for (;;) {
+        uint8_t *p = client->rx;
+        if (client->rxLen < 2) {
+            return true;
+        }
+        bool fin = p[0] & 0x80;
+        uint8_t opcode = p[0] & 0x0F;
+        bool masked = p[1] & 0x80;
+        uint64_t len = p[1] & 0x7F;
+        size_t pos = 2;
+
+        if (len == 126) {
+            if (client->rxLen < 4) {
+                return true;
+            }
+            len = (uint64_t)p[2] << 8 | p[3];
+            pos = 4;
+        } else if (len == 127) {
+            if (client->rxLen < 10) {
+                return true;
+            }
+            len = 0;
+            for (int i = 0; i < 8; i++) {
+                len = len << 8 | p[2 + i];
+            }
+            pos = 10;
+        }
+        if (len > MSG_MAX) {
+            return false;
+        }
+        size_t frameLen = pos + (masked ? 4 : 0) + (size_t)len;
+        if (client->rxLen < frameLen) {
+            return true;
+        }
+
+        uint8_t *payload = p + pos + (masked ? 4 : 0);
+        if (masked) {
+            for (uint64_t i = 0; i < len; i++) {
+                payload[i] ^= p[pos + (i & 3)];
+            }
+        }
+
+        switch (opcode) {
+            case WS_OP_TEXT:
+            case WS_OP_CONT:
+                if (opcode == WS_OP_TEXT) {
+                    client->msgLen = 0;
+                }
+                if (client->msgLen + len > MSG_MAX) {
+                    return false;
+                }
+                memcpy(client->msg + client->msgLen, payload, (size_t)len);
+                client->msgLen += (size_t)len;
+                if (fin) {
+                    client->msg[client->msgLen] = '\0';
+                    handleMessage(client, client->msg, client->msgLen);
+                    client->msgLen = 0;
+                }
+                break;
+            case WS_OP_PING:
+                sendControl(client, WS_OP_PONG, payload, (size_t)len);
+                break;
+            case WS_OP_CLOSE:
+                sendControl(client, WS_OP_CLOSE, payload, len < 2 ? (size_t)len : 2);
+                return false;
+            default:
+                break;
+        }
+
+        memmove(client->rx, client->rx + frameLen, client->rxLen - frameLen);
+        client->rxLen -= frameLen;
+    }
+}
+
+/* Newline-delimited OCPP-J, as forwarded by the ESP32 bridge */
+static void handleLines(Client *client) {
+    char *start = (char *)client->rx;
+    char *newline;
+    while ((newline = memchr(start, '\n', client->rxLen - (size_t)(start - (char *)client->rx)))) {
+        *newline = '\0';
+        if (newline > start && newline[-1] == '\r') {
+            newline[-1] = '\0';
+        }
+        handleMessage(client, start, strlen(start));
+        start = newline + 1;
+    }
+    client->rxLen -= (size_t)(start - (char *)client->rx);
+    memmove(client->rx, start, client->rxLen);
+    if (client->rxLen == RX_BUF_SIZE) {
+        client->rxLen = 0; // Overlong line, drop it
+    }
+}
+
+static bool serviceClient(Client *client) {
+    ssize_t n = read(client->fd, client->rx + client->rxLen, RX_BUF_SIZE - client->rxLen);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return true;
+    }
+    if (n <= 0) {
+        return false;
+    }
+    client->rxLen += (size_t)n;
+
+    if (client->serial) {
+        handleLines(client);
+        return true;
+    }
+    if (!client->upgraded && !handleHandshake(client)) {
+        return false;
+    }
+    return !client->upgraded || handleFrames(client);
+}
+
+/* Load generator ------------------------------------------------------------*/
+static int addClient(int fd, bool serial) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (!clients[i]) {
+            clients[i] = calloc(1, sizeof(Client));
+            if (!clients[i]) {
+                return -1;
+            }
+            clients[i]->fd = fd;
+            clients[i]->serial = serial;
+            clients[i]->upgraded = serial;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static Client *pickClient(void) {
+    for (int tries = 0; tries < MAX_CLIENTS; tries++) {
+        Client *client = clients[nextClient];
+        nextClient = (nextClient + 1) % MAX_CLIENTS;
+        if (client && client->upgraded) {
+            return client;
+        }
+    }
+    return NULL;
+}
+
+static bool sendScriptedCall(void) {
+    Client *client = pickClient();
+    char msg[256];
+    int len;
+
+    if (!client) {
+        return false;
+    }
+    Call *call = &calls[callsSent];
+    call->action = (uint8_t)(callsSent % actionCount);
+    const char *action = actions[call->action].name;
+
+    if (!strcmp(action, "RemoteStartTransaction")) {
+        len = snprintf(msg, sizeof(msg), "[2,\"" UID_PREFIX "%u\",\"%s\",{\"connectorId\":1,\"idTag\":\"LOAD%04u\"}]",
+                       (unsigned)callsSent, action, (unsigned)(callsSent % 10000));
+    } else if (!strcmp(action, "RemoteStopTransaction")) {
+        len = snprintf(msg, sizeof(msg), "[2,\"" UID_PREFIX "%u\",\"%s\",{\"transactionId\":%d}]",
+                       (unsigned)callsSent, action, nextTransactionId > 1 ? nextTransactionId - 1 : 1);
+    } else {
+        len = snprintf(msg, sizeof(msg), "[2,\"" UID_PREFIX "%u\",\"%s\",{}]", (unsigned)callsSent, action);
+    }
+
+    call->sentUs = nowUs();
+    call->answer = ANSWER_NONE;
+    actions[call->action].sent++;
+    callsSent++;
+    callsOpen++;
+    sendText(client, msg, (size_t)len);
+    return true;
+}
+
+static void expireCalls(uint64_t now) {
+    static uint32_t oldest;
+    while (oldest < callsSent && now - calls[oldest].sentUs > (uint64_t)timeoutMs * 1000) {
+        if (calls[oldest].answer == ANSWER_NONE) {
+            actions[calls[oldest].action].timeouts++;
+            callsOpen--;
+        }
+        oldest++;
+    }
+}
+
+static int compareU32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentileMs(const ActionStats *stats, uint32_t pct) {
+    if (stats->latencyCount == 0) {
+        return 0.0;
+    }
+    return stats->latencyUs[(stats->latencyCount - 1) * pct / 100] / 1000.0;
+}
+
+static void printReport(void) {
+    printf("%-24s %6s %6s %6s %6s %6s %9s %9s %9s %9s\n", "action", "sent", "result", "error", "echo",
+           "tmout", "p50_ms", "p90_ms", "p99_ms", "max_ms");
+    for (int i = 0; i < actionCount; i++) {
+        ActionStats *stats = &actions[i];
+        qsort(stats->latencyUs, stats->latencyCount, sizeof(uint32_t), compareU32);
+        printf("%-24s %6u %6u %6u %6u %6u %9.1f %9.1f %9.1f %9.1f\n", stats->name, (unsigned)stats->sent,
+               (unsigned)stats->results, (unsigned)stats->errors, (unsigned)stats->echoes,
+               (unsigned)stats->timeouts, percentileMs(stats, 50), percentileMs(stats, 90),
+               percentileMs(stats, 99), percentileMs(stats, 100));
+    }
+}
+
+static int parseActions(char *list) {
+    for (char *name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+        if (actionCount == MAX_ACTIONS) {
+            return -1;
+        }
+        actions[actionCount++].name = name;
+    }
+    return actionCount ? 0 : -1;
+}
+
+static int openListener(void) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    struct sockaddr_in addr = {0};
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, MAX_CLIENTS)) {
+        perror("ocpp_server: listen");
+        return -1;
+    }
+    fprintf(stderr, "[server] ws://0.0.0.0:%d%s\n", port, WS_PATH);
+    return fd;
+}
+
+static int openSerial(void) {
+    struct termios tio;
+    int fd = open(serialDevice, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        perror("ocpp_server: serial");
+        return -1;
+    }
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, B115200);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    fprintf(stderr, "[server] serial %s\n", serialDevice);
+    return fd;
+}
+
+int main(int argc, char **argv) {
+    char defaultActions[] = "RemoteStartTransaction,RemoteStopTransaction";
+    char *actionList = defaultActions;
+    int listener = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:s:n:r:b:a:t:w:l:")) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 's': serialDevice = optarg; break;
+            case 'n': totalCalls = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'r': callsPerSec = atof(optarg); break;
+            case 'b': burst = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'a': actionList = optarg; break;
+            case 't': timeoutMs = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'w': startDelayS = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'l': frameLog = fopen(optarg, "w"); break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-s device] [-n calls] [-r calls_per_s] [-b burst] "
+                                "[-a Action,...] [-t timeout_ms] [-w start_delay_s] [-l frame_log.tsv]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (totalCalls > MAX_CALLS || callsPerSec <= 0.0 || burst == 0 || parseActions(actionList)) {
+        fprintf(stderr, "ocpp_server: invalid load parameters\n");
+        return 2;
+    }
+    calls = calloc(totalCalls ? totalCalls : 1, sizeof(Call));
+    for (int i = 0; i < actionCount; i++) {
+        actions[i].latencyUs = calloc(totalCalls ? totalCalls : 1, sizeof(uint32_t));
+    }
+
+    startUs = nowUs();
+    if (serialDevice) {
+        int fd = openSerial();
+        if (fd < 0 || addClient(fd, true) < 0) {
+            return 1;
+        }
+    } else if ((listener = openListener()) < 0) {
+        return 1;
+    }
+
+    uint64_t burstIntervalUs = (uint64_t)(burst * 1000000.0 / callsPerSec);
+    uint64_t nextBurstUs = startUs + (uint64_t)startDelayS * 1000000;
+    uint64_t lastSendUs = 0;
+
+    for (;;) {
+        struct pollfd pfds[MAX_CLIENTS + 1];
+        int map[MAX_CLIENTS + 1];
+        int n = 0;
+
+        if (listener >= 0) {
+            pfds[n] = (struct pollfd){listener, POLLIN, 0};
+            map[n++] = -1;
+        }
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (clients[i]) {
+                pfds[n] = (struct pollfd){clients[i]->fd, POLLIN, 0};
+                map[n++] = i;
+            }
+        }
+        poll(pfds, (nfds_t)n, 1);
+
+        for (int i = 0; i < n; i++) {
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            if (map[i] < 0) {
+                int fd = accept(listener, NULL, NULL);
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                if (fd >= 0 && addClient(fd, false) < 0) {
+                    close(fd);
+                }
+            } else if (!serviceClient(clients[map[i]])) {
+                closeClient(map[i]);
+            }
+        }
+
+        /* Scripted CALLs, `burst` at a time */
+        uint64_t now = nowUs();
+        if (callsSent < totalCalls && now >= nextBurstUs) {
+            for (uint32_t b = 0; b < burst && callsSent < totalCalls; b++) {
+                if (!sendScriptedCall()) {
+                    break; // Nobody connected yet
+                }
+                lastSendUs = now;
+            }
+            nextBurstUs += burstIntervalUs;
+            if (nextBurstUs < now) {
+                nextBurstUs = now + burstIntervalUs; // Do not catch up after a stall
+            }
+        }
+        now = nowUs(); // Calls above are stamped after the previous reading
+        expireCalls(now);
+
+        if (totalCalls && callsSent == totalCalls &&
+            (callsOpen == 0 || now - lastSendUs > (uint64_t)timeoutMs * 1000)) {
+            expireCalls(now + (uint64_t)timeoutMs * 1000 + 1);
+            break;
+        }
+    }
+
+    printReport();
+    if (frameLog) {
+        fclose(frameLog);
+    }
+    return 0;
+}
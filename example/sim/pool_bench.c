@@ -0,0 +1,638 @@
+/*
+ * Replays an allocation trace through the block pools (common/block_pool.c)
+ * and two mallocs, on the same RAM budget.
+ *
+ *   nano-model  first-fit model of newlib-nano's malloc: address-ordered free
+ *               list with coalescing, 8-byte chunks with a 4-byte size header,
+ *               an arena grown upwards like _sbrk() and never shrunk. It gets
+ *               the whole budget (-a, default 6144 B, what an F030 has left
+ *               after .data, .bss and the stack).
+ *   pool        the block pools, falling back to a nano-model arena of the
+ *               budget minus the pool storage.
+ *   glibc       the host malloc, unbounded, as a speed reference only.
+ *
+ * The trace is a file of "a <ptr> <size>" / "f <ptr>" lines, written by the
+ * native build with NATIVE_HEAP_TRACE=<file>. Without a file a synthetic
+ * trace is generated. It is shaped like MicroOcpp handling inbound messages:
+ * a JSON document, an operation object, a few strings and a response per
+ * message, and transactions with meter samples that live across messages.
+ *
+ * Before the replay it sizes the pools for the trace: the peak live blocks
+ * per heap_stats.h bucket, and the POOL_CLASSES that hold every class's peak
+ * in the fewest bytes. Build with that POOL_CLASSES to replay it.
+ *
+ * Every block is tagged at both ends on allocation and checked on free, so an
+ * allocator handing out overlapping blocks fails the run. Timings are host
+ * nanoseconds. Compare allocators with each other, not with target cycles.
+ *
+ * Usage: pool_bench [-a arena] [-r runs] [-m messages] [-s seed] [trace]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "block_pool.h"
+
+#define MAX_ARENA   (256 * 1024)
+#define MAX_RUNS    64
+#define HISTOGRAM_BUCKETS 8 // <=16 B ... <=1024 B, >1024 B as in common/heap_stats.h
+#define SIZING_CLASSES 6    // Most classes the sizing suggests
+#define NANO_HEADER 4
+#define NANO_MIN    16
+#define NANO_NONE   0xFFFFFFFFu
+
+typedef struct {
+    uint32_t slot;
+    uint32_t size; // 0 frees the slot
+} TraceOp;
+
+typedef struct {
+    TraceOp *ops;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t slots;
+    uint32_t allocs;
+    uint32_t peakLiveBytes;
+    uint32_t peakLiveBlocks;
+    uint32_t minSize, maxSize;
+} Trace;
+
+typedef struct {
+    const char *name;
+    void *(*alloc)(size_t size);
+    void (*free)(void *ptr);
+    void (*reset)(void);
+    uint32_t (*heapTop)(void); // High-water mark of the RAM used, 0 if unbounded
+} Allocator;
+
+/* Nano model ----------------------------------------------------------------*/
+static uint8_t nanoArena[MAX_ARENA] __attribute__((aligned(8)));
+static uint32_t nanoLimit;
+static uint32_t nanoTop = NANO_HEADER; // Chunks start 4 bytes before an 8-byte boundary
+static uint32_t nanoPeak;
+static uint32_t nanoFreeList = NANO_NONE;
+
+static uint32_t *word(uint32_t offset) {
+    return (uint32_t *)&nanoArena[offset];
+}
+
+#define CHUNK_SIZE(c) (*word(c))
+#define CHUNK_NEXT(c) (*word((c) + NANO_HEADER))
+
+static void *nanoMallocChunk(uint32_t size) {
+    uint32_t prev = NANO_NONE;
+
+    for (uint32_t c = nanoFreeList; c != NANO_NONE; prev = c, c = CHUNK_NEXT(c)) {
+        if (CHUNK_SIZE(c) < size) {
+            continue;
+        }
+        uint32_t rest = CHUNK_SIZE(c) - size;
+        if (rest >= NANO_MIN) { // Split, handing out the tail as newlib-nano does
+            CHUNK_SIZE(c) = rest;
+            c += rest;
+            CHUNK_SIZE(c) = size;
+        } else if (prev == NANO_NONE) {
+            nanoFreeList = CHUNK_NEXT(c);
+        } else {
+            CHUNK_NEXT(prev) = CHUNK_NEXT(c);
+        }
+        return &nanoArena[c + NANO_HEADER];
+    }
+
+    if (nanoTop + size > nanoLimit) {
+        return NULL; // _sbrk() refuses
+    }
+    uint32_t c = nanoTop;
+    nanoTop += size;
+    if (nanoTop > nanoPeak) {
+        nanoPeak = nanoTop;
+    }
+    CHUNK_SIZE(c) = size;
+    return &nanoArena[c + NANO_HEADER];
+}
+
+void *nanoMalloc(size_t request) {
+    uint32_t size = ((uint32_t)request + NANO_HEADER + 7) & ~7u;
+    return nanoMallocChunk(size < NANO_MIN ? NANO_MIN : size);
+}
+
+void nanoFree(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    uint32_t c = (uint32_t)((uint8_t *)ptr - nanoArena) - NANO_HEADER;
+    uint32_t prev = NANO_NONE, next = nanoFreeList;
+
+    while (next != NANO_NONE && next < c) {
+        prev = next;
+        next = CHUNK_NEXT(next);
+    }
+    if (next != NANO_NONE && c + CHUNK_SIZE(c) == next) { // Merge with the following chunk
+        CHUNK_SIZE(c) += CHUNK_SIZE(next);
+        next = CHUNK_NEXT(next);
+    }
+    CHUNK_NEXT(c) = next;
+    if (prev == NANO_NONE) {
+        nanoFreeList = c;
+    } else if (prev + CHUNK_SIZE(prev) == c) { // Merge into the preceding chunk
+        CHUNK_SIZE(prev) += CHUNK_SIZE(c);
+        CHUNK_NEXT(prev) = next;
+    } else {
+        CHUNK_NEXT(prev) = c;
+    }
+}
+
+static uint32_t arenaBytes;
+static uint32_t poolBytes;
+
+static void nanoReset(void) {
+    nanoTop = NANO_HEADER;
+    nanoPeak = nanoTop;
+    nanoFreeList = NANO_NONE;
+    nanoLimit = arenaBytes + NANO_HEADER;
+}
+
+static uint32_t nanoHeapTop(void) {
+    return nanoPeak - NANO_HEADER;
+}
+
+/* Pools with the nano model behind them (POOL_FALLBACK_MALLOC=nanoMalloc) */
+static void poolReset(void) {
+    nanoReset();
+    nanoLimit -= poolBytes;
+}
+
+static uint32_t poolHeapTop(void) {
+    return poolBytes + nanoHeapTop();
+}
+
+static void glibcReset(void) {
+}
+
+static uint32_t glibcHeapTop(void) {
+    return 0;
+}
+
+static const Allocator allocators[] = {
+    {"nano-model", nanoMalloc, nanoFree, nanoReset, nanoHeapTop},
+    {"pool", poolAlloc, poolFree, poolReset, poolHeapTop},
+    {"glibc", malloc, free, glibcReset, glibcHeapTop},
+};
+
+/* Trace ---------------------------------------------------------------------*/
+static void addOp(Trace *trace, uint32_t slot, uint32_t size) {
+    if (trace->count == trace->capacity) {
+        trace->capacity = trace->capacity ? trace->capacity * 2 : 4096;
+        trace->ops = realloc(trace->ops, trace->capacity * sizeof(TraceOp));
+        if (!trace->ops) {
+            fprintf(stderr, "pool_bench: out of memory\n");
+            exit(1);
+        }
+    }
+    trace->ops[trace->count++] = (TraceOp){slot, size};
+}
+
+/* Slot numbers are reused once freed, so the live table stays small */
+typedef struct {
+    uint32_t *freeSlots;
+    uint32_t freeCount;
+    uint32_t next;
+} SlotAllocator;
+
+static uint32_t takeSlot(SlotAllocator *slots) {
+    return slots->freeCount ? slots->freeSlots[--slots->freeCount] : slots->next++;
+}
+
+static void giveSlot(SlotAllocator *slots, uint32_t slot) {
+    slots->freeSlots = realloc(slots->freeSlots, (slots->freeCount + 1) * sizeof(uint32_t));
+    slots->freeSlots[slots->freeCount++] = slot;
+}
+
+static uint32_t seed = 1;
+
+static uint32_t rnd(uint32_t lo, uint32_t hi) {
+    seed = seed * 1103515245u + 12345u;
+    return lo + (seed >> 8) % (hi - lo + 1);
+}
+
+static void synthesize(Trace *trace, uint32_t messages) {
+    SlotAllocator slots = {NULL, 0, 0};
+    uint32_t samples[8], sampleCount = 0, tx = 0;
+    bool inTx = false;
+
+#define ALLOC(size) ({ uint32_t s_ = takeSlot(&slots); addOp(trace, s_, (size)); s_; })
+#define FREE(s)     do { addOp(trace, (s), 0); giveSlot(&slots, (s)); } while (0)
+
+    for (int i = 0; i < 24; i++) {
+        (void)ALLOC(rnd(12, 96)); // Configuration and model objects, never freed
+    }
+    for (uint32_t m = 0; m < messages; m++) {
+        uint32_t doc = ALLOC(rnd(192, 512)); // Parsed JSON document
+        uint32_t op = ALLOC(rnd(96, 160));   // Operation object
+        uint32_t strings[4], n = rnd(1, 4);
+        for (uint32_t i = 0; i < n; i++) {
+            strings[i] = ALLOC(rnd(8, 40));
+        }
+        FREE(doc);
+        uint32_t response = ALLOC(rnd(64, 256));
+
+        if (!inTx && m % 40 == 0) {
+            tx = ALLOC(184); // Transaction record
+            inTx = true;
+        } else if (inTx && m % 40 == 30) {
+            for (uint32_t i = 0; i < sampleCount; i++) {
+                FREE(samples[i]);
+            }
+            sampleCount = 0;
+            FREE(tx);
+            inTx = false;
+        }
+        if (inTx && m % 4 == 0) {
+            if (sampleCount == 8) {
+                FREE(samples[0]);
+                memmove(samples, samples + 1, 7 * sizeof(uint32_t));
+                sampleCount--;
+            }
+            samples[sampleCount++] = ALLOC(rnd(24, 48)); // Meter sample kept for the StopTransaction
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            FREE(strings[i]);
+        }
+        FREE(response);
+        FREE(op);
+    }
+#undef ALLOC
+#undef FREE
+    trace->slots = slots.next;
+    free(slots.freeSlots);
+}
+
+/* Pointers of a recorded trace, open addressing */
+typedef struct {
+    unsigned long long *keys;
+    uint32_t *values;
+    uint32_t mask;
+} PtrMap;
+
+static uint32_t *ptrSlot(PtrMap *map, unsigned long long key, bool insert) {
+    for (uint32_t i = (uint32_t)(key >> 4) * 2654435761u & map->mask;; i = (i + 1) & map->mask) {
+        if (map->keys[i] == key) {
+            return &map->values[i];
+        }
+        if (map->keys[i] == 0) {
+            if (!insert) {
+                return NULL;
+            }
+            map->keys[i] = key;
+            return &map->values[i];
+        }
+    }
+}
+
+static void ptrRemove(PtrMap *map, unsigned long long key) {
+    uint32_t *value = ptrSlot(map, key, false);
+    if (value) {
+        *value = NANO_NONE; // Tombstone, the key stays for probing
+    }
+}
+
+static int load(Trace *trace, const char *path) {
+    FILE *f = fopen(path, "r");
+    SlotAllocator slots = {NULL, 0, 0};
+    PtrMap map;
+    char line[96];
+    uint32_t lines = 0;
+
+    if (!f) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        lines++;
+    }
+    rewind(f);
+    map.mask = 1024;
+    while (map.mask < lines * 2) {
+        map.mask <<= 1;
+    }
+    map.keys = calloc(map.mask, sizeof(*map.keys));
+    map.values = calloc(map.mask, sizeof(*map.values));
+    map.mask--;
+
+    while (fgets(line, sizeof(line), f)) {
+        char op;
+        unsigned long long ptr;
+        unsigned long size = 0;
+        if (sscanf(line, "%c %llx %lu", &op, &ptr, &size) < 2 || !ptr) {
+            continue;
+        }
+        uint32_t *value = ptrSlot(&map, ptr, op == 'a');
+        if (op == 'a') {
+            *value = takeSlot(&slots);
+            addOp(trace, *value, size ? (uint32_t)size : 1);
+        } else if (op == 'f' && value && *value != NANO_NONE) { // Blocks from before the trace are skipped
+            addOp(trace, *value, 0);
+            giveSlot(&slots, *value);
+            ptrRemove(&map, ptr);
+        }
+    }
+    fclose(f);
+    free(map.keys);
+    free(map.values);
+    free(slots.freeSlots);
+    trace->slots = slots.next;
+    return 0;
+}
+
+static void measureTrace(Trace *trace) {
+    uint32_t *sizes = calloc(trace->slots, sizeof(uint32_t));
+    uint32_t liveBytes = 0, liveBlocks = 0;
+
+    trace->minSize = UINT32_MAX;
+    for (uint32_t i = 0; i < trace->count; i++) {
+        const TraceOp *op = &trace->ops[i];
+        if (op->size) {
+            trace->allocs++;
+            sizes[op->slot] = op->size;
+            liveBytes += op->size;
+            liveBlocks++;
+            trace->minSize = op->size < trace->minSize ? op->size : trace->minSize;
+            trace->maxSize = op->size > trace->maxSize ? op->size : trace->maxSize;
+            if (liveBytes > trace->peakLiveBytes) {
+                trace->peakLiveBytes = liveBytes;
+                trace->peakLiveBlocks = liveBlocks;
+            }
+        } else {
+            liveBytes -= sizes[op->slot];
+            liveBlocks--;
+        }
+    }
+    free(sizes);
+}
+
+/* Peak live blocks of the requests in (lo, hi] */
+static uint32_t peakLive(const Trace *trace, uint32_t *sizes, uint32_t lo, uint32_t hi) {
+    uint32_t live = 0, peak = 0;
+
+    for (uint32_t i = 0; i < trace->count; i++) {
+        const TraceOp *op = &trace->ops[i];
+        if (op->size) {
+            sizes[op->slot] = op->size;
+            if (op->size > lo && op->size <= hi && ++live > peak) {
+                peak = live;
+            }
+        } else if (sizes[op->slot] > lo && sizes[op->slot] <= hi) {
+            live--;
+        }
+    }
+    return peak;
+}
+
+/*
+ * POOL_CLASSES for the trace: the histogram of common/heap_stats.h, then the
+ * block sizes (multiples of 8) that reserve the fewest bytes when each class
+ * holds its own peak. Dynamic programming over the class boundaries.
+ */
+static void sizeClasses(const Trace *trace) {
+    uint32_t *sizes = calloc(trace->slots, sizeof(uint32_t));
+    uint32_t top = (trace->maxSize + 7) & ~7u;
+    uint32_t steps = top / 8;
+    uint64_t *cost = calloc((size_t)(steps + 1) * (SIZING_CLASSES + 1), sizeof(uint64_t));
+    uint32_t *from = calloc((size_t)(steps + 1) * (SIZING_CLASSES + 1), sizeof(uint32_t));
+    uint32_t *peaks = calloc((size_t)(steps + 1) * (steps + 1), sizeof(uint32_t));
+    char suggestion[192];
+    int used = 0;
+
+    for (uint32_t c = 0, lo = 0; c < HISTOGRAM_BUCKETS; lo = 16u << c, c++) {
+        uint32_t hi = c < HISTOGRAM_BUCKETS - 1 ? 16u << c : UINT32_MAX;
+        uint32_t peak = peakLive(trace, sizes, lo, hi);
+        if (peak) {
+            printf("histogram  %s%u B: peak %u live\n", hi == UINT32_MAX ? ">" : "<=", hi == UINT32_MAX ? lo : hi,
+                   (unsigned)peak);
+        }
+    }
+
+    /* peaks[i * (steps + 1) + j]: requests in (8i, 8j] */
+    for (uint32_t i = 0; i < steps; i++) {
+        for (uint32_t j = i + 1; j <= steps; j++) {
+            peaks[i * (steps + 1) + j] = peakLive(trace, sizes, 8 * i, 8 * j);
+        }
+    }
+    /* cost[k * (steps + 1) + j]: fewest bytes for k classes covering (0, 8j] */
+    for (uint32_t j = 1; j <= steps; j++) {
+        cost[j] = UINT64_MAX;
+    }
+    for (uint32_t k = 1; k <= SIZING_CLASSES; k++) {
+        for (uint32_t j = 0; j <= steps; j++) {
+            uint64_t best = j ? UINT64_MAX : 0;
+            for (uint32_t i = 0; i < j; i++) {
+                uint64_t prev = cost[(k - 1) * (steps + 1) + i];
+                uint32_t peak = peaks[i * (steps + 1) + j];
+                uint64_t total = prev == UINT64_MAX ? UINT64_MAX : prev + (uint64_t)8 * j * peak;
+                if (total < best || (total == best && !peak)) {
+                    best = total;
+                    from[k * (steps + 1) + j] = i;
+                }
+            }
+            cost[k * (steps + 1) + j] = best;
+        }
+    }
+
+    uint32_t bounds[SIZING_CLASSES], count = 0;
+    for (uint32_t k = SIZING_CLASSES, j = steps; j > 0; k--) {
+        uint32_t i = from[k * (steps + 1) + j];
+        if (peaks[i * (steps + 1) + j]) {
+            bounds[count++] = j;
+        }
+        j = i;
+    }
+    uint32_t lo = 0;
+    while (count-- > 0) {
+        uint32_t hi = bounds[count];
+        used += snprintf(suggestion + used, sizeof(suggestion) - used, "%sX(%u,%u)", used ? " " : "",
+                         (unsigned)(8 * hi), (unsigned)peaks[lo * (steps + 1) + hi]);
+        lo = hi;
+    }
+    printf("sizing     %llu B: -D'POOL_CLASSES(X)=%s'\n",
+           (unsigned long long)cost[SIZING_CLASSES * (steps + 1) + steps], suggestion);
+    free(sizes);
+    free(cost);
+    free(from);
+    free(peaks);
+}
+
+/* Replay --------------------------------------------------------------------*/
+typedef struct {
+    double nsPerOp;
+    uint32_t p50, p99, max;
+    uint32_t failed;
+    uint32_t corrupt;
+    uint32_t heapTop;
+} ReplayResult;
+
+static uint64_t monotonicNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int compareU32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static uint8_t tagOf(uint32_t slot) {
+    return (uint8_t)(slot * 31 + 7);
+}
+
+/* One pass; latency != NULL times every operation on its own */
+static void replay(const Allocator *a, const Trace *trace, void **live, uint32_t *sizes, uint32_t *latency,
+                   ReplayResult *result) {
+    a->reset();
+    memset(live, 0, trace->slots * sizeof(void *));
+    for (uint32_t i = 0; i < trace->count; i++) {
+        const TraceOp *op = &trace->ops[i];
+        uint64_t t0 = latency ? monotonicNs() : 0;
+        if (op->size) {
+            uint8_t *p = a->alloc(op->size);
+            live[op->slot] = p;
+            if (latency) {
+                latency[i] = (uint32_t)(monotonicNs() - t0);
+            }
+            if (!p) {
+                result->failed++;
+                continue;
+            }
+            sizes[op->slot] = op->size;
+            p[0] = p[op->size - 1] = tagOf(op->slot);
+        } else {
+            uint8_t *p = live[op->slot];
+            if (p && (p[0] != tagOf(op->slot) || p[sizes[op->slot] - 1] != tagOf(op->slot))) {
+                result->corrupt++;
+            }
+            if (latency) {
+                t0 = monotonicNs();
+            }
+            a->free(p);
+            if (latency) {
+                latency[i] = (uint32_t)(monotonicNs() - t0);
+            }
+            live[op->slot] = NULL;
+        }
+    }
+    result->heapTop = a->heapTop();
+    for (uint32_t s = 0; s < trace->slots; s++) {
+        a->free(live[s]); // Leave the allocator empty for the next pass
+    }
+}
+
+static void run(const Allocator *a, const Trace *trace, uint32_t runs, ReplayResult *result) {
+    void **live = calloc(trace->slots, sizeof(void *));
+    uint32_t *sizes = calloc(trace->slots, sizeof(uint32_t));
+    uint32_t *latency = calloc(trace->count, sizeof(uint32_t));
+    double nsPerOp[MAX_RUNS];
+
+    memset(result, 0, sizeof(*result));
+    replay(a, trace, live, sizes, latency, result);
+    qsort(latency, trace->count, sizeof(uint32_t), compareU32);
+    result->p50 = latency[(trace->count - 1) / 2];
+    result->p99 = latency[(uint64_t)(trace->count - 1) * 99 / 100];
+    result->max = latency[trace->count - 1];
+
+    for (uint32_t r = 0; r < runs; r++) {
+        ReplayResult ignored = {0};
+        uint64_t t0 = monotonicNs();
+        replay(a, trace, live, sizes, NULL, &ignored);
+        nsPerOp[r] = (double)(monotonicNs() - t0) / trace->count;
+    }
+    qsort(nsPerOp, runs, sizeof(double), compareDouble);
+    result->nsPerOp = nsPerOp[(runs - 1) / 2];
+    free(live);
+    free(sizes);
+    free(latency);
+}
+
+static void printLine(void *ctx, const char *line) {
+    (void)ctx;
+    printf("%s\n", line);
+}
+
+int main(int argc, char **argv) {
+    Trace trace = {0};
+    uint32_t runs = 9, messages = 20000;
+    int opt;
+
+    arenaBytes = 6144;
+    while ((opt = getopt(argc, argv, "a:r:m:s:")) != -1) {
+        switch (opt) {
+            case 'a': arenaBytes = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'r': runs = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'm': messages = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 's': seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+            default: optind = argc + 1; break;
+        }
+    }
+    if (optind < argc - 1 || optind > argc) {
+        fprintf(stderr, "usage: %s [-a arena] [-r runs] [-m messages] [-s seed] [trace]\n", argv[0]);
+        return 2;
+    }
+    runs = runs < 1 ? 1 : runs > MAX_RUNS ? MAX_RUNS : runs;
+    arenaBytes = arenaBytes > MAX_ARENA - 64 ? MAX_ARENA - 64 : arenaBytes & ~7u;
+
+    if (optind == argc - 1) {
+        if (load(&trace, argv[optind])) {
+            perror(argv[optind]);
+            return 1;
+        }
+        printf("trace      %s: ", argv[optind]);
+    } else {
+        uint32_t firstSeed = seed;
+        synthesize(&trace, messages);
+        printf("trace      synthetic, %u messages (seed %u): ", (unsigned)messages, (unsigned)firstSeed);
+    }
+    if (!trace.count) {
+        fprintf(stderr, "pool_bench: empty trace\n");
+        return 1;
+    }
+    measureTrace(&trace);
+    printf("%u ops, %u allocs of %u-%u B, peak live %u B in %u blocks\n", (unsigned)trace.count,
+           (unsigned)trace.allocs, (unsigned)trace.minSize, (unsigned)trace.maxSize,
+           (unsigned)trace.peakLiveBytes, (unsigned)trace.peakLiveBlocks);
+    sizeClasses(&trace);
+
+    for (uint32_t c = 0; c < poolClassCount(); c++) {
+        PoolClassStats cls;
+        poolClassStats(c, &cls);
+        poolBytes += (uint32_t)cls.blockSize * cls.blocks;
+    }
+    printf("budget     %u B: nano-model arena %u B, pool %u B + nano-model fallback %u B\n",
+           (unsigned)arenaBytes, (unsigned)arenaBytes, (unsigned)poolBytes,
+           (unsigned)(arenaBytes > poolBytes ? arenaBytes - poolBytes : 0));
+    if (poolBytes > arenaBytes) {
+        fprintf(stderr, "pool_bench: the pools alone exceed the budget\n");
+        return 1;
+    }
+
+    printf("%-11s %7s %6s %6s %7s %7s %8s %7s\n", "allocator", "ns/op", "p50", "p99", "max", "failed", "heap top",
+           "corrupt");
+    int status = 0;
+    for (size_t i = 0; i < sizeof(allocators) / sizeof(allocators[0]); i++) {
+        ReplayResult result;
+        run(&allocators[i], &trace, runs, &result);
+        char top[16] = "-";
+        if (result.heapTop) {
+            snprintf(top, sizeof(top), "%u", (unsigned)result.heapTop);
+        }
+        printf("%-11s %7.1f %6u %6u %7u %7u %8s %7u\n", allocators[i].name, result.nsPerOp, (unsigned)result.p50,
+               (unsigned)result.p99, (unsigned)result.max, (unsigned)result.failed, top, (unsigned)result.corrupt);
+        status |= result.corrupt != 0;
+    }
+    poolExport(printLine, NULL); // Accumulated over all pool passes
+    return status;
+}
@@ -0,0 +1,219 @@
+/*
+ * Host-side simulation of a fleet of bridges reconnecting after a backend
+ * outage. Runs the real reconnect_policy.c against a stand-in backend that
+ * accepts a limited number of WebSocket upgrades per second and rejects the
+ * rest (HTTP 503), and compares it with the fixed 500 ms reconnect interval
+ * of WebSocketsClient.
+ *
+ * Usage: reconnect_sim [bridges] [outage_s] [capacity_per_s] [duration_s]
+ * Output: CSV connection-rate curve on stdout, summary on stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "reconnect_policy.h"
+
+#define TICK_MS          10
+#define HANDSHAKE_MS     300  // TCP + HTTP upgrade on the LAN
+#define FIXED_RETRY_MS   500  // WebSocketsClient default reconnect interval
+#define TCP_FAIL_MS      20   // Refused connection while the backend is down
+#define START_MS         1000000u
+
+typedef struct {
+    ReconnectPolicy policy;
+    uint32_t connectDoneMs; // Handshake in flight until this time, 0 = none
+    uint32_t nextRetryMs;   // Fixed-interval model only
+    int connected;
+} Bridge;
+
+typedef struct {
+    const char *name;
+    Bridge *bridges;
+    uint32_t *attemptsPerSec;
+    uint32_t *connectedPerSec;
+    uint32_t rejected;
+    uint32_t lastConnectMs;
+    uint32_t ninetyNineMs;
+} Fleet;
+
+typedef struct {
+    int bridges;
+    uint32_t outageMs;
+    uint32_t capacityPerSec;
+    uint32_t durationMs;
+} Scenario;
+
+/* Backend stand-in: token bucket refilled every second */
+typedef struct {
+    uint32_t tokens;
+    uint32_t second;
+} Backend;
+
+static int backendAccept(Backend *backend, const Scenario *sc, uint32_t t) {
+    if (t < sc->outageMs) {
+        return -1; // Down, TCP connect fails
+    }
+    if (t / 1000 != backend->second) {
+        backend->second = t / 1000;
+        backend->tokens = sc->capacityPerSec;
+    }
+    if (backend->tokens == 0) {
+        return 0; // Overloaded, upgrade rejected
+    }
+    backend->tokens--;
+    return 1;
+}
+
+static void noteConnected(Fleet *fleet, const Scenario *sc, uint32_t t, int *connectedCount) {
+    (*connectedCount)++;
+    fleet->connectedPerSec[t / 1000]++;
+    fleet->lastConnectMs = t;
+    if (!fleet->ninetyNineMs && *connectedCount * 100 >= sc->bridges * 99) {
+        fleet->ninetyNineMs = t;
+    }
+}
+
+static void runPolicy(Fleet *fleet, const Scenario *sc) {
+    ReconnectConfig config;
+    Backend backend = {0, 0};
+    int connectedCount = 0;
+
+    reconnectConfigDefaults(&config);
+    for (int i = 0; i < sc->bridges; i++) {
+        Bridge *b = &fleet->bridges[i];
+        // Consecutive MACs, as on a real site
+        reconnectInit(&b->policy, &config, 0x24A16000u + (uint32_t)i, START_MS);
+        reconnectOnConnected(&b->policy, START_MS - config.stableMs); // Long-running connection
+        reconnectOnDisconnected(&b->policy, START_MS);                // Backend goes away at t=0
+    }
+
+    for (uint32_t t = 0; t < sc->durationMs; t += TICK_MS) {
+        uint32_t now = START_MS + t;
+        for (int i = 0; i < sc->bridges; i++) {
+            Bridge *b = &fleet->bridges[i];
+
+            if (b->connectDoneMs && now >= b->connectDoneMs) {
+                b->connectDoneMs = 0;
+                reconnectOnConnected(&b->policy, now);
+                noteConnected(fleet, sc, t, &connectedCount);
+            }
+
+            if (reconnectPoll(&b->policy, now) != RECONNECT_BEGIN) {
+                continue;
+            }
+            fleet->attemptsPerSec[t / 1000]++;
+            switch (backendAccept(&backend, sc, t)) {
+                case 1:
+                    b->connectDoneMs = now + HANDSHAKE_MS;
+                    break;
+                case 0:
+                    fleet->rejected++;
+                    reconnectOnDisconnected(&b->policy, now + HANDSHAKE_MS);
+                    break;
+                default:
+                    break; // No event, the attempt window expires
+            }
+        }
+    }
+}
+
+static void runFixed(Fleet *fleet, const Scenario *sc) {
+    Backend backend = {0, 0};
+    int connectedCount = 0;
+
+    for (int i = 0; i < sc->bridges; i++) {
+        fleet->bridges[i].nextRetryMs = 0; // Everybody notices the outage at once
+    }
+
+    for (uint32_t t = 0; t < sc->durationMs; t += TICK_MS) {
+        for (int i = 0; i < sc->bridges; i++) {
+            Bridge *b = &fleet->bridges[i];
+
+            if (b->connectDoneMs && t >= b->connectDoneMs) {
+                b->connectDoneMs = 0;
+                b->connected = 1;
+                noteConnected(fleet, sc, t, &connectedCount);
+            }
+            if (b->connected || b->connectDoneMs || t < b->nextRetryMs) {
+                continue;
+            }
+            fleet->attemptsPerSec[t / 1000]++;
+            switch (backendAccept(&backend, sc, t)) {
+                case 1:
+                    b->connectDoneMs = t + HANDSHAKE_MS;
+                    break;
+                case 0:
+                    fleet->rejected++;
+                    b->nextRetryMs = t + HANDSHAKE_MS + FIXED_RETRY_MS;
+                    break;
+                default:
+                    b->nextRetryMs = t + TCP_FAIL_MS + FIXED_RETRY_MS;
+                    break;
+            }
+        }
+    }
+}
+
+static int fleetAlloc(Fleet *fleet, const char *name, const Scenario *sc) {
+    size_t seconds = sc->durationMs / 1000 + 1;
+    memset(fleet, 0, sizeof(*fleet));
+    fleet->name = name;
+    fleet->bridges = calloc((size_t)sc->bridges, sizeof(Bridge));
+    fleet->attemptsPerSec = calloc(seconds, sizeof(uint32_t));
+    fleet->connectedPerSec = calloc(seconds, sizeof(uint32_t));
+    return fleet->bridges && fleet->attemptsPerSec && fleet->connectedPerSec ? 0 : -1;
+}
+
+static void fleetFree(Fleet *fleet) {
+    free(fleet->bridges);
+    free(fleet->attemptsPerSec);
+    free(fleet->connectedPerSec);
+}
+
+static void printSummary(const Fleet *fleet, const Scenario *sc) {
+    uint32_t peak = 0;
+    uint32_t total = 0;
+    for (uint32_t s = 0; s <= sc->durationMs / 1000; s++) {
+        total += fleet->attemptsPerSec[s];
+        if (fleet->attemptsPerSec[s] > peak) {
+            peak = fleet->attemptsPerSec[s];
+        }
+    }
+    fprintf(stderr, "%-7s attempts=%u peak=%u/s rejected=%u 99%%-connected=%.1fs all-connected=%.1fs\n",
+            fleet->name, total, peak, fleet->rejected,
+            fleet->ninetyNineMs ? (fleet->ninetyNineMs - sc->outageMs) / 1000.0 : -1.0,
+            fleet->lastConnectMs ? (fleet->lastConnectMs - sc->outageMs) / 1000.0 : -1.0);
+}
+
+int main(int argc, char **argv) {
+    Scenario sc;
+    Fleet fixed, policy;
+
+    sc.bridges = argc > 1 ? atoi(argv[1]) : 1000;
+    sc.outageMs = (uint32_t)(argc > 2 ? atoi(argv[2]) : 60) * 1000;
+    sc.capacityPerSec = (uint32_t)(argc > 3 ? atoi(argv[3]) : 50);
+    sc.durationMs = (uint32_t)(argc > 4 ? atoi(argv[4]) : 600) * 1000;
+
+    if (sc.bridges <= 0 || fleetAlloc(&fixed, "fixed", &sc) || fleetAlloc(&policy, "backoff", &sc)) {
+        fprintf(stderr, "reconnect_sim: invalid arguments or out of memory\n");
+        return 1;
+    }
+
+    runFixed(&fixed, &sc);
+    runPolicy(&policy, &sc);
+
+    printf("second,fixed_attempts,fixed_connected,backoff_attempts,backoff_connected\n");
+    for (uint32_t s = 0; s <= sc.durationMs / 1000; s++) {
+        printf("%u,%u,%u,%u,%u\n", s, fixed.attemptsPerSec[s], fixed.connectedPerSec[s],
+               policy.attemptsPerSec[s], policy.connectedPerSec[s]);
+    }
+
+    fprintf(stderr, "%d bridges, backend down for %us, accepts %u upgrades/s\n",
+            sc.bridges, sc.outageMs / 1000, sc.capacityPerSec);
+    printSummary(&fixed, &sc);
+    printSummary(&policy, &sc);
+
+    fleetFree(&fixed);
+    fleetFree(&policy);
+    return 0;
+}
@@ -0,0 +1,323 @@
+/*
+ * Host-side measurement of TLS handshake cost against a local stand-in
+ * backend, for the reconnect path of esp32_tls.
+ *
+ * A server thread on 127.0.0.1 presents an ECDSA P-256 certificate signed by a
+ * CA generated at startup. The client connects in two ways:
+ *   pem      The CA PEM is parsed into a new trust store for every
+ *            connection, as setCACert() did before ca_bundle.c. Every
+ *            handshake is a full one.
+ *   bundle   The CA is parsed once and the context reused (ca_bundle.c).
+ *            Every handshake is still a full one.
+ * No session is offered: esp32_tls does not resume sessions, so neither
+ * does the bench.
+ * Times are wall time per handshake and CPU time of the client and the server
+ * thread. OpenSSL on a PC is not mbedTLS on an ESP32: compare the rows with
+ * each other, not with the device.
+ *
+ * Also checks that a client without a trust anchor fails the handshake.
+ *
+ * Usage: tls_bench [connections]
+ * Exits 1 if a handshake fails or the check fails.
+ */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#define DEFAULT_CONNECTIONS 200
+
+typedef enum {
+    MODE_PEM,
+    MODE_BUNDLE,
+    MODE_COUNT
+} Mode;
+
+static const char *const modeNames[MODE_COUNT] = {"pem", "bundle"};
+
+/* Server Stand-In */
+typedef struct {
+    int listenFd;
+    SSL_CTX *ctx;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    unsigned served;
+    double lastCpuUs; // Of the last handshake
+} Server;
+
+static double nowUs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static EVP_PKEY *newKey(void) {
+    return EVP_EC_gen("P-256");
+}
+
+static X509 *newCert(const char *cn, EVP_PKEY *key, X509 *issuer, EVP_PKEY *issuerKey, long serial) {
+    X509 *cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), serial);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 86400L * 365);
+    X509_set_pubkey(cert, key);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)cn, -1, -1, 0);
+    X509_set_issuer_name(cert, issuer ? X509_get_subject_name(issuer) : name);
+
+    X509V3_CTX v3;
+    X509V3_set_ctx(&v3, issuer ? issuer : cert, cert, NULL, NULL, 0);
+    X509_EXTENSION *ext = X509V3_EXT_conf_nid(NULL, &v3, NID_basic_constraints,
+                                              issuer ? "critical,CA:FALSE" : "critical,CA:TRUE");
+    X509_add_ext(cert, ext, -1);
+    X509_EXTENSION_free(ext);
+    if (issuer) {
+        ext = X509V3_EXT_conf_nid(NULL, &v3, NID_subject_alt_name, "IP:127.0.0.1");
+        X509_add_ext(cert, ext, -1);
+        X509_EXTENSION_free(ext);
+    }
+    X509_sign(cert, issuerKey ? issuerKey : key, EVP_sha256());
+    return cert;
+}
+
+static void *serverThread(void *arg) {
+    Server *server = (Server *)arg;
+    for (;;) {
+        int fd = accept(server->listenFd, NULL, NULL);
+        if (fd < 0) {
+            break;
+        }
+        double cpu = nowUs(CLOCK_THREAD_CPUTIME_ID);
+        SSL *ssl = SSL_new(server->ctx);
+        SSL_set_fd(ssl, fd);
+        int ok = SSL_accept(ssl) == 1;
+        cpu = nowUs(CLOCK_THREAD_CPUTIME_ID) - cpu;
+        if (ok) {
+            char byte;
+            SSL_read(ssl, &byte, 1); // Client closes after the handshake
+            SSL_shutdown(ssl);
+        }
+        SSL_free(ssl);
+        close(fd);
+
+        pthread_mutex_lock(&server->lock);
+        server->lastCpuUs = cpu;
+        server->served++;
+        pthread_cond_signal(&server->done);
+        pthread_mutex_unlock(&server->lock);
+    }
+    return NULL;
+}
+
+static int serverStart(Server *server, X509 *cert, EVP_PKEY *key, X509 *ca, uint16_t *port) {
+    memset(server, 0, sizeof(*server));
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_cond_init(&server->done, NULL);
+
+    server->ctx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX_set_max_proto_version(server->ctx, TLS1_2_VERSION); // As the ESP32 mbedTLS build
+    SSL_CTX_use_certificate(server->ctx, cert);
+    SSL_CTX_add1_chain_cert(server->ctx, ca);
+    SSL_CTX_use_PrivateKey(server->ctx, key);
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    socklen_t len = sizeof(addr);
+    if (server->listenFd < 0 ||
+        bind(server->listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listenFd, 16) != 0 ||
+        getsockname(server->listenFd, (struct sockaddr *)&addr, &len) != 0) {
+        perror("tls_bench: listen");
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, serverThread, server);
+    pthread_detach(thread);
+    return 0;
+}
+
+/* Client */
+
+/* Replaces the trust store with one parsed from PEM */
+static void loadCa(SSL_CTX *ctx, const char *caPem) {
+    X509_STORE *store = X509_STORE_new();
+    BIO *bio = BIO_new_mem_buf(caPem, -1);
+    X509 *ca = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+    X509_STORE_add_cert(store, ca);
+    X509_free(ca);
+    BIO_free(bio);
+    SSL_CTX_set_cert_store(ctx, store);
+}
+
+static SSL_CTX *clientContext(const char *caPem) {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    if (caPem) {
+        loadCa(ctx, caPem);
+    }
+    return ctx;
+}
+
+/* One connection; returns 1 on a verified handshake */
+static int connectOnce(uint16_t port, SSL_CTX *ctx) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("tls_bench: connect");
+        close(fd);
+        return 0;
+    }
+
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    SSL_set1_host(ssl, "127.0.0.1");
+    int ok = SSL_connect(ssl) == 1 && SSL_get_verify_result(ssl) == X509_V_OK;
+    if (ok) {
+        SSL_shutdown(ssl);
+    }
+    SSL_free(ssl);
+    close(fd);
+    return ok;
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *values, int n) {
+    qsort(values, (size_t)n, sizeof(double), compareDouble);
+    return values[n / 2];
+}
+
+static int runMode(Mode mode, int connections, uint16_t port, Server *server, const char *caPem) {
+    double *wall = malloc(sizeof(double) * connections);
+    double *client = malloc(sizeof(double) * connections);
+    double *serverCpu = malloc(sizeof(double) * connections);
+    SSL_CTX *ctx = clientContext(caPem);
+    int n = 0, failures = 0, warmupFailed = 0;
+
+    // One warm-up connection, kept out of the samples
+    for (int i = -1; i < connections; i++) {
+        unsigned served = server->served;
+        double w = nowUs(CLOCK_MONOTONIC);
+        double c = nowUs(CLOCK_THREAD_CPUTIME_ID);
+        if (mode == MODE_PEM) {
+            loadCa(ctx, caPem); // The context is kept, only the certificate is parsed again
+        }
+        int ok = connectOnce(port, ctx);
+        c = nowUs(CLOCK_THREAD_CPUTIME_ID) - c;
+        w = nowUs(CLOCK_MONOTONIC) - w;
+
+        pthread_mutex_lock(&server->lock);
+        while (server->served == served) {
+            pthread_cond_wait(&server->done, &server->lock);
+        }
+        double s = server->lastCpuUs;
+        pthread_mutex_unlock(&server->lock);
+
+        if (i < 0) {
+            warmupFailed = !ok;
+        } else if (!ok) {
+            failures++;
+        } else {
+            wall[n] = w;
+            client[n] = c;
+            serverCpu[n] = s;
+            n++;
+        }
+    }
+
+    if (n > 0) {
+        printf("%-8s %6d %10.0f %12.0f %12.0f\n", modeNames[mode], n,
+               median(wall, n), median(client, n), median(serverCpu, n));
+    }
+    if (warmupFailed) {
+        fprintf(stderr, "%s: warm-up handshake failed\n", modeNames[mode]);
+    }
+    if (failures) {
+        fprintf(stderr, "%s: %d failed handshakes\n", modeNames[mode], failures);
+    }
+
+    SSL_CTX_free(ctx);
+    free(wall);
+    free(client);
+    free(serverCpu);
+    return !warmupFailed && failures == 0;
+}
+
+int main(int argc, char **argv) {
+    int connections = argc > 1 ? atoi(argv[1]) : DEFAULT_CONNECTIONS;
+    if (connections < 1) {
+        connections = DEFAULT_CONNECTIONS;
+    }
+
+    EVP_PKEY *caKey = newKey();
+    EVP_PKEY *serverKey = newKey();
+    X509 *ca = newCert("Stand-in CA", caKey, NULL, NULL, 1);
+    X509 *cert = newCert("127.0.0.1", serverKey, ca, caKey, 2);
+
+    BIO *bio = BIO_new(BIO_s_mem());
+    PEM_write_bio_X509(bio, ca);
+    char *pem;
+    long pemLen = BIO_get_mem_data(bio, &pem);
+    char *caPem = strndup(pem, (size_t)pemLen);
+    BIO_free(bio);
+
+    Server server;
+    uint16_t port;
+    if (serverStart(&server, cert, serverKey, ca, &port) != 0) {
+        return 1;
+    }
+
+    printf("TLS 1.2, ECDSA P-256, %d connections per mode, medians\n", connections);
+    printf("%-8s %6s %10s %12s %12s\n", "mode", "ok", "wall us", "client cpu", "server cpu");
+    int ok = 1;
+    for (int mode = 0; mode < MODE_COUNT; mode++) {
+        ok &= runMode((Mode)mode, connections, port, &server, caPem);
+    }
+
+    // Without a trust anchor the handshake must fail (esp32_tls refuses to connect instead)
+    SSL_CTX *bare = clientContext(NULL);
+    unsigned served = server.served;
+    if (connectOnce(port, bare)) {
+        fprintf(stderr, "handshake without a trust anchor succeeded\n");
+        ok = 0;
+    } else {
+        printf("no trust anchor: handshake refused\n");
+    }
+    pthread_mutex_lock(&server.lock);
+    while (server.served == served) {
+        pthread_cond_wait(&server.done, &server.lock);
+    }
+    pthread_mutex_unlock(&server.lock);
+    SSL_CTX_free(bare);
+    ERR_clear_error();
+
+    free(caPem);
+    return ok ? 0 : 1;
+}
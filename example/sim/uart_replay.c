@@ -0,0 +1,305 @@
+/*
+ * Replays a UART capture into the STM32 firmware on the native HAL.
+ *
+ * stm32/main.c runs on the native shim in its own thread (built with
+ * -Dmain=stm32_main, as in cosim.c). The bytes the capture recorded towards
+ * the STM32 are injected through the USART2 RX interrupt path, either with the
+ * recorded timing or back to back (-f). What the firmware transmits is
+ * counted and hashed. In recorded-timing mode each transmit also blocks for
+ * its wire time at the captured baud rate, like the blocking
+ * HAL_UART_Transmit on the target.
+ *
+ * The report is meant to be diffed between builds. It gives the input
+ * throughput and the dispatch time of each message (the RX interrupt that
+ * receives the '\n'), as medians over the runs. It lists the bytes that
+ * arrived while the previous RX interrupt was still running for more than a
+ * byte time, which are overruns on the target. Delays of the host scheduler
+ * alone are not counted. It also
+ * hashes the firmware output, so a behaviour change shows up next to the
+ * timing.
+ *
+ * Captures come from NATIVE_CAPTURE=<file> (native or cosim build) or from
+ * the "[UCAP]" lines a target with -DUART_CAPTURE_SIZE=<n> logs when it
+ * receives a DataTransfer "UartCaptureDump".
+ *
+ * Usage: uart_replay [-f] [-r runs] capture
+ */
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal_shim.h"
+#include "uart_capture_file.h"
+
+#undef main // stm32/main.c is built with -Dmain=stm32_main
+
+#define SETTLE_MS  200 // Firmware init before the first run
+#define DRAIN_MS   200 // Output must be quiet this long to end a run
+#define MAX_RUNS   32
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME  16777619u
+
+/* Timing figures are doubles so medianOf() can take any of them */
+typedef struct {
+    double bytesPerSec;
+    double msgsPerSec;
+    double p50Us;
+    double p90Us;
+    double p99Us;
+    double maxUs;
+    double lateBytes;
+    uint32_t outBytes;
+    uint32_t outLines;
+    uint32_t outHash;
+} RunResult;
+
+int stm32_main(void);
+
+static UartCaptureImage image;
+static bool fastMode;
+static uint64_t byteNs;
+
+/* Firmware output of the current run; written from the main loop and the RX interrupt */
+static pthread_mutex_t outputLock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t outBytes, outLines, outHash;
+static uint64_t lastOutputNs;
+
+static uint64_t monotonicNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void waitUntil(uint64_t deadlineNs) {
+    uint64_t now = monotonicNs();
+    if (deadlineNs > now + 100000) {
+        struct timespec ts = {0, (long)(deadlineNs - now - 50000)}; // Sleep most of it, spin the rest
+        ts.tv_sec = ts.tv_nsec / 1000000000;
+        ts.tv_nsec %= 1000000000;
+        nanosleep(&ts, NULL);
+    }
+    while (monotonicNs() < deadlineNs) {
+    }
+}
+
+static uint32_t fnv1a(uint32_t hash, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint32_t countLines(const uint8_t *data, size_t len) {
+    uint32_t lines = 0;
+    for (size_t i = 0; i < len; i++) {
+        lines += data[i] == '\n';
+    }
+    return lines;
+}
+
+/* HAL_UART_Transmit of the STM32 */
+static void stmUartTx(void *ctx, const uint8_t *data, uint16_t len) {
+    (void)ctx;
+    if (!fastMode) {
+        waitUntil(monotonicNs() + len * byteNs); // Blocking transmit at the captured baud rate
+    }
+    pthread_mutex_lock(&outputLock);
+    outBytes += len;
+    outLines += countLines(data, len);
+    outHash = fnv1a(outHash, data, len);
+    lastOutputNs = monotonicNs();
+    pthread_mutex_unlock(&outputLock);
+}
+
+static void *stm32Thread(void *arg) {
+    (void)arg;
+    stm32_main();
+    return NULL;
+}
+
+static int compareU32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t *sorted, uint32_t n, uint32_t pct) {
+    return n ? sorted[(n - 1) * pct / 100] : 0;
+}
+
+/* Totals of the capture; the output is counted from the first byte to the STM32 on */
+typedef struct {
+    uint32_t records;
+    uint32_t inBytes;
+    uint32_t messages;
+    uint32_t outBytes;
+    uint32_t outHash;
+    uint64_t spanUs;
+} CaptureSummary;
+
+static void summarize(CaptureSummary *sum) {
+    UartCaptureRecord rec;
+    uint32_t offset = 0, lastStamp = 0;
+    bool started = false;
+
+    memset(sum, 0, sizeof(*sum));
+    sum->outHash = FNV_OFFSET;
+    while (uartCaptureNext(image.area, image.areaBytes, &offset, &rec)) {
+        sum->records++;
+        if (started) {
+            sum->spanUs += (uint32_t)(rec.stampUs - lastStamp); // Stamps wrap after 71 minutes
+        }
+        lastStamp = rec.stampUs;
+        if (rec.dir == UART_CAPTURE_TO_STM32) {
+            started = true;
+            sum->inBytes += rec.len;
+            sum->messages += countLines(rec.data, rec.len);
+        } else if (started) {
+            sum->outBytes += rec.len;
+            sum->outHash = fnv1a(sum->outHash, rec.data, rec.len);
+        }
+    }
+}
+
+static void runReplay(RunResult *result, uint32_t *latency, uint32_t maxMessages) {
+    UartCaptureRecord rec;
+    uint32_t offset = 0, messages = 0, inBytes = 0, lastStamp = 0;
+    uint64_t recordNs = 0, injectEndNs = 0;
+    bool started = false;
+
+    pthread_mutex_lock(&outputLock);
+    outBytes = 0;
+    outLines = 0;
+    outHash = FNV_OFFSET;
+    pthread_mutex_unlock(&outputLock);
+
+    memset(result, 0, sizeof(*result));
+    uint64_t startNs = monotonicNs();
+    while (uartCaptureNext(image.area, image.areaBytes, &offset, &rec)) {
+        if (started) {
+            recordNs += (uint64_t)(uint32_t)(rec.stampUs - lastStamp) * 1000;
+        }
+        lastStamp = rec.stampUs;
+        if (rec.dir != UART_CAPTURE_TO_STM32) {
+            continue;
+        }
+        started = true;
+
+        for (uint32_t i = 0; i < rec.len; i++) {
+            if (!fastMode) {
+                uint64_t due = startNs + recordNs + i * byteNs;
+                if (injectEndNs > due + byteNs) {
+                    result->lateBytes++; // The previous RX interrupt held the receiver too long
+                }
+                waitUntil(due);
+            }
+            uint64_t t0 = monotonicNs();
+            shimUartInject(USART2, rec.data[i]);
+            injectEndNs = monotonicNs();
+            if (rec.data[i] == '\n' && messages < maxMessages) {
+                latency[messages++] = (uint32_t)((injectEndNs - t0) / 1000);
+            }
+            inBytes++;
+        }
+    }
+    double seconds = (monotonicNs() - startNs) / 1e9;
+
+    do {
+        usleep(DRAIN_MS * 1000);
+    } while (monotonicNs() - lastOutputNs < DRAIN_MS * 1000000ull);
+
+    qsort(latency, messages, sizeof(uint32_t), compareU32);
+    result->bytesPerSec = seconds > 0 ? inBytes / seconds : 0;
+    result->msgsPerSec = seconds > 0 ? messages / seconds : 0;
+    result->p50Us = percentile(latency, messages, 50);
+    result->p90Us = percentile(latency, messages, 90);
+    result->p99Us = percentile(latency, messages, 99);
+    result->maxUs = percentile(latency, messages, 100);
+    pthread_mutex_lock(&outputLock);
+    result->outBytes = outBytes;
+    result->outLines = outLines;
+    result->outHash = outHash;
+    pthread_mutex_unlock(&outputLock);
+}
+
+/* Median of one timing field over the runs */
+static double medianOf(const RunResult *results, uint32_t runs, size_t field) {
+    double values[MAX_RUNS];
+    for (uint32_t r = 0; r < runs; r++) {
+        values[r] = *(const double *)((const char *)&results[r] + field);
+    }
+    qsort(values, runs, sizeof(double), compareDouble);
+    return values[(runs - 1) / 2];
+}
+
+#define MEDIAN(field) medianOf(results, runs, offsetof(RunResult, field))
+
+int main(int argc, char **argv) {
+    RunResult results[MAX_RUNS];
+    CaptureSummary sum;
+    uint32_t runs = 0;
+    pthread_t thread;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "fr:")) != -1) {
+        switch (opt) {
+            case 'f': fastMode = true; break;
+            case 'r': runs = (uint32_t)strtoul(optarg, NULL, 10); break;
+            default: optind = argc + 1; break;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-f] [-r runs] capture\n", argv[0]);
+        return 2;
+    }
+    if (uartCaptureLoad(argv[optind], &image)) {
+        fprintf(stderr, "uart_replay: %s is not a UART capture\n", argv[optind]);
+        return 1;
+    }
+    if (runs == 0) {
+        runs = fastMode ? 5 : 1;
+    }
+    runs = runs > MAX_RUNS ? MAX_RUNS : runs;
+    byteNs = 10000000000ull / (image.header.baud ? image.header.baud : 115200);
+    summarize(&sum);
+    uint32_t *latency = calloc(sum.messages + 1, sizeof(uint32_t));
+
+    shimUartSetTxHook(USART2, stmUartTx, NULL);
+    shimGpioSetInput(GPIOB, GPIO_PIN_0, GPIO_PIN_SET); // EV plugged in, as in cosim
+    if (!latency || pthread_create(&thread, NULL, stm32Thread, NULL)) {
+        fprintf(stderr, "uart_replay: cannot start the STM32 thread\n");
+        return 1;
+    }
+    usleep(SETTLE_MS * 1000);
+
+    for (uint32_t r = 0; r < runs; r++) {
+        runReplay(&results[r], latency, sum.messages);
+    }
+
+    uint32_t identical = 0;
+    for (uint32_t r = 0; r < runs; r++) {
+        identical += results[r].outHash == results[0].outHash;
+    }
+    printf("capture     %u records, %u messages / %u bytes to STM32, %u bytes from STM32, %.1f s, %u baud, "
+           "%u dropped\n", (unsigned)sum.records, (unsigned)sum.messages, (unsigned)sum.inBytes,
+           (unsigned)sum.outBytes, sum.spanUs / 1e6, (unsigned)image.header.baud,
+           (unsigned)image.header.dropped);
+    printf("replay      %s, %u runs (medians below)\n", fastMode ? "fast" : "recorded timing", (unsigned)runs);
+    printf("throughput  %.1f kB/s, %.1f msg/s\n", MEDIAN(bytesPerSec) / 1024,
+           MEDIAN(msgsPerSec));
+    printf("dispatch_us p50 %.0f p90 %.0f p99 %.0f max %.0f\n", MEDIAN(p50Us),
+           MEDIAN(p90Us), MEDIAN(p99Us), MEDIAN(maxUs));
+    printf("late_bytes  %.0f\n", MEDIAN(lateBytes));
+    printf("output      %u bytes, %u lines, fnv1a %08x (same in %u/%u runs; capture %08x, %s)\n",
+           (unsigned)results[0].outBytes, (unsigned)results[0].outLines, (unsigned)results[0].outHash,
+           (unsigned)identical, (unsigned)runs, (unsigned)sum.outHash,
+           results[0].outHash == sum.outHash ? "match" : "differs");
+    return 0; // Ends the firmware thread with the process
+}
@@ -0,0 +1,117 @@
+#include "virtual_uart.h"
+
+#include <stdlib.h>
+
+#define BITS_PER_BYTE 10 // Start + 8 data + stop
+#define POLL_BATCH    64
+
+static uint32_t nextRandom(VirtualUart *line) {
+    uint32_t x = line->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    line->rng = x;
+    return x;
+}
+
+static uint8_t applyBitErrors(VirtualUart *line, uint8_t byte) {
+    uint8_t flips = 0;
+
+    if (line->cfg.bitErrorRate <= 0.0) {
+        return byte;
+    }
+    for (int bit = 0; bit < 8; bit++) {
+        if (nextRandom(line) < line->cfg.bitErrorRate * 4294967296.0) {
+            flips |= (uint8_t)(1u << bit);
+        }
+    }
+    if (flips) {
+        line->corruptedBytes++;
+    }
+    return byte ^ flips;
+}
+
+int vuartInit(VirtualUart *line, const VirtualUartConfig *cfg) {
+    line->ring = malloc(cfg->txSize);
+    if (!line->ring || pthread_mutex_init(&line->lock, NULL)) {
+        free(line->ring);
+        return -1;
+    }
+    line->cfg = *cfg;
+    line->rng = cfg->seed ? cfg->seed : 1;
+    line->bytesSent = 0;
+    line->corruptedBytes = 0;
+    line->writeStalls = 0;
+    vuartConfigure(line, cfg->baud, cfg->bitErrorRate);
+    return 0;
+}
+
+void vuartFree(VirtualUart *line) {
+    pthread_mutex_destroy(&line->lock);
+    free(line->ring);
+    line->ring = NULL;
+}
+
+void vuartConfigure(VirtualUart *line, uint32_t baud, double bitErrorRate) {
+    pthread_mutex_lock(&line->lock);
+    line->cfg.baud = baud;
+    line->cfg.bitErrorRate = bitErrorRate;
+    line->byteNs = (uint64_t)BITS_PER_BYTE * 1000000000ull / baud;
+    line->head = 0;
+    line->count = 0;
+    line->nextDoneNs = 0;
+    line->wireFreeNs = 0;
+    pthread_mutex_unlock(&line->lock);
+}
+
+size_t vuartWrite(VirtualUart *line, const uint8_t *data, size_t len, uint64_t nowUs) {
+    uint64_t nowNs = nowUs * 1000;
+    size_t accepted = 0;
+
+    pthread_mutex_lock(&line->lock);
+    if (line->count == 0 && len > 0) {
+        // Idle line: the first byte starts now, or when the previous one has left
+        line->nextDoneNs = (line->wireFreeNs > nowNs ? line->wireFreeNs : nowNs) + line->byteNs;
+    }
+    while (accepted < len && line->count < line->cfg.txSize) {
+        line->ring[(line->head + line->count) % line->cfg.txSize] = data[accepted++];
+        line->count++;
+    }
+    if (accepted < len) {
+        line->writeStalls++;
+    }
+    pthread_mutex_unlock(&line->lock);
+    return accepted;
+}
+
+void vuartPoll(VirtualUart *line, uint64_t nowUs, VirtualUartDeliverFn deliver, void *ctx) {
+    uint64_t nowNs = nowUs * 1000;
+    uint8_t batch[POLL_BATCH];
+    size_t n;
+
+    do {
+        // Pop under the lock, deliver outside of it so receivers may block
+        n = 0;
+        pthread_mutex_lock(&line->lock);
+        while (n < POLL_BATCH && line->count > 0 && line->nextDoneNs <= nowNs) {
+            batch[n++] = applyBitErrors(line, line->ring[line->head]);
+            line->head = (line->head + 1) % line->cfg.txSize;
+            line->count--;
+            line->wireFreeNs = line->nextDoneNs;
+            line->nextDoneNs += line->byteNs;
+            line->bytesSent++;
+        }
+        pthread_mutex_unlock(&line->lock);
+
+        for (size_t i = 0; i < n; i++) {
+            deliver(ctx, batch[i]);
+        }
+    } while (n == POLL_BATCH);
+}
+
+bool vuartIdle(VirtualUart *line) {
+    pthread_mutex_lock(&line->lock);
+    bool idle = line->count == 0;
+    pthread_mutex_unlock(&line->lock);
+    return idle;
+}
@@ -0,0 +1,66 @@
+#ifndef VIRTUAL_UART_H
+#define VIRTUAL_UART_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * One direction of a simulated 8N1 UART line.
+ *
+ * The sender writes into a TX ring of fixed size (1 models a bare shift
+ * register, i.e. a blocking HAL_UART_Transmit) and gets backpressure when it
+ * is full. Bytes leave the ring one at a time at 10 bit times each and are
+ * handed to the receiver once their stop bit has been sent. Each data bit can
+ * be flipped with a given probability. Writers and the polling thread may
+ * run concurrently.
+ */
+
+typedef void (*VirtualUartDeliverFn)(void *ctx, uint8_t byte);
+
+typedef struct {
+    uint32_t baud;
+    uint32_t txSize;     // Sender TX ring in bytes
+    double bitErrorRate; // Per data bit, 0 = clean line
+    uint32_t seed;
+} VirtualUartConfig;
+
+typedef struct {
+    VirtualUartConfig cfg;
+    pthread_mutex_t lock;
+    uint8_t *ring;
+    uint32_t head;
+    uint32_t count;
+    uint64_t byteNs;
+    uint64_t nextDoneNs;  // End of the stop bit of the byte at head
+    uint64_t wireFreeNs;  // End of the last byte sent
+    uint32_t rng;
+    uint32_t bytesSent;
+    uint32_t corruptedBytes;
+    uint32_t writeStalls; // Writes that found the ring full
+} VirtualUart;
+
+int vuartInit(VirtualUart *line, const VirtualUartConfig *cfg);
+void vuartFree(VirtualUart *line);
+
+/* Changes the line parameters and drops anything still queued */
+void vuartConfigure(VirtualUart *line, uint32_t baud, double bitErrorRate);
+
+/* Queues up to len bytes, returns how many fit into the TX ring */
+size_t vuartWrite(VirtualUart *line, const uint8_t *data, size_t len, uint64_t nowUs);
+
+/* Delivers every byte that has finished on the wire by nowUs */
+void vuartPoll(VirtualUart *line, uint64_t nowUs, VirtualUartDeliverFn deliver, void *ctx);
+
+bool vuartIdle(VirtualUart *line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VIRTUAL_UART_H */
@@ -1,9 +1,26 @@
 #include "main.h"
 #include "lwip.h"
 #include "microocpp.h"
+#include "../common/link_protocol.h"
+#include "../common/probe.h"
+#include "../common/uart_capture.h"
+#include "../common/heap_stats.h"
+#include "../common/stack_watch.h"
+#include "../common/block_pool.h"
+#include "../common/msg_arena.h"
+#include "../common/str_intern.h"
+#include "../common/metering.h"
+#include "../common/fixed_point.h"
+#include "../common/fixed_bench.h"
+#include "uart_rx_line.h"
 #include <stdio.h>
 #include <string.h>
 
+/* Split Processing: 1 = ESP32 terminates OCPP-J and sends binary commands */
+#ifndef SPLIT_PROCESSING
+#define SPLIT_PROCESSING 0
+#endif
+
 /* Network Configuration */
 #define OCPP_BACKEND_URL   "ws://192.168.1.100:8180/steve/websocket/CentralSystemService"
 #define OCPP_CHARGE_BOX_ID "stm32-charger"
@@ -11,18 +28,112 @@
 /* UART for Communication with ESP32 */
 extern UART_HandleTypeDef huart2;
 
-#define UART_RX_BUFFER_SIZE 256
-char uartRxBuffer[UART_RX_BUFFER_SIZE];
-volatile uint16_t uartRxIndex = 0;
+#if SPLIT_PROCESSING
+LinkDecoder linkDecoder; // ~40 bytes instead of the 256 byte text buffer
+uint8_t uartRxByte;
+#else
+UartRxLine uartRxLine;
+#define STATS_LOG_INTERVAL_MS 60000
+MsgArena messageArena; // Everything one inbound message needs, reset after its dispatch
+uint8_t messageArenaBuf[MSG_ARENA_SIZE];
+#define REPLY_SIZE 96
+char pendingReply[REPLY_SIZE];     // Answer to the last CALL, sent from the main loop
+volatile bool replyPending = false;
+uint32_t repliesDropped = 0;       // Previous answer still pending, or too long
+
+/* OCPP-J CALL [2,"<uid>","<action>",{...}], strings copied into messageArena */
+typedef struct {
+    const char *uid;
+    const char *action;
+    const char *payload; // Into the receive buffer, from the opening brace
+} OcppCall;
+#endif
+
+/* Link Capture: RAM ring of the UART traffic, power of two bytes, 0 = off */
+#ifndef UART_CAPTURE_SIZE
+#define UART_CAPTURE_SIZE 0
+#endif
+#if UART_CAPTURE_SIZE
+UartCapture linkCapture;
+uint8_t linkCaptureRing[UART_CAPTURE_SIZE];
+volatile bool captureDumpRequested = false; // DataTransfer "UartCaptureDump" or a debugger
+#define CAPTURE(dir, data, len) uartCaptureAppend(&linkCapture, dir, data, len)
+#else
+#define CAPTURE(dir, data, len) ((void)0)
+#endif
+
+/* Heap Statistics: -DHEAP_STATS=1 with the malloc wraps (common/heap_stats.h) */
+#if HEAP_STATS
+volatile bool heapStatsRequested = false; // DataTransfer "HeapStats" or a debugger
+#endif
+
+/* Block Pools: -DBLOCK_POOL=1 with common/pool_new.cpp (common/block_pool.h) */
+#if BLOCK_POOL
+volatile bool poolStatsRequested = false; // DataTransfer "PoolStats" or a debugger
+#endif
+
+/* Stack High-Water Marks: MSP painted at boot (common/stack_watch.h) */
+#if STACK_WATCH
+volatile bool stackStatsRequested = false; // DataTransfer "StackStats" or a debugger
+volatile uint32_t stackAlarms = 0;         // Regions that reached their guard band
+#endif
+
+/* Fixed-Point Bench: soft-float against common/fixed_point.h in cycles, 0 = off (common/fixed_bench.h) */
+#ifndef FIXED_BENCH
+#define FIXED_BENCH 0
+#endif
+#if FIXED_BENCH
+volatile bool fixedBenchRequested = false; // DataTransfer "FixedBench" or a debugger
+#endif
+
+/* Interned Strings: the open transaction keeps its idTag as a handle (common/str_intern.h) */
+StrHandle transactionIdTag = STR_NONE;
+
+/* Energy Metering: TIM3 triggers ADC1 on PA0 (voltage) and PA1 (current) (common/metering.h) */
+ADC_HandleTypeDef hadc;
+DMA_HandleTypeDef hdma_adc;
+TIM_HandleTypeDef htim3;
+Meter energyMeter;
+uint16_t adcBuffer[2 * METER_BLOCK_PAIRS * 2]; // Two blocks of V, I pairs, DMA fills one while the other is processed
+
+/* Control Pilot: TIM1 CH1 on PA8, 1 kHz PWM with 1 µs ticks, so the compare is the duty cycle in 0.1 % */
+TIM_HandleTypeDef htim1;
+#define PILOT_PERIOD_TICKS 1000
+
+/* Link and Dispatch Statistics (both modes) */
+LinkStats linkStats;
+volatile uint32_t dispatchCount = 0;
+volatile uint32_t dispatchCyclesTotal = 0;
+volatile uint32_t dispatchCyclesMax = 0;
 
 /* Function Prototypes */
 void SystemClock_Config(void);
 void MX_GPIO_Init(void);
 void MX_USART2_UART_Init(void);
+void MX_DMA_Init(void);
+void MX_ADC_Init(void);
+void MX_TIM3_Init(void);
+void MX_TIM1_Init(void);
 void MX_LWIP_Init(void);
 void logMessage(const char *message);
+#if !SPLIT_PROCESSING
 void handleBackendMessage(const char *message);
+#endif
 void sendToBackend(const char *message);
+void handleLinkFrame(const LinkDecoder *frame);
+void sendLinkFrame(uint8_t type, const void *payload, uint8_t len);
+void linkTransmit(const uint8_t *data, uint16_t len);
+void readSysTick(uint32_t *tick, uint32_t *val);
+uint32_t cycleStamp(void);
+uint32_t captureMicros(void);
+void recordDispatch(uint32_t startCycles);
+uint32_t ramStaticBytes(void);
+uint32_t ramRxPathBytes(void);
+void logLine(void *ctx, const char *line);
+bool openTransaction(const char *idTag, size_t len);
+bool closeTransaction(uint8_t reason);
+void processAdcBlock(const uint16_t *block);
+void applyCurrentLimit(int32_t milliAmps);
 
 /* Callback Prototypes */
 float getEnergyMeterReading(void);
@@ -30,14 +141,40 @@ bool isConnectorPlugged(void);
 void setSmartChargingCurrent(float limit);
 
 int main(void) {
+#if STACK_WATCH
+    stackWatchInit(); // Before anything runs on the stack
+#endif
+
     /* Initialize Hardware */
     HAL_Init();
     SystemClock_Config();
     MX_GPIO_Init();
     MX_USART2_UART_Init();
+    MX_DMA_Init();
+    MX_ADC_Init();
+    MX_TIM3_Init();
+    MX_TIM1_Init();
     MX_LWIP_Init();
 
+    /* Latency Probes */
+#if defined(__ARM_ARCH_6M__)
+    probeInit(cycleStamp, (SysTick->LOAD + 1) * 1000u); // Cortex-M0 has no DWT
+#else
+    probeInit(NULL, SystemCoreClock); // DWT cycle counter, clock_gettime() on the host
+#endif
+#if UART_CAPTURE_SIZE
+    uartCaptureInit(&linkCapture, linkCaptureRing, UART_CAPTURE_SIZE, true, huart2.Init.BaudRate, captureMicros);
+#endif
+
+    /* Start Metering: conversions run from here on, blocks arrive every 10 ms */
+    meterInit(&energyMeter, METER_FULL_SCALE_MV, METER_FULL_SCALE_MA);
+    HAL_ADCEx_Calibration_Start(&hadc);
+    HAL_ADC_Start_DMA(&hadc, (uint32_t *)adcBuffer, sizeof(adcBuffer) / sizeof(adcBuffer[0]));
+    HAL_TIM_Base_Start(&htim3);
+    HAL_TIM_PWM_Start(&htim1, TIM_CHANNEL_1); // 100 % until a limit is set: no charging
+
     /* Initialize OCPP */
+    strInternInit();
     logMessage("[STM32] Initializing Micro OCPP...\r\n");
     mocpp_initialize(OCPP_BACKEND_URL, OCPP_CHARGE_BOX_ID, "STM32 Charger", "My Company");
     setEnergyMeterInput(getEnergyMeterReading);
@@ -45,9 +182,25 @@ int main(void) {
     setSmartChargingCurrentOutput(setSmartChargingCurrent);
 
     /* Enable UART Receive Interrupt */
-    HAL_UART_Receive_IT(&huart2, (uint8_t *)&uartRxBuffer[uartRxIndex], 1);
+#if SPLIT_PROCESSING
+    linkDecoderInit(&linkDecoder);
+    HAL_UART_Receive_IT(&huart2, &uartRxByte, 1);
+    bool permitted = false;
+#else
+    msgArenaInit(&messageArena, messageArenaBuf, sizeof(messageArenaBuf));
+    HAL_UART_Receive_IT(&huart2, uartRxLineSlot(&uartRxLine), 1);
+    uint32_t lastStatsLog = HAL_GetTick();
+#endif
+    bool relayClosed = false;
 
     while (1) {
+        /* Measurements of the Last Metering Window */
+#if SPLIT_PROCESSING
+        bool measured = meterUpdate(&energyMeter); // One window a second, each one goes to the ESP32
+#else
+        meterUpdate(&energyMeter);
+#endif
+
         /* Process OCPP Logic */
         mocpp_loop();
 
@@ -57,6 +210,85 @@ int main(void) {
         } else {
             HAL_GPIO_WritePin(GPIOA, GPIO_PIN_5, GPIO_PIN_RESET); // De-energize EV plug
         }
+        if (ocppPermitsCharge() != relayClosed) {
+            relayClosed = !relayClosed;
+            PROBE(PROBE_GPIO_WRITE);
+        }
+#if STACK_WATCH
+        stackAlarms += stackWatchCheck(logLine, NULL); // Guard band only, a few words per region
+#endif
+
+#if SPLIT_PROCESSING
+        /* Report Status Changes and Meter Readings as Binary Events */
+        if (ocppPermitsCharge() != permitted) {
+            permitted = ocppPermitsCharge();
+            LinkStatus status = {1, permitted ? LINK_STATUS_CHARGING : LINK_STATUS_AVAILABLE};
+            sendLinkFrame(LINK_EVT_STATUS, &status, sizeof(status));
+        }
+        if (measured) { // The ESP32 aggregates the readings into MeterValues (common/meter_agg.h)
+            LinkMeter meter = {1, (uint32_t)(meterEnergyMilliWh(&energyMeter) / 1000),
+                               (uint16_t)(energyMeter.milliWatts > 0 ? energyMeter.milliWatts / 1000 : 0),
+                               (uint16_t)(energyMeter.milliVolts / 100), (uint16_t)(energyMeter.milliAmps / 10)};
+            sendLinkFrame(LINK_EVT_METER, &meter, sizeof(meter));
+        }
+#else
+        if (replyPending) {
+            sendToBackend(pendingReply);
+            replyPending = false;
+        }
+
+        /* Report Dispatch Timing and Link Usage */
+        if (HAL_GetTick() - lastStatsLog >= STATS_LOG_INTERVAL_MS) {
+            char buffer[128];
+            lastStatsLog = HAL_GetTick();
+            sprintf(buffer, "[STM32] %lu cmds, %lu avg / %lu max cycles, link rx %lu / tx %lu bytes\r\n",
+                    (unsigned long)dispatchCount,
+                    (unsigned long)(dispatchCount ? dispatchCyclesTotal / dispatchCount : 0),
+                    (unsigned long)dispatchCyclesMax, (unsigned long)linkStats.rxBytes,
+                    (unsigned long)linkStats.txBytes);
+            logMessage(buffer);
+            sprintf(buffer, "[STM32] RAM %lu B static, %lu B receive path (text)\r\n",
+                    (unsigned long)ramStaticBytes(), (unsigned long)ramRxPathBytes());
+            logMessage(buffer);
+            probeExport(logLine, NULL); // Stage latency histograms
+            msgArenaExport(&messageArena, logLine, NULL);
+            strInternExport(logLine, NULL);
+            meterExport(&energyMeter, logLine, NULL);
+#if STACK_WATCH
+            stackWatchExport(logLine, NULL);
+#endif
+        }
+#if UART_CAPTURE_SIZE
+        if (captureDumpRequested) {
+            captureDumpRequested = false;
+            uartCaptureDumpHex(&linkCapture, logLine, NULL); // Not captured itself
+        }
+#endif
+#if HEAP_STATS
+        if (heapStatsRequested) {
+            heapStatsRequested = false;
+            heapStatsExport(logLine, NULL);
+        }
+#endif
+#if BLOCK_POOL
+        if (poolStatsRequested) {
+            poolStatsRequested = false;
+            poolExport(logLine, NULL);
+        }
+#endif
+#if STACK_WATCH
+        if (stackStatsRequested) {
+            stackStatsRequested = false;
+            stackWatchExport(logLine, NULL);
+        }
+#endif
+#if FIXED_BENCH
+        if (fixedBenchRequested) {
+            fixedBenchRequested = false;
+            fxBench(cycleStamp, "cycles", 100, logLine, NULL);
+        }
+#endif
+#endif
 
         /* Perform Other Tasks */
         HAL_Delay(10);
@@ -64,54 +296,422 @@ int main(void) {
 }
 
 /* UART Receive Callback */
+#if SPLIT_PROCESSING
 void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
     if (huart->Instance == USART2) { // UART2 (ESP32)
-        if (uartRxIndex < UART_RX_BUFFER_SIZE - 1) {
-            if (uartRxBuffer[uartRxIndex] == '\n') { // Message Complete
-                uartRxBuffer[uartRxIndex] = '\0';   // Null-terminate string
-                handleBackendMessage(uartRxBuffer); // Process message
-                uartRxIndex = 0;                    // Reset buffer index
-            } else {
-                uartRxIndex++; // Continue storing bytes
-            }
-        } else {
-            uartRxIndex = 0; // Buffer overflow, reset
+        linkStats.rxBytes++;
+        CAPTURE(UART_CAPTURE_TO_STM32, &uartRxByte, 1);
+        if (linkDecodeByte(&linkDecoder, uartRxByte)) { // Frame Complete
+            PROBE(PROBE_RX_DONE);
+            uint32_t start = cycleStamp();
+            linkStats.rxFrames++;
+            handleLinkFrame(&linkDecoder);
+            recordDispatch(start);
+        }
+
+        // Re-enable UART Receive Interrupt
+        HAL_UART_Receive_IT(huart, &uartRxByte, 1);
+    }
+}
+#else
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
+    if (huart->Instance == USART2) { // UART2 (ESP32)
+        linkStats.rxBytes++;
+        CAPTURE(UART_CAPTURE_TO_STM32, uartRxLineSlot(&uartRxLine), 1);
+        if (uartRxLineStore(&uartRxLine) == UART_RX_COMPLETE) {
+            PROBE(PROBE_RX_DONE);
+            uint32_t start = cycleStamp();
+            linkStats.rxFrames++;
+            handleBackendMessage(uartRxLine.buffer); // Process message
+            recordDispatch(start);
         }
 
         // Re-enable UART Receive Interrupt
-        HAL_UART_Receive_IT(huart, (uint8_t *)&uartRxBuffer[uartRxIndex], 1);
+        HAL_UART_Receive_IT(huart, uartRxLineSlot(&uartRxLine), 1);
     }
 }
+#endif
+
+/* ADC DMA Callbacks: the half of adcBuffer the DMA has just finished */
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc) {
+    if (hadc->Instance == ADC1) {
+        processAdcBlock(&adcBuffer[0]);
+    }
+}
+
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc) {
+    if (hadc->Instance == ADC1) {
+        processAdcBlock(&adcBuffer[METER_BLOCK_PAIRS * 2]);
+    }
+}
+
+void processAdcBlock(const uint16_t *block) {
+    uint32_t start = cycleStamp();
+    meterProcessBlock(&energyMeter, block, METER_BLOCK_PAIRS);
+    uint32_t cycles = cycleStamp() - start;
+    energyMeter.cyclesTotal += cycles;
+    if (cycles > energyMeter.cyclesMax) {
+        energyMeter.cyclesMax = cycles;
+    }
+}
+
+void DMA1_Channel1_IRQHandler(void) {
+    HAL_DMA_IRQHandler(&hdma_adc);
+}
+
+#if !SPLIT_PROCESSING
+static const char *skipSpace(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r') {
+        p++;
+    }
+    return p;
+}
+
+/* JSON string at p into the arena (escapes are kept as they are); returns the position after it */
+static const char *takeString(const char *p, const char **out) {
+    const char *start;
+
+    p = skipSpace(p);
+    if (*p != '"') {
+        return NULL;
+    }
+    for (start = ++p; *p && *p != '"'; p++) {
+        if (*p == '\\' && p[1]) {
+            p++;
+        }
+    }
+    if (*p != '"' || !(*out = msgArenaStrndup(&messageArena, start, (size_t)(p - start)))) {
+        return NULL;
+    }
+    return p + 1;
+}
+
+static const char *expect(const char *p, char c) {
+    p = skipSpace(p);
+    return *p == c ? p + 1 : NULL;
+}
+
+static bool parseCall(const char *message, OcppCall *call) {
+    const char *p = expect(message, '[');
+    if (!p || !(p = expect(p, '2')) || !(p = expect(p, ',')) || !(p = takeString(p, &call->uid)) ||
+        !(p = expect(p, ',')) || !(p = takeString(p, &call->action)) || !(p = expect(p, ','))) {
+        return false;
+    }
+    call->payload = skipSpace(p);
+    return *call->payload == '{';
+}
+
+/* String member of a payload, copied into the arena; a key search, not a full parser */
+static const char *payloadString(const char *payload, const char *key) {
+    size_t keyLen = strlen(key);
+    const char *value = NULL;
+
+    for (const char *p = strchr(payload, '"'); p; p = strchr(p + 1, '"')) {
+        if (!strncmp(p + 1, key, keyLen) && p[1 + keyLen] == '"') {
+            const char *colon = expect(p + 2 + keyLen, ':');
+            return colon && takeString(colon, &value) ? value : NULL;
+        }
+    }
+    return NULL;
+}
+
+/* CALLRESULT with a status, or CALLERROR NotImplemented when status is NULL */
+static void answerCall(const OcppCall *call, const char *status) {
+    const char *reply;
+    if (status) {
+        reply = msgArenaPrintf(&messageArena, "[3,\"%s\",{\"status\":\"%s\"}]", call->uid, status);
+    } else {
+        reply = msgArenaPrintf(&messageArena, "[4,\"%s\",\"NotImplemented\",\"%s\",{}]", call->uid,
+                               call->action);
+    }
+    if (!reply || replyPending || strlen(reply) >= REPLY_SIZE) {
+        repliesDropped++;
+        return;
+    }
+    strcpy(pendingReply, reply); // A blocking transmit here would overrun the next message
+    replyPending = true;
+}
+
+/* Bare text commands, for testing without a backend: the operation named anywhere in the line */
+static const char *bareCommand(const char *message) {
+    if (strstr(message, "RemoteStartTransaction")) {
+        return "RemoteStartTransaction";
+    }
+    if (strstr(message, "RemoteStopTransaction")) {
+        return "RemoteStopTransaction";
+    }
+    return NULL;
+}
+
+static bool isAction(const char *action, const char *name) {
+    return action && !strcmp(action, name);
+}
 
 /* Process Backend Message Received via ESP32 */
 void handleBackendMessage(const char *message) {
+    OcppCall call = {NULL, NULL, NULL};
+    const char *status = "Accepted"; // Answer to a CALL, NULL if not implemented
+
+    PROBE(PROBE_DISPATCH);
     logMessage("[STM32] Received message from backend:\r\n");
     logMessage(message);
+    bool isCall = parseCall(message, &call);
+    const char *action = isCall ? call.action : bareCommand(message);
+    const char *messageId = isAction(action, "DataTransfer") ? payloadString(call.payload, "messageId") : NULL;
 
     // Example: Handle specific OCPP operations
-    if (strstr(message, "RemoteStartTransaction")) {
-        beginTransaction("1234567890"); // Start a transaction with a dummy idTag
-        logMessage("[STM32] RemoteStartTransaction processed.\r\n");
-    } else if (strstr(message, "RemoteStopTransaction")) {
-        endTransaction();
-        logMessage("[STM32] RemoteStopTransaction processed.\r\n");
+    if (isAction(action, "RemoteStartTransaction")) {
+        const char *idTag = isCall ? payloadString(call.payload, "idTag") : NULL;
+        if (!idTag) {
+            idTag = "1234567890"; // Dummy idTag for a bare text command
+        }
+        if (openTransaction(idTag, strlen(idTag))) {
+            PROBE(PROBE_BEGIN_TX);
+            logMessage("[STM32] RemoteStartTransaction processed.\r\n");
+        } else {
+            status = "Rejected";
+        }
+    } else if (isAction(action, "RemoteStopTransaction")) {
+        if (closeTransaction(LINK_TX_REASON_REMOTE)) {
+            logMessage("[STM32] RemoteStopTransaction processed.\r\n");
+        } else {
+            status = "Rejected"; // No transaction open
+        }
+#if UART_CAPTURE_SIZE
+    } else if (isAction(messageId, "UartCaptureDump")) {
+        captureDumpRequested = true; // Dumped from the main loop, not from this interrupt
+#endif
+#if HEAP_STATS
+    } else if (isAction(messageId, "HeapStats")) {
+        heapStatsRequested = true; // mallinfo() walks the free list, not from this interrupt
+#endif
+#if BLOCK_POOL
+    } else if (isAction(messageId, "PoolStats")) {
+        poolStatsRequested = true;
+#endif
+#if STACK_WATCH
+    } else if (isAction(messageId, "StackStats")) {
+        stackStatsRequested = true;
+#endif
+#if FIXED_BENCH
+    } else if (isAction(messageId, "FixedBench")) {
+        fixedBenchRequested = true; // Takes milliseconds, not from this interrupt
+#endif
+    } else {
+        status = NULL;
+    }
+
+    if (isCall) {
+        answerCall(&call, status);
     }
+    msgArenaReset(&messageArena, isCall ? call.action : NULL); // Frees all of the above at once
+}
+#endif
+
+/* Process Binary Command from ESP32 (split mode) */
+void handleLinkFrame(const LinkDecoder *frame) {
+    LinkResult result = {0, LINK_RESULT_REJECTED};
+
+    PROBE(PROBE_DISPATCH);
+    if (frame->len >= sizeof(result.msgId)) {
+        memcpy(&result.msgId, frame->payload, sizeof(result.msgId));
+    }
+
+    switch (frame->type) {
+        case LINK_CMD_REMOTE_START:
+            if (frame->len == sizeof(LinkRemoteStart)) {
+                const char *idTag = ((const LinkRemoteStart *)frame->payload)->idTag;
+                if (openTransaction(idTag, strnlen(idTag, LINK_ID_TAG_LEN))) {
+                    PROBE(PROBE_BEGIN_TX);
+                    result.result = LINK_RESULT_ACCEPTED;
+                }
+            }
+            break;
+
+        case LINK_CMD_REMOTE_STOP:
+            if (frame->len == sizeof(LinkRemoteStop)) {
+                if (closeTransaction(LINK_TX_REASON_REMOTE)) { // The ESP32 has matched the transactionId
+                    result.result = LINK_RESULT_ACCEPTED;
+                }
+            }
+            break;
+
+        case LINK_CMD_SET_CURRENT_LIMIT:
+            if (frame->len == sizeof(LinkSetCurrentLimit)) {
+                const LinkSetCurrentLimit *cmd = (const LinkSetCurrentLimit *)frame->payload;
+                applyCurrentLimit(cmd->limitDeciAmps * 100);
+                result.result = LINK_RESULT_ACCEPTED;
+            }
+            break;
+
+        case LINK_CMD_GET_STATS: {
+            LinkStatsReport report;
+            report.commands = dispatchCount;
+            report.avgCycles = dispatchCount ? dispatchCyclesTotal / dispatchCount : 0;
+            report.maxCycles = dispatchCyclesMax;
+            report.rxBytes = linkStats.rxBytes;
+            report.txBytes = linkStats.txBytes;
+            report.ramStatic = (uint16_t)ramStaticBytes();
+            report.ramRxPath = (uint16_t)ramRxPathBytes();
+            sendLinkFrame(LINK_EVT_STATS, &report, sizeof(report));
+            return;
+        }
+
+        default:
+            break;
+    }
+    sendLinkFrame(LINK_EVT_RESULT, &result, sizeof(result));
+}
+
+/*
+ * Transaction with its idTag interned; false if the tag is too long or the
+ * table is full. In split mode the ESP32 learns of it from LINK_EVT_TX_BEGIN
+ * and LINK_EVT_TX_END, since it sends the Start/StopTransaction.
+ */
+bool openTransaction(const char *idTag, size_t len) {
+    StrHandle handle = strIntern(idTag, len);
+    bool opened = transactionIdTag == STR_NONE;
+    if (handle == STR_INVALID) {
+        return false;
+    }
+    strRelease(transactionIdTag); // A second RemoteStart replaces the tag
+    transactionIdTag = handle;
+    beginTransaction(strText(handle));
+#if SPLIT_PROCESSING
+    if (opened) {
+        LinkTxBegin begin = {1, (uint32_t)(meterEnergyMilliWh(&energyMeter) / 1000), {0}};
+        memcpy(begin.idTag, idTag, len); // At most LINK_ID_TAG_LEN, or strIntern() refused it
+        sendLinkFrame(LINK_EVT_TX_BEGIN, &begin, sizeof(begin));
+    }
+#else
+    (void)opened;
+#endif
+    return true;
+}
+
+/* false if no transaction is open */
+bool closeTransaction(uint8_t reason) {
+    bool open = transactionIdTag != STR_NONE;
+    endTransaction();
+    strRelease(transactionIdTag);
+    transactionIdTag = STR_NONE;
+#if SPLIT_PROCESSING
+    if (open) {
+        LinkTxEnd end = {1, reason, (uint32_t)(meterEnergyMilliWh(&energyMeter) / 1000)};
+        sendLinkFrame(LINK_EVT_TX_END, &end, sizeof(end));
+    }
+#else
+    (void)reason;
+#endif
+    return open;
+}
+
+/* Send Binary Event to ESP32 (split mode) */
+void sendLinkFrame(uint8_t type, const void *payload, uint8_t len) {
+    uint8_t frame[LINK_MAX_FRAME];
+    size_t size = linkEncodeFrame(frame, type, payload, len);
+    linkTransmit(frame, size);
+    linkStats.txBytes += size;
+    linkStats.txFrames++;
 }
 
 /* Send Message to Backend via ESP32 */
 void sendToBackend(const char *message) {
-    HAL_UART_Transmit(&huart2, (uint8_t *)message, strlen(message), HAL_MAX_DELAY);
-    HAL_UART_Transmit(&huart2, (uint8_t *)"\n", 1, HAL_MAX_DELAY); // Add newline for message delimiter
+    size_t len = strlen(message);
+    linkTransmit((const uint8_t *)message, len);
+    linkTransmit((const uint8_t *)"\n", 1); // Add newline for message delimiter
+    linkStats.txBytes += len + 1;
+    linkStats.txFrames++;
+}
+
+/* Blocking Transmit to ESP32 (every byte goes through the link capture) */
+void linkTransmit(const uint8_t *data, uint16_t len) {
+    CAPTURE(UART_CAPTURE_TO_ESP32, data, len);
+    HAL_UART_Transmit(&huart2, (uint8_t *)data, len, HAL_MAX_DELAY);
 }
 
 /* Logging Helper */
 void logMessage(const char *message) {
-    HAL_UART_Transmit(&huart2, (uint8_t *)message, strlen(message), HAL_MAX_DELAY);
+#if !SPLIT_PROCESSING // The link carries binary frames only in split mode
+    linkTransmit((const uint8_t *)message, strlen(message));
+#else
+    (void)message;
+#endif
+}
+
+/*
+ * Consistent HAL tick and SysTick counter pair. Called from interrupts at the
+ * SysTick priority (TICK_INT_PRIORITY 0), where the tick interrupt cannot run:
+ * a wrap then shows as a pending SysTick, and the tick it would add is added
+ * here so that stamps never jump back.
+ */
+void readSysTick(uint32_t *tick, uint32_t *val) {
+    uint32_t before;
+    do {
+        before = HAL_GetTick();
+        *tick = before;
+        *val = SysTick->VAL;
+        if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+            *val = SysTick->VAL; // Read after the wrap was seen, so from the new period
+            *tick = before + 1;
+        }
+    } while (before != HAL_GetTick()); // Retry if the tick interrupt hit in between
+}
+
+/* CPU Cycle Stamp from SysTick (the Cortex-M0 has no DWT cycle counter) */
+uint32_t cycleStamp(void) {
+    uint32_t reload = SysTick->LOAD + 1;
+    uint32_t tick, val;
+    readSysTick(&tick, &val);
+    return tick * reload + (reload - 1 - val);
+}
+
+/* Microsecond Clock of the Link Capture */
+uint32_t captureMicros(void) {
+    uint32_t reload = SysTick->LOAD + 1;
+    uint32_t tick, val;
+    readSysTick(&tick, &val);
+    return tick * 1000u + (reload - 1 - val) * 1000u / reload;
+}
+
+/* Static RAM (.data + .bss) from the linker script, unknown on a host */
+uint32_t ramStaticBytes(void) {
+#if defined(__arm__)
+    extern uint8_t _sdata, _ebss; // Linker script
+    return (uint32_t)(&_ebss - &_sdata);
+#else
+    return 0;
+#endif
+}
+
+/* RAM the backend receive path needs in this mode */
+uint32_t ramRxPathBytes(void) {
+#if SPLIT_PROCESSING
+    return sizeof(linkDecoder) + sizeof(uartRxByte);
+#else
+    return sizeof(uartRxLine.buffer) + sizeof(messageArenaBuf) + sizeof(pendingReply);
+#endif
+}
+
+void recordDispatch(uint32_t startCycles) {
+    uint32_t cycles = cycleStamp() - startCycles;
+    dispatchCount++;
+    dispatchCyclesTotal += cycles;
+    if (cycles > dispatchCyclesMax) {
+        dispatchCyclesMax = cycles;
+    }
+}
+
+/* Probe, Capture, Heap and Stack Export over the Logging UART */
+void logLine(void *ctx, const char *line) {
+    (void)ctx;
+    logMessage(line);
+    logMessage("\r\n");
 }
 
 /* Energy Meter Reading Callback */
 float getEnergyMeterReading(void) {
-    return 1234.5f; // Example static value. Replace with actual ADC reading or sensor data.
+    return (float)meterEnergyMilliWh(&energyMeter) * 0.001f; // The library wants float Wh
 }
 
 /* Connector Plugged Status Callback */
@@ -121,8 +721,17 @@ bool isConnectorPlugged(void) {
 
 /* Smart Charging Limit Callback */
 void setSmartChargingCurrent(float limit) {
-    char buffer[50];
-    sprintf(buffer, "[STM32] Smart Charging Limit: %.2f\n", limit);
+    applyCurrentLimit((int32_t)fxMulShift(fxFromFloat(limit, 16), 1000, 16)); // No soft-float
+}
+
+/* Current Limit to Control Pilot Duty Cycle */
+void applyCurrentLimit(int32_t milliAmps) {
+    char buffer[64];
+    milliAmps = milliAmps > 0 ? milliAmps : 0;
+    uint16_t duty = fxPilotDuty(milliAmps);
+    __HAL_TIM_SET_COMPARE(&htim1, TIM_CHANNEL_1, duty); // Takes effect at the next period
+    sprintf(buffer, "[STM32] Smart Charging Limit: %ld.%02ld A, pilot %u.%u%%\n", (long)(milliAmps / 1000),
+            (long)(milliAmps % 1000 / 10), (unsigned)(duty / 10), (unsigned)(duty % 10));
     logMessage(buffer);
 }
 
@@ -163,6 +772,113 @@ void MX_USART2_UART_Init(void) {
     HAL_UART_Init(&huart2);
 }
 
+void MX_DMA_Init(void) {
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    /* ADC1 half- and full-transfer interrupts */
+    HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+}
+
+void MX_ADC_Init(void) {
+    ADC_ChannelConfTypeDef sConfig = {0};
+
+    hadc.Instance = ADC1;
+    hadc.Init.ClockPrescaler = ADC_CLOCK_ASYNC_DIV1;
+    hadc.Init.Resolution = ADC_RESOLUTION_12B;
+    hadc.Init.DataAlign = ADC_DATAALIGN_RIGHT;
+    hadc.Init.ScanConvMode = ADC_SCAN_DIRECTION_FORWARD; // Channel 0 (voltage), then 1 (current)
+    hadc.Init.EOCSelection = ADC_EOC_SEQ_CONV;
+    hadc.Init.LowPowerAutoWait = DISABLE;
+    hadc.Init.LowPowerAutoPowerOff = DISABLE;
+    hadc.Init.ContinuousConvMode = DISABLE;
+    hadc.Init.DiscontinuousConvMode = DISABLE;
+    hadc.Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T3_TRGO;
+    hadc.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+    hadc.Init.DMAContinuousRequests = ENABLE;
+    hadc.Init.Overrun = ADC_OVR_DATA_OVERWRITTEN;
+    HAL_ADC_Init(&hadc);
+
+    sConfig.Channel = ADC_CHANNEL_0;
+    sConfig.Rank = ADC_RANK_CHANNEL_NUMBER;
+    sConfig.SamplingTime = ADC_SAMPLETIME_7CYCLES_5;
+    HAL_ADC_ConfigChannel(&hadc, &sConfig);
+    sConfig.Channel = ADC_CHANNEL_1;
+    HAL_ADC_ConfigChannel(&hadc, &sConfig);
+}
+
+void HAL_ADC_MspInit(ADC_HandleTypeDef *adcHandle) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    if (adcHandle->Instance == ADC1) {
+        __HAL_RCC_ADC1_CLK_ENABLE();
+
+        /* PA0: voltage divider, PA1: current transformer burden */
+        GPIO_InitStruct.Pin = GPIO_PIN_0 | GPIO_PIN_1;
+        GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
+        GPIO_InitStruct.Pull = GPIO_NOPULL;
+        HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+        /* Circular half-word transfers: an interrupt at each half of adcBuffer */
+        hdma_adc.Instance = DMA1_Channel1;
+        hdma_adc.Init.Direction = DMA_PERIPH_TO_MEMORY;
+        hdma_adc.Init.PeriphInc = DMA_PINC_DISABLE;
+        hdma_adc.Init.MemInc = DMA_MINC_ENABLE;
+        hdma_adc.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+        hdma_adc.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+        hdma_adc.Init.Mode = DMA_CIRCULAR;
+        hdma_adc.Init.Priority = DMA_PRIORITY_HIGH;
+        HAL_DMA_Init(&hdma_adc);
+        __HAL_LINKDMA(adcHandle, DMA_Handle, hdma_adc);
+    }
+}
+
+void MX_TIM3_Init(void) {
+    TIM_MasterConfigTypeDef sMasterConfig = {0};
+
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    htim3.Instance = TIM3;
+    htim3.Init.Prescaler = 0;
+    htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim3.Init.Period = SystemCoreClock / METER_SAMPLE_HZ - 1; // Update event triggers both conversions
+    htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    HAL_TIM_Base_Init(&htim3);
+
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
+    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    HAL_TIMEx_MasterConfigSynchronization(&htim3, &sMasterConfig);
+}
+
+void MX_TIM1_Init(void) {
+    TIM_OC_InitTypeDef sConfigOC = {0};
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    __HAL_RCC_TIM1_CLK_ENABLE();
+    htim1.Instance = TIM1;
+    htim1.Init.Prescaler = SystemCoreClock / 1000000 - 1; // 1 µs ticks
+    htim1.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim1.Init.Period = PILOT_PERIOD_TICKS - 1;
+    htim1.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim1.Init.RepetitionCounter = 0;
+    htim1.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    HAL_TIM_PWM_Init(&htim1);
+
+    sConfigOC.OCMode = TIM_OCMODE_PWM1;
+    sConfigOC.Pulse = PILOT_PERIOD_TICKS; // Compare past the period: high all the time
+    sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+    sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+    HAL_TIM_PWM_ConfigChannel(&htim1, &sConfigOC, TIM_CHANNEL_1);
+
+    /* PA8: TIM1_CH1 to the control pilot driver */
+    GPIO_InitStruct.Pin = GPIO_PIN_8;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    GPIO_InitStruct.Alternate = GPIO_AF2_TIM1;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+}
+
 void MX_LWIP_Init(void) {
     // Ethernet stack setup (auto-generated via STM32CubeMX)
 }
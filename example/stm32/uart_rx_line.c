@@ -0,0 +1,20 @@
+#include "uart_rx_line.h"
+
+UartRxStatus uartRxLineStore(UartRxLine *line) {
+    uint16_t index = line->index;
+    if (line->buffer[index] == UART_RX_CANCEL) {
+        line->index = 0;
+        return UART_RX_CANCELLED;
+    }
+    if (index >= UART_RX_BUFFER_SIZE - 1) {
+        line->index = 0; // Buffer overflow, reset
+        return UART_RX_OVERFLOW;
+    }
+    if (line->buffer[index] == '\n') { // Message Complete
+        line->buffer[index] = '\0';    // Null-terminate string
+        line->index = 0;               // Reset buffer index
+        return UART_RX_COMPLETE;
+    }
+    line->index = index + 1; // Continue storing bytes
+    return UART_RX_PENDING;
+}
@@ -0,0 +1,47 @@
+#ifndef UART_RX_LINE_H
+#define UART_RX_LINE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Text-mode receive buffer of the STM32 (stm32/main.c).
+ *
+ * The RX interrupt receives each byte in place: HAL_UART_Receive_IT() is
+ * armed on uartRxLineSlot(), and uartRxLineStore() then looks at the byte it
+ * wrote. A '\n' ends the line, which is handed on as a NUL-terminated string
+ * in buffer; it stays valid until the receive is armed again. sim/framers.c
+ * runs this same code in the framer suite.
+ */
+
+#define UART_RX_BUFFER_SIZE 256
+#define UART_RX_CANCEL 0x18 // UART_STREAM_CANCEL (esp32/uart_stream.h): discard the partial line
+
+typedef struct {
+    char buffer[UART_RX_BUFFER_SIZE];
+    volatile uint16_t index;
+} UartRxLine;
+
+typedef enum {
+    UART_RX_PENDING,   // Byte stored
+    UART_RX_COMPLETE,  // buffer holds the line without its '\n'
+    UART_RX_CANCELLED, // The bridge aborted this message, discarded
+    UART_RX_OVERFLOW   // Buffer full, the line so far is discarded
+} UartRxStatus;
+
+/* Where the next byte is received */
+static inline uint8_t *uartRxLineSlot(UartRxLine *line) {
+    return (uint8_t *)&line->buffer[line->index];
+}
+
+/* Takes the byte just received into the slot */
+UartRxStatus uartRxLineStore(UartRxLine *line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UART_RX_LINE_H */
@@ -1,5 +1,7 @@
 #include "main.h"
 #include "microocpp.h"
+#include "../common/ocpp_config.h"
+#include "../common/flash_kv.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -13,9 +15,33 @@ extern UART_HandleTypeDef huart2;
 char uartBuffer[UART_BUFFER_SIZE];
 uint16_t uartIndex = 0;
 
+// Get/ChangeConfiguration CALL, answered from the main loop (the reply can be 2 KB)
+char configCall[UART_BUFFER_SIZE];
+volatile bool configCallPending = false;
+
+// Changed configuration values, kept in the flash the linker script reserves (flash_kv.h)
+extern "C" const uint8_t _kvstore_start[], _kvstore_end[];
+FlashKv configStore;
+bool configStoreMounted = false;
+#define CONFIG_FLUSH_INTERVAL_MS 60000 // Staged changes reach the flash at most this late (flash_kv_sim: 60 s)
+uint32_t lastConfigFlush = 0;
+
+// Store keys after the OcppConfigId values
+#define KV_KEY_TX_SEQ OCPP_CONFIG_KEY_COUNT         // Transactions started, uint32_t
+#define KV_KEY_TX     (OCPP_CONFIG_KEY_COUNT + 1)   // The open transaction: its number and idTag
+uint32_t txSeq = 0;
+volatile bool txStarted = false, txStopped = false; // Saved from the main loop, a page erase stalls 40 ms
+
 // Function Prototypes
 void handleBackendMessage(const char *message);
 void sendToBackend(const char *message);
+void uartWrite(void *ctx, const char *data, size_t len);
+void answerConfigCall(const char *message);
+bool kvProgram(void *ctx, uint32_t offset, const uint16_t *data, uint32_t halfWords);
+bool kvErase(void *ctx, uint32_t page);
+void loadConfig(void);
+void saveConfig(int id, bool now);
+void saveTransaction(const char *idTag);
 
 void SystemClock_Config(void);
 void MX_GPIO_Init(void);
@@ -27,6 +53,10 @@ int main(void) {
     MX_GPIO_Init();
     MX_USART2_UART_Init();
 
+    // Configuration keys: names and defaults in flash, values in a packed RAM block
+    ocppConfigInit();
+    loadConfig(); // Values changed before the last reset replace the defaults
+
     mocpp_initialize(
         nullptr,                // No direct backend connection
         OCPP_CHARGE_BOX_ID,     // Charge box ID
@@ -36,9 +66,26 @@ int main(void) {
     );
 
     HAL_UART_Receive_IT(&huart2, (uint8_t *)&uartBuffer[uartIndex], 1);
+    lastConfigFlush = HAL_GetTick();
 
     while (1) {
         mocpp_loop();
+        if (configCallPending) {
+            answerConfigCall(configCall);
+            configCallPending = false;
+        }
+        if (txStarted) {
+            txStarted = false;
+            saveTransaction("1234567890");
+        }
+        if (txStopped) {
+            txStopped = false;
+            saveTransaction(NULL);
+        }
+        if (configStoreMounted && HAL_GetTick() - lastConfigFlush >= CONFIG_FLUSH_INTERVAL_MS) {
+            flashKvFlush(&configStore); // One record per changed key, however often it changed
+            lastConfigFlush = HAL_GetTick();
+        }
         HAL_Delay(10); // Main loop delay
     }
 }
@@ -64,9 +111,146 @@ void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart) {
 void handleBackendMessage(const char *message) {
     if (strstr(message, "RemoteStartTransaction")) {
         beginTransaction("1234567890"); // Start transaction with dummy idTag
+        txStarted = true;
     } else if (strstr(message, "RemoteStopTransaction")) {
         endTransaction(); // End current transaction
+        txStopped = true;
+    } else if ((strstr(message, "\"GetConfiguration\"") || strstr(message, "\"ChangeConfiguration\"")) &&
+               !configCallPending) {
+        strcpy(configCall, message); // Same size as uartBuffer
+        configCallPending = true;
+    }
+}
+
+void uartWrite(void *ctx, const char *data, size_t len) {
+    (void)ctx;
+    HAL_UART_Transmit(&huart2, (uint8_t *)data, len, HAL_MAX_DELAY);
+}
+
+// [2,"<uid>","<action>",{payload}] -> [3,"<uid>",{...}]
+void answerConfigCall(const char *message) {
+    const char *uid = strchr(message, '"');
+    const char *uidEnd = uid ? strchr(uid + 1, '"') : NULL;
+    const char *action = uidEnd ? strchr(uidEnd + 1, '"') : NULL;
+    const char *payload = action ? strchr(action, '{') : NULL;
+
+    if (!payload) {
+        return;
+    }
+    uartWrite(NULL, "[3,", 3);
+    uartWrite(NULL, uid, (size_t)(uidEnd - uid + 1));
+    uartWrite(NULL, ",", 1);
+    if (!strncmp(action, "\"GetConfiguration\"", 18)) {
+        ocppConfigGet(payload, uartWrite, NULL); // Streamed, never held in RAM
+    } else {
+        OcppConfigStatus result = ocppConfigChange(payload);
+        if (result == OCPP_CONFIG_ACCEPTED || result == OCPP_CONFIG_REBOOT_REQUIRED) {
+            // A key that takes effect after a reboot is in flash before the backend sees the answer
+            saveConfig(ocppConfigChangeKey(payload), result == OCPP_CONFIG_REBOOT_REQUIRED);
+        }
+        uartWrite(NULL, "{\"status\":\"", 11);
+        const char *status = ocppConfigStatusName(result);
+        uartWrite(NULL, status, strlen(status));
+        uartWrite(NULL, "\"}", 2);
+    }
+    uartWrite(NULL, "]\n", 2);
+}
+
+/*
+ * Key-value store device. The CPU stalls while the flash is busy: a page erase
+ * takes up to 40 ms, so a CALL arriving meanwhile can overrun the UART. Erases
+ * only happen when a 1 KB page fills up.
+ */
+bool kvProgram(void *ctx, uint32_t offset, const uint16_t *data, uint32_t halfWords) {
+    bool ok = true;
+    (void)ctx;
+    HAL_FLASH_Unlock();
+    for (uint32_t i = 0; ok && i < halfWords; i++) {
+        ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, (uint32_t)_kvstore_start + offset + 2 * i, data[i]) == HAL_OK;
+    }
+    HAL_FLASH_Lock();
+    return ok;
+}
+
+bool kvErase(void *ctx, uint32_t page) {
+    FLASH_EraseInitTypeDef erase;
+    uint32_t pageError;
+    bool ok;
+    (void)ctx;
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.PageAddress = (uint32_t)_kvstore_start + page * FLASH_PAGE_SIZE;
+    erase.NbPages = 1;
+    HAL_FLASH_Unlock();
+    ok = HAL_FLASHEx_Erase(&erase, &pageError) == HAL_OK;
+    HAL_FLASH_Lock();
+    return ok;
+}
+
+/*
+ * Key = OcppConfigId, value = the OCPP text form. The transaction counter and
+ * the open transaction follow the configuration keys. The authorization cache
+ * is MicroOcpp's and stays in RAM (FilesystemOpt::Use_InMemory); it would
+ * need a MicroOcpp filesystem adapter on this store.
+ */
+void loadConfig(void) {
+    FlashKvDevice device = {_kvstore_start, FLASH_PAGE_SIZE, (uint32_t)(_kvstore_end - _kvstore_start) / FLASH_PAGE_SIZE,
+                            kvProgram, kvErase, nullptr};
+    char value[FLASH_KV_MAX_VALUE];
+
+    configStoreMounted = flashKvMount(&configStore, &device) == FLASH_KV_OK;
+    for (uint32_t id = 0; configStoreMounted && id < OCPP_CONFIG_KEY_COUNT; id++) {
+        int len = flashKvGet(&configStore, (uint16_t)id, value, sizeof(value));
+        if (len >= 0) {
+            ocppConfigSet((OcppConfigId)id, value, (size_t)len);
+        }
+    }
+    if (configStoreMounted && flashKvGet(&configStore, KV_KEY_TX_SEQ, &txSeq, sizeof(txSeq)) != sizeof(txSeq)) {
+        txSeq = 0;
+    }
+    int len = configStoreMounted ? flashKvGet(&configStore, KV_KEY_TX, value, sizeof(value) - 1) : -1;
+    if (len > (int)sizeof(uint32_t)) {
+        uint32_t number;
+        char line[80];
+        memcpy(&number, value, sizeof(number));
+        value[len] = '\0';
+        snprintf(line, sizeof(line), "[STM32] Transaction %lu (%s) was open at reset\r\n", (unsigned long)number,
+                 value + sizeof(number));
+        uartWrite(nullptr, line, strlen(line));
+        saveTransaction(NULL);
+    }
+}
+
+// Staged until the main loop's next flush, unless now is set
+void saveConfig(int id, bool now) {
+    char value[FLASH_KV_MAX_VALUE + 1];
+
+    if (!configStoreMounted || id < 0) {
+        return;
+    }
+    size_t len = ocppConfigFormat((OcppConfigId)id, value, sizeof(value));
+    if (flashKvSet(&configStore, (uint16_t)id, value, len) == FLASH_KV_OK && now) {
+        flashKvFlush(&configStore);
+    }
+}
+
+// Transaction start (idTag) or stop (NULL); flushed at once, with any staged configuration
+void saveTransaction(const char *idTag) {
+    uint8_t record[sizeof(uint32_t) + 21]; // Number and an idTag of up to 20 characters
+
+    if (!configStoreMounted) {
+        return;
+    }
+    if (idTag) {
+        size_t len = strnlen(idTag, sizeof(record) - sizeof(txSeq));
+        txSeq++;
+        memcpy(record, &txSeq, sizeof(txSeq));
+        memcpy(record + sizeof(txSeq), idTag, len);
+        flashKvSet(&configStore, KV_KEY_TX_SEQ, &txSeq, sizeof(txSeq));
+        flashKvSet(&configStore, KV_KEY_TX, record, (uint32_t)(sizeof(txSeq) + len));
+    } else if (flashKvGet(&configStore, KV_KEY_TX, record, sizeof(record)) >= 0) {
+        flashKvDelete(&configStore, KV_KEY_TX);
     }
+    flashKvFlush(&configStore);
 }
 
 void sendToBackend(const char *message) {
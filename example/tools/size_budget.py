@@ -0,0 +1,546 @@
+#!/usr/bin/env python3
+"""
+Flash/RAM budget report for the STM32 firmware images.
+
+Reads a linked ELF (and its linker map, when one sits next to it) and prints
+the flash and RAM use, a per-module and a per-symbol breakdown, and the
+change against a stored baseline. It exits with 1 when a budget is exceeded,
+so it can gate a build. Nothing but Python 3 is needed: the ELF is parsed
+here, not with binutils.
+
+  size_budget.py firmware.elf [--map firmware.map] [--baseline size_baseline.json]
+                 [--flash-budget 60K] [--ram-budget 7K] [--max-growth 512]
+                 [--update-baseline] [--top 15]
+
+Flash is every allocated PROGBITS section that loads into the FLASH region
+(.isr_vector, .text, .rodata, the .data initialisers, ...). RAM is every
+allocated section in the RAM region. The part of it that only reserves heap
+and stack (._user_heap_stack, _Min_Heap_Size + _Min_Stack_Size) is shown
+separately. The RAM budget applies to the total, as the linker does.
+
+Modules come from the input sections listed in the map, so every byte is
+attributed. Without a map, symbols are grouped by the compile unit whose code
+range (.debug_aranges) holds them, then by the source file of local symbols;
+what is left is listed as "(globals)" and "(unattributed)".
+
+As a PlatformIO extra script (extra_scripts = post:<path>/size_budget.py) it
+writes a map during the link and adds two targets:
+
+  pio run -e nucleo_f030r8 -t size_budget      report and gate
+  pio run -e nucleo_f030r8 -t size_baseline    store the current sizes as the baseline
+
+Options in the environment: custom_flash_budget, custom_ram_budget,
+custom_size_max_growth, custom_size_baseline (default size_baseline.json in
+the project) and custom_size_gate = yes to run the gate after every build.
+"""
+import argparse
+import bisect
+import json
+import os
+import re
+import struct
+import sys
+
+# STM32F030R8 when the map does not give the regions
+DEFAULT_REGIONS = {"FLASH": (0x08000000, 64 * 1024), "RAM": (0x20000000, 8 * 1024)}
+
+SHT_PROGBITS = 1
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+SHF_ALLOC = 0x2
+PT_LOAD = 1
+STT_OBJECT = 1
+STT_FUNC = 2
+STT_FILE = 4
+STB_LOCAL = 0
+
+
+def parseSize(text):
+    """60K, 0xF000, 61440"""
+    text = str(text).strip()
+    scale = 1
+    if text[-1:] in "kK":
+        text, scale = text[:-1], 1024
+    return int(text, 0) * scale
+
+
+# ELF
+
+class Elf:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        d = self.data
+        if d[:4] != b"\x7fELF" or d[5] != 1:
+            raise ValueError("%s is not a little-endian ELF file" % path)
+        self.is64 = d[4] == 2
+        if self.is64:
+            (phoff, shoff) = struct.unpack_from("<QQ", d, 0x20)
+            (phentsize, phnum, shentsize, shnum, shstrndx) = struct.unpack_from("<HHHHH", d, 0x36)
+        else:
+            (phoff, shoff) = struct.unpack_from("<II", d, 0x1C)
+            (phentsize, phnum, shentsize, shnum, shstrndx) = struct.unpack_from("<HHHHH", d, 0x2A)
+
+        self.segments = []
+        for i in range(phnum):
+            off = phoff + i * phentsize
+            if self.is64:
+                ptype, _, poff, vaddr, paddr, filesz, memsz = struct.unpack_from("<IIQQQQQ", d, off)
+            else:
+                ptype, poff, vaddr, paddr, filesz, memsz = struct.unpack_from("<IIIIII", d, off)
+            if ptype == PT_LOAD:
+                self.segments.append((vaddr, paddr, memsz))
+
+        self.sections = []
+        for i in range(shnum):
+            off = shoff + i * shentsize
+            if self.is64:
+                name, stype, flags, addr, soff, size, link, _, _, entsize = struct.unpack_from(
+                    "<IIQQQQIIQQ", d, off)
+            else:
+                name, stype, flags, addr, soff, size, link, _, _, entsize = struct.unpack_from(
+                    "<IIIIIIIIII", d, off)
+            self.sections.append({"nameOff": name, "type": stype, "flags": flags, "addr": addr,
+                                  "offset": soff, "size": size, "link": link, "entsize": entsize})
+        strtab = self.sections[shstrndx]
+        for s in self.sections:
+            s["name"] = self.cstring(strtab["offset"] + s["nameOff"])
+            s["lma"] = self.loadAddress(s["addr"])
+
+    def cstring(self, off):
+        return self.data[off:self.data.index(b"\0", off)].decode("latin-1")
+
+    def loadAddress(self, addr):
+        for vaddr, paddr, memsz in self.segments:
+            if vaddr <= addr < vaddr + memsz:
+                return paddr + (addr - vaddr)
+        return addr
+
+    def symbols(self):
+        """(name, value, size, type, bind, section index, file) in table order"""
+        for s in self.sections:
+            if s["type"] != SHT_SYMTAB:
+                continue
+            strOff = self.sections[s["link"]]["offset"]
+            current = None
+            for off in range(s["offset"], s["offset"] + s["size"], s["entsize"]):
+                if self.is64:
+                    name, info, _, shndx, value, size = struct.unpack_from("<IBBHQQ", self.data, off)
+                else:
+                    name, value, size, info, _, shndx = struct.unpack_from("<IIIBBH", self.data, off)
+                stype, bind = info & 0xF, info >> 4
+                symName = self.cstring(strOff + name)
+                if stype == STT_FILE:
+                    current = symName
+                    continue
+                yield symName, value, size, stype, bind, shndx, current if bind == STB_LOCAL else None
+
+    def section(self, name):
+        return next((s for s in self.sections if s["name"] == name), None)
+
+    def compileUnits(self):
+        """Sorted (start, end, source) code ranges from .debug_aranges, empty without debug info"""
+        aranges, info, abbrev, strs = (self.section(n) for n in (
+            ".debug_aranges", ".debug_info", ".debug_abbrev", ".debug_str"))
+        if not (aranges and info and abbrev):
+            return []
+        ranges = []
+        names = {}
+        off, end = aranges["offset"], aranges["offset"] + aranges["size"]
+        while off + 12 <= end:
+            length, _, cu, addrSize, _ = struct.unpack_from("<IHIBB", self.data, off)
+            if length == 0xFFFFFFFF or addrSize not in (4, 8):
+                break # 64-bit DWARF is not used on these targets
+            entry = off + 12
+            entry += -(entry - off) % (2 * addrSize)
+            fmt = "<II" if addrSize == 4 else "<QQ"
+            while entry + 2 * addrSize <= off + 4 + length:
+                start, size = struct.unpack_from(fmt, self.data, entry)
+                entry += 2 * addrSize
+                if start == 0 and size == 0:
+                    break
+                if cu not in names:
+                    names[cu] = self.unitName(info, abbrev, strs, cu) or "cu@%x" % cu
+                ranges.append((start, start + size, names[cu]))
+            off += 4 + length
+        return sorted(ranges)
+
+    def unitName(self, info, abbrev, strs, cu):
+        """DW_AT_name of the compile unit DIE at cu, or None for forms not handled here"""
+        d = self.data
+        off = info["offset"] + cu
+        version = struct.unpack_from("<H", d, off + 4)[0]
+        if version >= 5:
+            addrSize, abbrevOff = struct.unpack_from("<BI", d, off + 7)
+            off += 12
+        else:
+            abbrevOff, addrSize = struct.unpack_from("<IB", d, off + 6)
+            off += 11
+        code, off = uleb(d, off)
+
+        a = abbrev["offset"] + abbrevOff
+        while True:
+            entryCode, a = uleb(d, a)
+            if entryCode == 0:
+                return None
+            _, a = uleb(d, a)
+            a += 1 # DW_CHILDREN
+            attrs = []
+            while True:
+                attr, a = uleb(d, a)
+                form, a = uleb(d, a)
+                if form == 0x21: # DW_FORM_implicit_const
+                    _, a = uleb(d, a)
+                if attr == 0 and form == 0:
+                    break
+                attrs.append((attr, form))
+            if entryCode == code:
+                break
+
+        fixed = {0x01: addrSize, 0x05: 2, 0x06: 4, 0x07: 8, 0x0B: 1, 0x0C: 1, 0x0E: 4, 0x10: 4, 0x11: 1,
+                 0x12: 2, 0x13: 4, 0x14: 8, 0x17: 4, 0x19: 0, 0x1F: 4, 0x21: 0}
+        for attr, form in attrs:
+            if attr == 0x03: # DW_AT_name
+                if form == 0x08:
+                    return self.cstring(off)
+                if form == 0x0E and strs:
+                    return self.cstring(strs["offset"] + struct.unpack_from("<I", d, off)[0])
+                return None
+            if form in fixed:
+                off += fixed[form]
+            elif form == 0x08:
+                off = d.index(b"\0", off) + 1
+            elif form in (0x0D, 0x0F, 0x15):
+                _, off = uleb(d, off)
+            elif form in (0x18, 0x09):
+                size, off = uleb(d, off)
+                off += size
+            elif form == 0x0A:
+                off += 1 + d[off]
+            else:
+                return None
+        return None
+
+
+def uleb(data, off):
+    value = shift = 0
+    while True:
+        byte = data[off]
+        off += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if byte < 0x80:
+            return value, off
+
+
+def inRegion(regions, name, addr):
+    origin, length = regions[name]
+    return origin <= addr < origin + length
+
+
+def classifySections(elf, regions):
+    """Section name -> (bytes in flash, bytes in RAM) for one byte of the section"""
+    classes = {}
+    for s in elf.sections:
+        if not s["flags"] & SHF_ALLOC or s["size"] == 0:
+            continue
+        flash = s["type"] != SHT_NOBITS and inRegion(regions, "FLASH", s["lma"])
+        ram = inRegion(regions, "RAM", s["addr"])
+        if flash or ram:
+            classes[s["name"]] = (int(flash), int(ram))
+    return classes
+
+
+def isReservation(name):
+    return "heap" in name or "stack" in name
+
+
+# Linker map
+
+SECTION_LINE = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S.*))?$")
+
+
+def moduleName(path):
+    """./Core/Src/main.o -> main.o, .../libc_nano.a(lib_a-memcpy.o) -> libc_nano.a(lib_a-memcpy.o)"""
+    path = path.strip()
+    m = re.match(r"^(.*?)([^/\\]+\.a)\((.+)\)$", path)
+    if m:
+        return "%s(%s)" % (m.group(2), m.group(3))
+    return os.path.basename(path)
+
+
+def parseMap(path):
+    """Regions and {output section: [(module, size)]} from a GNU ld map"""
+    regions = {}
+    contributions = {}
+    with open(path, errors="replace") as f:
+        lines = f.read().splitlines()
+
+    i = 0
+    while i < len(lines) and not lines[i].startswith("Memory Configuration"):
+        i += 1
+    for line in lines[i + 1:]:
+        if line.startswith("Linker script and memory map"):
+            break
+        fields = line.split()
+        if len(fields) >= 3 and fields[1].startswith("0x") and fields[0] != "*default*":
+            regions[fields[0]] = (int(fields[1], 16), int(fields[2], 16))
+
+    output = None
+    pending = None # Input section whose name filled its own line
+    for line in lines[i:]:
+        if not line:
+            continue
+        if not line[0].isspace():
+            fields = line.split()
+            output = fields[0] if fields[0].startswith(".") else None
+            pending = None
+            continue
+        if output is None:
+            continue
+        stripped = line.strip()
+        if stripped.startswith("*fill*"):
+            fields = stripped.split()
+            if len(fields) >= 3:
+                contributions.setdefault(output, []).append(("(fill)", int(fields[2], 16)))
+            continue
+        if line.startswith(" .") or line.startswith(" COMMON"):
+            fields = stripped.split(None, 3)
+            if len(fields) == 1:
+                pending = fields[0]
+                continue
+            if len(fields) >= 4 and fields[1].startswith("0x"):
+                contributions.setdefault(output, []).append((moduleName(fields[3]), int(fields[2], 16)))
+            continue
+        if pending:
+            m = SECTION_LINE.match(line)
+            if m and m.group(3):
+                contributions.setdefault(output, []).append((moduleName(m.group(3)), int(m.group(2), 16)))
+            pending = None
+    return regions, contributions
+
+
+# Report
+
+def measure(elfPath, mapPath):
+    elf = Elf(elfPath)
+    regions = dict(DEFAULT_REGIONS)
+    contributions = None
+    if mapPath:
+        mapRegions, contributions = parseMap(mapPath)
+        regions.update({k: v for k, v in mapRegions.items() if k in regions})
+    classes = classifySections(elf, regions)
+
+    sizes = {"flash": 0, "ramStatic": 0, "ramReserved": 0,
+             "flashSize": regions["FLASH"][1], "ramSize": regions["RAM"][1]}
+    for s in elf.sections:
+        if s["name"] not in classes:
+            continue
+        flash, ram = classes[s["name"]]
+        sizes["flash"] += flash * s["size"]
+        if isReservation(s["name"]):
+            sizes["ramReserved"] += ram * s["size"]
+        else:
+            sizes["ramStatic"] += ram * s["size"]
+
+    modules = {}
+
+    def add(table, key, flash, ram):
+        entry = table.setdefault(key, [0, 0])
+        entry[0] += flash
+        entry[1] += ram
+
+    if contributions is not None:
+        for s in elf.sections:
+            if s["name"] not in classes:
+                continue
+            flash, ram = classes[s["name"]]
+            if isReservation(s["name"]):
+                add(modules, "(heap+stack)", flash * s["size"], ram * s["size"])
+                continue
+            attributed = 0
+            for module, size in contributions.get(s["name"], []):
+                add(modules, module, flash * size, ram * size)
+                attributed += size
+            rest = s["size"] - attributed # Assignments such as ". = . + _Min_Stack_Size"
+            if rest > 0:
+                add(modules, "(linker %s)" % s["name"], flash * rest, ram * rest)
+
+    units = elf.compileUnits() if contributions is None else []
+    starts = [u[0] for u in units]
+
+    def unitOf(addr):
+        i = bisect.bisect_right(starts, addr) - 1
+        return units[i][2] if i >= 0 and addr < units[i][1] else None
+
+    symbols = {}
+    byIndex = {i: s["name"] for i, s in enumerate(elf.sections)}
+    for name, value, size, stype, bind, shndx, source in elf.symbols():
+        section = byIndex.get(shndx)
+        if size == 0 or stype not in (STT_FUNC, STT_OBJECT) or section not in classes:
+            continue
+        flash, ram = classes[section]
+        add(symbols, name, flash * size, ram * size)
+        if contributions is None:
+            module = unitOf(value & ~1) or source or "(globals)" # Thumb functions have bit 0 set
+            add(modules, os.path.basename(module), flash * size, ram * size)
+    if contributions is None:
+        attributedFlash = sum(v[0] for v in modules.values())
+        attributedRam = sum(v[1] for v in modules.values())
+        add(modules, "(unattributed)", sizes["flash"] - attributedFlash,
+            sizes["ramStatic"] + sizes["ramReserved"] - attributedRam)
+
+    return {"elf": os.path.basename(elfPath), "map": os.path.basename(mapPath) if mapPath else None,
+            "sizes": sizes, "modules": modules, "symbols": symbols}
+
+
+def percent(part, whole):
+    return 100.0 * part / whole if whole else 0.0
+
+
+def signed(value):
+    return "%+d" % value if value else "."
+
+
+def printTable(title, table, base, top):
+    """Largest entries first, then the largest changes among the rest"""
+    rows = []
+    for key in set(table) | set(base or {}):
+        now = table.get(key, [0, 0])
+        old = base.get(key, [0, 0]) if base else now
+        rows.append((key, now, now[0] - old[0], now[1] - old[1]))
+    rows.sort(key=lambda r: (-(r[1][0] + r[1][1]), r[0]))
+    shown, hidden = rows[:top], rows[top:]
+
+    def printRow(key, now, dFlash, dRam):
+        line = "%-40s %8d %8d" % (key[:40], now[0], now[1])
+        if base:
+            line += "   %8s %8s" % (signed(dFlash), signed(dRam))
+            if key not in base:
+                line += "  new"
+            elif key not in table:
+                line += "  removed"
+        print(line)
+
+    print("\n%-40s %8s %8s" % (title, "flash", "ram") + ("   %8s %8s" % ("Δflash", "Δram") if base else ""))
+    for row in shown:
+        printRow(*row)
+    if hidden:
+        print("%-40s %8d %8d" % ("(%d more)" % len(hidden), sum(r[1][0] for r in hidden),
+                                 sum(r[1][1] for r in hidden)))
+    changed = [r for r in hidden if r[2] or r[3]] if base else []
+    if changed:
+        print("changed among those:")
+    for row in sorted(changed, key=lambda r: -abs(r[2]) - abs(r[3]))[:top]:
+        printRow(*row)
+
+
+def report(result, baseline, flashBudget, ramBudget, maxGrowth, top):
+    s = result["sizes"]
+    ram = s["ramStatic"] + s["ramReserved"]
+    failures = []
+    print("size_budget: %s%s" % (result["elf"], " (map %s)" % result["map"] if result["map"] else " (no map)"))
+    print("%-14s %8s %8s %7s %8s" % ("region", "used", "size", "use", "budget"))
+
+    def row(label, used, size, budget):
+        print("%-14s %8d %8d %6.1f%% %8s" % (label, used, size, percent(used, size),
+                                          budget if budget is not None else "-"))
+
+    row("flash", s["flash"], s["flashSize"], flashBudget)
+    row("ram", ram, s["ramSize"], ramBudget)
+    row("  static", s["ramStatic"], s["ramSize"], None)
+    row("  heap+stack", s["ramReserved"], s["ramSize"], None)
+
+    if flashBudget is not None and s["flash"] > flashBudget:
+        failures.append("flash %d > budget %d" % (s["flash"], flashBudget))
+    if ramBudget is not None and ram > ramBudget:
+        failures.append("ram %d > budget %d" % (ram, ramBudget))
+
+    base = baseline or {}
+    if baseline:
+        b = baseline["sizes"]
+        dFlash = s["flash"] - b["flash"]
+        dRam = ram - b["ramStatic"] - b["ramReserved"]
+        print("baseline       flash %s, ram %s (static %s, heap+stack %s) against %s" % (
+            signed(dFlash), signed(dRam), signed(s["ramStatic"] - b["ramStatic"]),
+            signed(s["ramReserved"] - b["ramReserved"]), baseline.get("elf", "?")))
+        if maxGrowth is not None and dFlash > maxGrowth:
+            failures.append("flash grew %d > %d" % (dFlash, maxGrowth))
+        if maxGrowth is not None and dRam > maxGrowth:
+            failures.append("ram grew %d > %d" % (dRam, maxGrowth))
+
+    printTable("module", result["modules"], base.get("modules"), top)
+    printTable("symbol", result["symbols"], base.get("symbols"), top)
+
+    for failure in failures:
+        print("size_budget: FAIL %s" % failure)
+    return 1 if failures else 0
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description="Flash/RAM budget report from an ELF and its map")
+    parser.add_argument("elf")
+    parser.add_argument("--map", help="linker map (default: <elf>.map when it exists)")
+    parser.add_argument("--baseline", help="baseline JSON to diff against")
+    parser.add_argument("--update-baseline", action="store_true", help="write the current sizes to --baseline")
+    parser.add_argument("--flash-budget", type=parseSize)
+    parser.add_argument("--ram-budget", type=parseSize)
+    parser.add_argument("--max-growth", type=parseSize, help="largest allowed growth against the baseline")
+    parser.add_argument("--top", type=int, default=15, help="rows per table")
+    args = parser.parse_args(argv)
+
+    mapPath = args.map
+    if mapPath is None and os.path.exists(os.path.splitext(args.elf)[0] + ".map"):
+        mapPath = os.path.splitext(args.elf)[0] + ".map"
+    try:
+        result = measure(args.elf, mapPath)
+    except (OSError, ValueError, struct.error) as e:
+        print("size_budget: %s" % e, file=sys.stderr)
+        return 2
+
+    if args.update_baseline:
+        if not args.baseline:
+            print("size_budget: --update-baseline needs --baseline", file=sys.stderr)
+            return 2
+        with open(args.baseline, "w") as f:
+            json.dump(result, f, indent=1, sort_keys=True)
+            f.write("\n")
+        print("size_budget: baseline %s updated" % args.baseline)
+        return 0
+
+    baseline = None
+    if args.baseline and os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    return report(result, baseline, args.flash_budget, args.ram_budget, args.max_growth, args.top)
+
+
+def registerPlatformIO(env):
+    import inspect
+    script = os.path.abspath(inspect.getframeinfo(inspect.currentframe()).filename)
+    elf = "$BUILD_DIR/${PROGNAME}.elf"
+    env.Append(LINKFLAGS=["-Wl,-Map,$BUILD_DIR/${PROGNAME}.map"])
+
+    baseline = env.GetProjectOption("custom_size_baseline", "size_baseline.json")
+    command = '"$PYTHONEXE" "%s" "%s" --baseline "%s"' % (
+        script, elf, os.path.join(env.subst("$PROJECT_DIR"), baseline))
+    for option, flag in (("custom_flash_budget", "--flash-budget"), ("custom_ram_budget", "--ram-budget"),
+                         ("custom_size_max_growth", "--max-growth")):
+        value = env.GetProjectOption(option, "")
+        if value:
+            command += " %s %s" % (flag, value)
+
+    env.AddCustomTarget("size_budget", elf, command, title="Size budget",
+                        description="Flash/RAM report against the baseline and budgets")
+    env.AddCustomTarget("size_baseline", elf, command + " --update-baseline", title="Size baseline",
+                        description="Store the current flash/RAM use as the baseline")
+    if env.GetProjectOption("custom_size_gate", "no").lower() in ("yes", "true", "1"):
+        env.AddPostAction(elf, command)
+
+
+try:
+    Import("env") # noqa: F821 (PlatformIO/SCons extra script)
+    registerPlatformIO(env) # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        sys.exit(main())
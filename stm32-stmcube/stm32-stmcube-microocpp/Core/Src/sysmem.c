@@ -22,6 +22,7 @@
 
 /* Includes */
 #include <errno.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /**
@@ -29,6 +30,11 @@
  */
 static uint8_t *__sbrk_heap_end = NULL;
 
+/**
+ * Heap instrumentation (example/common/heap_stats.c), called when linked in
+ */
+extern void heapStatsSbrk(uint32_t arenaBytes, uint32_t limitBytes, bool ok) __attribute__((weak));
+
 /**
  * @brief _sbrk() allocates memory to the newlib heap and is used by malloc
  *        and others from the C library
@@ -68,12 +74,20 @@ void *_sbrk(ptrdiff_t incr)
   /* Protect heap from growing into the reserved MSP stack */
   if (__sbrk_heap_end + incr > max_heap)
   {
+    if (heapStatsSbrk)
+    {
+      heapStatsSbrk(__sbrk_heap_end - &_end, max_heap - &_end, false);
+    }
     errno = ENOMEM;
     return (void *)-1;
   }
 
   prev_heap_end = __sbrk_heap_end;
   __sbrk_heap_end += incr;
+  if (heapStatsSbrk)
+  {
+    heapStatsSbrk(__sbrk_heap_end - &_end, max_heap - &_end, true);
+  }
 
   return (void *)prev_heap_end;
 }